@@ -0,0 +1,440 @@
+// DDS Tracing Library - adaptive export-rate-controlled sampling
+// Keeps the exported span rate near a budget through bursts (e.g. a sensor
+// flood into track-fusion). Root spans the configured sampler keeps are
+// thinned per span name:
+//
+//   - every span name gets a probability, applied to the trace id, and a
+//     token bucket capping its sampled roots within one control interval
+//   - every interval a controller measures root rates per name, exported
+//     spans per sampled root and the exporter queue depth, and shares the
+//     budget max-min fair between names: quiet names keep probability 1,
+//     flooding names are cut to their share
+//   - with the exporter queue more than half full the budget shrinks, down
+//     to 5% of it when the queue is full
+//
+// A probability that drops applies at once; one that rises moves halfway
+// per interval. Sampled roots carry the probability they were kept with as
+// sampling.probability: the configured sampler's (OTEL_TRACES_SAMPLER, the
+// TRACED_SAMPLING_RULES '*' ratio or the live sampling-ratio) times the name's
+// probability times the share of its roots that found a token in the last
+// interval. 1/probability re-weights counts; without the attribute (a sampler
+// of unknown probability) it does not. Root writes kept by a
+// TRACED_SAMPLING_RULES rule are never thinned.
+//
+// Configuration via environment variables:
+//   TRACED_ADAPTIVE_SPANS_PER_SEC - exported span budget (unset: off)
+//   TRACED_ADAPTIVE_INTERVAL_MS   - control interval (default: 500)
+//
+// The queue depth is counted around the batch span processor (sampled spans
+// handed in minus spans reaching the exporter); spans the full queue drops
+// are written off when the count exceeds the queue size.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+
+#include "opentelemetry/sdk/trace/exporter.h"
+#include "opentelemetry/sdk/trace/processor.h"
+#include "opentelemetry/sdk/trace/sampler.h"
+
+#include "traced_runtime.hpp"
+#include "traced_sampling.hpp"
+
+namespace traced {
+namespace adaptive {
+
+namespace nostd = opentelemetry::nostd;
+namespace common = opentelemetry::common;
+namespace trace_api = opentelemetry::trace;
+namespace trace_sdk = opentelemetry::sdk::trace;
+
+inline constexpr int MAX_NAMES = 64;            // last slot shared by overflow names
+inline constexpr size_t NAME_LEN = 48;
+inline constexpr double MIN_PRESSURE_FACTOR = 0.05;
+
+/**
+ * Per-span-name sampling state; written by the controller, read lock-free
+ * by the sampler
+ */
+struct Bucket {
+    std::atomic<uint64_t> hash{0};          // 0 = free
+    std::atomic<bool> ready{false};         // name copied
+    char name[NAME_LEN] = {0};
+    std::atomic<uint32_t> threshold{UINT32_MAX};   // probability * 2^32
+    std::atomic<int64_t> tokens{0};
+    std::atomic<double> token_share{1.0};  // of passed roots that found a token, last interval
+    std::atomic<uint64_t> seen{0};          // roots the configured sampler kept
+    std::atomic<uint64_t> passed{0};        // ... that the probability kept
+    std::atomic<uint64_t> sampled{0};       // ... that found a token
+
+    // Controller state
+    uint64_t last_seen = 0;
+    uint64_t last_passed = 0;
+    uint64_t last_sampled = 0;
+};
+
+namespace internal {
+
+inline bool g_enabled = false;
+inline double g_budget = 0;                 // spans/s
+inline size_t g_interval_ms = 500;
+
+inline std::atomic<uint64_t> g_enqueued{0}; // sampled spans into the span processor
+inline std::atomic<uint64_t> g_exported{0}; // spans handed to the exporter
+inline Bucket g_buckets[MAX_NAMES];
+
+// Read once, before the exporter is created
+inline bool load_config() {
+    static bool loaded = [] {
+        g_budget = static_cast<double>(runtime::internal::env_size("TRACED_ADAPTIVE_SPANS_PER_SEC", 0));
+        g_interval_ms = runtime::internal::env_size("TRACED_ADAPTIVE_INTERVAL_MS", 500);
+        if (g_interval_ms == 0) g_interval_ms = 500;
+        g_enabled = g_budget > 0;
+        Bucket& overflow = g_buckets[MAX_NAMES - 1];
+        strcpy(overflow.name, "(other)");
+        overflow.ready.store(true);
+        return true;
+    }();
+    return loaded && g_enabled;
+}
+
+inline uint64_t name_hash(nostd::string_view name) {
+    uint64_t h = 1469598103934665603ULL;
+    for (char c : name) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 1099511628211ULL;
+    }
+    return h | 1;       // never 0
+}
+
+// Open addressing, slots are claimed once and never freed
+inline Bucket& bucket(nostd::string_view name) {
+    uint64_t h = name_hash(name);
+    for (int probe = 0; probe < MAX_NAMES - 1; probe++) {
+        Bucket& b = g_buckets[(h + probe) % (MAX_NAMES - 1)];
+        uint64_t current = b.hash.load(std::memory_order_acquire);
+        if (current == h) return b;
+        if (current != 0) continue;
+        if (b.hash.compare_exchange_strong(current, h, std::memory_order_acq_rel)) {
+            size_t len = std::min(name.size(), NAME_LEN - 1);
+            memcpy(b.name, name.data(), len);
+            b.name[len] = '\0';
+            b.ready.store(true, std::memory_order_release);
+            return b;
+        }
+        if (current == h) return b;
+    }
+    return g_buckets[MAX_NAMES - 1];
+}
+
+// The last 32 trace id bits: OTel's ratio sampler compares the first 8
+// bytes, the live sampling-ratio the last 8 from the most significant one, so
+// their decisions stay independent of this one
+inline uint32_t trace_bits(const trace_api::TraceId& trace_id) {
+    uint32_t bits;
+    memcpy(&bits, trace_id.Id().data() + 12, sizeof(bits));
+    return bits;
+}
+
+inline double probability(uint32_t threshold) {
+    return static_cast<double>(threshold) / static_cast<double>(UINT32_MAX);
+}
+
+} // namespace internal
+
+inline bool enabled() { return internal::g_enabled; }
+
+/**
+ * Counts spans reaching the exporter, for the queue depth
+ */
+class CountingExporter : public trace_sdk::SpanExporter {
+public:
+    explicit CountingExporter(std::unique_ptr<trace_sdk::SpanExporter> inner) : inner_(std::move(inner)) {}
+
+    std::unique_ptr<trace_sdk::Recordable> MakeRecordable() noexcept override {
+        return inner_->MakeRecordable();
+    }
+
+    opentelemetry::sdk::common::ExportResult Export(
+        const nostd::span<std::unique_ptr<trace_sdk::Recordable>>& spans) noexcept override {
+        internal::g_exported.fetch_add(spans.size(), std::memory_order_relaxed);
+        return inner_->Export(spans);
+    }
+
+    bool ForceFlush(std::chrono::microseconds timeout) noexcept override {
+        return inner_->ForceFlush(timeout);
+    }
+
+    bool Shutdown(std::chrono::microseconds timeout) noexcept override {
+        return inner_->Shutdown(timeout);
+    }
+
+private:
+    std::unique_ptr<trace_sdk::SpanExporter> inner_;
+};
+
+/**
+ * Counts sampled spans entering the span processor, for the queue depth
+ */
+class CountingProcessor : public trace_sdk::SpanProcessor {
+public:
+    explicit CountingProcessor(std::unique_ptr<trace_sdk::SpanProcessor> inner) : inner_(std::move(inner)) {}
+
+    std::unique_ptr<trace_sdk::Recordable> MakeRecordable() noexcept override {
+        return inner_->MakeRecordable();
+    }
+
+    void OnStart(trace_sdk::Recordable& span, const trace_api::SpanContext& parent) noexcept override {
+        inner_->OnStart(span, parent);
+    }
+
+    void OnEnd(std::unique_ptr<trace_sdk::Recordable>&& span) noexcept override {
+        internal::g_enqueued.fetch_add(1, std::memory_order_relaxed);
+        inner_->OnEnd(std::move(span));
+    }
+
+    bool ForceFlush(std::chrono::microseconds timeout) noexcept override {
+        return inner_->ForceFlush(timeout);
+    }
+
+    bool Shutdown(std::chrono::microseconds timeout) noexcept override {
+        return inner_->Shutdown(timeout);
+    }
+
+private:
+    std::unique_ptr<trace_sdk::SpanProcessor> inner_;
+};
+
+/**
+ * Thins sampled root spans by their span name's probability and tokens
+ */
+class AdaptiveSampler : public trace_sdk::Sampler {
+public:
+    explicit AdaptiveSampler(std::unique_ptr<trace_sdk::Sampler> inner)
+        : inner_(std::move(inner)) {
+        nostd::string_view inner_desc = inner_->GetDescription();
+        description_ = "Adaptive{" + std::string(inner_desc.data(), inner_desc.size()) + "}";
+    }
+
+    trace_sdk::SamplingResult ShouldSample(
+        const trace_api::SpanContext& parent_context, trace_api::TraceId trace_id,
+        nostd::string_view name, trace_api::SpanKind span_kind,
+        const common::KeyValueIterable& attributes,
+        const trace_api::SpanContextKeyValueIterable& links) noexcept override {
+        // Inner samplers deciding the root themselves overwrite this
+        sampling::internal::g_root_probability = sampling::internal::g_configured_probability;
+        trace_sdk::SamplingResult result =
+            inner_->ShouldSample(parent_context, trace_id, name, span_kind, attributes, links);
+        if (result.decision != trace_sdk::Decision::RECORD_AND_SAMPLE || parent_context.IsValid() ||
+            sampling::internal::g_root_rule >= 0) {
+            return result;
+        }
+        double inner_probability = sampling::internal::g_root_probability;
+
+        Bucket& b = internal::bucket(name);
+        b.seen.fetch_add(1, std::memory_order_relaxed);
+        uint32_t threshold = b.threshold.load(std::memory_order_relaxed);
+        if (internal::trace_bits(trace_id) > threshold) {
+            result.decision = trace_sdk::Decision::DROP;
+            return result;
+        }
+        // Tokens are only taken by traces the probability keeps
+        b.passed.fetch_add(1, std::memory_order_relaxed);
+        if (b.tokens.fetch_sub(1, std::memory_order_relaxed) <= 0) {
+            result.decision = trace_sdk::Decision::DROP;
+            return result;
+        }
+        b.sampled.fetch_add(1, std::memory_order_relaxed);
+        if (inner_probability < 0) return result;
+
+        auto attrs = std::make_unique<std::map<std::string, common::AttributeValue>>();
+        if (result.attributes) *attrs = *result.attributes;
+        (*attrs)["sampling.probability"] = inner_probability * internal::probability(threshold) *
+                                           b.token_share.load(std::memory_order_relaxed);
+        result.attributes = std::move(attrs);
+        return result;
+    }
+
+    nostd::string_view GetDescription() const noexcept override { return description_; }
+
+private:
+    std::unique_ptr<trace_sdk::Sampler> inner_;
+    std::string description_;
+};
+
+/**
+ * Recomputes the per-name probabilities and tokens every interval
+ */
+class Controller {
+public:
+    static Controller& instance() {
+        static Controller controller;
+        return controller;
+    }
+
+    void start(size_t max_queue) {
+        if (thread_.joinable()) return;
+        max_queue_ = max_queue;
+        runtime::ScopedPlacement placement(runtime::Role::Exporter);
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~Controller() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+private:
+    struct Active {
+        Bucket* bucket;
+        double rate;        // roots/s the configured sampler kept
+    };
+
+    Controller() = default;
+
+    void run() {
+        pthread_setname_np(pthread_self(), "traced-adaptive");
+        const double interval_s = internal::g_interval_ms / 1000.0;
+        // Until the first interval, each name may take a full interval's budget
+        for (Bucket& b : internal::g_buckets) {
+            b.tokens.store(static_cast<int64_t>(internal::g_budget * interval_s) + 1);
+        }
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, std::chrono::milliseconds(internal::g_interval_ms),
+                                 [this]() { return stop_; });
+                if (stop_) return;
+            }
+            adjust(interval_s);
+        }
+    }
+
+    // Sampled spans not yet exported; drops of a full queue are written off
+    double queue_pressure() {
+        if (max_queue_ == 0) return 0;
+        uint64_t exported = internal::g_exported.load(std::memory_order_relaxed);
+        uint64_t enqueued = internal::g_enqueued.load(std::memory_order_relaxed);
+        uint64_t depth = enqueued > exported + written_off_ ? enqueued - exported - written_off_ : 0;
+        if (depth > max_queue_) {
+            written_off_ += depth - max_queue_;
+            depth = max_queue_;
+        }
+        return static_cast<double>(depth) / static_cast<double>(max_queue_);
+    }
+
+    void adjust(double interval_s) {
+        std::vector<Active> active;
+        uint64_t sampled_roots = 0;
+        for (Bucket& b : internal::g_buckets) {
+            if (!b.ready.load(std::memory_order_acquire)) continue;
+            uint64_t seen = b.seen.load(std::memory_order_relaxed);
+            uint64_t passed = b.passed.load(std::memory_order_relaxed);
+            uint64_t sampled = b.sampled.load(std::memory_order_relaxed);
+            sampled_roots += sampled - b.last_sampled;
+            if (seen > b.last_seen) active.push_back({&b, (seen - b.last_seen) / interval_s});
+            // Token drops are not random by trace id; their share re-weights the next interval
+            double share = passed > b.last_passed ?
+                static_cast<double>(sampled - b.last_sampled) / static_cast<double>(passed - b.last_passed) : 1.0;
+            b.token_share.store(std::min(1.0, share), std::memory_order_relaxed);
+            b.last_seen = seen;
+            b.last_passed = passed;
+            b.last_sampled = sampled;
+        }
+
+        // Spans per sampled root, from what reached the processor
+        uint64_t enqueued = internal::g_enqueued.load(std::memory_order_relaxed);
+        if (sampled_roots > 0) {
+            double measured = static_cast<double>(enqueued - last_enqueued_) / sampled_roots;
+            spans_per_root_ = 0.7 * spans_per_root_ + 0.3 * std::max(1.0, measured);
+        }
+        last_enqueued_ = enqueued;
+
+        double pressure = queue_pressure();
+        double factor = pressure <= 0.5 ? 1.0 : std::max(MIN_PRESSURE_FACTOR, 2.0 * (1.0 - pressure));
+        double root_budget = internal::g_budget / spans_per_root_ * factor;
+
+        // Max-min fair shares, quietest names first
+        std::sort(active.begin(), active.end(),
+                  [](const Active& a, const Active& b) { return a.rate < b.rate; });
+        double remaining = root_budget;
+        for (size_t i = 0; i < active.size(); i++) {
+            double share = remaining / static_cast<double>(active.size() - i);
+            double alloc = std::min(active[i].rate, share);
+            remaining -= alloc;
+
+            Bucket& b = *active[i].bucket;
+            double target = alloc / active[i].rate;
+            double current = internal::probability(b.threshold.load(std::memory_order_relaxed));
+            double p = target < current ? target : current + (target - current) / 2;
+            b.threshold.store(static_cast<uint32_t>(std::min(1.0, p) * UINT32_MAX), std::memory_order_relaxed);
+            // Twice the share absorbs bursts within the interval
+            b.tokens.store(static_cast<int64_t>(2 * alloc * interval_s) + 1, std::memory_order_relaxed);
+        }
+
+        // Idle names recover and may start with the unused part of the budget
+        int64_t idle_tokens = static_cast<int64_t>(std::max(remaining, 0.0) * interval_s) + 1;
+        for (Bucket& b : internal::g_buckets) {
+            bool is_active = std::any_of(active.begin(), active.end(),
+                                         [&b](const Active& a) { return a.bucket == &b; });
+            if (is_active) continue;
+            b.threshold.store(UINT32_MAX, std::memory_order_relaxed);
+            b.tokens.store(idle_tokens, std::memory_order_relaxed);
+        }
+    }
+
+    size_t max_queue_ = 0;
+    uint64_t written_off_ = 0;
+    uint64_t last_enqueued_ = 0;
+    double spans_per_root_ = 1.0;
+
+    std::mutex mutex_;                  // controller wakeup only
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+inline std::unique_ptr<trace_sdk::SpanExporter> wrap_exporter(std::unique_ptr<trace_sdk::SpanExporter> exporter) {
+    if (!internal::load_config()) return exporter;
+    return std::make_unique<CountingExporter>(std::move(exporter));
+}
+
+inline std::unique_ptr<trace_sdk::SpanProcessor> wrap_processor(std::unique_ptr<trace_sdk::SpanProcessor> processor) {
+    if (!internal::load_config()) return processor;
+    return std::make_unique<CountingProcessor>(std::move(processor));
+}
+
+/**
+ * Wrap the configured sampler and start the controller (called once from
+ * traced::internal::do_init); max_queue is the batch processor's queue
+ * size, 0 for the simple processor
+ */
+inline std::unique_ptr<trace_sdk::Sampler> configure(std::unique_ptr<trace_sdk::Sampler> sampler,
+                                                     size_t max_queue) {
+    if (!internal::load_config()) return sampler;
+    Controller::instance().start(max_queue);
+    printf("[traced] Adaptive sampling: %.0f spans/s, every %zums\n",
+           internal::g_budget, internal::g_interval_ms);
+    return std::make_unique<AdaptiveSampler>(std::move(sampler));
+}
+
+} // namespace adaptive
+} // namespace traced
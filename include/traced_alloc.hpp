@@ -0,0 +1,94 @@
+// DDS Tracing Library - allocation auditing
+// Interposed heap counters for tests, benchmarks and per-callback profiling.
+//
+// Usage (exactly once, at file scope of the executable):
+//   TRACED_ALLOC_AUDIT();
+//
+//   traced::alloc::Snapshot before = traced::alloc::snapshot();
+//   writer.write(msg, "op");
+//   traced::alloc::Snapshot used = traced::alloc::snapshot() - before;
+//   // used.count / used.bytes: C++ operator new, used.c_count / used.c_bytes: malloc & co
+//
+// Counters are per thread. Without TRACED_ALLOC_AUDIT() they stay at zero and
+// traced::alloc::installed() returns false.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace traced {
+namespace alloc {
+
+struct Snapshot {
+    uint64_t count = 0;    // operator new calls
+    uint64_t bytes = 0;
+    uint64_t c_count = 0;  // malloc/calloc/realloc calls (CycloneDDS, libc)
+    uint64_t c_bytes = 0;
+
+    Snapshot operator-(const Snapshot& o) const {
+        return {count - o.count, bytes - o.bytes, c_count - o.c_count, c_bytes - o.c_bytes};
+    }
+    Snapshot operator+(const Snapshot& o) const {
+        return {count + o.count, bytes + o.bytes, c_count + o.c_count, c_bytes + o.c_bytes};
+    }
+};
+
+namespace internal {
+
+// Trivial type, constant-initialized: safe to touch from inside malloc
+inline thread_local Snapshot g_counters;
+inline bool g_installed = false;
+
+inline void* count_new(size_t size) {
+    g_counters.count++;
+    g_counters.bytes += size;
+    void* p = __libc_malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+inline void count_c(size_t size) {
+    g_counters.c_count++;
+    g_counters.c_bytes += size;
+}
+
+} // namespace internal
+
+inline bool installed() { return internal::g_installed; }
+
+inline Snapshot snapshot() { return internal::g_counters; }
+
+} // namespace alloc
+} // namespace traced
+
+// Replaces global operator new/delete and the malloc family with counting
+// versions forwarding to glibc. Expand once per executable.
+#define TRACED_ALLOC_AUDIT() \
+    void* operator new(size_t size) { return traced::alloc::internal::count_new(size); } \
+    void* operator new[](size_t size) { return traced::alloc::internal::count_new(size); } \
+    void* operator new(size_t size, const std::nothrow_t&) noexcept { \
+        try { return traced::alloc::internal::count_new(size); } catch (...) { return nullptr; } } \
+    void* operator new[](size_t size, const std::nothrow_t&) noexcept { \
+        try { return traced::alloc::internal::count_new(size); } catch (...) { return nullptr; } } \
+    void operator delete(void* p) noexcept { __libc_free(p); } \
+    void operator delete[](void* p) noexcept { __libc_free(p); } \
+    void operator delete(void* p, size_t) noexcept { __libc_free(p); } \
+    void operator delete[](void* p, size_t) noexcept { __libc_free(p); } \
+    extern "C" void* malloc(size_t size) noexcept { \
+        traced::alloc::internal::count_c(size); return __libc_malloc(size); } \
+    extern "C" void* calloc(size_t n, size_t size) noexcept { \
+        traced::alloc::internal::count_c(n * size); return __libc_calloc(n, size); } \
+    extern "C" void* realloc(void* p, size_t size) noexcept { \
+        traced::alloc::internal::count_c(size); return __libc_realloc(p, size); } \
+    extern "C" void free(void* p) noexcept { __libc_free(p); } \
+    static const bool traced_alloc_audit_installed_ = (traced::alloc::internal::g_installed = true)
@@ -0,0 +1,341 @@
+// DDS Tracing Library - live runtime configuration
+// Settings a running service takes from the ServiceControl topic
+// (tools/traced-ctl) instead of a container restart:
+//
+//   traced-ctl set track-fusion take-batch=32,fusion-window-ms=5000
+//   traced-ctl set '*' sampling-ratio=0.05,log-level=info
+//   traced-ctl get '*'
+//
+// Settings:
+//   sampling-ratio - root spans no sampling rule matched are sampled at this
+//                    ratio by trace id; "default" returns to OTEL_TRACES_SAMPLER
+//   log-level      - quiet, info or messages (default: TRACED_LOG_LEVEL, else
+//                    messages); services print per-message lines at messages
+//   take-batch     - samples per Reader::take for every reader of the process,
+//                    1..64; "default" returns to each reader's EndpointQos::take_batch
+//   <param>        - an integer the service registered with config::param(),
+//                    e.g. track-fusion's fusion-window-ms
+//
+// All settings form one immutable Config. A command copies the current one,
+// changes it and publishes the copy with one atomic pointer store
+// (read-copy-update): the settings of a command become visible together or
+// not at all, and the hot path reads them with a single acquire load, no
+// lock. A replaced Config is freed after a grace period; readers never keep
+// the pointer beyond the call that loaded it.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "opentelemetry/sdk/trace/sampler.h"
+#include "traced_sampling.hpp"
+
+namespace traced {
+namespace config {
+
+namespace nostd = opentelemetry::nostd;
+namespace common = opentelemetry::common;
+namespace trace_api = opentelemetry::trace;
+namespace trace_sdk = opentelemetry::sdk::trace;
+
+inline constexpr int MAX_PARAMS = 16;
+inline constexpr int MAX_TAKE_BATCH = 64;     // Reader's sample array
+
+enum class LogLevel : int { Quiet = 0, Info = 1, Messages = 2 };
+
+struct Config {
+    uint32_t version = 0;
+    double sampling_ratio = -1;         // < 0: the configured sampler decides
+    LogLevel log_level = LogLevel::Messages;
+    int take_batch = 0;                 // 0: each reader's own
+    int64_t params[MAX_PARAMS] = {};
+};
+
+/**
+ * One setting changed by a command, for the span event and the reply
+ */
+struct Change {
+    std::string key;
+    std::string old_value;
+    std::string new_value;
+};
+
+namespace internal {
+
+inline constexpr int64_t GRACE_NS = 10000000000LL;     // 10 s
+
+inline std::atomic<const Config*> g_current{new Config()};
+
+// Writers only: control commands and param registration
+inline std::mutex g_mutex;
+inline std::vector<std::string> g_param_names;
+inline std::vector<std::pair<std::unique_ptr<const Config>, int64_t>> g_retired;
+
+inline int64_t mono_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline const char* level_name(LogLevel level) {
+    static const char* names[] = {"quiet", "info", "messages"};
+    return names[static_cast<int>(level)];
+}
+
+inline bool parse_level(const std::string& value, LogLevel& level) {
+    for (int i = 0; i <= static_cast<int>(LogLevel::Messages); i++) {
+        if (value == level_name(static_cast<LogLevel>(i))) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parse_int(const std::string& value, int64_t& out) {
+    char* end = nullptr;
+    long long v = strtoll(value.c_str(), &end, 10);
+    if (value.empty() || *end) return false;
+    out = v;
+    return true;
+}
+
+inline std::string format_ratio(double ratio) {
+    if (ratio < 0) return "default";
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%g", ratio);
+    return buf;
+}
+
+inline std::string format_batch(int batch) {
+    return batch > 0 ? std::to_string(batch) : "default";
+}
+
+// Caller holds g_mutex. The replaced version is freed once no reader can
+// still hold it; versions retired earlier are freed here as well.
+inline void publish(std::unique_ptr<Config> next) {
+    const Config* previous = g_current.load(std::memory_order_relaxed);
+    next->version = previous->version + 1;
+    g_current.store(next.release(), std::memory_order_release);
+
+    int64_t now = mono_ns();
+    g_retired.emplace_back(std::unique_ptr<const Config>(previous), now);
+    size_t keep = 0;
+    for (size_t i = 0; i < g_retired.size(); i++) {
+        if (now - g_retired[i].second < GRACE_NS) g_retired[keep++] = std::move(g_retired[i]);
+    }
+    g_retired.resize(keep);
+}
+
+// "key=value" onto next; false with error set for an unknown key or bad value
+inline bool set(Config& next, const std::string& key, const std::string& value,
+                std::vector<Change>& changes, std::string& error) {
+    Change change{key, "", value};
+    if (key == "sampling-ratio") {
+        double ratio = -1;
+        if (value != "default") {
+            char* end = nullptr;
+            ratio = strtod(value.c_str(), &end);
+            if (value.empty() || *end || ratio < 0 || ratio > 1) {
+                error = "sampling-ratio must be 0..1 or default";
+                return false;
+            }
+        }
+        change.old_value = format_ratio(next.sampling_ratio);
+        next.sampling_ratio = ratio;
+        change.new_value = format_ratio(ratio);
+    } else if (key == "log-level") {
+        LogLevel level;
+        if (!parse_level(value, level)) {
+            error = "log-level must be quiet, info or messages";
+            return false;
+        }
+        change.old_value = level_name(next.log_level);
+        next.log_level = level;
+    } else if (key == "take-batch") {
+        int64_t batch = 0;
+        if (value != "default" && (!parse_int(value, batch) || batch < 1 || batch > MAX_TAKE_BATCH)) {
+            error = "take-batch must be 1.." + std::to_string(MAX_TAKE_BATCH) + " or default";
+            return false;
+        }
+        change.old_value = format_batch(next.take_batch);
+        next.take_batch = static_cast<int>(batch);
+        change.new_value = format_batch(next.take_batch);
+    } else {
+        size_t idx = 0;
+        while (idx < g_param_names.size() && g_param_names[idx] != key) idx++;
+        if (idx == g_param_names.size()) {
+            error = "unknown setting '" + key + "'";
+            return false;
+        }
+        int64_t v = 0;
+        if (!parse_int(value, v)) {
+            error = key + " must be an integer";
+            return false;
+        }
+        change.old_value = std::to_string(next.params[idx]);
+        next.params[idx] = v;
+    }
+    changes.push_back(change);
+    return true;
+}
+
+} // namespace internal
+
+/**
+ * The current settings; valid until the calling function returns
+ */
+inline const Config* current() {
+    return internal::g_current.load(std::memory_order_acquire);
+}
+
+inline bool log_enabled(LogLevel level) {
+    return static_cast<int>(current()->log_level) >= static_cast<int>(level);
+}
+
+/**
+ * A service parameter settable at runtime, e.g.
+ *   static const traced::config::Param window = traced::config::param("fusion-window-ms", 3000);
+ *   ... window.get() ...
+ */
+class Param {
+public:
+    Param(int idx, int64_t fixed) : idx_(idx), fixed_(fixed) {}
+    int64_t get() const { return idx_ >= 0 ? current()->params[idx_] : fixed_; }
+
+private:
+    int idx_;
+    int64_t fixed_;     // value of a param that could not be registered
+};
+
+inline Param param(const char* name, int64_t initial) {
+    std::lock_guard<std::mutex> lock(internal::g_mutex);
+    if (internal::g_param_names.size() == MAX_PARAMS) {
+        fprintf(stderr, "[traced] More than %d config params, '%s' is not settable\n", MAX_PARAMS, name);
+        return Param(-1, initial);
+    }
+    auto next = std::make_unique<Config>(*current());
+    next->params[internal::g_param_names.size()] = initial;
+    internal::g_param_names.push_back(name);
+    internal::publish(std::move(next));
+    return Param(static_cast<int>(internal::g_param_names.size() - 1), initial);
+}
+
+/**
+ * Apply "key=value,..." as one new version; nothing changes on an error
+ */
+inline bool apply(const char* spec, std::vector<Change>& changes, std::string& error) {
+    std::lock_guard<std::mutex> lock(internal::g_mutex);
+    auto next = std::make_unique<Config>(*current());
+    std::string s(spec ? spec : "");
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) end = s.size();
+        std::string entry = s.substr(pos, end - pos);
+        pos = end + 1;
+        if (entry.empty()) continue;
+        size_t eq = entry.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            error = "expected key=value, got '" + entry + "'";
+            return false;
+        }
+        if (!internal::set(*next, entry.substr(0, eq), entry.substr(eq + 1), changes, error)) {
+            return false;
+        }
+    }
+    if (changes.empty()) {
+        error = "nothing to set";
+        return false;
+    }
+    internal::publish(std::move(next));
+    return true;
+}
+
+/**
+ * "key=value,..." of every setting, as accepted by apply()
+ */
+inline std::string describe() {
+    std::lock_guard<std::mutex> lock(internal::g_mutex);
+    const Config* c = current();
+    std::string out = "sampling-ratio=" + internal::format_ratio(c->sampling_ratio) +
+                      ",log-level=" + internal::level_name(c->log_level) +
+                      ",take-batch=" + internal::format_batch(c->take_batch);
+    for (size_t i = 0; i < internal::g_param_names.size(); i++) {
+        out += "," + internal::g_param_names[i] + "=" + std::to_string(c->params[i]);
+    }
+    return out;
+}
+
+/**
+ * Samples root spans no rule matched at the live sampling-ratio while one
+ * is set; every other span, and every span without one, goes to inner
+ */
+class LiveSampler : public trace_sdk::Sampler {
+public:
+    explicit LiveSampler(std::unique_ptr<trace_sdk::Sampler> inner)
+        : inner_(std::move(inner)) {
+        nostd::string_view inner_desc = inner_->GetDescription();
+        description_ = "Live{" + std::string(inner_desc.data(), inner_desc.size()) + "}";
+    }
+
+    trace_sdk::SamplingResult ShouldSample(
+        const trace_api::SpanContext& parent_context, trace_api::TraceId trace_id,
+        nostd::string_view name, trace_api::SpanKind span_kind,
+        const common::KeyValueIterable& attributes,
+        const trace_api::SpanContextKeyValueIterable& links) noexcept override {
+        trace_sdk::SamplingResult result =
+            inner_->ShouldSample(parent_context, trace_id, name, span_kind, attributes, links);
+        double ratio = current()->sampling_ratio;
+        if (ratio < 0 || parent_context.IsValid() || sampling::internal::g_root_rule >= 0) {
+            return result;
+        }
+        // The random low half of the trace id against the ratio
+        const uint8_t* id = trace_id.Id().data();
+        uint64_t bits = 0;
+        for (int i = 8; i < 16; i++) bits = (bits << 8) | id[i];
+        bool keep = ratio >= 1.0 || bits < static_cast<uint64_t>(ratio * 18446744073709551616.0);
+        sampling::internal::g_root_probability = std::min(ratio, 1.0);
+        result.decision = keep ? trace_sdk::Decision::RECORD_AND_SAMPLE : trace_sdk::Decision::DROP;
+        return result;
+    }
+
+    nostd::string_view GetDescription() const noexcept override { return description_; }
+
+private:
+    std::unique_ptr<trace_sdk::Sampler> inner_;
+    std::string description_;
+};
+
+// Read TRACED_LOG_LEVEL (called once from traced::internal::do_init)
+inline void init() {
+    const char* level = getenv("TRACED_LOG_LEVEL");
+    if (!level || !*level) return;
+    std::vector<Change> changes;
+    std::string error;
+    if (!apply((std::string("log-level=") + level).c_str(), changes, error)) {
+        fprintf(stderr, "[traced] TRACED_LOG_LEVEL: %s\n", error.c_str());
+    }
+}
+
+inline std::unique_ptr<trace_sdk::Sampler> wrap_sampler(std::unique_ptr<trace_sdk::Sampler> sampler) {
+    return std::make_unique<LiveSampler>(std::move(sampler));
+}
+
+} // namespace config
+} // namespace traced
+
+// printf at a log level: TRACED_LOG(Messages, "[RADAR] Track %s\n", id)
+#define TRACED_LOG(level, ...) \
+    do { \
+        if (traced::config::log_enabled(traced::config::LogLevel::level)) printf(__VA_ARGS__); \
+    } while (0)
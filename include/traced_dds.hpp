@@ -4,6 +4,42 @@
 // Configuration via environment variables:
 //   TRACED_SERVICE_NAME - Service name for tracing (required)
 //   OTEL_EXPORTER_OTLP_ENDPOINT - OTLP endpoint (default: http://localhost:4318/v1/traces)
+//   TRACED_SPAN_PROCESSOR - "simple" (export inline, default) or "batch" (exporter thread)
+//   TRACED_PLACEMENT / TRACED_PLACEMENT_FILE - thread placement, see traced_runtime.hpp
+//   TRACED_RT - real-time mode (implies batch export), see traced_runtime.hpp
+//   TRACED_TRACING - "off" installs no SDK: no-op spans, all-zero ids on the wire
+//   TRACED_ZERO_ALLOC - "1" takes spans from a preallocated pool and skips OTel
+//                       runtime-context scopes in write/take, so the traced path
+//                       allocates nothing per message, see traced_spanpool.hpp
+//   TRACED_CALLBACK_PROFILE - "1" records CPU time and context switches of
+//                             every take() callback on its span, allocations too
+//                             where TRACED_ALLOC_AUDIT() is expanded
+//   OTEL_TRACES_SAMPLER / OTEL_TRACES_SAMPLER_ARG - standard OTel sampler selection
+//                             (default: parentbased_always_on)
+//   TRACED_SAMPLING_RULES   - root writes sampled by message fields, see traced_sampling.hpp
+//   TRACED_ADAPTIVE_SPANS_PER_SEC - exported span budget per process, see traced_adaptive.hpp
+//   TRACED_FLIGHT_RECORDER* - in-memory ring of all spans, see traced_recorder.hpp
+//   TRACED_RED_METRICS      - "1" exports span-derived RED metrics, see traced_metrics.hpp
+//   TRACED_TOPOLOGY         - "0" stops publishing the dependency edges, see traced_topology.hpp
+//   TRACED_TIMESYNC         - "0" disables clock offset estimation, see traced_timesync.hpp
+//   TRACED_ECHO             - "0" disables the latency probe responder, see traced_echo.hpp
+//   TRACED_STATS_FILE       - per-process statistics file, see traced_stats.hpp
+//   TRACED_INDEX_DIR / TRACED_INDEX_FIELDS - local business-key to trace index,
+//                             see traced_index.hpp
+//   TRACED_TRACK_TRACES     - "1" makes write_keyed() keep one trace per key
+//   TRACED_TRACK_TRACE_MAX_SPANS / TRACED_TRACK_TRACE_MAX_AGE_S - rotate a key's trace
+//                             after this many updates / seconds (default: 1000 / 600)
+//   TRACED_TRACK_TRACE_MAX_KEYS - keys tracked per writer (default: 1024)
+//   TRACED_DDS_STATISTICS / TRACED_SLOW_WRITE_US - CycloneDDS entity statistics as
+//                             metrics and on slow writes, see traced_ddsstats.hpp
+//   TRACED_LOG_LEVEL        - quiet, info or messages (default); settable at runtime
+//                             with the other settings of traced_config.hpp
+//   TRACED_WATCHDOG*        - dispatch loop stall and backlog watchdog, see traced_watchdog.hpp
+//   TRACED_LOOP_METRICS     - "1" exports loop lag and backlog age histograms
+//
+// Readers drop duplicate samples with reader.set_dedup(...), see traced_dedup.hpp.
+// Alert rules over taken samples: traced::rules::Engine, see traced_rules.hpp
+// (TRACED_ALERT_RULES / TRACED_ALERT_RATE).
 //
 // Usage:
 //   auto writer = TRACED_WRITER(MsgType, participant, "TopicName");
@@ -26,6 +62,14 @@
 #include <cstdio>
 #include <cstring>
 #include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <unordered_map>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
 
 #include "dds/dds.h"
 
@@ -33,12 +77,41 @@
 #include "opentelemetry/exporters/otlp/otlp_http_exporter_options.h"
 #include "opentelemetry/sdk/trace/processor.h"
 #include "opentelemetry/sdk/trace/simple_processor_factory.h"
+#include "opentelemetry/sdk/trace/batch_span_processor_factory.h"
+#include "opentelemetry/sdk/trace/batch_span_processor_options.h"
 #include "opentelemetry/sdk/trace/tracer_provider_factory.h"
+#include "opentelemetry/sdk/trace/samplers/always_on_factory.h"
+#include "opentelemetry/sdk/trace/samplers/always_off_factory.h"
+#include "opentelemetry/sdk/trace/samplers/parent_factory.h"
+#include "opentelemetry/sdk/trace/samplers/trace_id_ratio_factory.h"
 #include "opentelemetry/trace/provider.h"
 #include "opentelemetry/sdk/resource/resource.h"
 
+#include "traced_runtime.hpp"
+#include "traced_alloc.hpp"
+#include "traced_probes.hpp"
+#include "traced_recorder.hpp"
+#include "traced_metrics.hpp"
+#include "traced_echo.hpp"
+#include "traced_timesync.hpp"
+#include "traced_topology.hpp"
+#include "traced_stats.hpp"
+#include "traced_ddsstats.hpp"
+#include "traced_sampling.hpp"
+#include "traced_adaptive.hpp"
+#include "traced_index.hpp"
+#include "traced_dedup.hpp"
+#include "traced_loss.hpp"
+#include "traced_config.hpp"
+#include "traced_rules.hpp"
+#include "traced_watchdog.hpp"
+#include "traced_spanpool.hpp"
+#include "TracedTopics.h"
+
 namespace traced {
 
+namespace nostd = opentelemetry::nostd;
+namespace common = opentelemetry::common;
 namespace trace_api = opentelemetry::trace;
 namespace trace_sdk = opentelemetry::sdk::trace;
 namespace otlp = opentelemetry::exporter::otlp;
@@ -48,20 +121,97 @@ namespace resource = opentelemetry::sdk::resource;
 inline opentelemetry::nostd::shared_ptr<trace_api::Tracer> g_tracer;
 inline std::string g_service_name;
 inline bool g_initialized = false;
-
-// Thread-local active trace context for automatic propagation
-inline thread_local std::string g_active_trace_id;
-inline thread_local std::string g_active_span_id;
+inline bool g_zero_alloc = false;
+inline bool g_callback_profile = false;
+inline bool g_track_traces = false;
+inline uint32_t g_track_max_spans = 1000;
+inline int64_t g_track_max_age_ns = DDS_SECS(600);
+inline size_t g_track_max_keys = 1024;
+
+// Thread-local active trace context for automatic propagation (invalid = none)
+inline thread_local trace_api::TraceId g_active_trace_id;
+inline thread_local trace_api::SpanId g_active_span_id;
+inline thread_local uint8_t g_active_trace_flags = 0;
 
 // Structure to hold trace context for span links
 struct TraceLink {
     std::string trace_id;
     std::string span_id;
     std::string sensor_id;  // Optional: for logging/attributes
+    std::string service;    // Optional: upstream service, counted as a topology edge
+    std::string topic;      // Optional: topic the linked sample came from
+    dds_time_t source_timestamp = 0;  // Optional: DDS source timestamp, for edge latency
+    int64_t origin_id = 0;  // Optional: writer's process (Reader::publisher_origin), for clock correction
 };
 
 namespace internal {
 
+// Sampler from OTEL_TRACES_SAMPLER / OTEL_TRACES_SAMPLER_ARG
+inline std::unique_ptr<trace_sdk::Sampler> create_sampler() {
+    const char* name = getenv("OTEL_TRACES_SAMPLER");
+    const char* arg = getenv("OTEL_TRACES_SAMPLER_ARG");
+    double ratio = arg ? atof(arg) : 1.0;
+    std::string kind = name && *name ? name : "parentbased_always_on";
+
+    bool parent_based = kind.compare(0, 12, "parentbased_") == 0;
+    std::string root_kind = parent_based ? kind.substr(12) : kind;
+
+    std::unique_ptr<trace_sdk::Sampler> root;
+    if (root_kind == "always_off") {
+        root = trace_sdk::AlwaysOffSamplerFactory::Create();
+        sampling::internal::g_configured_probability = 0;
+    } else if (root_kind == "traceidratio") {
+        root = trace_sdk::TraceIdRatioBasedSamplerFactory::Create(ratio);
+        sampling::internal::g_configured_probability = std::clamp(ratio, 0.0, 1.0);
+    } else {
+        if (root_kind != "always_on") {
+            fprintf(stderr, "[traced] Unknown OTEL_TRACES_SAMPLER '%s', using always_on\n", kind.c_str());
+        }
+        root = trace_sdk::AlwaysOnSamplerFactory::Create();
+        sampling::internal::g_configured_probability = 1;
+    }
+    if (!parent_based) return root;
+    return trace_sdk::ParentBasedSamplerFactory::Create(std::shared_ptr<trace_sdk::Sampler>(std::move(root)));
+}
+
+/**
+ * Registered fields of a message type listed in TRACED_INDEX_FIELDS
+ */
+class IndexedFields {
+public:
+    template<typename T>
+    static IndexedFields compile() {
+        IndexedFields indexed;
+        for (const sampling::Field& field : sampling::internal::fields<T>()) {
+            if (index::indexed(field.name)) indexed.fields_.push_back(field);
+        }
+        return indexed;
+    }
+
+    void append(const void* msg, const trace_api::SpanContext& ctx) const {
+        for (const sampling::Field& field : fields_) {
+            index::Indexer::instance().append(field.name, field.get(msg),
+                                              ctx.trace_id().Id().data(), ctx.span_id().Id().data());
+        }
+    }
+
+private:
+    std::vector<sampling::Field> fields_;
+};
+
+// Placement and RT mode of the initializing thread, the dispatch loop. The
+// first traced endpoint is created after the participant: DDS threads exist by
+// now. Threads the middleware starts afterwards (topology, clock sync) are
+// created under ScopedPlacement(Role::Exporter) and stay SCHED_OTHER.
+inline void enter_dispatch_loop() {
+    if (runtime::placement().any()) {
+        runtime::pin_current_thread(runtime::Role::Main);
+        runtime::pin_dds_threads();
+        runtime::report_placement(g_service_name.c_str());
+    }
+    runtime::enter_rt_process();
+}
+
 inline void do_init() {
     if (g_initialized) return;
 
@@ -72,29 +222,98 @@ inline void do_init() {
     if (!otlp_endpoint) otlp_endpoint = "http://localhost:4318/v1/traces";
 
     g_service_name = service_name;
+    config::init();
+
+    const char* zero_alloc = getenv("TRACED_ZERO_ALLOC");
+    g_zero_alloc = zero_alloc && strcmp(zero_alloc, "0") != 0;
+
+    const char* callback_profile = getenv("TRACED_CALLBACK_PROFILE");
+    g_callback_profile = callback_profile && strcmp(callback_profile, "0") != 0;
+
+    g_track_traces = recorder::internal::env_flag("TRACED_TRACK_TRACES", false);
+    size_t track_max_spans = runtime::internal::env_size("TRACED_TRACK_TRACE_MAX_SPANS", 1000);
+    if (track_max_spans > 0) g_track_max_spans = static_cast<uint32_t>(track_max_spans);
+    size_t track_max_age_s = runtime::internal::env_size("TRACED_TRACK_TRACE_MAX_AGE_S", 600);
+    if (track_max_age_s > 0) g_track_max_age_ns = DDS_SECS(static_cast<int64_t>(track_max_age_s));
+    size_t track_max_keys = runtime::internal::env_size("TRACED_TRACK_TRACE_MAX_KEYS", 1024);
+    if (track_max_keys > 0) g_track_max_keys = track_max_keys;
+
+    topology::internal::g_enabled = recorder::internal::env_flag("TRACED_TOPOLOGY", true);
+    timesync::internal::g_enabled = recorder::internal::env_flag("TRACED_TIMESYNC", true);
+    stats::Stats::instance().start(g_service_name);
+    ddsstats::Registry::instance().start(g_service_name, otlp_endpoint);
+    watchdog::Watchdog::instance().start(g_service_name, otlp_endpoint);
+
+    const char* tracing = getenv("TRACED_TRACING");
+    if (tracing && strcmp(tracing, "off") == 0) {
+        // API default provider: spans are no-ops with an invalid context, so
+        // writes carry all-zero ids and nothing propagates downstream
+        g_tracer = trace_api::Provider::GetTracerProvider()->GetTracer(g_service_name, "1.0.0");
+        g_initialized = true;
+        printf("[traced] Tracing disabled for %s\n", g_service_name.c_str());
+        enter_dispatch_loop();
+        return;
+    }
 
     otlp::OtlpHttpExporterOptions opts;
     opts.url = otlp_endpoint;
 
-    auto exporter = otlp::OtlpHttpExporterFactory::Create(opts);
-    auto processor = trace_sdk::SimpleSpanProcessorFactory::Create(std::move(exporter));
+    auto exporter = adaptive::wrap_exporter(otlp::OtlpHttpExporterFactory::Create(opts));
+
+    const char* processor_kind = getenv("TRACED_SPAN_PROCESSOR");
+    std::unique_ptr<trace_sdk::SpanProcessor> processor;
+    bool batch = runtime::rt_config().enabled ||
+                 (processor_kind && strcmp(processor_kind, "batch") == 0);
+    trace_sdk::BatchSpanProcessorOptions batch_opts;
+    if (batch) {
+        // Exporter thread inherits the placement of the creating thread;
+        // in RT mode it stays SCHED_OTHER (ScopedPlacement, Role::Exporter)
+        runtime::ScopedPlacement exporter_placement(runtime::Role::Exporter);
+        processor = trace_sdk::BatchSpanProcessorFactory::Create(std::move(exporter), batch_opts);
+    } else {
+        processor = trace_sdk::SimpleSpanProcessorFactory::Create(std::move(exporter));
+    }
+    processor = adaptive::wrap_processor(std::move(processor));
+
+    index::Indexer::instance().start(g_service_name);
 
     auto res = resource::Resource::Create({
         {"service.name", g_service_name},
         {"service.version", "1.0.0"}
     });
 
-    auto provider = trace_sdk::TracerProviderFactory::Create(std::move(processor), res);
+    // Flight recorder and RED metrics see every span, sampled or not;
+    // only sampled ones reach the exporter
+    auto sampler = adaptive::configure(config::wrap_sampler(sampling::configure(create_sampler())),
+                                       batch ? batch_opts.max_queue_size : 0);
+    std::vector<recorder::SpanSink> sinks;
+    if (recorder::internal::env_flag("TRACED_FLIGHT_RECORDER", true)) {
+        recorder::FlightRecorder::instance().start(g_service_name, otlp_endpoint);
+        if (recorder::FlightRecorder::instance().enabled()) sinks.push_back(recorder::record_span);
+    }
+    if (recorder::internal::env_flag("TRACED_RED_METRICS", false)) {
+        metrics::RedMetrics::instance().start(g_service_name, otlp_endpoint);
+        sinks.push_back(metrics::record_span);
+    }
+    if (!sinks.empty()) {
+        processor = std::make_unique<recorder::Processor>(std::move(processor), std::move(sinks));
+        sampler = std::make_unique<recorder::RecordAllSampler>(std::move(sampler));
+    }
+
+    auto provider = trace_sdk::TracerProviderFactory::Create(std::move(processor), res, std::move(sampler));
     trace_api::Provider::SetTracerProvider(std::move(provider));
 
     g_tracer = trace_api::Provider::GetTracerProvider()->GetTracer(g_service_name, "1.0.0");
+    if (g_zero_alloc) g_tracer = spanpool::wrap_tracer(g_tracer);
     g_initialized = true;
 
     printf("[traced] Initialized tracing for %s -> %s\n", g_service_name.c_str(), otlp_endpoint);
+    enter_dispatch_loop();
 }
 
 inline void do_shutdown() {
     if (!g_initialized) return;
+    spanpool::Pool::instance().flush();
     std::shared_ptr<trace_api::TracerProvider> none;
     trace_api::Provider::SetTracerProvider(none);
     g_initialized = false;
@@ -132,20 +351,61 @@ inline void span_id_to_hex(const trace_api::SpanId& id, char* out) {
     out[16] = '\0';
 }
 
+inline int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Decode exactly 2*n hex characters, false on bad length or digit
+inline bool hex_decode(const char* hex, uint8_t* out, size_t n) {
+    if (!hex) return false;
+    for (size_t i = 0; i < n; i++) {
+        int hi = hex_nibble(hex[i*2]);
+        int lo = hi < 0 ? -1 : hex_nibble(hex[i*2 + 1]);
+        if (lo < 0) return false;
+        out[i] = static_cast<uint8_t>((hi << 4) | lo);
+    }
+    return hex[n*2] == '\0';
+}
+
 inline trace_api::TraceId hex_to_trace_id(const char* hex) {
-    if (!hex || strlen(hex) != 32) return trace_api::TraceId();
     uint8_t buf[16];
-    for (int i = 0; i < 16; i++) sscanf(hex + i*2, "%2hhx", &buf[i]);
+    if (!hex_decode(hex, buf, 16)) return trace_api::TraceId();
     return trace_api::TraceId(buf);
 }
 
 inline trace_api::SpanId hex_to_span_id(const char* hex) {
-    if (!hex || strlen(hex) != 16) return trace_api::SpanId();
     uint8_t buf[8];
-    for (int i = 0; i < 8; i++) sscanf(hex + i*2, "%2hhx", &buf[i]);
+    if (!hex_decode(hex, buf, 8)) return trace_api::SpanId();
     return trace_api::SpanId(buf);
 }
 
+// OTel runtime-context scope, skipped in zero-allocation mode
+// (Context::SetValue and the attach token are heap allocated)
+inline void activate(std::optional<trace_api::Scope>& scope,
+                     const opentelemetry::nostd::shared_ptr<trace_api::Span>& span) {
+    if (!g_zero_alloc) scope.emplace(span);
+}
+
+inline void set_active(const trace_api::SpanContext& ctx) {
+    g_active_trace_id = ctx.trace_id();
+    g_active_span_id = ctx.span_id();
+    g_active_trace_flags = ctx.trace_flags().flags();
+}
+
+inline void clear_active() {
+    g_active_trace_id = trace_api::TraceId();
+    g_active_span_id = trace_api::SpanId();
+    g_active_trace_flags = 0;
+}
+
+inline trace_api::SpanContext active_context() {
+    return trace_api::SpanContext(g_active_trace_id, g_active_span_id,
+                                  trace_api::TraceFlags(g_active_trace_flags), true);
+}
+
 // Trait to access trace_ctx field - specialize for your message types
 template<typename T>
 struct TraceContextAccessor {
@@ -153,6 +413,325 @@ struct TraceContextAccessor {
     static const auto& get(const T& msg) { return msg.trace_ctx; }
 };
 
+/**
+ * The receive span as a take() callback sees it: forwards everything and
+ * notes whether the callback set a status, which the Reader then keeps
+ */
+class CallbackSpan final : public trace_api::Span {
+public:
+    explicit CallbackSpan(trace_api::Span& span) : span_(span) {}
+
+    using trace_api::Span::AddEvent;
+
+    void SetAttribute(nostd::string_view key, const common::AttributeValue& value) noexcept override {
+        span_.SetAttribute(key, value);
+    }
+
+    void AddEvent(nostd::string_view name) noexcept override { span_.AddEvent(name); }
+
+    void AddEvent(nostd::string_view name, common::SystemTimestamp timestamp) noexcept override {
+        span_.AddEvent(name, timestamp);
+    }
+
+    void AddEvent(nostd::string_view name, common::SystemTimestamp timestamp,
+                  const common::KeyValueIterable& attributes) noexcept override {
+        span_.AddEvent(name, timestamp, attributes);
+    }
+
+#if OPENTELEMETRY_ABI_VERSION_NO >= 2
+    void AddLink(const trace_api::SpanContext& target, const common::KeyValueIterable& attrs) noexcept override {
+        span_.AddLink(target, attrs);
+    }
+
+    void AddLinks(const trace_api::SpanContextKeyValueIterable& links) noexcept override {
+        span_.AddLinks(links);
+    }
+#endif
+
+    void SetStatus(trace_api::StatusCode code, nostd::string_view description = "") noexcept override {
+        status_set_ = true;
+        span_.SetStatus(code, description);
+    }
+
+    void UpdateName(nostd::string_view name) noexcept override { span_.UpdateName(name); }
+
+    void End(const trace_api::EndSpanOptions& options = {}) noexcept override { span_.End(options); }
+
+    trace_api::SpanContext GetContext() const noexcept override { return span_.GetContext(); }
+
+    bool IsRecording() const noexcept override { return span_.IsRecording(); }
+
+    bool status_set() const { return status_set_; }
+
+private:
+    trace_api::Span& span_;
+    bool status_set_ = false;
+};
+
+} // namespace internal
+
+// ============ Callback Profiling ============
+
+/**
+ * Measures what the calling thread did between construction and finish():
+ * CPU time (CLOCK_THREAD_CPUTIME_ID) vs wall time and context switches, plus
+ * heap allocations where TRACED_ALLOC_AUDIT() is expanded; without it the
+ * counters stay zero and thread.alloc.* is left out. CPU close to wall means
+ * CPU-bound; a large gap plus voluntary switches means blocked.
+ */
+class CpuProfile {
+public:
+    CpuProfile() {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start_);
+        clock_gettime(CLOCK_MONOTONIC, &wall_start_);
+        getrusage(RUSAGE_THREAD, &usage_start_);
+        allocs_start_ = alloc::snapshot();
+    }
+
+    void finish(trace_api::Span& span) const {
+        timespec cpu_end, wall_end;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+        clock_gettime(CLOCK_MONOTONIC, &wall_end);
+        rusage usage_end;
+        getrusage(RUSAGE_THREAD, &usage_end);
+
+        span.SetAttribute("thread.cpu_ns", elapsed_ns(cpu_start_, cpu_end));
+        span.SetAttribute("thread.wall_ns", elapsed_ns(wall_start_, wall_end));
+        span.SetAttribute("thread.ctx_switches.voluntary",
+                          (int64_t)(usage_end.ru_nvcsw - usage_start_.ru_nvcsw));
+        span.SetAttribute("thread.ctx_switches.involuntary",
+                          (int64_t)(usage_end.ru_nivcsw - usage_start_.ru_nivcsw));
+
+        if (alloc::installed()) {
+            alloc::Snapshot used = alloc::snapshot() - allocs_start_;
+            span.SetAttribute("thread.alloc.count", (int64_t)(used.count + used.c_count));
+            span.SetAttribute("thread.alloc.bytes", (int64_t)(used.bytes + used.c_bytes));
+        }
+    }
+
+private:
+    static int64_t elapsed_ns(const timespec& a, const timespec& b) {
+        return (b.tv_sec - a.tv_sec) * 1000000000LL + (b.tv_nsec - a.tv_nsec);
+    }
+
+    timespec cpu_start_;
+    timespec wall_start_;
+    rusage usage_start_;
+    alloc::Snapshot allocs_start_;
+};
+
+// ============ Transport-Priority Lanes ============
+
+/**
+ * Traffic lanes - each lane gets its own DDS writer/reader pair so a flood of
+ * bulk data cannot delay urgent samples in the writer history cache or in the
+ * receive path. Only the Normal lane uses the default partition: plain DDS
+ * readers and writers interoperate with it alone. Urgent and Bulk samples
+ * reach traced Readers only, which subscribe to every lane.
+ */
+enum class Lane : int { Urgent = 0, Normal = 1, Bulk = 2 };
+
+inline constexpr int LANE_COUNT = 3;
+
+struct LaneQos {
+    const char* name;
+    const char* partition;
+    int32_t transport_priority;     // > SynchronousDeliveryPriorityThreshold in cyclonedds.xml
+    dds_duration_t latency_budget;
+};
+
+inline const LaneQos& lane_qos(Lane lane) {
+    static const LaneQos lanes[LANE_COUNT] = {
+        {"urgent", "traced.lane.urgent", 100, 0},
+        {"normal", "",                   0,   0},
+        {"bulk",   "traced.lane.bulk",   0,   DDS_MSECS(100)},
+    };
+    return lanes[static_cast<int>(lane)];
+}
+
+/**
+ * Reliability and history of a traced endpoint, applied to every lane it
+ * uses. The defaults are what all services run with; tools/qos-bench
+ * measures the alternatives.
+ */
+struct EndpointQos {
+    dds_reliability_kind_t reliability = DDS_RELIABILITY_RELIABLE;
+    int32_t history_depth = 100;    // KEEP_LAST depth, 0 = KEEP_ALL
+    int take_batch = 10;            // Reader: samples per dds_take (1..64)
+};
+
+namespace internal {
+
+inline dds_qos_t* create_endpoint_qos(const EndpointQos& eq = EndpointQos()) {
+    dds_qos_t* qos = dds_create_qos();
+    dds_qset_reliability(qos, eq.reliability, DDS_SECS(10));
+    if (eq.history_depth > 0) {
+        dds_qset_history(qos, DDS_HISTORY_KEEP_LAST, eq.history_depth);
+    } else {
+        dds_qset_history(qos, DDS_HISTORY_KEEP_ALL, 0);
+    }
+    topology::set_service_userdata(qos, g_service_name.c_str());
+    return qos;
+}
+
+inline dds_qos_t* create_lane_qos(Lane lane, const EndpointQos& eq = EndpointQos()) {
+    const LaneQos& lq = lane_qos(lane);
+    dds_qos_t* qos = create_endpoint_qos(eq);
+    dds_qset_partition1(qos, lq.partition);
+    dds_qset_transport_priority(qos, lq.transport_priority);
+    dds_qset_latency_budget(qos, lq.latency_budget);
+    return qos;
+}
+
+// Reader QoS subscribing to every lane not served by a dedicated thread
+inline dds_qos_t* create_merged_lane_qos(const bool served[LANE_COUNT],
+                                         const EndpointQos& eq = EndpointQos()) {
+    const char* partitions[LANE_COUNT];
+    uint32_t n = 0;
+    for (int i = 0; i < LANE_COUNT; i++) {
+        if (!served[i]) partitions[n++] = lane_qos(static_cast<Lane>(i)).partition;
+    }
+    dds_qos_t* qos = create_endpoint_qos(eq);
+    dds_qset_partition(qos, n, partitions);
+    return qos;
+}
+
+} // namespace internal
+
+// ============ Service Control ============
+
+/**
+ * Every traced process listens on the ServiceControl topic (TracedTopics.idl)
+ * of the first participant it creates an endpoint on. Commands addressed to
+ * TRACED_SERVICE_NAME or "*" run on the CycloneDDS listener thread, each in
+ * a service-control span, and are answered with a ServiceControlStatus.
+ *
+ * Commands:
+ *   flight-recorder-dump - dump the flight recorder ring (traced_recorder.hpp)
+ *   set key=value,...    - change runtime settings (traced_config.hpp); each
+ *                          change is a config.changed event on the span
+ *   get                  - reply with the current settings
+ */
+inline constexpr const char* CONTROL_TOPIC = "TracedServiceControl";
+inline constexpr const char* CONTROL_STATUS_TOPIC = "TracedServiceControlStatus";
+
+namespace internal {
+
+inline dds_entity_t g_control_reader = 0;
+inline dds_entity_t g_control_status_writer = 0;
+
+inline dds_qos_t* create_control_qos() {
+    dds_qos_t* qos = dds_create_qos();
+    dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(1));
+    dds_qset_history(qos, DDS_HISTORY_KEEP_LAST, 8);
+    return qos;
+}
+
+inline void reply_control(const traced_ServiceControl& cmd, bool ok, const std::string& message) {
+    if (g_control_status_writer <= 0) return;
+    traced_ServiceControlStatus status;
+    memset(&status, 0, sizeof(status));
+    status.service = const_cast<char*>(g_service_name.c_str());
+    status.command_id = cmd.command_id;
+    status.command = cmd.command ? cmd.command : const_cast<char*>("");
+    status.ok = ok;
+    status.message = const_cast<char*>(message.c_str());
+    status.config_version = config::current()->version;
+    status.timestamp_ns = dds_time();
+    dds_write(g_control_status_writer, &status);
+}
+
+inline void handle_control(const traced_ServiceControl& cmd) {
+    const char* target = cmd.target_service ? cmd.target_service : "";
+    if (strcmp(target, "*") != 0 && g_service_name != target) return;
+
+    const char* command = cmd.command ? cmd.command : "";
+    const char* argument = cmd.argument ? cmd.argument : "";
+    printf("[traced] Control command '%s' for %s\n", command, g_service_name.c_str());
+
+    auto span = g_tracer->StartSpan("service-control");
+    span->SetAttribute("control.command", command);
+    span->SetAttribute("control.argument", argument);
+    span->SetAttribute("control.command_id", cmd.command_id);
+
+    bool ok = true;
+    std::string message;
+    if (strcmp(command, "flight-recorder-dump") == 0) {
+        recorder::request_dump(recorder::Reason::Control);
+        message = "dump requested";
+    } else if (strcmp(command, "set") == 0) {
+        std::vector<config::Change> changes;
+        ok = config::apply(argument, changes, message);
+        if (ok) {
+            uint32_t version = config::current()->version;
+            for (const config::Change& change : changes) {
+                span->AddEvent("config.changed", {
+                    {"config.key", change.key},
+                    {"config.old", change.old_value},
+                    {"config.new", change.new_value},
+                    {"config.version", static_cast<int64_t>(version)}});
+            }
+            message = config::describe();
+        }
+    } else if (strcmp(command, "get") == 0) {
+        message = config::describe();
+    } else {
+        ok = false;
+        message = std::string("unknown command '") + command + "'";
+    }
+
+    span->SetAttribute("config.version", static_cast<int64_t>(config::current()->version));
+    if (ok) {
+        span->SetStatus(trace_api::StatusCode::kOk);
+    } else {
+        span->SetStatus(trace_api::StatusCode::kError, message);
+        fprintf(stderr, "[traced] Control command '%s' failed: %s\n", command, message.c_str());
+    }
+    span->End();
+    reply_control(cmd, ok, message);
+}
+
+inline void on_control_data(dds_entity_t reader, void*) {
+    void* samples[4];
+    dds_sample_info_t infos[4];
+    while (true) {
+        samples[0] = nullptr;  // loan from DDS
+        dds_return_t n = dds_take(reader, samples, infos, 4, 4);
+        if (n <= 0) break;
+        for (int i = 0; i < n; i++) {
+            if (infos[i].valid_data) handle_control(*static_cast<traced_ServiceControl*>(samples[i]));
+        }
+        dds_return_loan(reader, samples, n);
+    }
+}
+
+// Per-process DDS services (control listener, topology publisher, clock sync,
+// probe responder) on the first participant
+inline void attach_participant(dds_entity_t participant) {
+    if (g_control_reader != 0) return;
+    topology::Publisher::instance().start(participant, g_service_name);
+    timesync::Sync::instance().start(participant, g_service_name);
+    echo::Responder::instance().start(participant, g_service_name);
+
+    dds_entity_t topic = dds_create_topic(participant, &traced_ServiceControl_desc,
+                                          CONTROL_TOPIC, nullptr, nullptr);
+    if (topic < 0) {
+        g_control_reader = topic;
+        return;
+    }
+
+    dds_qos_t* qos = create_control_qos();
+    dds_listener_t* listener = dds_create_listener(nullptr);
+    dds_lset_data_available(listener, on_control_data);
+    g_control_reader = dds_create_reader(participant, topic, qos, listener);
+    dds_delete_listener(listener);
+
+    dds_entity_t status_topic = dds_create_topic(participant, &traced_ServiceControlStatus_desc,
+                                                 CONTROL_STATUS_TOPIC, nullptr, nullptr);
+    if (status_topic >= 0) g_control_status_writer = dds_create_writer(participant, status_topic, qos, nullptr);
+    dds_delete_qos(qos);
+}
+
 } // namespace internal
 
 // ============ Traced Writer ============
@@ -163,70 +742,263 @@ struct TraceContextAccessor {
 template<typename T, typename Desc>
 class Writer {
 public:
-    Writer(dds_entity_t participant, const char* topic_name, const Desc& desc) {
+    Writer(dds_entity_t participant, const char* topic_name, const Desc& desc,
+           const EndpointQos& endpoint_qos = EndpointQos()) {
         internal::ensure_init();  // Auto-initialize tracing
+        internal::attach_participant(participant);
+        participant_ = participant;
+        topic_name_ = topic_name;
+        endpoint_qos_ = endpoint_qos;
         topic_ = dds_create_topic(participant, &desc, topic_name, nullptr, nullptr);
 
-        dds_qos_t* qos = dds_create_qos();
-        dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(10));
-        dds_qset_history(qos, DDS_HISTORY_KEEP_LAST, 100);
-
-        writer_ = dds_create_writer(participant, topic_, qos, nullptr);
+        dds_qos_t* qos = internal::create_endpoint_qos(endpoint_qos_);
+        dds_listener_t* listener = stats::matched_listener(stats::register_endpoint());
+        writer_ = dds_create_writer(participant, topic_, qos, listener);
+        if (listener) dds_delete_listener(listener);
         dds_delete_qos(qos);
+        rules_ = sampling::RuleTable::compile<T>();
+        index_ = internal::IndexedFields::compile<T>();
+        dds_endpoints_[static_cast<int>(Lane::Normal)] =
+            ddsstats::Registry::instance().add(writer_, topic_name_, "writer", "default");
     }
 
     ~Writer() {
         // DDS cleanup handled by participant deletion
     }
 
+    /**
+     * Route samples onto transport-priority lanes. The priority function is
+     * called for every write; Normal lane keeps using the default writer.
+     */
+    void set_priority(Lane (*priority)(const T&)) {
+        if (!lanes_created_) {
+            for (int i = 0; i < LANE_COUNT; i++) {
+                if (static_cast<Lane>(i) == Lane::Normal) {
+                    lane_writers_[i] = writer_;
+                    continue;
+                }
+                dds_qos_t* qos = internal::create_lane_qos(static_cast<Lane>(i), endpoint_qos_);
+                dds_listener_t* listener = stats::matched_listener(stats::register_endpoint());
+                lane_writers_[i] = dds_create_writer(participant_, topic_, qos, listener);
+                if (listener) dds_delete_listener(listener);
+                dds_delete_qos(qos);
+                dds_endpoints_[i] = ddsstats::Registry::instance().add(
+                    lane_writers_[i], topic_name_, "writer", lane_qos(static_cast<Lane>(i)).name);
+            }
+            lanes_created_ = true;
+        }
+        priority_ = priority;
+    }
+
     /**
      * Write message - automatically continues active trace or creates new root span
      */
-    bool write(T& msg, const std::string& span_name) {
+    bool write(T& msg, opentelemetry::nostd::string_view span_name) {
+        TRACED_PROBE2(write__entry, topic_name_.c_str(), sizeof(T));
         opentelemetry::nostd::shared_ptr<trace_api::Span> span;
 
         // Check if there's an active trace context (set by Reader.take)
-        if (!g_active_trace_id.empty() && !g_active_span_id.empty()) {
+        if (g_active_span_id.IsValid()) {
             // Continue the existing trace chain
-            auto trace_id = internal::hex_to_trace_id(g_active_trace_id.c_str());
-            auto parent_span = internal::hex_to_span_id(g_active_span_id.c_str());
-
-            auto parent_ctx = trace_api::SpanContext(trace_id, parent_span,
-                trace_api::TraceFlags(trace_api::TraceFlags::kIsSampled), true);
-
             trace_api::StartSpanOptions opts;
-            opts.parent = parent_ctx;
+            opts.parent = internal::active_context();
 
             span = g_tracer->StartSpan(span_name, opts);
         } else {
-            // No active trace - create root span
+            // No active trace - create root span, sampled by the rules if configured
+            int rule = rules_.active() ? rules_.evaluate(&msg) : sampling::NOT_EVALUATED;
+            sampling::RootDecision decision(rule);
             span = g_tracer->StartSpan(span_name);
+            if (rule >= 0) span->SetAttribute("sampling.rule", rules_.rule_text(rule));
         }
+        return send(msg, span);
+    }
 
-        auto scope = g_tracer->WithActiveSpan(span);
+    /**
+     * Write an update of a long-lived entity such as a sensor track. With
+     * TRACED_TRACK_TRACES on, root writes of the same key become child spans
+     * of one trace per key, rotated after TRACED_TRACK_TRACE_MAX_SPANS
+     * updates or TRACED_TRACK_TRACE_MAX_AGE_S seconds; otherwise, inside an
+     * active trace, and for keys that don't fit the track table, this is write().
+     */
+    bool write_keyed(T& msg, const char* key, opentelemetry::nostd::string_view span_name) {
+        if (!g_track_traces || !key || g_active_span_id.IsValid()) return write(msg, span_name);
+        TrackTrace* found = find_track(key);
+        if (!found) return write(msg, span_name);
+        TRACED_PROBE2(write__entry, topic_name_.c_str(), sizeof(T));
+
+        dds_time_t now = dds_time();
+        TrackTrace& track = *found;
+        int rule = rules_.active() ? rules_.evaluate(&msg) : sampling::NOT_EVALUATED;
+        // A rule match restarts a dropped track trace, so it is sampled from here on
+        bool promote = rule >= 0 && !track.root.IsSampled();
+        if (!track.root.IsValid() || promote || track.updates >= g_track_max_spans ||
+            now - track.started_ns >= g_track_max_age_ns) {
+            start_track(key, track, rule, now);
+        }
+
+        trace_api::StartSpanOptions opts;
+        opts.parent = track.root;
+        auto span = g_tracer->StartSpan(span_name, opts);
+        span->SetAttribute("track.key", key);
+        span->SetAttribute("track.update", static_cast<int64_t>(++track.updates));
+        track.last_ns = now;
+
+        if (++keyed_writes_ % TRACK_SWEEP_WRITES == 0) sweep_tracks(now);
+        return send(msg, span);
+    }
+
+    /**
+     * Send samples queued by DDS write batching (dds_write_set_batch)
+     */
+    void flush() {
+        dds_write_flush(writer_);
+        if (!lanes_created_) return;
+        for (int i = 0; i < LANE_COUNT; i++) {
+            if (lane_writers_[i] != writer_) dds_write_flush(lane_writers_[i]);
+        }
+    }
+
+    dds_entity_t get() { return writer_; }
+
+private:
+    static constexpr uint64_t TRACK_SWEEP_WRITES = 1024;
+    static constexpr size_t TRACK_KEY_BYTES = 64;
+
+    // Trace of one write_keyed() key; updates are children of root
+    struct TrackTrace {
+        trace_api::SpanContext root{false, false};
+        dds_time_t started_ns = 0;
+        dds_time_t last_ns = 0;
+        uint32_t updates = 0;
+        uint32_t generation = 0;
+        uint64_t hash = 0;
+        bool used = false;
+        char key[TRACK_KEY_BYTES];
+    };
+
+    // Open-addressed table of TRACED_TRACK_TRACE_MAX_KEYS keys at half load,
+    // allocated on the first keyed write. Null when the key is too long or
+    // the table is full.
+    TrackTrace* find_track(const char* key) {
+        size_t len = strlen(key);
+        if (len >= TRACK_KEY_BYTES) return nullptr;
+        if (!tracks_) {
+            track_mask_ = 1;
+            while (track_mask_ < 2 * g_track_max_keys) track_mask_ <<= 1;
+            tracks_.reset(new TrackTrace[track_mask_]);
+            track_mask_--;
+        }
+
+        uint64_t h = metrics::internal::fnv1a(14695981039346656037ULL, key, len);
+        for (size_t i = h & track_mask_;; i = (i + 1) & track_mask_) {
+            TrackTrace& track = tracks_[i];
+            if (!track.used) {
+                if (track_count_ >= g_track_max_keys) return nullptr;
+                track = TrackTrace();
+                track.hash = h;
+                track.used = true;
+                memcpy(track.key, key, len + 1);
+                track_count_++;
+                return &track;
+            }
+            if (track.hash == h && strcmp(track.key, key) == 0) return &track;
+        }
+    }
+
+    // Short root span of a key's next trace, linked to the previous one
+    void start_track(const char* key, TrackTrace& track, int rule, dds_time_t now) {
+        sampling::RootDecision decision(rule);
+        auto root = g_tracer->StartSpan("track-lifetime");
+        root->SetAttribute("track.key", key);
+        root->SetAttribute("track.generation", static_cast<int64_t>(track.generation));
+        root->SetAttribute("messaging.destination.name", topic_name_);
+        if (track.root.IsValid()) {
+            char previous[33];
+            internal::trace_id_to_hex(track.root.trace_id(), previous);
+            root->SetAttribute("track.previous_trace_id", previous);
+        }
+        if (rule >= 0) root->SetAttribute("sampling.rule", rules_.rule_text(rule));
+        root->End();
+
+        track.root = root->GetContext();
+        track.started_ns = now;
+        track.updates = 0;
+        track.generation++;
+    }
+
+    // Forget keys idle for longer than the rotation age
+    void sweep_tracks(dds_time_t now) {
+        for (size_t i = 0; i <= track_mask_; i++) {
+            // Erasing shifts a later key into slot i, which is checked again
+            while (tracks_[i].used && now - tracks_[i].last_ns > g_track_max_age_ns) erase_track(i);
+        }
+    }
+
+    // Backward-shift deletion keeps every probe sequence free of holes
+    void erase_track(size_t hole) {
+        track_count_--;
+        for (size_t i = (hole + 1) & track_mask_;; i = (i + 1) & track_mask_) {
+            TrackTrace& track = tracks_[i];
+            if (!track.used) break;
+            size_t home = track.hash & track_mask_;
+            // Stays if its home lies cyclically in (hole, i]
+            bool stays = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+            if (stays) continue;
+            tracks_[hole] = track;
+            hole = i;
+        }
+        tracks_[hole] = TrackTrace();
+    }
+
+    bool send(T& msg, opentelemetry::nostd::shared_ptr<trace_api::Span>& span) {
+        std::optional<trace_api::Scope> scope;
+        internal::activate(scope, span);
         
         // Auto-add trace metadata as span attributes
         span->SetAttribute("messaging.system", "dds");
         span->SetAttribute("messaging.operation", "send");
         
-        inject(msg, span);
-
-        dds_return_t ret = dds_write(writer_, &msg);
+        Lane lane = Lane::Normal;
+        dds_entity_t target = writer_;
+        if (priority_) {
+            lane = priority_(msg);
+            target = lane_writers_[static_cast<int>(lane)];
+            span->SetAttribute("messaging.dds.lane", lane_qos(lane).name);
+        }
+        ddsstats::Endpoint* dds_endpoint = dds_endpoints_[static_cast<int>(lane)];
+
+        inject(msg, span, lane);
+        index_.append(&msg, span->GetContext());
+        const char* trace_id = internal::TraceContextAccessor<T>::get(msg).trace_id;
+
+        // Only timed when slow writes are annotated
+        int64_t slow_write_ns = ddsstats::slow_write_ns();
+        dds_time_t write_start = slow_write_ns > 0 ? dds_time() : 0;
+        TRACED_PROBE3(dds__write__entry, topic_name_.c_str(), trace_id, sizeof(T));
+        dds_return_t ret = dds_write(target, &msg);
+        TRACED_PROBE3(dds__write__return, topic_name_.c_str(), trace_id, ret);
+        if (slow_write_ns > 0) {
+            int64_t write_ns = dds_time() - write_start;
+            if (write_ns > slow_write_ns) {
+                ddsstats::Registry::instance().annotate(dds_endpoint, *span, write_ns);
+            }
+        }
 
         if (ret >= 0) {
+            stats::count_write();
+            ddsstats::count_sample(dds_endpoint);
             span->SetStatus(trace_api::StatusCode::kOk);
         } else {
             span->SetStatus(trace_api::StatusCode::kError, "DDS write failed");
         }
         span->End();
 
+        TRACED_PROBE3(write__return, topic_name_.c_str(), trace_id, ret);
         return ret >= 0;
     }
 
-    dds_entity_t get() { return writer_; }
-
-private:
-    void inject(T& msg, opentelemetry::nostd::shared_ptr<trace_api::Span>& span) {
+    void inject(T& msg, opentelemetry::nostd::shared_ptr<trace_api::Span>& span, Lane lane) {
         auto ctx = span->GetContext();
         internal::trace_id_to_hex(ctx.trace_id(), internal::trace_id_buf);
         internal::span_id_to_hex(ctx.span_id(), internal::span_id_buf);
@@ -235,11 +1007,27 @@ private:
         tc.trace_id = internal::trace_id_buf;
         tc.span_id = internal::span_id_buf;
         tc.parent_span_id = (char*)"";
-        tc.trace_flags = 1;
+        tc.trace_flags = ctx.trace_flags().flags();
+        // Counted per lane: every lane is a DDS writer of its own downstream
+        tc.sequence = ++sequences_[static_cast<int>(lane)];
     }
 
+    dds_entity_t participant_;
+    std::string topic_name_;
     dds_entity_t topic_;
     dds_entity_t writer_;
+    EndpointQos endpoint_qos_;
+    dds_entity_t lane_writers_[LANE_COUNT] = {0, 0, 0};
+    ddsstats::Endpoint* dds_endpoints_[LANE_COUNT] = {nullptr, nullptr, nullptr};
+    uint32_t sequences_[LANE_COUNT] = {0, 0, 0};
+    sampling::RuleTable rules_;
+    internal::IndexedFields index_;
+    std::unique_ptr<TrackTrace[]> tracks_;
+    size_t track_mask_ = 0;
+    size_t track_count_ = 0;
+    uint64_t keyed_writes_ = 0;
+    bool lanes_created_ = false;
+    Lane (*priority_)(const T&) = nullptr;
 };
 
 // ============ Traced Reader ============
@@ -250,25 +1038,39 @@ private:
 template<typename T, typename Desc>
 class Reader {
 public:
-    Reader(dds_entity_t participant, const char* topic_name, const Desc& desc) {
+    Reader(dds_entity_t participant, const char* topic_name, const Desc& desc,
+           const EndpointQos& endpoint_qos = EndpointQos()) {
         internal::ensure_init();  // Auto-initialize tracing
+        internal::attach_participant(participant);
+        participant_ = participant;
+        topic_name_ = topic_name;
+        profile_ = g_callback_profile;
+        endpoint_qos_ = endpoint_qos;
+        take_batch_ = std::clamp(endpoint_qos.take_batch, 1, MAX_SAMPLES);
         topic_ = dds_create_topic(participant, &desc, topic_name, nullptr, nullptr);
 
-        dds_qos_t* qos = dds_create_qos();
-        dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(10));
-        dds_qset_history(qos, DDS_HISTORY_KEEP_LAST, 100);
-
-        reader_ = dds_create_reader(participant, topic_, qos, nullptr);
+        // Subscribe to all lanes until some are moved to dedicated threads
+        dds_qos_t* qos = internal::create_merged_lane_qos(served_, endpoint_qos_);
+        stats_endpoint_ = stats::register_endpoint();
+        dds_listener_t* listener = stats::matched_listener(stats_endpoint_);
+        reader_ = dds_create_reader(participant, topic_, qos, listener);
+        if (listener) dds_delete_listener(listener);
         dds_delete_qos(qos);
-
-        // Pre-allocate sample buffers
-        for (int i = 0; i < MAX_SAMPLES; i++) {
-            samples_[i] = nullptr;  // DDS will allocate
-        }
+        intake_.dds_endpoint = ddsstats::Registry::instance().add(reader_, topic_name_, "reader", "default");
+        intake_.backlog = watchdog::Watchdog::instance().add(reader_, topic_name_, "default");
+        index_ = internal::IndexedFields::compile<T>();
     }
 
     ~Reader() {
         // Samples freed by DDS or manually
+        watchdog::Watchdog::instance().remove(intake_.backlog);
+        for (auto& lane : lanes_) {
+            if (!lane) continue;
+            watchdog::Watchdog::instance().remove(lane->intake.backlog);
+            lane->running = false;
+            dds_set_guardcondition(lane->stop, true);
+            if (lane->thread.joinable()) lane->thread.join();
+        }
     }
 
     /**
@@ -277,87 +1079,298 @@ public:
      * Trace context is automatically propagated to any writer.write() calls within the callback
      */
     template<typename Callback>
-    int take(const std::string& span_name, Callback&& callback) {
+    int take(opentelemetry::nostd::string_view span_name, Callback&& callback) {
+        return process(reader_, intake_, span_name, callback);
+    }
+
+    /**
+     * Drop samples already taken within a time window before they reach the
+     * callback, keyed on writer and sequence or on a registered field (see
+     * traced_dedup.hpp). Call during setup, before serve_lane(); every lane
+     * keeps its own window.
+     */
+    void set_dedup(const dedup::Options& options) {
+        const char* (*field)(const void*) = nullptr;
+        if (options.key == dedup::Key::Field) {
+            for (const sampling::Field& f : sampling::internal::fields<T>()) {
+                if (options.field && strcmp(f.name, options.field) == 0) field = f.get;
+            }
+            if (!field) {
+                fprintf(stderr, "[traced] %s: dedup field '%s' is not registered with TRACED_DDS_FIELD, "
+                                "duplicates are not dropped\n",
+                        topic_name_.c_str(), options.field ? options.field : "");
+                return;
+            }
+        }
+        dedup_options_ = options;
+        dedup_field_ = field;
+        intake_.dedup.configure(options, field);
+    }
+
+    // Samples dropped as duplicates by take(), lanes not included
+    uint64_t duplicates() const { return intake_.dedup.dropped(); }
+
+    // Samples missing from writer sequences / taken late, seen by take(), lanes not included
+    uint64_t lost() const { return intake_.loss.lost(); }
+    uint64_t reordered() const { return intake_.loss.reordered(); }
+
+    /**
+     * Serve a lane from a dedicated receive thread. The lane gets its own DDS
+     * reader and is removed from the reader polled by take(). Call during setup,
+     * before the first take(); the callback runs on the lane thread.
+     */
+    template<typename Callback>
+    void serve_lane(Lane lane, opentelemetry::nostd::string_view span_name, Callback callback) {
+        int idx = static_cast<int>(lane);
+        if (lanes_[idx]) return;
+
+        auto server = std::make_unique<LaneServer>();
+        dds_qos_t* qos = internal::create_lane_qos(lane, endpoint_qos_);
+        server->reader = dds_create_reader(participant_, topic_, qos, nullptr);
+        dds_delete_qos(qos);
+        server->intake.dds_endpoint = ddsstats::Registry::instance().add(
+            server->reader, topic_name_, "reader", lane_qos(lane).name);
+        server->intake.backlog = watchdog::Watchdog::instance().add(server->reader, topic_name_, lane_qos(lane).name);
+        if (intake_.dedup.active()) server->intake.dedup.configure(dedup_options_, dedup_field_);
+
+        // Re-create the polled reader without the served lane
+        served_[idx] = true;
+        ddsstats::Registry::instance().remove(intake_.dds_endpoint);
+        watchdog::Watchdog::instance().remove(intake_.backlog);
+        dds_delete(reader_);
+        qos = internal::create_merged_lane_qos(served_, endpoint_qos_);
+        dds_listener_t* listener = stats::matched_listener(stats_endpoint_);
+        reader_ = dds_create_reader(participant_, topic_, qos, listener);
+        if (listener) dds_delete_listener(listener);
+        dds_delete_qos(qos);
+        intake_.dds_endpoint = ddsstats::Registry::instance().add(reader_, topic_name_, "reader", "default");
+        intake_.backlog = watchdog::Watchdog::instance().add(reader_, topic_name_, "default");
+
+        server->waitset = dds_create_waitset(participant_);
+        server->stop = dds_create_guardcondition(participant_);
+        dds_waitset_attach(server->waitset,
+                           dds_create_readcondition(server->reader, DDS_ANY_STATE), 0);
+        dds_waitset_attach(server->waitset, server->stop, 1);
+
+        LaneServer* ls = server.get();
+        std::string thread_name = std::string("lane-") + lane_qos(lane).name;
+        std::string name(span_name.data(), span_name.size());
+        ls->thread = std::thread([this, ls, thread_name, name, callback]() mutable {
+            pthread_setname_np(pthread_self(), thread_name.substr(0, 15).c_str());
+            runtime::pin_current_thread(runtime::Role::Worker);
+            runtime::enter_rt_thread();
+            while (ls->running) {
+                if (dds_waitset_wait(ls->waitset, nullptr, 0, DDS_INFINITY) < 0) break;
+                if (!ls->running) break;
+                while (process(ls->reader, ls->intake, name, callback) > 0) {}
+            }
+        });
+        lanes_[idx] = std::move(server);
+    }
+
+    /**
+     * Simplified take - callback receives only the message (no span parameter needed)
+     * Tracing is still fully automatic behind the scenes
+     */
+    template<typename Callback>
+    int take_simple(opentelemetry::nostd::string_view span_name, Callback&& callback) {
+        return take(span_name, [&callback](T& msg, trace_api::Span&) {
+            callback(msg);
+        });
+    }
+
+    /**
+     * Record per-callback CPU time, allocations and context switches
+     * (defaults to TRACED_CALLBACK_PROFILE)
+     */
+    void set_callback_profiling(bool enabled) { profile_ = enabled; }
+
+    /**
+     * Service that wrote a sample taken directly from get(), for callers doing
+     * their own dds_take (e.g. to fill TraceLink::service)
+     */
+    const char* publisher_service(const dds_sample_info_t& info) {
+        return intake_.publishers.service(reader_, info.publication_handle);
+    }
+
+    /**
+     * Process that wrote such a sample, for TraceLink::origin_id; 0 if unknown
+     */
+    int64_t publisher_origin(const dds_sample_info_t& info) {
+        return intake_.publishers.lookup(reader_, info.publication_handle).origin_id;
+    }
+
+    dds_entity_t get() { return reader_; }
+
+private:
+    static constexpr int MAX_SAMPLES = config::MAX_TAKE_BATCH;
+
+    // Take state of one DDS reader: the polled one or a lane server's
+    struct Intake {
+        void* samples[MAX_SAMPLES] = {nullptr};     // loaned by DDS for one pass
+        topology::PublisherCache publishers;
+        ddsstats::Endpoint* dds_endpoint = nullptr;
+        dedup::Filter dedup;
+        loss::Tracker loss;
+        watchdog::Backlog* backlog = nullptr;
+    };
+
+    struct LaneServer {
+        dds_entity_t reader = 0;
+        dds_entity_t waitset = 0;
+        dds_entity_t stop = 0;
+        Intake intake;
+        std::atomic<bool> running{true};
+        std::thread thread;
+    };
+
+    template<typename Callback>
+    int process(dds_entity_t reader, Intake& intake, opentelemetry::nostd::string_view span_name,
+                Callback& callback) {
+        // Heartbeat of the calling thread for the stall watchdog
+        watchdog::Pass pass(topic_name_.c_str());
+        void** samples = intake.samples;
+        ddsstats::Endpoint* dds_endpoint = intake.dds_endpoint;
+        dedup::Filter& dedup = intake.dedup;
         dds_sample_info_t infos[MAX_SAMPLES];
-        dds_return_t n = dds_take(reader_, samples_, infos, MAX_SAMPLES, MAX_SAMPLES);
+        int live_batch = config::current()->take_batch;
+        int batch = live_batch > 0 ? std::min(live_batch, MAX_SAMPLES) : take_batch_;
+        TRACED_PROBE2(take__batch__start, topic_name_.c_str(), batch);
+        // A loan sized for this pass's batch, returned at its end: the batch
+        // may grow at runtime (take-batch)
+        samples[0] = nullptr;
+        dds_return_t n = dds_take(reader, samples, infos, batch, batch);
+        pass.taken(n);
 
         int processed = 0;
         if (n > 0) {
+            dds_time_t received = dds_time();
+            // Loss CycloneDDS reported since the last take, on the first span of the batch
+            dds_sample_lost_status_t lost_status;
+            int32_t dds_lost = 0;
+            if (dds_get_sample_lost_status(reader, &lost_status) == DDS_RETCODE_OK) {
+                dds_lost = lost_status.total_count_change;
+                ddsstats::count_loss(dds_endpoint, 0, 0, static_cast<uint64_t>(dds_lost));
+            }
             for (int i = 0; i < n; i++) {
                 if (!infos[i].valid_data) continue;
 
-                T* msg = static_cast<T*>(samples_[i]);
+                const topology::Upstream& upstream = intake.publishers.lookup(reader, infos[i].publication_handle);
+                timesync::Latency transit =
+                    timesync::latency_since(upstream.clock, received, infos[i].source_timestamp);
+                topology::record_edge(topic_name_.c_str(), upstream.service,
+                                      topology::EdgeKind::Take, transit.ns);
+                stats::record_take(transit.ns);
+                ddsstats::count_sample(dds_endpoint);
 
+                T* msg = static_cast<T*>(samples[i]);
                 // Extract trace context and create child span
                 auto& tc = internal::TraceContextAccessor<T>::get(*msg);
-                std::string trace_id_str = tc.trace_id ? tc.trace_id : "";
-                std::string span_id_str = tc.span_id ? tc.span_id : "";
+                const char* trace_id_str = tc.trace_id ? tc.trace_id : "";
+                const char* span_id_str = tc.span_id ? tc.span_id : "";
 
-                auto trace_id = internal::hex_to_trace_id(trace_id_str.c_str());
-                auto parent_span_id = internal::hex_to_span_id(span_id_str.c_str());
+                auto trace_id = internal::hex_to_trace_id(trace_id_str);
+                auto parent_span_id = internal::hex_to_span_id(span_id_str);
 
                 auto parent_ctx = trace_api::SpanContext(trace_id, parent_span_id,
-                    trace_api::TraceFlags(trace_api::TraceFlags::kIsSampled), true);
+                    trace_api::TraceFlags(tc.trace_flags), true);
+                // queue: take -> callback start, behind earlier samples of the batch
+                int64_t queue_ns = dds_time() - received;
 
                 trace_api::StartSpanOptions opts;
                 opts.parent = parent_ctx;
 
+                loss::Observation seq = intake.loss.observe(upstream.writer_id, tc.sequence, received);
+                ddsstats::count_loss(dds_endpoint, seq.missing,
+                                     seq.kind == loss::Observation::Reordered ? 1 : 0, 0);
+
+                if (dedup.active() && dedup.duplicate(msg, upstream.writer_id, tc.sequence,
+                                                      infos[i].source_timestamp, received)) {
+                    ddsstats::count_duplicate(dds_endpoint);
+                    auto dup = g_tracer->StartSpan(span_name, opts);
+                    dup->SetAttribute("messaging.system", "dds");
+                    dup->SetAttribute("messaging.operation", "receive");
+                    dup->SetAttribute("messaging.dds.duplicate", true);
+                    loss::annotate(*dup, seq, upstream.service);
+                    dup->AddEvent("dds.duplicate", {
+                        {"dedup.key", dedup.key_name()},
+                        {"messaging.dds.sequence", static_cast<int64_t>(tc.sequence)},
+                        {"messaging.dds.publisher", upstream.service},
+                        {"dedup.dropped", static_cast<int64_t>(dedup.dropped())}});
+                    dup->End();
+                    continue;
+                }
+
                 auto span = g_tracer->StartSpan(span_name, opts);
-                auto scope = g_tracer->WithActiveSpan(span);
+                std::optional<trace_api::Scope> scope;
+                internal::activate(scope, span);
 
                 // Set thread-local active trace context for automatic propagation
-                auto ctx = span->GetContext();
-                internal::trace_id_to_hex(ctx.trace_id(), internal::trace_id_buf);
-                internal::span_id_to_hex(ctx.span_id(), internal::span_id_buf);
-                g_active_trace_id = internal::trace_id_buf;
-                g_active_span_id = internal::span_id_buf;
+                internal::set_active(span->GetContext());
+                index_.append(msg, span->GetContext());
 
                 // Auto-add trace metadata as span attributes
                 span->SetAttribute("messaging.system", "dds");
                 span->SetAttribute("messaging.operation", "receive");
-                if (!trace_id_str.empty()) {
+                if (trace_id_str[0]) {
                     span->SetAttribute("messaging.source_trace_id", trace_id_str);
                 }
-                if (!span_id_str.empty()) {
+                if (span_id_str[0]) {
                     span->SetAttribute("messaging.source_span_id", span_id_str);
                 }
+                span->SetAttribute("messaging.dds.transit_ns", transit.ns);
+                span->SetAttribute("messaging.dds.queue_ns", queue_ns);
+                if (transit.corrected) {
+                    span->SetAttribute("messaging.dds.clock_offset_ns", transit.clock_offset_ns);
+                }
+                loss::annotate(*span, seq, upstream.service);
+                if (dds_lost > 0) {
+                    span->AddEvent("dds.sample_lost", {{"dds.lost_count", static_cast<int64_t>(dds_lost)}});
+                    dds_lost = 0;
+                }
 
                 // Call user callback with message and span
-                callback(*msg, *span);
+                pass.set_context(span->GetContext());
+                internal::CallbackSpan callback_span(*span);
+                TRACED_PROBE3(callback__entry, topic_name_.c_str(), trace_id_str, sizeof(T));
+                if (profile_) {
+                    CpuProfile profile;
+                    callback(*msg, callback_span);
+                    profile.finish(*span);
+                } else {
+                    callback(*msg, callback_span);
+                }
+                TRACED_PROBE2(callback__return, topic_name_.c_str(), trace_id_str);
 
                 // Clear active context after callback
-                g_active_trace_id.clear();
-                g_active_span_id.clear();
+                internal::clear_active();
 
-                // Auto-set OK status if not already set
-                span->SetStatus(trace_api::StatusCode::kOk);
+                // OK unless the callback set a status itself
+                if (!callback_span.status_set()) span->SetStatus(trace_api::StatusCode::kOk);
                 span->End();
                 processed++;
             }
+            dds_return_loan(reader, samples, n);
         }
 
+        TRACED_PROBE3(take__batch__end, topic_name_.c_str(), n, processed);
         return processed;
     }
 
-    /**
-     * Simplified take - callback receives only the message (no span parameter needed)
-     * Tracing is still fully automatic behind the scenes
-     */
-    template<typename Callback>
-    int take_simple(const std::string& span_name, Callback&& callback) {
-        return take(span_name, [&callback](T& msg, trace_api::Span&) {
-            callback(msg);
-        });
-    }
-
-    dds_entity_t get() { return reader_; }
-
-private:
-    static constexpr int MAX_SAMPLES = 10;
-
+    dds_entity_t participant_;
+    std::string topic_name_;
     dds_entity_t topic_;
     dds_entity_t reader_;
-    void* samples_[MAX_SAMPLES];
+    Intake intake_;
+    EndpointQos endpoint_qos_;
+    int take_batch_ = 10;
+    stats::Endpoint* stats_endpoint_ = nullptr;
+    internal::IndexedFields index_;
+    dedup::Options dedup_options_;
+    const char* (*dedup_field_)(const void*) = nullptr;
+    bool served_[LANE_COUNT] = {false, false, false};
+    std::unique_ptr<LaneServer> lanes_[LANE_COUNT];
+    bool profile_ = false;
 };
 
 // ============ Convenience Macros ============
@@ -395,7 +1408,7 @@ private:
  *   span->End();
  */
 inline std::pair<opentelemetry::nostd::shared_ptr<trace_api::Span>, trace_api::Scope> 
-create_linked_span(const std::string& span_name, const std::vector<TraceLink>& links) {
+create_linked_span(opentelemetry::nostd::string_view span_name, const std::vector<TraceLink>& links) {
     internal::ensure_init();
     
     trace_api::StartSpanOptions opts;
@@ -409,22 +1422,29 @@ create_linked_span(const std::string& span_name, const std::vector<TraceLink>& l
     int link_idx = 0;
     for (const auto& link : links) {
         if (!link.trace_id.empty() && !link.span_id.empty()) {
-            std::string prefix = "link." + std::to_string(link_idx) + ".";
-            span->SetAttribute(prefix + "trace_id", link.trace_id);
-            span->SetAttribute(prefix + "span_id", link.span_id);
+            char key[48];
+            snprintf(key, sizeof(key), "link.%d.trace_id", link_idx);
+            span->SetAttribute(key, link.trace_id);
+            snprintf(key, sizeof(key), "link.%d.span_id", link_idx);
+            span->SetAttribute(key, link.span_id);
             if (!link.sensor_id.empty()) {
-                span->SetAttribute(prefix + "sensor_id", link.sensor_id);
+                snprintf(key, sizeof(key), "link.%d.sensor_id", link_idx);
+                span->SetAttribute(key, link.sensor_id);
             }
             link_idx++;
         }
+        if (!link.service.empty()) {
+            int64_t latency = -1;
+            if (link.source_timestamp) {
+                const timesync::Peer* clock = timesync::Sync::instance().find(link.origin_id);
+                latency = timesync::latency_since(clock, dds_time(), link.source_timestamp).ns;
+            }
+            topology::record_edge(link.topic.c_str(), link.service.c_str(), topology::EdgeKind::Link, latency);
+        }
     }
     
     // Set active context for child spans
-    auto ctx = span->GetContext();
-    internal::trace_id_to_hex(ctx.trace_id(), internal::trace_id_buf);
-    internal::span_id_to_hex(ctx.span_id(), internal::span_id_buf);
-    g_active_trace_id = internal::trace_id_buf;
-    g_active_span_id = internal::span_id_buf;
+    internal::set_active(span->GetContext());
     
     return {span, std::move(scope)};
 }
@@ -434,29 +1454,20 @@ create_linked_span(const std::string& span_name, const std::vector<TraceLink>& l
  * Used for measuring sub-operations within a fusion process.
  */
 inline std::pair<opentelemetry::nostd::shared_ptr<trace_api::Span>, trace_api::Scope>
-create_child_span(const std::string& span_name) {
+create_child_span(opentelemetry::nostd::string_view span_name) {
     internal::ensure_init();
     
     trace_api::StartSpanOptions opts;
     
-    if (!g_active_trace_id.empty() && !g_active_span_id.empty()) {
-        auto trace_id = internal::hex_to_trace_id(g_active_trace_id.c_str());
-        auto parent_span = internal::hex_to_span_id(g_active_span_id.c_str());
-        
-        auto parent_ctx = trace_api::SpanContext(trace_id, parent_span,
-            trace_api::TraceFlags(trace_api::TraceFlags::kIsSampled), true);
-        opts.parent = parent_ctx;
+    if (g_active_span_id.IsValid()) {
+        opts.parent = internal::active_context();
     }
     
     auto span = g_tracer->StartSpan(span_name, opts);
     auto scope = g_tracer->WithActiveSpan(span);
     
     // Update active context
-    auto ctx = span->GetContext();
-    internal::trace_id_to_hex(ctx.trace_id(), internal::trace_id_buf);
-    internal::span_id_to_hex(ctx.span_id(), internal::span_id_buf);
-    g_active_trace_id = internal::trace_id_buf;
-    g_active_span_id = internal::span_id_buf;
+    internal::set_active(span->GetContext());
     
     return {span, std::move(scope)};
 }
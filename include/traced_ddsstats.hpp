@@ -0,0 +1,362 @@
+// DDS Tracing Library - CycloneDDS entity statistics
+// Samples the statistics CycloneDDS keeps per writer and reader
+// (dds_create_statistics / dds_refresh_statistics: retransmitted bytes,
+// writer history throttling, ...) and exports them as per-topic OTLP
+// metrics. A traced write slower than a threshold gets the current values
+// of its writer as span attributes, so a slow write shows whether DDS was
+// retransmitting or throttling at the time.
+//
+// Configuration via environment variables:
+//   TRACED_DDS_STATISTICS             - "1" samples and exports the statistics
+//   TRACED_DDS_STATISTICS_INTERVAL_MS - sampling/export interval (default: 10000)
+//   TRACED_SLOW_WRITE_US              - writes slower than this get the
+//                                       writer's statistics on their span
+//                                       (default: unset, off)
+//
+// Metrics (cumulative sums), attributes service.name,
+// messaging.destination.name (topic), dds.entity (writer/reader) and
+// messaging.dds.lane:
+//   traced.dds.<statistic> - every statistic CycloneDDS reports for the
+//                            entity, e.g. traced.dds.rexmit_bytes,
+//                            traced.dds.throttle_count
+//   traced.dds.samples     - samples written / taken through the endpoint
+//   traced.dds.duplicates  - samples a reader dropped as duplicates
+//                            (Reader::set_dedup)
+//   traced.dds.lost, traced.dds.reordered - samples missing from / taken
+//                            late in writer sequences (traced_loss.hpp)
+//   traced.dds.sample_lost - CycloneDDS SAMPLE_LOST status of the reader
+//
+// The entity statistics need CycloneDDS 0.10 or newer
+// (dds/ddsc/dds_statistics.h). Older builds compile without them, say so
+// once and export only the counters the library keeps itself.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "dds/dds.h"
+#if __has_include("dds/ddsc/dds_statistics.h")
+#include "dds/ddsc/dds_statistics.h"
+#define TRACED_HAVE_DDS_STATISTICS 1
+#else
+#define TRACED_HAVE_DDS_STATISTICS 0
+#endif
+
+#include "opentelemetry/trace/span.h"
+#include "traced_runtime.hpp"
+#include "traced_recorder.hpp"
+#include "traced_metrics.hpp"
+
+namespace traced {
+namespace ddsstats {
+
+namespace metrics_sdk = opentelemetry::sdk::metrics;
+namespace otlp = opentelemetry::exporter::otlp;
+namespace resource = opentelemetry::sdk::resource;
+
+/**
+ * A registered writer or reader. Endpoints are never freed: a removed one
+ * keeps its last values so the cumulative per-topic sums never go back.
+ */
+struct Endpoint {
+    std::string topic;
+    const char* entity_kind;        // "writer" / "reader"
+    const char* lane;
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> duplicates{0};
+    std::atomic<uint64_t> lost{0};
+    std::atomic<uint64_t> reordered{0};
+    std::atomic<uint64_t> sample_lost{0};
+
+    std::mutex mutex;               // sampler thread vs slow-write annotation
+#if TRACED_HAVE_DDS_STATISTICS
+    struct dds_statistics* stats = nullptr;
+#endif
+    std::vector<std::pair<std::string, uint64_t>> values;   // last refresh
+};
+
+namespace internal {
+
+inline bool g_export = false;
+inline int64_t g_slow_write_ns = 0;     // 0 = off
+
+#if TRACED_HAVE_DDS_STATISTICS
+inline uint64_t stat_value(const struct dds_stat_keyvalue& kv) {
+    switch (kv.kind) {
+    case DDS_STAT_KIND_UINT32: return kv.u.u32;
+    case DDS_STAT_KIND_UINT64: return kv.u.u64;
+    case DDS_STAT_KIND_LENGTHTIME: return kv.u.lengthtime;
+    }
+    return 0;
+}
+#endif
+
+// Refresh under ep.mutex; a failed refresh (entity deleted) keeps the last values
+inline bool refresh(Endpoint& ep) {
+#if TRACED_HAVE_DDS_STATISTICS
+    if (!ep.stats || dds_refresh_statistics(ep.stats) < 0) return false;
+    ep.values.resize(ep.stats->count);
+    for (size_t i = 0; i < ep.stats->count; i++) {
+        ep.values[i].first = ep.stats->kv[i].name;
+        ep.values[i].second = stat_value(ep.stats->kv[i]);
+    }
+    return true;
+#else
+    (void)ep;
+    return false;
+#endif
+}
+
+} // namespace internal
+
+inline bool enabled() { return internal::g_export || internal::g_slow_write_ns > 0; }
+inline int64_t slow_write_ns() { return internal::g_slow_write_ns; }
+
+/**
+ * Endpoint registry plus the sampling/export thread
+ */
+class Registry {
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    // Called once from traced::internal::do_init
+    void start(const std::string& service_name, const std::string& traces_endpoint) {
+        if (started_) return;
+        started_ = true;
+        bool requested = recorder::internal::env_flag("TRACED_DDS_STATISTICS", false);
+        int64_t slow_write_us = static_cast<int64_t>(runtime::internal::env_size("TRACED_SLOW_WRITE_US", 0));
+#if !TRACED_HAVE_DDS_STATISTICS
+        if (requested || slow_write_us > 0) {
+            fprintf(stderr, "[traced] CycloneDDS without entity statistics (needs 0.10+), "
+                            "exporting the traced counters only\n");
+        }
+#endif
+        internal::g_slow_write_ns = slow_write_us * 1000;
+        if (!requested) return;
+        internal::g_export = true;
+
+        service_name_ = service_name;
+        interval_ms_ = runtime::internal::env_size("TRACED_DDS_STATISTICS_INTERVAL_MS", 10000);
+        if (interval_ms_ == 0) interval_ms_ = 10000;
+
+        otlp::OtlpHttpMetricExporterOptions opts;
+        opts.url = metrics::metrics_endpoint(traces_endpoint);
+        opts.aggregation_temporality = otlp::PreferredAggregationTemporality::kCumulative;
+        exporter_ = otlp::OtlpHttpMetricExporterFactory::Create(opts);
+
+        resource_ = std::make_unique<resource::Resource>(resource::Resource::Create({
+            {"service.name", service_name_},
+            {"service.version", "1.0.0"}
+        }));
+        scope_ = opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create(
+            "traced.dds", "1.0.0");
+        start_time_ = std::chrono::system_clock::now();
+
+        {
+            runtime::ScopedPlacement export_placement(runtime::Role::Exporter);
+            thread_ = std::thread([this]() { run(); });
+        }
+        printf("[traced] DDS statistics every %zums -> %s\n", interval_ms_, opts.url.c_str());
+    }
+
+    ~Registry() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+    /**
+     * Track a DDS writer/reader; nullptr when neither export nor slow-write
+     * annotation is on
+     */
+    Endpoint* add(dds_entity_t entity, const std::string& topic, const char* entity_kind,
+                  const char* lane) {
+        if (!enabled()) return nullptr;
+        auto ep = std::make_unique<Endpoint>();
+        ep->topic = topic;
+        ep->entity_kind = entity_kind;
+        ep->lane = lane;
+#if TRACED_HAVE_DDS_STATISTICS
+        ep->stats = dds_create_statistics(entity);
+#endif
+        std::lock_guard<std::mutex> lock(mutex_);
+        endpoints_.push_back(std::move(ep));
+        return endpoints_.back().get();
+    }
+
+    // Before the entity is deleted: take its final values and stop sampling it
+    void remove(Endpoint* ep) {
+        if (!ep) return;
+        std::lock_guard<std::mutex> lock(ep->mutex);
+        internal::refresh(*ep);
+#if TRACED_HAVE_DDS_STATISTICS
+        if (ep->stats) dds_delete_statistics(ep->stats);
+        ep->stats = nullptr;
+#endif
+    }
+
+    /**
+     * Current statistics of a slow write's writer on its span
+     */
+    void annotate(Endpoint* ep, opentelemetry::trace::Span& span, int64_t write_ns) {
+        span.SetAttribute("messaging.dds.write_us", write_ns / 1000);
+        if (!ep) return;
+        std::lock_guard<std::mutex> lock(ep->mutex);
+        internal::refresh(*ep);
+        char key[96];
+        for (const auto& kv : ep->values) {
+            snprintf(key, sizeof(key), "messaging.dds.stat.%s", kv.first.c_str());
+            span.SetAttribute(key, static_cast<int64_t>(kv.second));
+        }
+    }
+
+private:
+    // (metric, topic, entity kind, lane)
+    using Key = std::tuple<std::string, std::string, const char*, const char*>;
+
+    Registry() = default;
+
+    std::map<Key, uint64_t> sample_all() {
+        std::vector<Endpoint*> endpoints;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& ep : endpoints_) endpoints.push_back(ep.get());
+        }
+        std::map<Key, uint64_t> totals;
+        for (Endpoint* ep : endpoints) {
+            std::lock_guard<std::mutex> lock(ep->mutex);
+            internal::refresh(*ep);
+            for (const auto& kv : ep->values) {
+                totals[Key("traced.dds." + kv.first, ep->topic, ep->entity_kind, ep->lane)] += kv.second;
+            }
+            totals[Key("traced.dds.samples", ep->topic, ep->entity_kind, ep->lane)] +=
+                ep->samples.load(std::memory_order_relaxed);
+            if (std::strcmp(ep->entity_kind, "reader") == 0) {
+                const std::pair<const char*, const std::atomic<uint64_t>*> counters[] = {
+                    {"traced.dds.duplicates", &ep->duplicates},
+                    {"traced.dds.lost", &ep->lost},
+                    {"traced.dds.reordered", &ep->reordered},
+                    {"traced.dds.sample_lost", &ep->sample_lost},
+                };
+                for (const auto& c : counters) {
+                    totals[Key(c.first, ep->topic, ep->entity_kind, ep->lane)] +=
+                        c.second->load(std::memory_order_relaxed);
+                }
+            }
+        }
+        return totals;
+    }
+
+    metrics_sdk::ResourceMetrics collect() {
+        opentelemetry::common::SystemTimestamp start(start_time_);
+        opentelemetry::common::SystemTimestamp now(std::chrono::system_clock::now());
+
+        std::map<std::string, metrics_sdk::MetricData> by_name;
+        for (const auto& entry : sample_all()) {
+            const std::string& name = std::get<0>(entry.first);
+            auto it = by_name.find(name);
+            if (it == by_name.end()) {
+                metrics_sdk::MetricData data;
+                data.instrument_descriptor = {name, "CycloneDDS entity statistic", "1",
+                                              metrics_sdk::InstrumentType::kCounter,
+                                              metrics_sdk::InstrumentValueType::kLong};
+                data.aggregation_temporality = metrics_sdk::AggregationTemporality::kCumulative;
+                data.start_ts = start;
+                data.end_ts = now;
+                it = by_name.emplace(name, std::move(data)).first;
+            }
+            metrics_sdk::PointAttributes attrs;
+            attrs.SetAttribute("service.name", service_name_);
+            attrs.SetAttribute("messaging.destination.name", std::get<1>(entry.first));
+            attrs.SetAttribute("dds.entity", std::get<2>(entry.first));
+            attrs.SetAttribute("messaging.dds.lane", std::get<3>(entry.first));
+
+            metrics_sdk::SumPointData sum;
+            sum.value_ = static_cast<int64_t>(entry.second);
+            sum.is_monotonic_ = true;
+            it->second.point_data_attr_.push_back({attrs, sum});
+        }
+
+        metrics_sdk::ScopeMetrics scope_metrics;
+        scope_metrics.scope_ = scope_.get();
+        for (auto& entry : by_name) scope_metrics.metric_data_.push_back(std::move(entry.second));
+
+        metrics_sdk::ResourceMetrics out;
+        out.resource_ = resource_.get();
+        out.scope_metric_data_.push_back(std::move(scope_metrics));
+        return out;
+    }
+
+    void run() {
+        pthread_setname_np(pthread_self(), "dds-stats");
+        bool stopping = false;
+        while (!stopping) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, std::chrono::milliseconds(interval_ms_), [this]() { return stop_; });
+                stopping = stop_;
+            }
+            auto result = exporter_->Export(collect());
+            bool ok = result == opentelemetry::sdk::common::ExportResult::kSuccess;
+            if (!ok && !export_failed_) {
+                fprintf(stderr, "[traced] DDS statistics export failed (is the endpoint an OTLP metrics receiver?)\n");
+            }
+            export_failed_ = !ok;
+        }
+        exporter_->Shutdown();
+    }
+
+    bool started_ = false;
+    std::string service_name_;
+    size_t interval_ms_ = 10000;
+    std::chrono::system_clock::time_point start_time_;
+
+    std::unique_ptr<metrics_sdk::PushMetricExporter> exporter_;
+    std::unique_ptr<resource::Resource> resource_;
+    std::unique_ptr<opentelemetry::sdk::instrumentationscope::InstrumentationScope> scope_;
+    bool export_failed_ = false;
+
+    std::mutex mutex_;                  // endpoint list and thread wakeup
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+    std::vector<std::unique_ptr<Endpoint>> endpoints_;
+};
+
+inline void count_sample(Endpoint* ep) {
+    if (ep) ep->samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void count_duplicate(Endpoint* ep) {
+    if (ep) ep->duplicates.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void count_loss(Endpoint* ep, uint64_t lost, uint64_t reordered, uint64_t sample_lost) {
+    if (!ep || (lost | reordered | sample_lost) == 0) return;
+    ep->lost.fetch_add(lost, std::memory_order_relaxed);
+    ep->reordered.fetch_add(reordered, std::memory_order_relaxed);
+    ep->sample_lost.fetch_add(sample_lost, std::memory_order_relaxed);
+}
+
+} // namespace ddsstats
+} // namespace traced
@@ -0,0 +1,178 @@
+// DDS Tracing Library - duplicate sample suppression
+// An opt-in stage of traced::Reader that drops samples it has already seen,
+// before the span callback runs. Duplicates come from reconnects and
+// durability replays (the same sample of the same writer again) and from
+// redundant publishers (hot-standby fusion, replayed data: another writer,
+// the same business entity). Two kinds of key:
+//
+//   Key::Writer - the writer's GUID plus its TraceContext.sequence (the
+//                 source timestamp for writers that do not set one)
+//   Key::Field  - a string field registered with TRACED_DDS_FIELD, e.g.
+//                 mission_id, so any writer's copy of the entity is dropped
+//
+//   reader.set_dedup({traced::dedup::Key::Field, "mission_id"});
+//
+// Keys are remembered in a split-block bloom filter of two generations.
+// A generation is retired after window_ms, or early once it holds capacity
+// keys, so memory stays at capacity * 4 bytes (rounded up to a power of
+// two) and a key is remembered for window_ms to twice that. The price of
+// the bounded memory is a false positive rate around 0.1% at capacity: a
+// new sample is then dropped as a duplicate. Size capacity for the keys
+// arriving within one window.
+//
+// A dropped duplicate still gets its receive span, with the
+// messaging.dds.duplicate attribute and a dds.duplicate event, and is
+// counted as traced.dds.duplicates with TRACED_DDS_STATISTICS on.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace traced {
+namespace dedup {
+
+enum class Key { Writer, Field };
+
+struct Options {
+    Key key = Key::Writer;
+    const char* field = nullptr;    // Key::Field: name of a TRACED_DDS_FIELD
+    int64_t window_ms = 60000;      // keys are remembered at least this long
+    size_t capacity = 16384;        // keys per window at the rated false positive rate
+};
+
+namespace internal {
+
+// 8 x 64-bit words, one cache line; a key sets one bit per word
+struct alignas(64) Block {
+    uint64_t words[8];
+};
+
+inline constexpr uint32_t SALT[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t hash_string(const char* s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (; *s; s++) h = (h ^ static_cast<unsigned char>(*s)) * 1099511628211ULL;
+    return mix(h);
+}
+
+} // namespace internal
+
+/**
+ * Time-windowed membership filter of one reader (or one lane of it);
+ * single-threaded like the take loop it belongs to
+ */
+class Filter {
+public:
+    void configure(const Options& options, const char* (*field)(const void*)) {
+        options_ = options;
+        field_ = field;
+        size_t blocks = 1;
+        // 16 bits per key
+        while (blocks * 32 < options.capacity) blocks <<= 1;
+        for (Generation& g : generations_) {
+            g.blocks.assign(blocks, internal::Block{});
+            g.count = 0;
+            g.started_ns = 0;
+        }
+        mask_ = blocks - 1;
+        current_ = 0;
+        active_ = true;
+    }
+
+    bool active() const { return active_; }
+    Key key() const { return options_.key; }
+    const char* key_name() const { return options_.key == Key::Field ? options_.field : "writer"; }
+    uint64_t dropped() const { return dropped_; }
+
+    /**
+     * True if the sample's key was seen within the window; otherwise the key
+     * is remembered and the sample should be processed
+     */
+    bool duplicate(const void* msg, uint64_t writer_id, uint32_t sequence,
+                   int64_t source_timestamp, int64_t now_ns) {
+        uint64_t h;
+        if (field_) {
+            h = internal::hash_string(field_(msg));
+        } else {
+            uint64_t seq = sequence ? sequence : static_cast<uint64_t>(source_timestamp);
+            h = internal::mix(writer_id ^ internal::mix(seq));
+        }
+
+        Generation& current = generations_[current_];
+        if (current.started_ns == 0) current.started_ns = now_ns;
+        if (now_ns - current.started_ns >= options_.window_ms * 1000000 ||
+            current.count >= options_.capacity) {
+            rotate(now_ns);
+        }
+
+        if (contains(generations_[0], h) || contains(generations_[1], h)) {
+            dropped_++;
+            return true;
+        }
+        insert(generations_[current_], h);
+        return false;
+    }
+
+private:
+    struct Generation {
+        std::vector<internal::Block> blocks;
+        size_t count = 0;
+        int64_t started_ns = 0;
+    };
+
+    // Block from the high half of the hash, one bit per word from the low half
+    internal::Block& block(Generation& g, uint64_t h) const {
+        return g.blocks[(h >> 32) & mask_];
+    }
+
+    static uint64_t bit(uint64_t h, int word) {
+        return 1ULL << ((static_cast<uint32_t>(h) * internal::SALT[word]) >> 26);
+    }
+
+    bool contains(Generation& g, uint64_t h) const {
+        const internal::Block& b = block(g, h);
+        uint64_t missing = 0;
+        for (int i = 0; i < 8; i++) missing |= bit(h, i) & ~b.words[i];
+        return missing == 0;
+    }
+
+    void insert(Generation& g, uint64_t h) {
+        internal::Block& b = block(g, h);
+        for (int i = 0; i < 8; i++) b.words[i] |= bit(h, i);
+        g.count++;
+    }
+
+    // The older generation is cleared and becomes the current one
+    void rotate(int64_t now_ns) {
+        current_ ^= 1;
+        Generation& g = generations_[current_];
+        memset(g.blocks.data(), 0, g.blocks.size() * sizeof(internal::Block));
+        g.count = 0;
+        g.started_ns = now_ns;
+    }
+
+    Options options_;
+    const char* (*field_)(const void*) = nullptr;
+    Generation generations_[2];
+    uint64_t mask_ = 0;
+    int current_ = 0;
+    bool active_ = false;
+    uint64_t dropped_ = 0;
+};
+
+} // namespace dedup
+} // namespace traced
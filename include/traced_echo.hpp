@@ -0,0 +1,154 @@
+// DDS Tracing Library - echo responder for the latency probe
+// Every traced service answers EchoSample requests from services/latency-probe
+// on the CycloneDDS listener thread, straight from the loaned sample, so the
+// probe measures the network and middleware rather than application code.
+//
+// Configuration via environment variables:
+//   TRACED_ECHO          - "0" disables the responder
+//   TRACED_ECHO_PROFILES - comma-separated profiles to answer (default: all)
+//
+// Profiles (shared with the probe, one partition traced.echo.<name> each):
+//   reliable     - reliable, the default endpoint QoS
+//   best-effort  - best effort
+//   urgent       - reliable, transport priority of the urgent lane
+//   bulk         - reliable, latency budget of the bulk lane
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "dds/dds.h"
+#include "TracedTopics.h"
+
+namespace traced {
+namespace echo {
+
+inline constexpr const char* REQUEST_TOPIC = "TracedEchoRequest";
+inline constexpr const char* REPLY_TOPIC = "TracedEchoReply";
+
+struct Profile {
+    const char* name;
+    dds_reliability_kind_t reliability;
+    int32_t transport_priority;     // urgent: above SynchronousDeliveryPriorityThreshold
+    dds_duration_t latency_budget;
+};
+
+inline constexpr int PROFILE_COUNT = 4;
+
+inline const Profile& profile(int i) {
+    static const Profile profiles[PROFILE_COUNT] = {
+        {"reliable",    DDS_RELIABILITY_RELIABLE,    0,   0},
+        {"best-effort", DDS_RELIABILITY_BEST_EFFORT, 0,   0},
+        {"urgent",      DDS_RELIABILITY_RELIABLE,    100, 0},
+        {"bulk",        DDS_RELIABILITY_RELIABLE,    0,   DDS_MSECS(100)},
+    };
+    return profiles[i];
+}
+
+inline int find_profile(const char* name) {
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        if (strcmp(profile(i).name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// True if name is in the comma-separated list (nullptr = all)
+inline bool listed(const char* list, const char* name) {
+    if (!list) return true;
+    size_t n = strlen(name);
+    for (const char* p = list; *p;) {
+        const char* end = strchr(p, ',');
+        size_t len = end ? static_cast<size_t>(end - p) : strlen(p);
+        if (len == n && strncmp(p, name, n) == 0) return true;
+        if (!end) break;
+        p = end + 1;
+    }
+    return false;
+}
+
+// Same QoS for both sides and both directions of a profile
+inline dds_qos_t* create_qos(const Profile& p) {
+    char partition[64];
+    snprintf(partition, sizeof(partition), "traced.echo.%s", p.name);
+    dds_qos_t* qos = dds_create_qos();
+    dds_qset_reliability(qos, p.reliability, DDS_SECS(1));
+    dds_qset_history(qos, DDS_HISTORY_KEEP_LAST, 16);
+    dds_qset_partition1(qos, partition);
+    dds_qset_transport_priority(qos, p.transport_priority);
+    dds_qset_latency_budget(qos, p.latency_budget);
+    return qos;
+}
+
+/**
+ * Request reader and reply writer per profile on the service's participant
+ */
+class Responder {
+public:
+    static Responder& instance() {
+        static Responder responder;
+        return responder;
+    }
+
+    // Called once with the first participant a traced endpoint is created on
+    void start(dds_entity_t participant, const std::string& service_name) {
+        const char* enabled = getenv("TRACED_ECHO");
+        if (started_ || (enabled && strcmp(enabled, "0") == 0)) return;
+        started_ = true;
+        service_name_ = service_name;
+
+        dds_entity_t requests = dds_create_topic(participant, &traced_EchoSample_desc,
+                                                 REQUEST_TOPIC, nullptr, nullptr);
+        dds_entity_t replies = dds_create_topic(participant, &traced_EchoSample_desc,
+                                                REPLY_TOPIC, nullptr, nullptr);
+        if (requests < 0 || replies < 0) return;
+
+        const char* profiles = getenv("TRACED_ECHO_PROFILES");
+        for (int i = 0; i < PROFILE_COUNT; i++) {
+            if (!listed(profiles, profile(i).name)) continue;
+            dds_qos_t* qos = create_qos(profile(i));
+            writers_[i] = dds_create_writer(participant, replies, qos, nullptr);
+            dds_listener_t* listener = dds_create_listener(&writers_[i]);
+            dds_lset_data_available(listener, on_request);
+            dds_create_reader(participant, requests, qos, listener);
+            dds_delete_listener(listener);
+            dds_delete_qos(qos);
+        }
+    }
+
+private:
+    Responder() = default;
+
+    // arg: the reply writer of the request reader's profile
+    static void on_request(dds_entity_t reader, void* arg) {
+        dds_entity_t writer = *static_cast<dds_entity_t*>(arg);
+        const char* service = instance().service_name_.c_str();
+        void* samples[8];
+        dds_sample_info_t infos[8];
+        while (true) {
+            samples[0] = nullptr;  // loan from DDS
+            dds_return_t n = dds_take(reader, samples, infos, 8, 8);
+            int64_t received = dds_time();
+            if (n <= 0) break;
+            for (int i = 0; i < n; i++) {
+                if (!infos[i].valid_data) continue;
+                // Reply in place: the payload goes back out of the loaned buffer
+                traced_EchoSample reply = *static_cast<traced_EchoSample*>(samples[i]);
+                reply.responder_service = const_cast<char*>(service);
+                reply.received_ns = received;
+                reply.replied_ns = dds_time();
+                dds_write(writer, &reply);
+            }
+            dds_return_loan(reader, samples, n);
+        }
+    }
+
+    bool started_ = false;
+    std::string service_name_;
+    dds_entity_t writers_[PROFILE_COUNT] = {0};
+};
+
+} // namespace echo
+} // namespace traced
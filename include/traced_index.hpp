@@ -0,0 +1,424 @@
+// DDS Tracing Library - local business-key to trace index
+// Every traced write and take appends (field, key, trace_id, span_id, time)
+// for the configured message fields (e.g. mission_id) to memory-mapped
+// segment files, so tools/trace-index finds the traces of a mission or track
+// without going through Jaeger's tag search.
+//
+// Configuration via environment variables:
+//   TRACED_INDEX_DIR             - segment directory (unset: no index)
+//   TRACED_INDEX_FIELDS          - indexed fields, e.g. "mission_id,tactical_track_id";
+//                                  each must be registered with TRACED_DDS_FIELD
+//   TRACED_INDEX_SEGMENT_S       - segment rotation age (default: 3600)
+//   TRACED_INDEX_SEGMENT_RECORDS - records per segment, rounded up to a power
+//                                  of two (default: 262144)
+//   TRACED_INDEX_RETAIN          - segments of this process kept (default: 48)
+//
+// Segment file <dir>/<service>-<pid>-<start s>-<n>.tidx, append-only:
+//   [Header, one page][uint32 heads[buckets]][Record records[capacity]]
+// heads[] and Record::next chain records by key hash (record index + 1,
+// 0 = end), newest first. A record is written completely before it is
+// linked and counted, so lookups can read a live segment without locks.
+//
+// The write/take path only copies the key into a lock-free ring; a
+// background thread drains it into the current segment. A full ring drops
+// entries (counted in Header::dropped) rather than block. Only this
+// process's own segments are rotated out; those of earlier runs stay.
+
+#pragma once
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#include "traced_runtime.hpp"
+
+namespace traced {
+namespace index {
+
+inline constexpr uint64_t MAGIC = 0x5844494543415254ULL;   // "TRACEIDX"
+inline constexpr uint32_t VERSION = 1;
+inline constexpr size_t HEADER_SIZE = 4096;
+inline constexpr size_t FIELD_LEN = 24;
+inline constexpr size_t KEY_LEN = 64;
+inline constexpr size_t SERVICE_LEN = 64;
+inline constexpr size_t RING_SIZE = 8192;                  // power of two
+
+struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t buckets;
+    uint32_t capacity;
+    uint32_t count;             // published records
+    int64_t start_ns;           // wall clock
+    int64_t end_ns;             // 0 while the segment is written
+    uint64_t dropped;           // ring overflows while this segment was current
+    uint32_t pid;
+    char service[SERVICE_LEN];
+};
+
+struct Record {
+    uint64_t key_hash;
+    uint32_t next;              // record index + 1 of the next same-bucket record
+    uint32_t reserved;
+    int64_t timestamp_ns;
+    uint8_t trace_id[16];
+    uint8_t span_id[8];
+    char field[FIELD_LEN];
+    char key[KEY_LEN];
+};
+
+inline uint64_t key_hash(const char* key) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const char* p = key; *p; p++) {
+        h ^= static_cast<uint8_t>(*p);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline size_t segment_size(uint32_t capacity) {
+    return HEADER_SIZE + sizeof(uint32_t) * capacity + sizeof(Record) * capacity;
+}
+
+inline uint32_t* heads(void* base) {
+    return reinterpret_cast<uint32_t*>(static_cast<char*>(base) + HEADER_SIZE);
+}
+
+inline Record* records(void* base, uint32_t buckets) {
+    return reinterpret_cast<Record*>(reinterpret_cast<char*>(heads(base)) + sizeof(uint32_t) * buckets);
+}
+
+namespace internal {
+
+inline bool g_enabled = false;
+inline std::vector<std::string> g_fields;
+
+inline int64_t wall_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Ring slot; field points at the registered field name (static storage)
+struct Entry {
+    std::atomic<uint64_t> sequence{0};
+    const char* field;
+    int64_t timestamp_ns;
+    uint8_t trace_id[16];
+    uint8_t span_id[8];
+    char key[KEY_LEN];
+};
+
+} // namespace internal
+
+inline bool enabled() { return internal::g_enabled; }
+
+/**
+ * Whether a field is listed in TRACED_INDEX_FIELDS
+ */
+inline bool indexed(const char* field) {
+    if (!internal::g_enabled) return false;
+    return std::find(internal::g_fields.begin(), internal::g_fields.end(), field) != internal::g_fields.end();
+}
+
+/**
+ * Queue plus segment writer thread
+ */
+class Indexer {
+public:
+    static Indexer& instance() {
+        static Indexer indexer;
+        return indexer;
+    }
+
+    // Called once from traced::internal::do_init
+    void start(const std::string& service_name) {
+        const char* dir = getenv("TRACED_INDEX_DIR");
+        const char* fields = getenv("TRACED_INDEX_FIELDS");
+        if (thread_.joinable() || !dir || !*dir) return;
+        if (!fields || !*fields) {
+            fprintf(stderr, "[traced] TRACED_INDEX_DIR without TRACED_INDEX_FIELDS, no index\n");
+            return;
+        }
+        for (const char* p = fields; *p;) {
+            const char* end = strchr(p, ',');
+            size_t len = end ? static_cast<size_t>(end - p) : strlen(p);
+            if (len > 0 && len < FIELD_LEN) internal::g_fields.emplace_back(p, len);
+            p += len + (end ? 1 : 0);
+        }
+        dir_ = dir;
+        mkdir(dir_.c_str(), 0755);
+        service_ = service_name;
+        segment_ns_ = static_cast<int64_t>(runtime::internal::env_size("TRACED_INDEX_SEGMENT_S", 3600)) * 1000000000LL;
+        if (segment_ns_ <= 0) segment_ns_ = 3600 * 1000000000LL;
+        size_t records = std::max<size_t>(runtime::internal::env_size("TRACED_INDEX_SEGMENT_RECORDS", 262144), 1024);
+        capacity_ = 1024;
+        while (capacity_ < records && capacity_ < (1u << 30)) capacity_ <<= 1;
+        retain_ = std::max<size_t>(runtime::internal::env_size("TRACED_INDEX_RETAIN", 48), 1);
+
+        for (size_t i = 0; i < RING_SIZE; i++) ring_[i].sequence.store(i, std::memory_order_relaxed);
+        internal::g_enabled = true;
+        runtime::ScopedPlacement placement(runtime::Role::Exporter);
+        thread_ = std::thread([this]() { run(); });
+        printf("[traced] Indexing %s into %s\n", fields, dir_.c_str());
+    }
+
+    ~Indexer() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+    /**
+     * Queue one record (any thread, lock-free; dropped when the ring is full)
+     */
+    void append(const char* field, const char* key, const uint8_t* trace_id, const uint8_t* span_id) {
+        if (!key || !*key) return;
+        uint64_t pos = head_.load(std::memory_order_relaxed);
+        internal::Entry* entry;
+        while (true) {
+            entry = &ring_[pos & (RING_SIZE - 1)];
+            uint64_t seq = entry->sequence.load(std::memory_order_acquire);
+            if (seq == pos) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (seq < pos) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        entry->field = field;
+        entry->timestamp_ns = internal::wall_ns();
+        memcpy(entry->trace_id, trace_id, sizeof(entry->trace_id));
+        memcpy(entry->span_id, span_id, sizeof(entry->span_id));
+        strncpy(entry->key, key, KEY_LEN - 1);
+        entry->key[KEY_LEN - 1] = '\0';
+        entry->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+private:
+    Indexer() = default;
+
+    void run() {
+        pthread_setname_np(pthread_self(), "traced-index");
+        bool stopping = false;
+        while (!stopping) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, std::chrono::milliseconds(10), [this]() { return stop_; });
+                stopping = stop_;
+            }
+            drain();
+        }
+        close_segment();
+    }
+
+    void drain() {
+        while (true) {
+            internal::Entry& entry = ring_[tail_ & (RING_SIZE - 1)];
+            if (entry.sequence.load(std::memory_order_acquire) != tail_ + 1) break;
+            write(entry);
+            entry.sequence.store(tail_ + RING_SIZE, std::memory_order_release);
+            tail_++;
+        }
+        if (base_) {
+            Header* header = static_cast<Header*>(base_);
+            header->dropped = dropped_.load(std::memory_order_relaxed) - dropped_at_open_;
+        }
+    }
+
+    void write(const internal::Entry& entry) {
+        Header* header = static_cast<Header*>(base_);
+        if (!base_ || header->count == capacity_ || entry.timestamp_ns - header->start_ns >= segment_ns_) {
+            close_segment();
+            if (!open_segment(entry.timestamp_ns)) return;
+            header = static_cast<Header*>(base_);
+        }
+
+        uint32_t idx = header->count;
+        Record& record = records(base_, capacity_)[idx];
+        record.key_hash = key_hash(entry.key);
+        record.timestamp_ns = entry.timestamp_ns;
+        memcpy(record.trace_id, entry.trace_id, sizeof(record.trace_id));
+        memcpy(record.span_id, entry.span_id, sizeof(record.span_id));
+        strncpy(record.field, entry.field, FIELD_LEN - 1);
+        memcpy(record.key, entry.key, KEY_LEN);
+
+        // Link and count only once the record is complete
+        uint32_t* head = &heads(base_)[record.key_hash & (capacity_ - 1)];
+        record.next = *head;
+        __atomic_store_n(head, idx + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&header->count, idx + 1, __ATOMIC_RELEASE);
+    }
+
+    bool open_segment(int64_t now_ns) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s-%d-%lld-%u.tidx", dir_.c_str(), service_.c_str(),
+                 static_cast<int>(getpid()), static_cast<long long>(now_ns / 1000000000LL), sequence_++);
+        size_t size = segment_size(capacity_);
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            if (!open_failed_) fprintf(stderr, "[traced] Cannot create index segment %s\n", path);
+            open_failed_ = true;
+            if (fd >= 0) close(fd);
+            return false;
+        }
+        void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) return false;
+
+        // Sparse file: untouched heads and records read as zero
+        Header* header = static_cast<Header*>(base);
+        header->version = VERSION;
+        header->buckets = capacity_;
+        header->capacity = capacity_;
+        header->start_ns = now_ns;
+        header->pid = static_cast<uint32_t>(getpid());
+        strncpy(header->service, service_.c_str(), SERVICE_LEN - 1);
+        __atomic_store_n(&header->magic, MAGIC, __ATOMIC_RELEASE);
+
+        base_ = base;
+        dropped_at_open_ = dropped_.load(std::memory_order_relaxed);
+        segments_.push_back(path);
+        while (segments_.size() > retain_) {
+            unlink(segments_.front().c_str());
+            segments_.pop_front();
+        }
+        open_failed_ = false;
+        return true;
+    }
+
+    void close_segment() {
+        if (!base_) return;
+        Header* header = static_cast<Header*>(base_);
+        header->end_ns = internal::wall_ns();
+        msync(base_, segment_size(capacity_), MS_ASYNC);
+        munmap(base_, segment_size(capacity_));
+        base_ = nullptr;
+    }
+
+    std::string dir_;
+    std::string service_;
+    int64_t segment_ns_ = 0;
+    uint32_t capacity_ = 0;
+    size_t retain_ = 48;
+
+    internal::Entry ring_[RING_SIZE];
+    std::atomic<uint64_t> head_{0};     // producers
+    uint64_t tail_ = 0;                 // writer thread
+    std::atomic<uint64_t> dropped_{0};
+    uint64_t dropped_at_open_ = 0;
+
+    void* base_ = nullptr;              // current segment
+    std::deque<std::string> segments_;
+    uint32_t sequence_ = 0;             // segments opened, keeps names unique
+    bool open_failed_ = false;
+
+    std::mutex mutex_;                  // writer thread wakeup only
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+/**
+ * Read-only view of one segment file (tools/trace-index)
+ */
+class Segment {
+public:
+    explicit Segment(const std::string& path) : path_(path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= HEADER_SIZE) {
+            void* base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (base != MAP_FAILED) {
+                base_ = base;
+                size_ = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+        if (base_ && (header()->magic != MAGIC || header()->version != VERSION ||
+                      size_ < segment_size(header()->capacity))) {
+            munmap(base_, size_);
+            base_ = nullptr;
+        }
+    }
+
+    ~Segment() {
+        if (base_) munmap(base_, size_);
+    }
+
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    bool valid() const { return base_ != nullptr; }
+    const std::string& path() const { return path_; }
+    const Header* header() const { return static_cast<const Header*>(base_); }
+    uint32_t count() const { return __atomic_load_n(&header()->count, __ATOMIC_ACQUIRE); }
+
+    /**
+     * Records of a key, newest first; field nullptr matches any field
+     */
+    template<typename Callback>
+    void find(const char* key, const char* field, Callback&& callback) const {
+        uint64_t h = key_hash(key);
+        const Header* hdr = header();
+        uint32_t* head = heads(base_);
+        const Record* recs = records(base_, hdr->buckets);
+        uint32_t next = __atomic_load_n(&head[h & (hdr->buckets - 1)], __ATOMIC_ACQUIRE);
+        while (next != 0 && next <= hdr->capacity) {
+            const Record& r = recs[next - 1];
+            if (r.key_hash == h && strncmp(r.key, key, KEY_LEN) == 0 &&
+                (!field || strncmp(r.field, field, FIELD_LEN) == 0)) {
+                callback(r);
+            }
+            next = r.next;
+        }
+    }
+
+private:
+    std::string path_;
+    void* base_ = nullptr;
+    size_t size_ = 0;
+};
+
+/**
+ * Segment files in a directory, by name
+ */
+inline std::vector<std::string> segment_files(const std::string& dir) {
+    std::vector<std::string> files;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return files;
+    while (struct dirent* e = readdir(d)) {
+        size_t len = strlen(e->d_name);
+        if (len > 5 && strcmp(e->d_name + len - 5, ".tidx") == 0) files.push_back(dir + "/" + e->d_name);
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+} // namespace index
+} // namespace traced
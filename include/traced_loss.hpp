@@ -0,0 +1,157 @@
+// DDS Tracing Library - sequence gap and loss detection
+// Every traced writer numbers its samples (TraceContext.sequence, per lane),
+// so a reader can tell a lost sample from a quiet writer. traced::Reader
+// follows the sequence of every writer it takes from:
+//
+//   gap       - the sample is ahead of the next expected one; the samples
+//               in between count as lost
+//   reordered - the sample is older than the newest one of its writer and
+//               fills an earlier gap (it was counted as lost, so the net
+//               loss is lost - reordered)
+//
+// Best-effort loss and KEEP_LAST history overflow, on the writer or the
+// reader side, show up as gaps. The first sample of a writer only sets the
+// baseline, so late joiners and restarted writers (new GUID) are not loss.
+// CycloneDDS's own SAMPLE_LOST status is polled after every take as well.
+//
+// Span attributes and events on the receive span that reveals the loss:
+//   messaging.dds.sequence - the sample's writer sequence
+//   dds.sequence_gap       - event: messaging.dds.publisher, sequence.expected,
+//                            sequence.received, sequence.missing
+//   dds.reordered          - event: messaging.dds.publisher, messaging.dds.sequence,
+//                            sequence.highest
+//   dds.sample_lost        - event: dds.lost_count, samples CycloneDDS reported
+//                            lost since the previous take
+//
+// Counted per topic as traced.dds.lost, traced.dds.reordered and
+// traced.dds.sample_lost with TRACED_DDS_STATISTICS on (traced_ddsstats.hpp).
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "opentelemetry/trace/span.h"
+
+namespace traced {
+namespace loss {
+
+struct Observation {
+    enum Kind { Untracked, First, InOrder, Gap, Reordered, Repeat };
+    Kind kind = Untracked;
+    uint32_t sequence = 0;
+    uint32_t expected = 0;      // Gap: next sequence expected
+    uint32_t missing = 0;       // Gap: samples skipped
+    uint32_t highest = 0;       // Reordered/Repeat: newest sequence of the writer
+};
+
+/**
+ * Sequence state of the writers one DDS reader takes from; single-threaded
+ * like the take loop it belongs to
+ */
+class Tracker {
+public:
+    Tracker() { writers_.reserve(MAX_WRITERS); }
+
+    Observation observe(uint64_t writer_id, uint32_t sequence, int64_t now_ns) {
+        Observation obs;
+        obs.sequence = sequence;
+        if (sequence == 0) return obs;
+
+        WriterState* w = find(writer_id);
+        if (!w) {
+            insert(writer_id, sequence, now_ns);
+            obs.kind = Observation::First;
+            return obs;
+        }
+        w->last_ns = now_ns;
+
+        // Serial number arithmetic, so a wrapped counter still moves forward
+        int32_t ahead = static_cast<int32_t>(sequence - w->highest);
+        if (ahead > 0) {
+            obs.kind = ahead == 1 ? Observation::InOrder : Observation::Gap;
+            obs.expected = w->highest + 1;
+            obs.missing = static_cast<uint32_t>(ahead - 1);
+            w->received = ahead >= WINDOW ? 1 : (w->received << ahead) | 1;
+            w->highest = sequence;
+            lost_ += obs.missing;
+            return obs;
+        }
+
+        // Older than the newest: a gap filled late, or delivered again.
+        // Beyond the window it can only have been part of a gap.
+        obs.highest = w->highest;
+        uint32_t behind = static_cast<uint32_t>(-ahead);
+        uint64_t bit = behind < WINDOW ? 1ULL << behind : 0;
+        if (bit && (w->received & bit)) {
+            obs.kind = Observation::Repeat;
+            return obs;
+        }
+        w->received |= bit;
+        obs.kind = Observation::Reordered;
+        reordered_++;
+        return obs;
+    }
+
+    uint64_t lost() const { return lost_; }
+    uint64_t reordered() const { return reordered_; }
+
+private:
+    static constexpr size_t MAX_WRITERS = 64;
+    static constexpr int WINDOW = 64;
+
+    struct WriterState {
+        uint64_t id;
+        uint32_t highest;
+        uint64_t received;          // bit i: highest - i was taken
+        int64_t last_ns;
+    };
+
+    WriterState* find(uint64_t writer_id) {
+        for (WriterState& w : writers_) {
+            if (w.id == writer_id) return &w;
+        }
+        return nullptr;
+    }
+
+    // The writer heard from least recently makes room
+    void insert(uint64_t writer_id, uint32_t sequence, int64_t now_ns) {
+        WriterState state{writer_id, sequence, 1, now_ns};
+        if (writers_.size() < MAX_WRITERS) {
+            writers_.push_back(state);
+            return;
+        }
+        WriterState* oldest = &writers_[0];
+        for (WriterState& w : writers_) {
+            if (w.last_ns < oldest->last_ns) oldest = &w;
+        }
+        *oldest = state;
+    }
+
+    std::vector<WriterState> writers_;
+    uint64_t lost_ = 0;
+    uint64_t reordered_ = 0;
+};
+
+/**
+ * Sequence attribute and gap/reorder events on a receive span
+ */
+inline void annotate(opentelemetry::trace::Span& span, const Observation& obs, const char* publisher) {
+    if (obs.kind == Observation::Untracked) return;
+    span.SetAttribute("messaging.dds.sequence", static_cast<int64_t>(obs.sequence));
+    if (obs.kind == Observation::Gap) {
+        span.AddEvent("dds.sequence_gap", {
+            {"messaging.dds.publisher", publisher},
+            {"sequence.expected", static_cast<int64_t>(obs.expected)},
+            {"sequence.received", static_cast<int64_t>(obs.sequence)},
+            {"sequence.missing", static_cast<int64_t>(obs.missing)}});
+    } else if (obs.kind == Observation::Reordered) {
+        span.AddEvent("dds.reordered", {
+            {"messaging.dds.publisher", publisher},
+            {"messaging.dds.sequence", static_cast<int64_t>(obs.sequence)},
+            {"sequence.highest", static_cast<int64_t>(obs.highest)}});
+    }
+}
+
+} // namespace loss
+} // namespace traced
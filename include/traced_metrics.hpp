@@ -0,0 +1,424 @@
+// DDS Tracing Library - span-derived RED metrics
+// Rate, errors and duration of every ended span, sampled or not, aggregated
+// in-process and exported as OTLP metrics. Accurate at any trace sampling rate.
+//
+// Configuration via environment variables:
+//   TRACED_RED_METRICS                  - "1" enables the aggregation and export
+//   TRACED_RED_METRICS_INTERVAL_MS      - export interval (default: 10000)
+//   OTEL_EXPORTER_OTLP_METRICS_ENDPOINT - OTLP/HTTP metrics endpoint (default: the
+//                                         traces endpoint with /v1/traces -> /v1/metrics)
+//
+// Metrics (cumulative), attributes service.name, span.name, span.kind,
+// status.code and, for errors, status.message:
+//   traced.span.calls     - counter, spans ended
+//   traced.span.duration  - histogram, span duration in ms
+//   traced.span.overflow  - counter, spans counted under span.name "other"
+//                           because their thread's table was full
+//
+// A full table still keys by kind and status, so errors stay visible.
+//
+// Every thread aggregates into its own table with plain loads and stores;
+// the export thread merges all tables without locking the span producers.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#include "opentelemetry/exporters/otlp/otlp_http_metric_exporter_factory.h"
+#include "opentelemetry/exporters/otlp/otlp_http_metric_exporter_options.h"
+#include "opentelemetry/sdk/metrics/push_metric_exporter.h"
+#include "opentelemetry/sdk/metrics/export/metric_producer.h"
+#include "opentelemetry/sdk/metrics/data/metric_data.h"
+#include "opentelemetry/sdk/metrics/data/point_data.h"
+#include "opentelemetry/sdk/common/attribute_utils.h"
+#include "opentelemetry/sdk/resource/resource.h"
+#include "opentelemetry/sdk/instrumentationscope/instrumentation_scope.h"
+
+#include "traced_runtime.hpp"
+#include "traced_recorder.hpp"
+
+namespace traced {
+namespace metrics {
+
+namespace metrics_sdk = opentelemetry::sdk::metrics;
+namespace otlp = opentelemetry::exporter::otlp;
+namespace resource = opentelemetry::sdk::resource;
+
+inline constexpr int BUCKET_COUNT = 16;
+inline constexpr int64_t BUCKET_BOUNDS_NS[BUCKET_COUNT] = {
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000,
+    50000000, 100000000, 250000000, 500000000, 1000000000, 2500000000LL, 5000000000LL, 10000000000LL
+};
+
+inline constexpr size_t SERIES_PER_THREAD = 256;
+inline constexpr int KIND_COUNT = 5;        // trace_api::SpanKind
+inline constexpr int STATUS_COUNT = 3;      // trace_api::StatusCode
+
+namespace internal {
+
+// One (span name, kind, status, error message) series. Key fields are written
+// once before `used` is published; counters have a single writer (the owning
+// thread) and are read concurrently by the exporter.
+struct Series {
+    std::atomic<bool> used{false};
+    uint64_t hash = 0;
+    char name[48];
+    char status_message[48];
+    uint8_t status = 0;
+    uint8_t kind = 0;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum_ns{0};
+    std::atomic<int64_t> min_ns{INT64_MAX};
+    std::atomic<int64_t> max_ns{0};
+    std::atomic<uint64_t> buckets[BUCKET_COUNT + 1];
+
+    Series() {
+        for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct Shard {
+    Series series[SERIES_PER_THREAD];
+    Series overflow[KIND_COUNT][STATUS_COUNT];  // spans whose series did not fit
+    Shard* next = nullptr;
+
+    Shard() {
+        for (int kind = 0; kind < KIND_COUNT; kind++) {
+            for (int status = 0; status < STATUS_COUNT; status++) {
+                Series& s = overflow[kind][status];
+                s.name[0] = s.status_message[0] = '\0';
+                s.kind = static_cast<uint8_t>(kind);
+                s.status = static_cast<uint8_t>(status);
+            }
+        }
+    }
+};
+
+// Shards are pushed once and never freed, so counts of exited threads stay
+// in the cumulative totals
+inline std::atomic<Shard*> g_shards{nullptr};
+inline thread_local Shard* t_shard = nullptr;
+
+inline Shard* local_shard() {
+    if (t_shard) return t_shard;
+    Shard* shard = new Shard();
+    shard->next = g_shards.load(std::memory_order_relaxed);
+    while (!g_shards.compare_exchange_weak(shard->next, shard,
+                                           std::memory_order_release, std::memory_order_relaxed)) {}
+    t_shard = shard;
+    return shard;
+}
+
+inline uint64_t fnv1a(uint64_t h, const void* data, size_t n) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+inline bool is_error(const recorder::Record& rec) {
+    return rec.status == static_cast<uint8_t>(opentelemetry::trace::StatusCode::kError);
+}
+
+inline bool same_key(const Series& s, const recorder::Record& rec) {
+    return s.status == rec.status && s.kind == rec.kind && strcmp(s.name, rec.name) == 0 &&
+           (!is_error(rec) || strcmp(s.status_message, rec.status_message) == 0);
+}
+
+inline Series& find_series(Shard* shard, const recorder::Record& rec) {
+    uint64_t h = fnv1a(14695981039346656037ULL, rec.name, strlen(rec.name));
+    h = fnv1a(h, &rec.status, 1);
+    h = fnv1a(h, &rec.kind, 1);
+    if (is_error(rec)) h = fnv1a(h, rec.status_message, strlen(rec.status_message));
+
+    for (size_t probe = 0; probe < SERIES_PER_THREAD; probe++) {
+        Series& s = shard->series[(h + probe) % SERIES_PER_THREAD];
+        if (!s.used.load(std::memory_order_relaxed)) {
+            s.hash = h;
+            memcpy(s.name, rec.name, sizeof(s.name));
+            if (is_error(rec)) memcpy(s.status_message, rec.status_message, sizeof(s.status_message));
+            else s.status_message[0] = '\0';
+            s.status = rec.status;
+            s.kind = rec.kind;
+            s.used.store(true, std::memory_order_release);
+            return s;
+        }
+        if (s.hash == h && same_key(s, rec)) return s;
+    }
+    return shard->overflow[rec.kind < KIND_COUNT ? rec.kind : 0][rec.status < STATUS_COUNT ? rec.status : 0];
+}
+
+// Single writer: load + store instead of a locked read-modify-write
+inline void bump(std::atomic<uint64_t>& counter, uint64_t delta) {
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+inline int bucket_index(int64_t duration_ns) {
+    int i = 0;
+    while (i < BUCKET_COUNT && duration_ns > BUCKET_BOUNDS_NS[i]) i++;
+    return i;
+}
+
+} // namespace internal
+
+/**
+ * OTLP/HTTP metrics URL: OTEL_EXPORTER_OTLP_METRICS_ENDPOINT, else the traces
+ * endpoint with /v1/traces replaced by /v1/metrics
+ */
+inline std::string metrics_endpoint(const std::string& traces_endpoint) {
+    const char* endpoint = getenv("OTEL_EXPORTER_OTLP_METRICS_ENDPOINT");
+    if (endpoint) return endpoint;
+    const std::string suffix = "/v1/traces";
+    if (traces_endpoint.size() >= suffix.size() &&
+        traces_endpoint.compare(traces_endpoint.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        return traces_endpoint.substr(0, traces_endpoint.size() - suffix.size()) + "/v1/metrics";
+    }
+    return traces_endpoint;
+}
+
+/**
+ * Merges the per-thread tables and exports them periodically over OTLP/HTTP
+ */
+class RedMetrics {
+public:
+    static RedMetrics& instance() {
+        static RedMetrics metrics;
+        return metrics;
+    }
+
+    bool enabled() const { return started_; }
+
+    // Called once from traced::internal::do_init when the SDK is installed
+    void start(const std::string& service_name, const std::string& traces_endpoint) {
+        if (started_) return;
+        started_ = true;
+        service_name_ = service_name;
+        interval_ms_ = runtime::internal::env_size("TRACED_RED_METRICS_INTERVAL_MS", 10000);
+        if (interval_ms_ == 0) interval_ms_ = 10000;
+
+        otlp::OtlpHttpMetricExporterOptions opts;
+        opts.url = metrics_endpoint(traces_endpoint);
+        opts.aggregation_temporality = otlp::PreferredAggregationTemporality::kCumulative;
+        exporter_ = otlp::OtlpHttpMetricExporterFactory::Create(opts);
+
+        resource_ = std::make_unique<resource::Resource>(resource::Resource::Create({
+            {"service.name", service_name_},
+            {"service.version", "1.0.0"}
+        }));
+        scope_ = opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create(
+            "traced.red", "1.0.0");
+        start_time_ = std::chrono::system_clock::now();
+
+        {
+            runtime::ScopedPlacement export_placement(runtime::Role::Exporter);
+            thread_ = std::thread([this]() { run(); });
+        }
+        printf("[traced] RED metrics every %zums -> %s\n", interval_ms_, opts.url.c_str());
+    }
+
+    ~RedMetrics() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+    // Builds the cumulative calls/duration metrics from all thread tables
+    metrics_sdk::ResourceMetrics collect() {
+        std::map<Key, Totals> merged;
+        uint64_t overflowed = 0;
+        for (internal::Shard* shard = internal::g_shards.load(std::memory_order_acquire);
+             shard; shard = shard->next) {
+            for (const internal::Series& s : shard->series) {
+                if (s.used.load(std::memory_order_acquire)) add(merged, s, s.name);
+            }
+            for (const auto& by_kind : shard->overflow) {
+                for (const internal::Series& s : by_kind) {
+                    overflowed += s.count.load(std::memory_order_relaxed);
+                    add(merged, s, "other");
+                }
+            }
+        }
+
+        opentelemetry::common::SystemTimestamp start(start_time_);
+        opentelemetry::common::SystemTimestamp now(std::chrono::system_clock::now());
+
+        metrics_sdk::MetricData calls;
+        calls.instrument_descriptor = {"traced.span.calls", "Spans ended", "{span}",
+                                       metrics_sdk::InstrumentType::kCounter,
+                                       metrics_sdk::InstrumentValueType::kLong};
+        calls.aggregation_temporality = metrics_sdk::AggregationTemporality::kCumulative;
+        calls.start_ts = start;
+        calls.end_ts = now;
+
+        metrics_sdk::MetricData duration;
+        duration.instrument_descriptor = {"traced.span.duration", "Span duration", "ms",
+                                          metrics_sdk::InstrumentType::kHistogram,
+                                          metrics_sdk::InstrumentValueType::kDouble};
+        duration.aggregation_temporality = metrics_sdk::AggregationTemporality::kCumulative;
+        duration.start_ts = start;
+        duration.end_ts = now;
+
+        metrics_sdk::MetricData overflow;
+        overflow.instrument_descriptor = {"traced.span.overflow", "Spans counted as span.name other",
+                                          "{span}", metrics_sdk::InstrumentType::kCounter,
+                                          metrics_sdk::InstrumentValueType::kLong};
+        overflow.aggregation_temporality = metrics_sdk::AggregationTemporality::kCumulative;
+        overflow.start_ts = start;
+        overflow.end_ts = now;
+        {
+            metrics_sdk::PointAttributes attrs;
+            attrs.SetAttribute("service.name", service_name_);
+            metrics_sdk::SumPointData sum;
+            sum.value_ = static_cast<int64_t>(overflowed);
+            sum.is_monotonic_ = true;
+            overflow.point_data_attr_.push_back({attrs, sum});
+        }
+
+        std::vector<double> boundaries;
+        for (int64_t bound : BUCKET_BOUNDS_NS) boundaries.push_back(bound / 1e6);
+
+        for (const auto& entry : merged) {
+            const Key& key = entry.first;
+            const Totals& t = entry.second;
+            metrics_sdk::PointAttributes attrs;
+            attrs.SetAttribute("service.name", service_name_);
+            attrs.SetAttribute("span.name", std::get<0>(key));
+            attrs.SetAttribute("span.kind", kind_name(std::get<1>(key)));
+            attrs.SetAttribute("status.code", status_name(std::get<2>(key)));
+            if (!std::get<3>(key).empty()) attrs.SetAttribute("status.message", std::get<3>(key));
+
+            metrics_sdk::SumPointData sum;
+            sum.value_ = static_cast<int64_t>(t.count);
+            sum.is_monotonic_ = true;
+            calls.point_data_attr_.push_back({attrs, sum});
+
+            metrics_sdk::HistogramPointData hist;
+            hist.boundaries_ = boundaries;
+            hist.counts_.assign(t.buckets, t.buckets + BUCKET_COUNT + 1);
+            hist.count_ = t.count;
+            hist.sum_ = t.sum_ns / 1e6;
+            hist.min_ = t.min_ns / 1e6;
+            hist.max_ = t.max_ns / 1e6;
+            hist.record_min_max_ = true;
+            duration.point_data_attr_.push_back({attrs, hist});
+        }
+
+        metrics_sdk::ScopeMetrics scope_metrics;
+        scope_metrics.scope_ = scope_.get();
+        scope_metrics.metric_data_.push_back(std::move(calls));
+        scope_metrics.metric_data_.push_back(std::move(duration));
+        scope_metrics.metric_data_.push_back(std::move(overflow));
+
+        metrics_sdk::ResourceMetrics out;
+        out.resource_ = resource_.get();
+        out.scope_metric_data_.push_back(std::move(scope_metrics));
+        return out;
+    }
+
+private:
+    // (span name, kind, status, error message)
+    using Key = std::tuple<std::string, uint8_t, uint8_t, std::string>;
+
+    struct Totals {
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+        int64_t min_ns = INT64_MAX;
+        int64_t max_ns = 0;
+        uint64_t buckets[BUCKET_COUNT + 1] = {0};
+    };
+
+    RedMetrics() = default;
+
+    static const char* kind_name(uint8_t kind) {
+        static const char* names[] = {"SPAN_KIND_INTERNAL", "SPAN_KIND_SERVER", "SPAN_KIND_CLIENT",
+                                      "SPAN_KIND_PRODUCER", "SPAN_KIND_CONSUMER"};
+        return kind < 5 ? names[kind] : names[0];
+    }
+
+    static const char* status_name(uint8_t status) {
+        static const char* names[] = {"STATUS_CODE_UNSET", "STATUS_CODE_OK", "STATUS_CODE_ERROR"};
+        return status < 3 ? names[status] : names[0];
+    }
+
+    static void add(std::map<Key, Totals>& merged, const internal::Series& s, const char* name) {
+        uint64_t count = s.count.load(std::memory_order_relaxed);
+        if (count == 0) return;
+        Totals& t = merged[Key(name, s.kind, s.status, s.status_message)];
+        t.count += count;
+        t.sum_ns += s.sum_ns.load(std::memory_order_relaxed);
+        t.min_ns = std::min(t.min_ns, s.min_ns.load(std::memory_order_relaxed));
+        t.max_ns = std::max(t.max_ns, s.max_ns.load(std::memory_order_relaxed));
+        for (int i = 0; i <= BUCKET_COUNT; i++) {
+            t.buckets[i] += s.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void run() {
+        pthread_setname_np(pthread_self(), "red-metrics");
+        bool stopping = false;
+        while (!stopping) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, std::chrono::milliseconds(interval_ms_), [this]() { return stop_; });
+                stopping = stop_;
+            }
+            auto result = exporter_->Export(collect());
+            bool ok = result == opentelemetry::sdk::common::ExportResult::kSuccess;
+            if (!ok && !export_failed_) {
+                fprintf(stderr, "[traced] RED metrics export failed (is the endpoint an OTLP metrics receiver?)\n");
+            }
+            export_failed_ = !ok;
+        }
+        exporter_->Shutdown();
+    }
+
+    bool started_ = false;
+    std::string service_name_;
+    size_t interval_ms_ = 10000;
+    std::chrono::system_clock::time_point start_time_;
+
+    std::unique_ptr<metrics_sdk::PushMetricExporter> exporter_;
+    std::unique_ptr<resource::Resource> resource_;
+    std::unique_ptr<opentelemetry::sdk::instrumentationscope::InstrumentationScope> scope_;
+    bool export_failed_ = false;
+
+    std::mutex mutex_;                  // export thread wakeup only
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+/**
+ * Span sink: aggregates one ended span into the calling thread's table
+ */
+inline void record_span(const recorder::Record& rec) {
+    internal::Series& s = internal::find_series(internal::local_shard(), rec);
+    int64_t duration = rec.duration_ns < 0 ? 0 : rec.duration_ns;
+    internal::bump(s.count, 1);
+    internal::bump(s.sum_ns, static_cast<uint64_t>(duration));
+    internal::bump(s.buckets[internal::bucket_index(duration)], 1);
+    if (duration < s.min_ns.load(std::memory_order_relaxed)) s.min_ns.store(duration, std::memory_order_relaxed);
+    if (duration > s.max_ns.load(std::memory_order_relaxed)) s.max_ns.store(duration, std::memory_order_relaxed);
+}
+
+} // namespace metrics
+} // namespace traced
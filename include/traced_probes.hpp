@@ -0,0 +1,40 @@
+// DDS Tracing Library - USDT static probes
+// SystemTap/USDT probes (provider "traced") in the write and take paths.
+// Disabled probes are a single nop in the binary; attach with perf or bpftrace:
+//
+//   bpftrace -l 'usdt:./app:traced:*'
+//   bpftrace -e 'usdt:./app:traced:dds__write__entry { @[str(arg0)] = count(); }'
+//   perf buildid-cache --add ./app && perf probe sdt_traced:dds__write__entry
+//
+// The names keep their double underscores (<sys/sdt.h> does not rewrite them).
+//
+// Probes and arguments (strings are char*):
+//   write__entry         (topic, sample_size)
+//   dds__write__entry    (topic, trace_id, sample_size)
+//   dds__write__return   (topic, trace_id, ret)
+//   write__return        (topic, trace_id, ret)
+//   take__batch__start   (topic, max_samples)
+//   take__batch__end     (topic, taken, processed)
+//   callback__entry      (topic, source_trace_id, sample_size)
+//   callback__return     (topic, source_trace_id)
+//
+// Built without <sys/sdt.h> (package systemtap-sdt-dev) or with
+// TRACED_NO_USDT defined, every probe compiles to nothing but still uses its
+// arguments, so variables kept only for probes raise no unused warnings.
+
+#pragma once
+
+#if !defined(TRACED_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACED_HAS_USDT 1
+#endif
+#endif
+
+#ifdef TRACED_HAS_USDT
+#define TRACED_PROBE2(name, a, b) DTRACE_PROBE2(traced, name, a, b)
+#define TRACED_PROBE3(name, a, b, c) DTRACE_PROBE3(traced, name, a, b, c)
+#else
+#define TRACED_PROBE2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#define TRACED_PROBE3(name, a, b, c) do { (void)(a); (void)(b); (void)(c); } while (0)
+#endif
@@ -0,0 +1,765 @@
+// DDS Tracing Library - flight recorder
+// Keeps the most recent spans of the process, sampled or not, in a fixed-size
+// ring of compact records. Recording a span is one memcpy; unsampled spans get
+// no exporter recordable, only their record. Nothing leaves the process until a
+// dump is triggered.
+//
+// Configuration via environment variables:
+//   TRACED_FLIGHT_RECORDER          - "0" disables the recorder (default: on)
+//   TRACED_FLIGHT_RECORDER_SPANS    - ring capacity in spans, 512 bytes each (default: 8192)
+//   TRACED_FLIGHT_RECORDER_SECONDS  - how far back a dump reaches (default: 30)
+//   TRACED_FLIGHT_RECORDER_DUMP     - "file" (default), "otlp" or "both"
+//   TRACED_FLIGHT_RECORDER_DIR      - directory for file dumps (default: /tmp)
+//   TRACED_FLIGHT_RECORDER_ON_ERROR - "0" disables dumps triggered by error spans
+//   TRACED_FLIGHT_RECORDER_RETAIN   - error-triggered dump files of this process
+//                                     kept, oldest removed first (default: 10)
+//
+// Dump triggers:
+//   SIGUSR1                        - e.g. docker compose kill -s SIGUSR1 <service>
+//   ServiceControl command         - tools/traced-ctl flight-recorder-dump [service]
+//   span ending with error status  - dumped 2s later to include the aftermath,
+//                                    at most once every 30s
+//   traced::recorder::request_dump()
+//
+// File dumps are JSON lines: a header object, then one object per span.
+// OTLP dumps re-export only the unsampled spans (sampled ones went out already),
+// tagged with the "traced.flight_recorder.dump" attribute.
+
+#pragma once
+
+#include <semaphore.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "opentelemetry/exporters/otlp/otlp_http_exporter_factory.h"
+#include "opentelemetry/exporters/otlp/otlp_http_exporter_options.h"
+#include "opentelemetry/sdk/trace/processor.h"
+#include "opentelemetry/sdk/trace/recordable.h"
+#include "opentelemetry/sdk/trace/sampler.h"
+#include "opentelemetry/sdk/resource/resource.h"
+#include "opentelemetry/sdk/instrumentationscope/instrumentation_scope.h"
+
+#include "traced_runtime.hpp"
+
+namespace traced {
+namespace recorder {
+
+namespace nostd = opentelemetry::nostd;
+namespace common = opentelemetry::common;
+namespace trace_api = opentelemetry::trace;
+namespace trace_sdk = opentelemetry::sdk::trace;
+namespace resource = opentelemetry::sdk::resource;
+
+enum class Reason : int { None = 0, Signal, Control, Error, Api };
+
+inline const char* reason_name(Reason reason) {
+    static const char* names[] = {"none", "signal", "control", "error", "api"};
+    return names[static_cast<int>(reason)];
+}
+
+// Attribute encoding in Record::attrs: [type][key\0][8 raw bytes | string\0]
+enum AttrType : uint8_t { ATTR_STRING = 1, ATTR_INT, ATTR_UINT, ATTR_DOUBLE, ATTR_BOOL };
+
+inline constexpr size_t ATTR_BYTES = 360;
+inline constexpr size_t MAX_STRING_VALUE = 64;
+
+// Compact span record, one 512-byte ring slot per span
+struct Record {
+    uint8_t trace_id[16];
+    uint8_t span_id[8];
+    uint8_t parent_span_id[8];
+    int64_t start_ns;           // unix epoch
+    int64_t duration_ns;
+    uint8_t flags;              // W3C trace flags, bit 0 = sampled (exported)
+    uint8_t status;             // trace_api::StatusCode
+    uint8_t kind;               // trace_api::SpanKind
+    uint8_t truncated;          // some attributes did not fit
+    uint16_t attr_len;
+    uint16_t events;
+    char name[48];
+    char status_message[48];
+    uint8_t attrs[ATTR_BYTES];
+};
+
+static_assert(sizeof(Record) == 512, "flight recorder slots are 512 bytes");
+
+namespace internal {
+
+inline void copy_string(char* dst, size_t size, nostd::string_view src) {
+    size_t n = std::min(src.size(), size - 1);
+    memcpy(dst, src.data(), n);
+    dst[n] = '\0';
+}
+
+inline int64_t unix_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+inline int64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+inline bool env_flag(const char* name, bool fallback) {
+    const char* v = getenv(name);
+    if (!v || !*v) return fallback;
+    return strcmp(v, "0") != 0 && strcmp(v, "off") != 0;
+}
+
+} // namespace internal
+
+/**
+ * Appends attributes to a fixed buffer in the Record::attrs encoding; an
+ * attribute that does not fit sets the truncated flag
+ */
+class AttrWriter {
+public:
+    AttrWriter(uint8_t* buf, size_t capacity, uint16_t& len, uint8_t& truncated,
+               size_t max_string = MAX_STRING_VALUE)
+        : buf_(buf), capacity_(capacity), max_string_(max_string), len_(len), truncated_(truncated) {}
+
+    void put(nostd::string_view key, const common::AttributeValue& value) {
+        nostd::visit([&](const auto& v) { put_value(key, v); }, value);
+    }
+
+private:
+    bool reserve(nostd::string_view key, size_t value_size, uint8_t*& out) {
+        size_t need = 1 + key.size() + 1 + value_size;
+        if (len_ + need > capacity_) {
+            truncated_ = 1;
+            return false;
+        }
+        out = buf_ + len_;
+        len_ += static_cast<uint16_t>(need);
+        return true;
+    }
+
+    void put_raw(nostd::string_view key, uint8_t type, const void* value) {
+        uint8_t* p;
+        if (!reserve(key, 8, p)) return;
+        *p++ = type;
+        memcpy(p, key.data(), key.size());
+        p[key.size()] = '\0';
+        memcpy(p + key.size() + 1, value, 8);
+    }
+
+    void put_value(nostd::string_view key, nostd::string_view value) {
+        size_t n = std::min(value.size(), max_string_ - 1);
+        uint8_t* p;
+        if (!reserve(key, n + 1, p)) return;
+        *p++ = ATTR_STRING;
+        memcpy(p, key.data(), key.size());
+        p += key.size();
+        *p++ = '\0';
+        memcpy(p, value.data(), n);
+        p[n] = '\0';
+    }
+
+    void put_value(nostd::string_view key, const char* value) {
+        put_value(key, nostd::string_view(value ? value : ""));
+    }
+    void put_value(nostd::string_view key, bool value) { int64_t v = value; put_raw(key, ATTR_BOOL, &v); }
+    void put_value(nostd::string_view key, int32_t value) { int64_t v = value; put_raw(key, ATTR_INT, &v); }
+    void put_value(nostd::string_view key, int64_t value) { put_raw(key, ATTR_INT, &value); }
+    void put_value(nostd::string_view key, uint32_t value) { uint64_t v = value; put_raw(key, ATTR_UINT, &v); }
+    void put_value(nostd::string_view key, uint64_t value) { put_raw(key, ATTR_UINT, &value); }
+    void put_value(nostd::string_view key, double value) { put_raw(key, ATTR_DOUBLE, &value); }
+
+    // Array attributes are not recorded
+    template<typename V>
+    void put_value(nostd::string_view, const V&) { truncated_ = 1; }
+
+    uint8_t* buf_;
+    size_t capacity_;
+    size_t max_string_;
+    uint16_t& len_;
+    uint8_t& truncated_;
+};
+
+// Calls fn(type, key, value) for every attribute of an encoded buffer
+template<typename Fn>
+inline void for_each_attr(const uint8_t* attrs, size_t len, Fn&& fn) {
+    size_t pos = 0;
+    while (pos < len) {
+        uint8_t type = attrs[pos++];
+        const char* key = reinterpret_cast<const char*>(attrs + pos);
+        pos += strlen(key) + 1;
+        const uint8_t* value = attrs + pos;
+        pos += type == ATTR_STRING ? strlen(reinterpret_cast<const char*>(value)) + 1 : 8;
+        fn(type, key, value);
+    }
+}
+
+// An encoded value as an AttributeValue; strings point into the buffer
+inline common::AttributeValue attr_value(uint8_t type, const uint8_t* value) {
+    int64_t i;
+    uint64_t u;
+    double d;
+    switch (type) {
+    case ATTR_INT: memcpy(&i, value, 8); return i;
+    case ATTR_UINT: memcpy(&u, value, 8); return u;
+    case ATTR_DOUBLE: memcpy(&d, value, 8); return d;
+    case ATTR_BOOL: memcpy(&i, value, 8); return i != 0;
+    default: return reinterpret_cast<const char*>(value);
+    }
+}
+
+/**
+ * Recordable handed out by the recorder's span processor. Captures the span
+ * into a Record; only a sampled span also gets the exporter's recordable, built
+ * once SetIdentity shows the sampled flag, and every call is forwarded to it.
+ * An unsampled span costs the fixed Record and nothing else.
+ */
+class SpanRecordable : public trace_sdk::Recordable {
+public:
+    explicit SpanRecordable(trace_sdk::SpanProcessor& export_processor)
+        : export_processor_(export_processor) {
+        memset(&rec_, 0, sizeof(rec_));
+    }
+
+    // The SDK span calls SetName and SetInstrumentationScope before this
+    void SetIdentity(const trace_api::SpanContext& ctx, trace_api::SpanId parent) noexcept override {
+        memcpy(rec_.trace_id, ctx.trace_id().Id().data(), sizeof(rec_.trace_id));
+        memcpy(rec_.span_id, ctx.span_id().Id().data(), sizeof(rec_.span_id));
+        memcpy(rec_.parent_span_id, parent.Id().data(), sizeof(rec_.parent_span_id));
+        rec_.flags = ctx.trace_flags().flags();
+        if (!ctx.trace_flags().IsSampled()) return;
+        inner_ = export_processor_.MakeRecordable();
+        if (!inner_) return;
+        inner_->SetName(pending_name_);
+        if (pending_scope_) inner_->SetInstrumentationScope(*pending_scope_);
+        inner_->SetIdentity(ctx, parent);
+    }
+
+    void SetAttribute(nostd::string_view key, const common::AttributeValue& value) noexcept override {
+        AttrWriter(rec_.attrs, ATTR_BYTES, rec_.attr_len, rec_.truncated).put(key, value);
+        if (inner_) inner_->SetAttribute(key, value);
+    }
+
+    void AddEvent(nostd::string_view name, common::SystemTimestamp timestamp,
+                  const common::KeyValueIterable& attributes) noexcept override {
+        rec_.events++;
+        if (inner_) inner_->AddEvent(name, timestamp, attributes);
+    }
+
+    void AddLink(const trace_api::SpanContext& ctx,
+                 const common::KeyValueIterable& attributes) noexcept override {
+        if (inner_) inner_->AddLink(ctx, attributes);
+    }
+
+    void SetStatus(trace_api::StatusCode code, nostd::string_view description) noexcept override {
+        rec_.status = static_cast<uint8_t>(code);
+        internal::copy_string(rec_.status_message, sizeof(rec_.status_message), description);
+        if (inner_) inner_->SetStatus(code, description);
+    }
+
+    // Before SetIdentity the name is held by view: both come from the span's constructor
+    void SetName(nostd::string_view name) noexcept override {
+        internal::copy_string(rec_.name, sizeof(rec_.name), name);
+        if (inner_) inner_->SetName(name);
+        else pending_name_ = name;
+    }
+
+    void SetSpanKind(trace_api::SpanKind kind) noexcept override {
+        rec_.kind = static_cast<uint8_t>(kind);
+        if (inner_) inner_->SetSpanKind(kind);
+    }
+
+    void SetResource(const resource::Resource& res) noexcept override {
+        if (inner_) inner_->SetResource(res);
+    }
+
+    void SetStartTime(common::SystemTimestamp start) noexcept override {
+        rec_.start_ns = start.time_since_epoch().count();
+        if (inner_) inner_->SetStartTime(start);
+    }
+
+    void SetDuration(std::chrono::nanoseconds duration) noexcept override {
+        rec_.duration_ns = duration.count();
+        if (inner_) inner_->SetDuration(duration);
+    }
+
+    // The tracer's scope, which outlives its spans
+    void SetInstrumentationScope(
+        const opentelemetry::sdk::instrumentationscope::InstrumentationScope& scope) noexcept override {
+        if (inner_) inner_->SetInstrumentationScope(scope);
+        else pending_scope_ = &scope;
+    }
+
+    const Record& record() const { return rec_; }
+
+    // Sampled and holding the exporter's recordable
+    bool exported() const { return inner_ != nullptr; }
+
+    trace_sdk::Recordable* inner() { return inner_.get(); }
+    std::unique_ptr<trace_sdk::Recordable> release() { return std::move(inner_); }
+
+private:
+    trace_sdk::SpanProcessor& export_processor_;
+    std::unique_ptr<trace_sdk::Recordable> inner_;
+    nostd::string_view pending_name_;
+    const opentelemetry::sdk::instrumentationscope::InstrumentationScope* pending_scope_ = nullptr;
+    Record rec_;
+};
+
+/**
+ * Process-wide ring of span records plus the dump thread. Writers claim a slot
+ * with one atomic increment and publish it through a per-slot sequence number,
+ * so the dump never blocks span producers and skips slots being overwritten.
+ */
+class FlightRecorder {
+public:
+    static FlightRecorder& instance() {
+        static FlightRecorder recorder;
+        return recorder;
+    }
+
+    bool enabled() const { return capacity_ > 0; }
+
+    // Called once from traced::internal::do_init when the SDK is installed
+    void start(const std::string& service_name, const std::string& otlp_endpoint) {
+        if (enabled()) return;
+
+        capacity_ = runtime::internal::env_size("TRACED_FLIGHT_RECORDER_SPANS", 8192);
+        if (capacity_ == 0) return;
+        slots_.reset(new Slot[capacity_]);
+        for (size_t i = 0; i < capacity_; i++) slots_[i].seq.store(0, std::memory_order_relaxed);
+
+        service_name_ = service_name;
+        otlp_endpoint_ = otlp_endpoint;
+        window_ns_ = (int64_t)runtime::internal::env_size("TRACED_FLIGHT_RECORDER_SECONDS", 30) * 1000000000LL;
+        dump_on_error_ = internal::env_flag("TRACED_FLIGHT_RECORDER_ON_ERROR", true);
+        retain_ = std::max<size_t>(runtime::internal::env_size("TRACED_FLIGHT_RECORDER_RETAIN", 10), 1);
+        const char* dir = getenv("TRACED_FLIGHT_RECORDER_DIR");
+        dir_ = dir && *dir ? dir : "/tmp";
+        const char* target = getenv("TRACED_FLIGHT_RECORDER_DUMP");
+        to_file_ = !target || strcmp(target, "otlp") != 0;
+        to_otlp_ = target && (strcmp(target, "otlp") == 0 || strcmp(target, "both") == 0);
+
+        sem_init(&wakeup_, 0, 0);
+        {
+            // Dump thread runs with the exporter's placement and stays SCHED_OTHER
+            runtime::ScopedPlacement dump_placement(runtime::Role::Exporter);
+            thread_ = std::thread([this]() { run(); });
+        }
+
+        struct sigaction old_action;
+        if (sigaction(SIGUSR1, nullptr, &old_action) == 0 && old_action.sa_handler == SIG_DFL) {
+            struct sigaction action;
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = on_signal;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            sigaction(SIGUSR1, &action, nullptr);
+        }
+
+        printf("[traced] Flight recorder: %zu spans, last %llds, dump to %s%s%s\n",
+               capacity_, (long long)(window_ns_ / 1000000000LL),
+               to_file_ ? dir_.c_str() : "", to_file_ && to_otlp_ ? " + " : "",
+               to_otlp_ ? "otlp" : "");
+    }
+
+    void commit(const Record& rec) {
+        uint64_t ticket = head_.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots_[ticket % capacity_];
+        slot.seq.store(2 * ticket + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&slot.rec, &rec, sizeof(Record));
+        slot.seq.store(2 * ticket + 2, std::memory_order_release);
+    }
+
+    // Async-signal-safe
+    void request_dump(Reason reason) {
+        if (!enabled()) return;
+        pending_.store(static_cast<int>(reason), std::memory_order_relaxed);
+        sem_post(&wakeup_);
+    }
+
+    void on_error_span() {
+        if (!dump_on_error_) return;
+        int64_t now = internal::monotonic_ns();
+        int64_t last = last_error_dump_ns_.load(std::memory_order_relaxed);
+        if (last && now - last < ERROR_COOLDOWN_NS) return;
+        if (!last_error_dump_ns_.compare_exchange_strong(last, now)) return;
+        request_dump(Reason::Error);
+    }
+
+    // Synchronous dump from the calling thread, returns the number of spans written
+    size_t dump(Reason reason) {
+        if (!enabled()) return 0;
+        std::vector<Record> records = collect();
+
+        size_t written = 0;
+        std::string path;
+        if (to_file_) {
+            written = write_file(records, reason, path);
+            if (reason == Reason::Error) rotate_error_dumps(path);
+        }
+        size_t exported = to_otlp_ ? export_otlp(records, reason) : 0;
+
+        printf("[traced] Flight recorder dump (%s): %zu spans", reason_name(reason), records.size());
+        if (to_file_) printf(", %zu -> %s", written, path.c_str());
+        if (to_otlp_) printf(", %zu unsampled -> otlp", exported);
+        printf("\n");
+        fflush(stdout);
+        return records.size();
+    }
+
+    ~FlightRecorder() {
+        if (!thread_.joinable()) return;
+        stop_ = true;
+        sem_post(&wakeup_);
+        thread_.join();
+    }
+
+private:
+    static constexpr int64_t ERROR_COOLDOWN_NS = 30 * 1000000000LL;
+    static constexpr int64_t ERROR_POST_TRIGGER_MS = 2000;
+    static constexpr size_t OTLP_BATCH = 512;
+
+    struct Slot {
+        std::atomic<uint64_t> seq;   // 2*ticket+1 while writing, 2*ticket+2 when published
+        Record rec;
+    };
+
+    FlightRecorder() = default;
+
+    static void on_signal(int) { instance().request_dump(Reason::Signal); }
+
+    void run() {
+        pthread_setname_np(pthread_self(), "flight-rec");
+        while (true) {
+            if (sem_wait(&wakeup_) != 0) continue;  // EINTR
+            if (stop_) break;
+            Reason reason = static_cast<Reason>(pending_.exchange(0));
+            if (reason == Reason::None) continue;
+            if (reason == Reason::Error) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(ERROR_POST_TRIGGER_MS));
+                if (stop_) break;
+            }
+            dump(reason);
+        }
+    }
+
+    // Dump thread only: error dumps repeat for as long as errors do
+    void rotate_error_dumps(const std::string& path) {
+        error_dumps_.push_back(path);
+        while (error_dumps_.size() > retain_) {
+            unlink(error_dumps_.front().c_str());
+            error_dumps_.pop_front();
+        }
+    }
+
+    // Consistent copy of the published records inside the dump window, oldest first
+    std::vector<Record> collect() {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t first = head > capacity_ ? head - capacity_ : 0;
+        int64_t oldest = internal::unix_ns() - window_ns_;
+
+        std::vector<Record> out;
+        out.reserve(static_cast<size_t>(head - first));
+        Record copy;
+        for (uint64_t ticket = first; ticket < head; ticket++) {
+            const Slot& slot = slots_[ticket % capacity_];
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != 2 * ticket + 2) continue;
+            memcpy(&copy, &slot.rec, sizeof(Record));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+            if (copy.start_ns + copy.duration_ns < oldest) continue;
+            out.push_back(copy);
+        }
+        std::sort(out.begin(), out.end(), [](const Record& a, const Record& b) {
+            return a.start_ns < b.start_ns;
+        });
+        return out;
+    }
+
+    static void write_hex(FILE* f, const uint8_t* bytes, size_t n) {
+        for (size_t i = 0; i < n; i++) fprintf(f, "%02x", bytes[i]);
+    }
+
+    static void write_json_string(FILE* f, const char* s) {
+        fputc('"', f);
+        for (; *s; s++) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+            else if (c < 0x20) fprintf(f, "\\u%04x", c);
+            else fputc(c, f);
+        }
+        fputc('"', f);
+    }
+
+    static const char* kind_name(uint8_t kind) {
+        static const char* names[] = {"internal", "server", "client", "producer", "consumer"};
+        return kind < 5 ? names[kind] : "internal";
+    }
+
+    static const char* status_name(uint8_t status) {
+        static const char* names[] = {"UNSET", "OK", "ERROR"};
+        return status < 3 ? names[status] : "UNSET";
+    }
+
+    size_t write_file(const std::vector<Record>& records, Reason reason, std::string& path) {
+        int64_t now = internal::unix_ns();
+        time_t secs = now / 1000000000LL;
+        struct tm tm;
+        gmtime_r(&secs, &tm);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y%m%dT%H%M%S", &tm);
+
+        char name[256];
+        snprintf(name, sizeof(name), "%s/flight-%s-%d-%s-%s.jsonl", dir_.c_str(),
+                 service_name_.c_str(), (int)getpid(), stamp, reason_name(reason));
+        path = name;
+
+        FILE* f = fopen(name, "w");
+        if (!f) {
+            fprintf(stderr, "[traced] Flight recorder: cannot write %s: %s\n", name, strerror(errno));
+            return 0;
+        }
+
+        fprintf(f, "{\"service\":");
+        write_json_string(f, service_name_.c_str());
+        fprintf(f, ",\"pid\":%d,\"reason\":\"%s\",\"dumped_at_unix_ns\":%lld,\"window_s\":%lld,"
+                   "\"spans\":%zu,\"capacity\":%zu,\"recorded_total\":%llu}\n",
+                (int)getpid(), reason_name(reason), (long long)now,
+                (long long)(window_ns_ / 1000000000LL), records.size(), capacity_,
+                (unsigned long long)head_.load(std::memory_order_relaxed));
+
+        for (const Record& rec : records) {
+            fprintf(f, "{\"trace_id\":\"");
+            write_hex(f, rec.trace_id, sizeof(rec.trace_id));
+            fprintf(f, "\",\"span_id\":\"");
+            write_hex(f, rec.span_id, sizeof(rec.span_id));
+            fprintf(f, "\",\"parent_span_id\":\"");
+            write_hex(f, rec.parent_span_id, sizeof(rec.parent_span_id));
+            fprintf(f, "\",\"name\":");
+            write_json_string(f, rec.name);
+            fprintf(f, ",\"kind\":\"%s\",\"start_unix_ns\":%lld,\"duration_ns\":%lld,"
+                       "\"sampled\":%s,\"status\":\"%s\"",
+                    kind_name(rec.kind), (long long)rec.start_ns, (long long)rec.duration_ns,
+                    (rec.flags & 1) ? "true" : "false", status_name(rec.status));
+            if (rec.status_message[0]) {
+                fprintf(f, ",\"status_message\":");
+                write_json_string(f, rec.status_message);
+            }
+            if (rec.events) fprintf(f, ",\"events\":%u", (unsigned)rec.events);
+            if (rec.truncated) fprintf(f, ",\"truncated\":true");
+
+            fprintf(f, ",\"attributes\":{");
+            bool first = true;
+            for_each_attr(rec.attrs, rec.attr_len, [&](uint8_t type, const char* key, const uint8_t* value) {
+                if (!first) fputc(',', f);
+                first = false;
+                write_json_string(f, key);
+                fputc(':', f);
+                int64_t i;
+                uint64_t u;
+                double d;
+                switch (type) {
+                case ATTR_STRING: write_json_string(f, reinterpret_cast<const char*>(value)); break;
+                case ATTR_INT: memcpy(&i, value, 8); fprintf(f, "%lld", (long long)i); break;
+                case ATTR_UINT: memcpy(&u, value, 8); fprintf(f, "%llu", (unsigned long long)u); break;
+                case ATTR_DOUBLE: memcpy(&d, value, 8); fprintf(f, "%.17g", d); break;
+                case ATTR_BOOL: memcpy(&i, value, 8); fprintf(f, i ? "true" : "false"); break;
+                default: fprintf(f, "null"); break;
+                }
+            });
+            fprintf(f, "}}\n");
+        }
+        fclose(f);
+        return records.size();
+    }
+
+    // Rebuilds unsampled records as exporter recordables; sampled ones were exported already
+    size_t export_otlp(const std::vector<Record>& records, Reason reason) {
+        if (!exporter_) {
+            otlp_opts_.url = otlp_endpoint_;
+            exporter_ = opentelemetry::exporter::otlp::OtlpHttpExporterFactory::Create(otlp_opts_);
+            resource_ = std::make_unique<resource::Resource>(resource::Resource::Create({
+                {"service.name", service_name_},
+                {"service.version", "1.0.0"}
+            }));
+            scope_ = opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create(
+                "traced.flight_recorder", "1.0.0");
+        }
+
+        std::vector<std::unique_ptr<trace_sdk::Recordable>> batch;
+        size_t exported = 0;
+        for (const Record& rec : records) {
+            if (rec.flags & 1) continue;
+            batch.push_back(to_recordable(rec, reason));
+            if (batch.size() == OTLP_BATCH) {
+                exported += flush(batch);
+            }
+        }
+        exported += flush(batch);
+        return exported;
+    }
+
+    size_t flush(std::vector<std::unique_ptr<trace_sdk::Recordable>>& batch) {
+        if (batch.empty()) return 0;
+        size_t n = batch.size();
+        auto result = exporter_->Export(
+            nostd::span<std::unique_ptr<trace_sdk::Recordable>>(batch.data(), batch.size()));
+        batch.clear();
+        return result == opentelemetry::sdk::common::ExportResult::kSuccess ? n : 0;
+    }
+
+    std::unique_ptr<trace_sdk::Recordable> to_recordable(const Record& rec, Reason reason) {
+        auto r = exporter_->MakeRecordable();
+        trace_api::SpanContext ctx(
+            trace_api::TraceId(nostd::span<const uint8_t, 16>(rec.trace_id, 16)),
+            trace_api::SpanId(nostd::span<const uint8_t, 8>(rec.span_id, 8)),
+            trace_api::TraceFlags(rec.flags), false);
+        r->SetIdentity(ctx, trace_api::SpanId(nostd::span<const uint8_t, 8>(rec.parent_span_id, 8)));
+        r->SetName(rec.name);
+        r->SetSpanKind(static_cast<trace_api::SpanKind>(rec.kind));
+        r->SetResource(*resource_);
+        r->SetInstrumentationScope(*scope_);
+        r->SetStartTime(common::SystemTimestamp(std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::nanoseconds(rec.start_ns)))));
+        r->SetDuration(std::chrono::nanoseconds(rec.duration_ns));
+        if (rec.status) {
+            r->SetStatus(static_cast<trace_api::StatusCode>(rec.status), rec.status_message);
+        }
+        for_each_attr(rec.attrs, rec.attr_len, [&](uint8_t type, const char* key, const uint8_t* value) {
+            r->SetAttribute(key, attr_value(type, value));
+        });
+        r->SetAttribute("traced.flight_recorder.dump", reason_name(reason));
+        return r;
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t capacity_ = 0;
+    std::atomic<uint64_t> head_{0};
+
+    std::string service_name_;
+    std::string otlp_endpoint_;
+    std::string dir_;
+    int64_t window_ns_ = 0;
+    bool to_file_ = true;
+    bool to_otlp_ = false;
+    bool dump_on_error_ = true;
+    size_t retain_ = 10;
+    std::deque<std::string> error_dumps_;  // this process's, oldest first
+
+    sem_t wakeup_;
+    std::atomic<int> pending_{0};
+    std::atomic<int64_t> last_error_dump_ns_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+
+    opentelemetry::exporter::otlp::OtlpHttpExporterOptions otlp_opts_;
+    std::unique_ptr<trace_sdk::SpanExporter> exporter_;
+    std::unique_ptr<resource::Resource> resource_;
+    std::unique_ptr<opentelemetry::sdk::instrumentationscope::InstrumentationScope> scope_;
+};
+
+// Consumer of every ended span (flight recorder, RED metrics), called on the ending thread
+using SpanSink = void (*)(const Record&);
+
+inline void record_span(const Record& rec) {
+    FlightRecorder& recorder = FlightRecorder::instance();
+    recorder.commit(rec);
+    if (rec.status == static_cast<uint8_t>(trace_api::StatusCode::kError)) recorder.on_error_span();
+}
+
+/**
+ * Span processor in front of the export processor: every ending span is handed
+ * to the sinks as a Record, only sampled spans reach the export processor at
+ * all (see SpanRecordable).
+ */
+class Processor : public trace_sdk::SpanProcessor {
+public:
+    Processor(std::unique_ptr<trace_sdk::SpanProcessor> inner, std::vector<SpanSink> sinks)
+        : inner_(std::move(inner)), sinks_(std::move(sinks)) {}
+
+    std::unique_ptr<trace_sdk::Recordable> MakeRecordable() noexcept override {
+        return std::unique_ptr<trace_sdk::Recordable>(new SpanRecordable(*inner_));
+    }
+
+    void OnStart(trace_sdk::Recordable& span, const trace_api::SpanContext& parent) noexcept override {
+        trace_sdk::Recordable* inner = static_cast<SpanRecordable&>(span).inner();
+        if (inner) inner_->OnStart(*inner, parent);
+    }
+
+    void OnEnd(std::unique_ptr<trace_sdk::Recordable>&& span) noexcept override {
+        auto* recordable = static_cast<SpanRecordable*>(span.get());
+        for (SpanSink sink : sinks_) sink(recordable->record());
+        if (recordable->exported()) inner_->OnEnd(recordable->release());
+    }
+
+    bool ForceFlush(std::chrono::microseconds timeout) noexcept override {
+        return inner_->ForceFlush(timeout);
+    }
+
+    bool Shutdown(std::chrono::microseconds timeout) noexcept override {
+        return inner_->Shutdown(timeout);
+    }
+
+private:
+    std::unique_ptr<trace_sdk::SpanProcessor> inner_;
+    std::vector<SpanSink> sinks_;
+};
+
+/**
+ * Turns the configured sampler's DROP into RECORD_ONLY: unsampled spans are
+ * still built (and recorded) but keep the sampled flag cleared, so they are
+ * neither exported here nor sampled downstream by parent-based samplers.
+ */
+class RecordAllSampler : public trace_sdk::Sampler {
+public:
+    explicit RecordAllSampler(std::unique_ptr<trace_sdk::Sampler> inner)
+        : inner_(std::move(inner)) {
+        nostd::string_view inner_desc = inner_->GetDescription();
+        description_ = "RecordAll{" + std::string(inner_desc.data(), inner_desc.size()) + "}";
+    }
+
+    trace_sdk::SamplingResult ShouldSample(
+        const trace_api::SpanContext& parent_context, trace_api::TraceId trace_id,
+        nostd::string_view name, trace_api::SpanKind span_kind,
+        const common::KeyValueIterable& attributes,
+        const trace_api::SpanContextKeyValueIterable& links) noexcept override {
+        trace_sdk::SamplingResult result =
+            inner_->ShouldSample(parent_context, trace_id, name, span_kind, attributes, links);
+        if (result.decision == trace_sdk::Decision::DROP) {
+            result.decision = trace_sdk::Decision::RECORD_ONLY;
+        }
+        return result;
+    }
+
+    nostd::string_view GetDescription() const noexcept override { return description_; }
+
+private:
+    std::unique_ptr<trace_sdk::Sampler> inner_;
+    std::string description_;
+};
+
+/**
+ * Ask the dump thread to write out the ring (no-op when the recorder is off)
+ */
+inline void request_dump(Reason reason = Reason::Api) {
+    FlightRecorder::instance().request_dump(reason);
+}
+
+} // namespace recorder
+} // namespace traced
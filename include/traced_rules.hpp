@@ -0,0 +1,575 @@
+// DDS Tracing Library - alert rule engine
+// Declarative alert rules over the samples a service takes, compiled once
+// into per-topic evaluation plans. Rules end with ';':
+//
+//   <name>: <source> <cond> [and <cond>...] [count <n> in <duration>]
+//           [with <source> <cond> [and <cond>...] in <duration>]
+//           => <ALERT_TYPE> <SEVERITY> [zone=<field>] [key=<field>] [quiet=<duration>];
+//
+//   cond     - <field> <op> <value>, op one of == != < <= > >=; string fields
+//              (TRACED_DDS_FIELD) take == and !=, numeric and boolean fields
+//              (TRACED_DDS_NUMBER) all six; true/false compare as 1/0
+//   count    - rate over a window: fire when the condition held for n
+//              samples within the duration (then count afresh); the samples
+//              are counted per rule, across all keys
+//   with     - multi-topic: fire only if a sample of the other source met
+//              its conditions within the duration before this one
+//   zone     - string field for CombatAlert.affected_zone (default: Unknown)
+//   key      - string field that, with the zone, identifies one alert for
+//              deduplication; the same rule and key fire at most once per
+//              quiet (default: 30s); durations take ms, s or m. Each rule
+//              remembers up to 1024 keys, beyond that the oldest is dropped
+//
+//   high-threat: recon threat_level == HIGH => ENEMY_SPOTTED CRITICAL key=mission_id;
+//   failed-recon: recon target_confirmed == false count 5 in 60s => MISSION_FAILED WARNING;
+//   supply-at-risk: supply current_stock < 100 with recon threat_level == EXTREME in 2m
+//                   => SUPPLY_AT_RISK CRITICAL zone=depot_location;
+//
+// The service names its sources, compiles its rules (TRACED_ALERT_RULES
+// replaces them) and evaluates every taken sample inside its receive span:
+//
+//   traced::rules::Engine alerts;
+//   int recon = alerts.source<combat_ReconReport>("recon");
+//   alerts.compile(DEFAULT_RULES);
+//   reader.take("...", [&](auto& msg, auto& span) {
+//       alerts.evaluate(recon, &msg, span, [&](const traced::rules::Alert& a) { ... });
+//   });
+//
+// A sample costs one function-pointer comparison per condition of the terms
+// on its topic; rules whose terms fail cost nothing more. Rules with the same
+// conditions on a source share one term. Count windows and key cooldowns are
+// sized when the rules compile, so evaluation allocates nothing beyond the
+// span events of an alert. The emit callback runs in the trigger's receive
+// span, so the alert it writes continues the trigger's trace; a with-rule also
+// names the other sample's trace in details.related_trace_id.
+//
+// Besides the per-key quiet period, all rules share a token bucket of
+// TRACED_ALERT_RATE alerts per minute (default: 30). Raised alerts add an
+// alert.raised event to the trigger span, suppressed ones alert.suppressed
+// with alert.reason duplicate or rate_limited.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "opentelemetry/trace/span.h"
+#include "traced_sampling.hpp"
+
+namespace traced {
+namespace rules {
+
+namespace trace_api = opentelemetry::trace;
+
+inline constexpr int MAX_CONDITIONS = 4;
+
+/**
+ * A registered numeric or boolean field of a message type
+ */
+struct NumberField {
+    const char* name;
+    double (*get)(const void* msg);
+};
+
+/**
+ * One alert to publish; valid during the emit callback only
+ */
+struct Alert {
+    const char* rule;
+    const char* type;
+    const char* severity;
+    const char* zone;
+    const char* message;        // the rule's conditions
+    const char* details;        // JSON
+};
+
+namespace internal {
+
+template<typename T>
+std::vector<NumberField>& numbers() {
+    static std::vector<NumberField> registered;
+    return registered;
+}
+
+inline int64_t mono_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t hash(uint64_t h, const char* s) {
+    for (; *s; s++) h = (h ^ static_cast<unsigned char>(*s)) * 1099511628211ULL;
+    return (h ^ 0xff) * 1099511628211ULL;
+}
+
+// "500ms", "60s", "2m"; -1 if malformed
+inline int64_t parse_duration(const std::string& s) {
+    char* end = nullptr;
+    double v = strtod(s.c_str(), &end);
+    if (end == s.c_str() || v < 0) return -1;
+    std::string unit(end);
+    if (unit == "ms") return static_cast<int64_t>(v * 1e6);
+    if (unit == "s") return static_cast<int64_t>(v * 1e9);
+    if (unit == "m") return static_cast<int64_t>(v * 60e9);
+    return -1;
+}
+
+inline std::vector<std::string> tokens(const std::string& s) {
+    std::vector<std::string> out;
+    size_t pos = 0;
+    while (pos < s.size()) {
+        size_t start = s.find_first_not_of(" \t\r\n", pos);
+        if (start == std::string::npos) break;
+        size_t end = s.find_first_of(" \t\r\n", start);
+        if (end == std::string::npos) end = s.size();
+        out.push_back(s.substr(start, end - start));
+        pos = end;
+    }
+    return out;
+}
+
+} // namespace internal
+
+template<typename T>
+bool register_number(const char* name, double (*get)(const void*)) {
+    internal::numbers<T>().push_back({name, get});
+    return true;
+}
+
+/**
+ * Compiled alert rules of one service; single-threaded like the take loop
+ * that calls evaluate()
+ */
+class Engine {
+public:
+    Engine() {
+        const char* rate = getenv("TRACED_ALERT_RATE");
+        rate_per_min_ = rate && *rate ? atof(rate) : 30.0;
+        tokens_ = rate_per_min_;
+    }
+
+    /**
+     * Name a message type for the rules; returns the id to evaluate() with
+     */
+    template<typename T>
+    int source(const char* name) {
+        sources_.push_back({name, &sampling::internal::fields<T>(), &internal::numbers<T>(), {}});
+        return static_cast<int>(sources_.size() - 1);
+    }
+
+    /**
+     * Compile rules (TRACED_ALERT_RULES instead, if set); a rule that does
+     * not compile is reported and left out. Returns the number compiled.
+     */
+    int compile(const char* spec) {
+        const char* env = getenv("TRACED_ALERT_RULES");
+        std::string s(env && *env ? env : (spec ? spec : ""));
+        int compiled = 0;
+        size_t pos = 0;
+        while (pos <= s.size()) {
+            size_t end = s.find(';', pos);
+            if (end == std::string::npos) end = s.size();
+            std::string statement = s.substr(pos, end - pos);
+            pos = end + 1;
+            size_t start = statement.find_first_not_of(" \t\r\n");
+            if (start == std::string::npos) continue;
+            statement.erase(0, start);
+            std::string error;
+            if (compile_rule(statement, error)) {
+                compiled++;
+            } else {
+                fprintf(stderr, "[traced] Alert rule '%s': %s, ignored\n", statement.c_str(), error.c_str());
+            }
+        }
+        printf("[traced] Alert rules: %d compiled, at most %g alerts per minute\n", compiled, rate_per_min_);
+        return compiled;
+    }
+
+    /**
+     * Run the plan of source's topic on one sample; emit(const Alert&) is
+     * called for each alert to publish
+     */
+    template<typename F>
+    void evaluate(int source, const void* msg, trace_api::Span& span, F&& emit) {
+        if (source < 0 || source >= static_cast<int>(sources_.size())) return;
+        int64_t now = 0;
+        for (int t : sources_[source].terms) {
+            Term& term = terms_[t];
+            if (!term.test(msg)) continue;
+            if (now == 0) now = internal::mono_ns();
+            if (term.tracked) {
+                term.last_ns = now;
+                span.GetContext().trace_id().ToLowerBase16(
+                    opentelemetry::nostd::span<char, 32>(term.trace_id, 32));
+            }
+            for (int r : term.rules) check(rules_[r], msg, span, now, emit);
+        }
+    }
+
+    uint64_t raised() const { return raised_; }
+    uint64_t suppressed() const { return suppressed_; }
+
+private:
+    enum class Op { Eq, Ne, Lt, Le, Gt, Ge };
+
+    struct Source {
+        std::string name;
+        const std::vector<sampling::Field>* texts;
+        const std::vector<NumberField>* numbers;
+        std::vector<int> terms;
+    };
+
+    struct Condition {
+        const char* (*text)(const void*) = nullptr;
+        double (*number)(const void*) = nullptr;
+        Op op = Op::Eq;
+        std::string value;
+        double threshold = 0;
+
+        bool same(const Condition& other) const {
+            return text == other.text && number == other.number && op == other.op && value == other.value;
+        }
+
+        bool test(const void* msg) const {
+            if (text) return (strcmp(text(msg), value.c_str()) == 0) == (op == Op::Eq);
+            double v = number(msg);
+            switch (op) {
+            case Op::Eq: return v == threshold;
+            case Op::Ne: return v != threshold;
+            case Op::Lt: return v < threshold;
+            case Op::Le: return v <= threshold;
+            case Op::Gt: return v > threshold;
+            case Op::Ge: return v >= threshold;
+            }
+            return false;
+        }
+    };
+
+    // Conditions on one source, shared by the rules it triggers
+    struct Term {
+        Condition conditions[MAX_CONDITIONS];
+        int count = 0;
+        std::vector<int> rules;         // rules this term triggers
+        bool tracked = false;           // some rule's with-term
+        int64_t last_ns = 0;
+        char trace_id[33] = {};
+
+        bool test(const void* msg) const {
+            for (int i = 0; i < count; i++) {
+                if (!conditions[i].test(msg)) return false;
+            }
+            return true;
+        }
+
+        bool same(const Term& other) const {
+            if (count != other.count) return false;
+            for (int i = 0; i < count; i++) {
+                if (!conditions[i].same(other.conditions[i])) return false;
+            }
+            return true;
+        }
+    };
+
+    // When a rule and key last raised an alert; raised_ns 0 is a free slot
+    struct Cooldown {
+        uint64_t key = 0;
+        int64_t raised_ns = 0;
+    };
+
+    struct Rule {
+        std::string name;
+        std::string type;
+        std::string severity;
+        std::string text;               // conditions, for Alert.message
+        const char* (*zone)(const void*) = nullptr;
+        const char* (*key)(const void*) = nullptr;
+        int64_t quiet_ns = 30000000000LL;
+        int count = 1;                  // count rule: n samples ...
+        int64_t count_ns = 0;           // ... within this window
+        std::vector<int64_t> hits;      // ring of the last n match times
+        size_t next_hit = 0;
+        int seen = 0;
+        int with = -1;                  // with-term, -1 if none
+        int64_t with_ns = 0;
+        std::vector<Cooldown> cooldowns; // MAX_KEYS, open addressed by key
+    };
+
+    template<typename F>
+    void check(Rule& rule, const void* msg, trace_api::Span& span, int64_t now, F&& emit) {
+        if (rule.count > 1) {
+            rule.hits[rule.next_hit] = now;
+            rule.next_hit = (rule.next_hit + 1) % rule.hits.size();
+            // The oldest of the last n matches, once there are n
+            if (++rule.seen < rule.count || now - rule.hits[rule.next_hit] > rule.count_ns) return;
+            rule.seen = 0;
+        }
+        const Term* with = rule.with >= 0 ? &terms_[rule.with] : nullptr;
+        if (with && (with->last_ns == 0 || now - with->last_ns > rule.with_ns)) return;
+
+        const char* zone = rule.zone ? rule.zone(msg) : "Unknown";
+        if (!*zone) zone = "Unknown";
+        uint64_t key = internal::hash(internal::hash(1469598103934665603ULL, zone),
+                                      rule.key ? rule.key(msg) : "");
+        const char* reason = nullptr;
+        Cooldown& cooldown = cooldown_slot(rule, key, now);
+        if (cooldown.key == key && cooldown.raised_ns && now - cooldown.raised_ns < rule.quiet_ns) {
+            reason = "duplicate";
+        } else if (!take_token(now)) {
+            reason = "rate_limited";
+        }
+        if (reason) {
+            suppressed_++;
+            span.AddEvent("alert.suppressed", {
+                {"alert.rule", rule.name.c_str()},
+                {"alert.reason", reason}});
+            return;
+        }
+        cooldown.key = key;
+        cooldown.raised_ns = now;
+
+        raised_++;
+        span.AddEvent("alert.raised", {
+            {"alert.rule", rule.name.c_str()},
+            {"alert.type", rule.type.c_str()},
+            {"alert.severity", rule.severity.c_str()},
+            {"alert.zone", zone}});
+        char counted[64] = "";
+        char related[64] = "";
+        if (rule.count > 1) {
+            snprintf(counted, sizeof(counted), ",\"count\":%d,\"window_ms\":%lld",
+                     rule.count, static_cast<long long>(rule.count_ns / 1000000));
+        }
+        if (with) snprintf(related, sizeof(related), ",\"related_trace_id\":\"%s\"", with->trace_id);
+        char details[256];
+        snprintf(details, sizeof(details), "{\"rule\":\"%s\"%s%s}", rule.name.c_str(), counted, related);
+        Alert alert{rule.name.c_str(), rule.type.c_str(), rule.severity.c_str(), zone,
+                    rule.text.c_str(), details};
+        emit(alert);
+    }
+
+    bool take_token(int64_t now) {
+        if (last_refill_ns_) {
+            tokens_ += (now - last_refill_ns_) / 60e9 * rate_per_min_;
+            if (tokens_ > rate_per_min_) tokens_ = rate_per_min_;
+        }
+        last_refill_ns_ = now;
+        if (tokens_ < 1.0) return false;
+        tokens_ -= 1.0;
+        return true;
+    }
+
+    // The key's slot among the COOLDOWN_PROBES from its home; otherwise a free
+    // one or one past its quiet period, and if there is none the oldest
+    static Cooldown& cooldown_slot(Rule& rule, uint64_t key, int64_t now) {
+        Cooldown* free = nullptr;
+        Cooldown* oldest = nullptr;
+        for (size_t p = 0; p < COOLDOWN_PROBES; p++) {
+            Cooldown& c = rule.cooldowns[(key + p) & (MAX_KEYS - 1)];
+            if (c.raised_ns && c.key == key) return c;
+            if (!c.raised_ns || now - c.raised_ns >= rule.quiet_ns) {
+                if (!free) free = &c;
+            } else if (!oldest || c.raised_ns < oldest->raised_ns) {
+                oldest = &c;
+            }
+        }
+        return free ? *free : *oldest;
+    }
+
+    int find_source(const std::string& name) const {
+        for (size_t i = 0; i < sources_.size(); i++) {
+            if (sources_[i].name == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    static const char* (*text_field(const Source& src, const std::string& name))(const void*) {
+        for (const sampling::Field& f : *src.texts) {
+            if (name == f.name) return f.get;
+        }
+        return nullptr;
+    }
+
+    // <source> <cond> [and <cond>...] from tok[i]; i ends after the term
+    bool parse_term(const std::vector<std::string>& tok, size_t& i, Term& term, int& source,
+                    std::string& text, std::string& error) {
+        if (i >= tok.size() || (source = find_source(tok[i])) < 0) {
+            error = "unknown source '" + (i < tok.size() ? tok[i] : std::string()) + "'";
+            return false;
+        }
+        const Source& src = sources_[source];
+        i++;
+        while (true) {
+            if (i + 2 >= tok.size()) {
+                error = "expected <field> <op> <value>";
+                return false;
+            }
+            if (term.count == MAX_CONDITIONS) {
+                error = "more than " + std::to_string(MAX_CONDITIONS) + " conditions in a term";
+                return false;
+            }
+            const std::string& field = tok[i];
+            const std::string& op = tok[i + 1];
+            const std::string& value = tok[i + 2];
+            Condition& c = term.conditions[term.count++];
+            static const char* ops[] = {"==", "!=", "<", "<=", ">", ">="};
+            int o = 0;
+            while (o < 6 && op != ops[o]) o++;
+            if (o == 6) {
+                error = "unknown operator '" + op + "'";
+                return false;
+            }
+            c.op = static_cast<Op>(o);
+            c.value = value;
+            c.text = text_field(src, field);
+            if (c.text) {
+                if (c.op != Op::Eq && c.op != Op::Ne) {
+                    error = "string field '" + field + "' takes == or != only";
+                    return false;
+                }
+            } else {
+                for (const NumberField& f : *src.numbers) {
+                    if (field == f.name) c.number = f.get;
+                }
+                if (!c.number) {
+                    error = "'" + field + "' is not a registered field of " + src.name;
+                    return false;
+                }
+                char* end = nullptr;
+                c.threshold = value == "true" ? 1 : value == "false" ? 0 : strtod(value.c_str(), &end);
+                if (end && (end == value.c_str() || *end)) {
+                    error = "'" + value + "' is not a number";
+                    return false;
+                }
+            }
+            text += (text.empty() ? "" : " and ") + field + " " + op + " " + value;
+            i += 3;
+            if (i < tok.size() && tok[i] == "and") {
+                i++;
+                continue;
+            }
+            return true;
+        }
+    }
+
+    bool compile_rule(const std::string& statement, std::string& error) {
+        std::vector<std::string> tok = internal::tokens(statement);
+        Rule rule;
+        if (tok.empty() || tok[0].size() < 2 || tok[0].back() != ':') {
+            error = "expected '<name>:'";
+            return false;
+        }
+        rule.name = tok[0].substr(0, tok[0].size() - 1);
+
+        size_t i = 1;
+        Term trigger;
+        int trigger_source = -1;
+        if (!parse_term(tok, i, trigger, trigger_source, rule.text, error)) return false;
+
+        if (i < tok.size() && tok[i] == "count") {
+            if (i + 3 >= tok.size() || tok[i + 2] != "in" || (rule.count = atoi(tok[i + 1].c_str())) < 1 ||
+                (rule.count_ns = internal::parse_duration(tok[i + 3])) < 0) {
+                error = "expected count <n> in <duration>";
+                return false;
+            }
+            rule.hits.assign(rule.count, 0);
+            rule.text += " count " + tok[i + 1] + " in " + tok[i + 3];
+            i += 4;
+        }
+
+        Term with;
+        int with_source = -1;
+        if (i < tok.size() && tok[i] == "with") {
+            i++;
+            std::string with_text;
+            if (!parse_term(tok, i, with, with_source, with_text, error)) return false;
+            if (i + 1 >= tok.size() || tok[i] != "in" ||
+                (rule.with_ns = internal::parse_duration(tok[i + 1])) < 0) {
+                error = "expected with ... in <duration>";
+                return false;
+            }
+            rule.text += " with " + sources_[with_source].name + " " + with_text + " in " + tok[i + 1];
+            i += 2;
+        }
+
+        if (i + 2 >= tok.size() || tok[i] != "=>") {
+            error = "expected => <ALERT_TYPE> <SEVERITY>";
+            return false;
+        }
+        rule.type = tok[i + 1];
+        rule.severity = tok[i + 2];
+        for (i += 3; i < tok.size(); i++) {
+            size_t eq = tok[i].find('=');
+            std::string opt = tok[i].substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : tok[i].substr(eq + 1);
+            if (opt == "zone" || opt == "key") {
+                auto get = text_field(sources_[trigger_source], value);
+                if (!get) {
+                    error = "'" + value + "' is not a string field of " + sources_[trigger_source].name;
+                    return false;
+                }
+                (opt == "zone" ? rule.zone : rule.key) = get;
+            } else if (opt == "quiet") {
+                if ((rule.quiet_ns = internal::parse_duration(value)) < 0) {
+                    error = "bad quiet duration '" + value + "'";
+                    return false;
+                }
+            } else {
+                error = "unknown option '" + tok[i] + "'";
+                return false;
+            }
+        }
+
+        rule.cooldowns.assign(MAX_KEYS, Cooldown());
+        int r = static_cast<int>(rules_.size());
+        if (with_source >= 0) {
+            with.tracked = true;
+            rule.with = add_term(with_source, with);
+        }
+        trigger.rules.push_back(r);
+        add_term(trigger_source, trigger);
+        rules_.push_back(std::move(rule));
+        return true;
+    }
+
+    // An identical term on the source takes over the rules and tracking
+    int add_term(int source, const Term& term) {
+        for (int t : sources_[source].terms) {
+            Term& existing = terms_[t];
+            if (!existing.same(term)) continue;
+            existing.rules.insert(existing.rules.end(), term.rules.begin(), term.rules.end());
+            existing.tracked = existing.tracked || term.tracked;
+            return t;
+        }
+        terms_.push_back(term);
+        int t = static_cast<int>(terms_.size() - 1);
+        sources_[source].terms.push_back(t);
+        return t;
+    }
+
+    static constexpr size_t MAX_KEYS = 1024;           // power of two
+    static constexpr size_t COOLDOWN_PROBES = 8;
+
+    std::vector<Source> sources_;
+    std::vector<Term> terms_;
+    std::vector<Rule> rules_;
+    double rate_per_min_;
+    double tokens_;
+    int64_t last_refill_ns_ = 0;
+    uint64_t raised_ = 0;
+    uint64_t suppressed_ = 0;
+};
+
+} // namespace rules
+} // namespace traced
+
+// Make a numeric or boolean field of a message type available to alert
+// rules (namespace scope, after TRACED_DDS_TYPE)
+#define TRACED_DDS_NUMBER(MsgType, field) \
+    [[maybe_unused]] static const bool traced_number_##MsgType##_##field = \
+        traced::rules::register_number<MsgType>(#field, [](const void* msg) -> double { \
+            return static_cast<double>(static_cast<const MsgType*>(msg)->field); \
+        })
@@ -0,0 +1,461 @@
+// DDS Tracing Library - runtime placement
+// Pins the dispatch loop, worker threads, the span exporter and CycloneDDS
+// threads to configured cores or NUMA nodes.
+//
+// Configuration via environment variables:
+//   TRACED_PLACEMENT      - inline spec, e.g. "main=2;worker=4-7;exporter=3;dds=node:1"
+//   TRACED_PLACEMENT_FILE - same spec, one "role=cpus" per line ('#' starts a comment)
+//
+// Roles:
+//   main       - thread that first creates a traced Writer/Reader (dispatch loop)
+//   worker     - threads calling traced::runtime::pin_current_thread(Role::Worker)
+//   exporter   - span export thread (TRACED_SPAN_PROCESSOR=batch)
+//   dds        - all CycloneDDS threads (recv*, tev*, dq.*, gc, lease, xmit*)
+//   dds:<name> - CycloneDDS threads whose name starts with <name> (recv, tev, dq.user, ...)
+//
+// CPU sets: "3", "4-7", "1,3,5-6" or "node:<n>" for all cores of a NUMA node.
+//
+// Real-time mode (for RT kernels):
+//   TRACED_RT=1                - lock memory, prefault stack and heap, SCHED_FIFO dispatch loop
+//   TRACED_RT_PRIORITY         - SCHED_FIFO priority of the dispatch loop (default: 80)
+//   TRACED_RT_STACK_PREFAULT   - bytes of stack to prefault per RT thread (default: 524288)
+//   TRACED_RT_HEAP_PREFAULT    - bytes of heap to prefault and keep (default: 67108864)
+
+#pragma once
+
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <malloc.h>
+#include <alloca.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace traced {
+namespace runtime {
+
+enum class Role : int { Main = 0, Worker = 1, Exporter = 2, Dds = 3 };
+
+inline constexpr int ROLE_COUNT = 4;
+
+inline const char* role_name(Role role) {
+    static const char* names[ROLE_COUNT] = {"main", "worker", "exporter", "dds"};
+    return names[static_cast<int>(role)];
+}
+
+struct Placement {
+    bool configured[ROLE_COUNT] = {false, false, false, false};
+    cpu_set_t cpus[ROLE_COUNT];
+    // Per-thread-name overrides for CycloneDDS threads ("dds:recv=5")
+    std::vector<std::pair<std::string, cpu_set_t>> dds_threads;
+
+    bool any() const {
+        for (bool c : configured) if (c) return true;
+        return !dds_threads.empty();
+    }
+};
+
+namespace internal {
+
+inline Placement g_placement;
+inline bool g_placement_loaded = false;
+
+inline pid_t gettid() { return static_cast<pid_t>(syscall(SYS_gettid)); }
+
+inline std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+// Parse "1,3,5-6" into a cpu set, returns false on malformed input
+inline bool parse_cpu_list(const std::string& list, cpu_set_t& set) {
+    CPU_ZERO(&set);
+    size_t pos = 0;
+    bool any = false;
+    while (pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        std::string item = trim(list.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos));
+        pos = comma == std::string::npos ? list.size() : comma + 1;
+        if (item.empty()) continue;
+
+        char* end = nullptr;
+        long lo = strtol(item.c_str(), &end, 10);
+        long hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        if (*end != '\0' || lo < 0 || hi < lo || hi >= CPU_SETSIZE) return false;
+        for (long c = lo; c <= hi; c++) CPU_SET(c, &set);
+        any = true;
+    }
+    return any;
+}
+
+inline bool parse_cpus(const std::string& value, cpu_set_t& set) {
+    if (value.compare(0, 5, "node:") == 0) {
+        std::string path = "/sys/devices/system/node/node" + trim(value.substr(5)) + "/cpulist";
+        FILE* f = fopen(path.c_str(), "r");
+        if (!f) return false;
+        char buf[256] = {0};
+        bool ok = fgets(buf, sizeof(buf), f) != nullptr;
+        fclose(f);
+        return ok && parse_cpu_list(buf, set);
+    }
+    return parse_cpu_list(value, set);
+}
+
+inline void parse_entry(const std::string& entry, Placement& p) {
+    std::string e = trim(entry);
+    if (e.empty() || e[0] == '#') return;
+
+    size_t eq = e.find('=');
+    if (eq == std::string::npos) {
+        fprintf(stderr, "[traced] placement: ignoring '%s' (expected role=cpus)\n", e.c_str());
+        return;
+    }
+    std::string role = trim(e.substr(0, eq));
+    cpu_set_t set;
+    if (!parse_cpus(trim(e.substr(eq + 1)), set)) {
+        fprintf(stderr, "[traced] placement: invalid cpus for '%s'\n", role.c_str());
+        return;
+    }
+
+    if (role.compare(0, 4, "dds:") == 0) {
+        p.dds_threads.emplace_back(role.substr(4), set);
+        return;
+    }
+    for (int i = 0; i < ROLE_COUNT; i++) {
+        if (role == role_name(static_cast<Role>(i))) {
+            p.configured[i] = true;
+            p.cpus[i] = set;
+            return;
+        }
+    }
+    fprintf(stderr, "[traced] placement: unknown role '%s'\n", role.c_str());
+}
+
+inline void parse_spec(const std::string& spec, char separator, Placement& p) {
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t sep = spec.find(separator, pos);
+        if (sep == std::string::npos) sep = spec.size();
+        parse_entry(spec.substr(pos, sep - pos), p);
+        pos = sep + 1;
+    }
+}
+
+inline std::string format_cpus(const cpu_set_t& set) {
+    std::string out;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (!CPU_ISSET(c, &set)) continue;
+        int hi = c;
+        while (hi + 1 < CPU_SETSIZE && CPU_ISSET(hi + 1, &set)) hi++;
+        if (!out.empty()) out += ",";
+        out += std::to_string(c);
+        if (hi > c) out += "-" + std::to_string(hi);
+        c = hi;
+    }
+    return out;
+}
+
+inline std::string read_task_file(pid_t tid, const char* file) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/%s", tid, file);
+    FILE* f = fopen(path, "r");
+    if (!f) return "";
+    char buf[512] = {0};
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    return buf;
+}
+
+inline std::string thread_name(pid_t tid) {
+    return trim(read_task_file(tid, "comm"));
+}
+
+// Field 39 of /proc/<tid>/stat: CPU the thread last ran on
+inline int last_cpu(pid_t tid) {
+    std::string stat = read_task_file(tid, "stat");
+    size_t p = stat.rfind(')');
+    if (p == std::string::npos) return -1;
+    int field = 2;
+    for (size_t i = p + 1; i < stat.size(); i++) {
+        if (stat[i] == ' ' && ++field == 39) return atoi(stat.c_str() + i + 1);
+    }
+    return -1;
+}
+
+inline std::vector<pid_t> list_threads() {
+    std::vector<pid_t> tids;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return tids;
+    while (dirent* ent = readdir(dir)) {
+        if (ent->d_name[0] == '.') continue;
+        tids.push_back(static_cast<pid_t>(atoi(ent->d_name)));
+    }
+    closedir(dir);
+    return tids;
+}
+
+inline bool set_affinity(pid_t tid, const cpu_set_t& set) {
+    if (sched_setaffinity(tid, sizeof(set), &set) != 0) {
+        fprintf(stderr, "[traced] placement: sched_setaffinity(%d) failed: %s\n", tid, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+} // namespace internal
+
+/**
+ * Placement loaded from TRACED_PLACEMENT / TRACED_PLACEMENT_FILE (parsed once)
+ */
+inline const Placement& placement() {
+    if (internal::g_placement_loaded) return internal::g_placement;
+    internal::g_placement_loaded = true;
+
+    if (const char* file = getenv("TRACED_PLACEMENT_FILE")) {
+        FILE* f = fopen(file, "r");
+        if (f) {
+            std::string spec;
+            char line[256];
+            while (fgets(line, sizeof(line), f)) spec += line;
+            fclose(f);
+            internal::parse_spec(spec, '\n', internal::g_placement);
+        } else {
+            fprintf(stderr, "[traced] placement: cannot open %s\n", file);
+        }
+    }
+    if (const char* spec = getenv("TRACED_PLACEMENT")) {
+        internal::parse_spec(spec, ';', internal::g_placement);
+    }
+    return internal::g_placement;
+}
+
+/**
+ * Pin the calling thread to the cpus configured for a role (no-op if unset)
+ */
+inline bool pin_current_thread(Role role) {
+    const Placement& p = placement();
+    int idx = static_cast<int>(role);
+    if (!p.configured[idx]) return false;
+    return internal::set_affinity(internal::gettid(), p.cpus[idx]);
+}
+
+/**
+ * Temporarily moves the calling thread onto a role's cpus. Threads created
+ * while it is alive (e.g. the OTel batch exporter) inherit that affinity.
+ * For Role::Exporter the thread is also SCHED_OTHER meanwhile, so background
+ * threads started from an RT dispatch loop don't inherit SCHED_FIFO.
+ */
+class ScopedPlacement {
+public:
+    explicit ScopedPlacement(Role role) {
+        if (role == Role::Exporter) leave_rt();
+        const Placement& p = placement();
+        int idx = static_cast<int>(role);
+        if (!p.configured[idx]) return;
+        active_ = sched_getaffinity(0, sizeof(saved_), &saved_) == 0 &&
+                  internal::set_affinity(internal::gettid(), p.cpus[idx]);
+    }
+    ~ScopedPlacement() {
+        if (active_) internal::set_affinity(internal::gettid(), saved_);
+        if (rt_left_) pthread_setschedparam(pthread_self(), saved_policy_, &saved_param_);
+    }
+    ScopedPlacement(const ScopedPlacement&) = delete;
+    ScopedPlacement& operator=(const ScopedPlacement&) = delete;
+
+private:
+    void leave_rt() {
+        if (pthread_getschedparam(pthread_self(), &saved_policy_, &saved_param_) != 0) return;
+        if (saved_policy_ == SCHED_OTHER) return;
+        sched_param other{};
+        rt_left_ = pthread_setschedparam(pthread_self(), SCHED_OTHER, &other) == 0;
+    }
+
+    cpu_set_t saved_;
+    bool active_ = false;
+    int saved_policy_ = SCHED_OTHER;
+    sched_param saved_param_{};
+    bool rt_left_ = false;
+};
+
+namespace internal {
+
+// Names CycloneDDS gives its domain threads: receive (recv, recvMC, recvUC),
+// timed events, delivery queues (dq.builtins, dq.user), gc, lease, transmit
+inline bool is_dds_thread_name(const std::string& name) {
+    static const char* const prefixes[] = {"recv", "tev", "dq.", "gc", "lease", "xmit"};
+    for (const char* prefix : prefixes) {
+        if (name.compare(0, strlen(prefix), prefix) == 0) return true;
+    }
+    return false;
+}
+
+} // namespace internal
+
+/**
+ * Pin CycloneDDS threads, recognised by name. The middleware's own threads
+ * (traced-*, dds-stats, watchdog, ...) may already run when this is called
+ * and keep the placement they were started with.
+ */
+inline void pin_dds_threads() {
+    const Placement& p = placement();
+    if (!p.configured[static_cast<int>(Role::Dds)] && p.dds_threads.empty()) return;
+
+    pid_t self = internal::gettid();
+
+    for (pid_t tid : internal::list_threads()) {
+        if (tid == self) continue;
+        std::string name = internal::thread_name(tid);
+
+        const cpu_set_t* set = nullptr;
+        for (const auto& entry : p.dds_threads) {
+            if (name.compare(0, entry.first.size(), entry.first) == 0) {
+                set = &entry.second;
+                break;
+            }
+        }
+        if (!set && p.configured[static_cast<int>(Role::Dds)] && internal::is_dds_thread_name(name)) {
+            set = &p.cpus[static_cast<int>(Role::Dds)];
+        }
+        if (set) internal::set_affinity(tid, *set);
+    }
+}
+
+/**
+ * Print the actual placement of every thread in the process
+ */
+inline void report_placement(const char* service_name) {
+    for (pid_t tid : internal::list_threads()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(tid, sizeof(set), &set);
+        printf("[traced] placement %s: tid %d %-15s cpus=%s last_cpu=%d\n",
+               service_name, tid, internal::thread_name(tid).c_str(),
+               internal::format_cpus(set).c_str(), internal::last_cpu(tid));
+    }
+}
+
+// ============ Real-Time Mode ============
+
+struct RtConfig {
+    bool enabled = false;
+    int priority = 80;
+    size_t stack_prefault = 512 * 1024;
+    size_t heap_prefault = 64 * 1024 * 1024;
+};
+
+namespace internal {
+
+inline RtConfig g_rt_config;
+inline bool g_rt_config_loaded = false;
+
+inline size_t env_size(const char* name, size_t fallback) {
+    const char* v = getenv(name);
+    return v ? static_cast<size_t>(strtoull(v, nullptr, 10)) : fallback;
+}
+
+} // namespace internal
+
+/**
+ * RT configuration loaded from TRACED_RT* (parsed once)
+ */
+inline const RtConfig& rt_config() {
+    if (internal::g_rt_config_loaded) return internal::g_rt_config;
+    internal::g_rt_config_loaded = true;
+
+    RtConfig& c = internal::g_rt_config;
+    const char* rt = getenv("TRACED_RT");
+    c.enabled = rt && strcmp(rt, "0") != 0;
+    c.priority = static_cast<int>(internal::env_size("TRACED_RT_PRIORITY", c.priority));
+    c.stack_prefault = internal::env_size("TRACED_RT_STACK_PREFAULT", c.stack_prefault);
+    c.heap_prefault = internal::env_size("TRACED_RT_HEAP_PREFAULT", c.heap_prefault);
+    return c;
+}
+
+/**
+ * Lock current and future pages so page faults never hit the RT path
+ */
+inline bool lock_memory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        fprintf(stderr, "[traced] rt: mlockall failed: %s\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Touch the calling thread's stack so later deep calls don't fault
+ */
+inline void prefault_stack(size_t bytes) {
+    if (bytes == 0) return;
+    volatile char* stack = static_cast<volatile char*>(alloca(bytes));
+    for (size_t i = 0; i < bytes; i += 4096) stack[i] = 0;
+}
+
+/**
+ * Grow the malloc arena once and keep it: with trimming and mmap disabled,
+ * steady-state allocations are served from already locked pages.
+ */
+inline void prefault_heap(size_t bytes) {
+    if (bytes == 0) return;
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    char* pool = static_cast<char*>(malloc(bytes));
+    if (!pool) return;
+    for (size_t i = 0; i < bytes; i += 4096) pool[i] = 0;
+    free(pool);
+}
+
+/**
+ * Switch the calling thread to SCHED_FIFO
+ */
+inline bool set_fifo_priority(int priority) {
+    sched_param param{};
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err != 0) {
+        fprintf(stderr, "[traced] rt: SCHED_FIFO %d failed: %s\n", priority, strerror(err));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Process-wide RT setup for the dispatch loop. Threads it creates later
+ * inherit SCHED_FIFO, except those started under ScopedPlacement(Role::Exporter).
+ */
+inline void enter_rt_process() {
+    const RtConfig& c = rt_config();
+    if (!c.enabled) return;
+    lock_memory();
+    prefault_heap(c.heap_prefault);
+    prefault_stack(c.stack_prefault);
+    set_fifo_priority(c.priority);
+    printf("[traced] rt: memory locked, heap %zu KiB prefaulted, dispatch loop SCHED_FIFO %d\n",
+           c.heap_prefault / 1024, c.priority);
+}
+
+/**
+ * RT setup for additional processing threads (lane receive threads),
+ * one priority level below the dispatch loop
+ */
+inline void enter_rt_thread() {
+    const RtConfig& c = rt_config();
+    if (!c.enabled) return;
+    prefault_stack(c.stack_prefault);
+    set_fifo_priority(c.priority > 1 ? c.priority - 1 : c.priority);
+}
+
+} // namespace runtime
+} // namespace traced
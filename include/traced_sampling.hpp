@@ -0,0 +1,247 @@
+// DDS Tracing Library - rule-based sampling on message fields
+// Root writes (no active trace) are sampled by rules over the message's
+// string fields instead of uniformly, so the traces that matter are always
+// kept:
+//
+//   TRACED_SAMPLING_RULES="priority=CRITICAL,mission_type=STRIKE,classification=HOSTILE,*=0.01"
+//
+// A root write matching any field=VALUE rule is sampled; every other root
+// write is sampled with the '*' ratio (default: 0.01) by trace id. Spans
+// with a parent keep following OTEL_TRACES_SAMPLER, so with the default
+// parentbased_* samplers the decision travels downstream in trace_flags and
+// the whole trace is kept or dropped together. Root spans not started by
+// Writer::write (e.g. create_fusion_span) use OTEL_TRACES_SAMPLER as before.
+//
+// Fields must be registered per message type so a rule can read them:
+//
+//   TRACED_DDS_FIELD(combat_MissionOrder, priority);
+//   TRACED_DDS_FIELD(combat_MissionOrder, mission_type);
+//
+// Each Writer compiles the rules once against its type's registered fields
+// into a fixed predicate table (rules on fields the type lacks are left out).
+// Evaluation runs every predicate without early exit; a matched rule is
+// recorded on the span as sampling.rule.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "opentelemetry/sdk/trace/sampler.h"
+#include "opentelemetry/sdk/trace/samplers/always_on_factory.h"
+#include "opentelemetry/sdk/trace/samplers/trace_id_ratio_factory.h"
+
+namespace traced {
+namespace sampling {
+
+namespace nostd = opentelemetry::nostd;
+namespace common = opentelemetry::common;
+namespace trace_api = opentelemetry::trace;
+namespace trace_sdk = opentelemetry::sdk::trace;
+
+inline constexpr int MAX_RULES = 8;
+
+// Root rule state of the calling thread, read by RuleSampler
+inline constexpr int NOT_EVALUATED = -2;
+inline constexpr int NO_MATCH = -1;
+
+/**
+ * A registered string field of a message type
+ */
+struct Field {
+    const char* name;
+    const char* (*get)(const void* msg);    // never nullptr, "" for unset strings
+};
+
+struct Rule {
+    std::string field;
+    std::string value;
+    std::string text;       // "field=VALUE", for sampling.rule
+};
+
+namespace internal {
+
+inline std::vector<Rule> g_rules;
+inline double g_default_ratio = 0.01;
+inline bool g_enabled = false;
+inline thread_local int g_root_rule = NOT_EVALUATED;
+
+// Probability a root span is kept with, for sampling.probability. The
+// configured sampler's is set by do_init (< 0: unknown); a sampler that
+// makes the root decision itself overwrites the calling thread's value.
+inline double g_configured_probability = -1;
+inline thread_local double g_root_probability = -1;
+
+template<typename T>
+std::vector<Field>& fields() {
+    static std::vector<Field> registered;
+    return registered;
+}
+
+// "field=VALUE,...,*=ratio"
+inline void parse_rules(const char* spec) {
+    std::string s(spec);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) end = s.size();
+        std::string entry = s.substr(pos, end - pos);
+        pos = end + 1;
+        if (entry.empty()) continue;
+
+        size_t eq = entry.find('=');
+        if (eq == std::string::npos || eq == 0 || eq + 1 == entry.size()) {
+            fprintf(stderr, "[traced] Ignoring sampling rule '%s' (expected field=VALUE)\n", entry.c_str());
+            continue;
+        }
+        std::string field = entry.substr(0, eq);
+        std::string value = entry.substr(eq + 1);
+        if (field == "*") {
+            g_default_ratio = atof(value.c_str());
+            continue;
+        }
+        if (static_cast<int>(g_rules.size()) == MAX_RULES) {
+            fprintf(stderr, "[traced] More than %d sampling rules, ignoring '%s'\n", MAX_RULES, entry.c_str());
+            continue;
+        }
+        g_rules.push_back({field, value, entry});
+    }
+}
+
+} // namespace internal
+
+template<typename T>
+bool register_field(const char* name, const char* (*get)(const void*)) {
+    internal::fields<T>().push_back({name, get});
+    return true;
+}
+
+inline bool enabled() { return internal::g_enabled; }
+
+/**
+ * Rules compiled against the fields of one message type
+ */
+class RuleTable {
+public:
+    template<typename T>
+    static RuleTable compile() {
+        RuleTable table;
+        if (!internal::g_enabled) return table;
+        table.active_ = true;
+        for (const Rule& rule : internal::g_rules) {
+            for (const Field& field : internal::fields<T>()) {
+                if (rule.field != field.name) continue;
+                Predicate& p = table.predicates_[table.count_++];
+                p.get = field.get;
+                p.value = rule.value.c_str();
+                p.text = rule.text.c_str();
+                break;
+            }
+        }
+        return table;
+    }
+
+    bool active() const { return active_; }
+
+    // Index of the first matching predicate, NO_MATCH if none
+    int evaluate(const void* msg) const {
+        int matched = NO_MATCH;
+        for (int i = 0; i < count_; i++) {
+            bool hit = strcmp(predicates_[i].get(msg), predicates_[i].value) == 0;
+            matched = (hit && matched == NO_MATCH) ? i : matched;
+        }
+        return matched;
+    }
+
+    const char* rule_text(int idx) const { return predicates_[idx].text; }
+
+private:
+    struct Predicate {
+        const char* (*get)(const void*) = nullptr;
+        const char* value = nullptr;
+        const char* text = nullptr;
+    };
+
+    Predicate predicates_[MAX_RULES];
+    int count_ = 0;
+    bool active_ = false;
+};
+
+/**
+ * Sets the calling thread's root rule result around a root StartSpan
+ */
+class RootDecision {
+public:
+    explicit RootDecision(int rule) { internal::g_root_rule = rule; }
+    ~RootDecision() { internal::g_root_rule = NOT_EVALUATED; }
+    RootDecision(const RootDecision&) = delete;
+    RootDecision& operator=(const RootDecision&) = delete;
+};
+
+/**
+ * Samples rule-evaluated root spans by their rule result and leaves every
+ * other span to the configured sampler
+ */
+class RuleSampler : public trace_sdk::Sampler {
+public:
+    explicit RuleSampler(std::unique_ptr<trace_sdk::Sampler> inner)
+        : inner_(std::move(inner)),
+          always_(trace_sdk::AlwaysOnSamplerFactory::Create()),
+          ratio_(trace_sdk::TraceIdRatioBasedSamplerFactory::Create(internal::g_default_ratio)) {
+        nostd::string_view inner_desc = inner_->GetDescription();
+        description_ = "Rules{" + std::string(inner_desc.data(), inner_desc.size()) + "}";
+    }
+
+    trace_sdk::SamplingResult ShouldSample(
+        const trace_api::SpanContext& parent_context, trace_api::TraceId trace_id,
+        nostd::string_view name, trace_api::SpanKind span_kind,
+        const common::KeyValueIterable& attributes,
+        const trace_api::SpanContextKeyValueIterable& links) noexcept override {
+        int rule = internal::g_root_rule;
+        trace_sdk::Sampler* sampler = inner_.get();
+        if (rule != NOT_EVALUATED && !parent_context.IsValid()) {
+            sampler = rule == NO_MATCH ? ratio_.get() : always_.get();
+            internal::g_root_probability = rule == NO_MATCH ? std::clamp(internal::g_default_ratio, 0.0, 1.0) : 1.0;
+        }
+        return sampler->ShouldSample(parent_context, trace_id, name, span_kind, attributes, links);
+    }
+
+    nostd::string_view GetDescription() const noexcept override { return description_; }
+
+private:
+    std::unique_ptr<trace_sdk::Sampler> inner_;
+    std::unique_ptr<trace_sdk::Sampler> always_;
+    std::unique_ptr<trace_sdk::Sampler> ratio_;
+    std::string description_;
+};
+
+/**
+ * Read TRACED_SAMPLING_RULES and wrap the configured sampler (called once
+ * from traced::internal::do_init)
+ */
+inline std::unique_ptr<trace_sdk::Sampler> configure(std::unique_ptr<trace_sdk::Sampler> sampler) {
+    const char* spec = getenv("TRACED_SAMPLING_RULES");
+    if (!spec || !*spec) return sampler;
+    internal::parse_rules(spec);
+    internal::g_enabled = true;
+    printf("[traced] Sampling rules: %zu always sampled, rest at %g\n",
+           internal::g_rules.size(), internal::g_default_ratio);
+    return std::make_unique<RuleSampler>(std::move(sampler));
+}
+
+} // namespace sampling
+} // namespace traced
+
+// Make a string field of a message type available to sampling rules and
+// the key index (namespace scope, after TRACED_DDS_TYPE)
+#define TRACED_DDS_FIELD(MsgType, field) \
+    [[maybe_unused]] static const bool traced_field_##MsgType##_##field = \
+        traced::sampling::register_field<MsgType>(#field, [](const void* msg) -> const char* { \
+            const char* value = static_cast<const MsgType*>(msg)->field; \
+            return value ? value : ""; \
+        })
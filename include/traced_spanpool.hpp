@@ -0,0 +1,628 @@
+// DDS Tracing Library - preallocated spans for zero-allocation mode
+// With TRACED_ZERO_ALLOC=1 and the SDK installed, the traced tracer hands out
+// spans from a fixed pool instead of the SDK's heap-allocated ones. A pooled
+// span records into its slot: name, status, events and attributes in the
+// flight recorder's encoding. A drain thread turns ended slots into the SDK
+// processor's recordables, so the flight recorder, RED metrics and the
+// exporter see the same spans as before, but allocate off the write/take path.
+//
+// Sampling runs inline with the SDK's configured sampler, and ids come from
+// its id generator. The span handle lives in its slot too (allocate_shared
+// with a slot allocator). A slot is reused once it was drained and the last
+// reference to its span is gone. A span is ended when that last reference
+// goes, as with the SDK. While every slot is in use, spans come from the SDK
+// tracer again (counted as overflow).
+//
+// Configuration via environment variables:
+//   TRACED_SPAN_POOL - span slots, about 3 KiB each (default: 1024)
+//
+// Per span: names up to 63 characters, 1 KiB of attributes (strings up to
+// 255 characters), 4 events with 256 bytes of attributes each. What does not
+// fit is dropped and the span counted as truncated.
+
+#pragma once
+
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "opentelemetry/common/key_value_iterable.h"
+#include "opentelemetry/context/runtime_context.h"
+#include "opentelemetry/sdk/trace/id_generator.h"
+#include "opentelemetry/sdk/trace/tracer.h"
+#include "opentelemetry/trace/span_metadata.h"
+#include "opentelemetry/trace/tracer.h"
+
+#include "traced_recorder.hpp"
+#include "traced_runtime.hpp"
+
+namespace traced {
+namespace spanpool {
+
+namespace nostd = opentelemetry::nostd;
+namespace common = opentelemetry::common;
+namespace context = opentelemetry::context;
+namespace trace_api = opentelemetry::trace;
+namespace trace_sdk = opentelemetry::sdk::trace;
+
+inline constexpr size_t NAME_LEN = 64;
+inline constexpr size_t STATUS_LEN = 64;
+inline constexpr size_t ATTR_BYTES = 1024;
+inline constexpr size_t MAX_STRING_VALUE = 256;
+inline constexpr int MAX_EVENTS = 4;
+inline constexpr size_t EVENT_NAME_LEN = 48;
+inline constexpr size_t EVENT_ATTR_BYTES = 256;
+inline constexpr size_t HANDLE_BYTES = 128;
+
+struct Event {
+    char name[EVENT_NAME_LEN];
+    int64_t timestamp_ns;       // unix epoch
+    uint16_t attr_len;
+    uint8_t truncated;
+    uint8_t attrs[EVENT_ATTR_BYTES];
+};
+
+/**
+ * One span: written by the span's owner until End(), then read by the drain
+ * thread. refs counts the two parties still holding it, the drain (or End()
+ * for spans that are not recorded) and the span handle's storage.
+ */
+struct Slot {
+    trace_api::SpanContext context{false, false};
+    trace_api::SpanContext parent{false, false};
+    int64_t start_ns = 0;       // unix epoch
+    std::chrono::steady_clock::time_point start_steady;
+    int64_t duration_ns = 0;
+    bool recording = false;
+    bool ended = false;
+    uint8_t kind = 0;
+    uint8_t status = 0;
+    uint8_t truncated = 0;
+    uint16_t attr_len = 0;
+    uint16_t events = 0;
+    char name[NAME_LEN];
+    char status_message[STATUS_LEN];
+    uint8_t attrs[ATTR_BYTES];
+    Event event[MAX_EVENTS];
+
+    uint32_t index = 0;
+    std::atomic<int> refs{0};
+    std::mutex mutex;
+    alignas(std::max_align_t) unsigned char handle[HANDLE_BYTES];
+};
+
+namespace internal {
+
+inline int64_t unix_ns(common::SystemTimestamp timestamp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+}
+
+inline common::SystemTimestamp system_timestamp(int64_t unix_ns) {
+    return common::SystemTimestamp(std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(unix_ns))));
+}
+
+// Context of the span stored in an OTel context, invalid if there is none
+// (trace_api::GetSpan would allocate a default span instead)
+inline trace_api::SpanContext span_context(const context::Context& ctx) {
+    if (!ctx.HasKey(trace_api::kSpanKey)) return trace_api::SpanContext::GetInvalid();
+    context::ContextValue value = ctx.GetValue(trace_api::kSpanKey);
+    if (!nostd::holds_alternative<nostd::shared_ptr<trace_api::Span>>(value)) {
+        return trace_api::SpanContext::GetInvalid();
+    }
+    return nostd::get<nostd::shared_ptr<trace_api::Span>>(value)->GetContext();
+}
+
+// Parent as the SDK tracer picks it: the options' parent, else the active span
+inline trace_api::SpanContext parent_context(const trace_api::StartSpanOptions& options) {
+    if (nostd::holds_alternative<trace_api::SpanContext>(options.parent)) {
+        const trace_api::SpanContext& parent = nostd::get<trace_api::SpanContext>(options.parent);
+        if (parent.IsValid()) return parent;
+    } else if (nostd::holds_alternative<context::Context>(options.parent)) {
+        trace_api::SpanContext parent = span_context(nostd::get<context::Context>(options.parent));
+        if (parent.IsValid()) return parent;
+    }
+    return span_context(context::RuntimeContext::GetCurrent());
+}
+
+/**
+ * Bounded lock-free MPMC queue of slot indices. Sized to the pool, so a
+ * push never finds it full.
+ */
+class IndexQueue {
+public:
+    void init(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        cells_.reset(new Cell[size]);
+        mask_ = size - 1;
+        for (size_t i = 0; i < size; i++) cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(uint32_t value) {
+        uint64_t pos = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+            if (seq == pos) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (seq < pos) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(uint32_t& value) {
+        uint64_t pos = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & mask_];
+            uint64_t seq = cell.sequence.load(std::memory_order_acquire);
+            if (seq == pos + 1) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (seq < pos + 1) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        uint32_t value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    std::atomic<uint64_t> head_{0};
+    std::atomic<uint64_t> tail_{0};
+};
+
+/**
+ * Attributes of an event, decoded from its slot for the SDK recordable
+ */
+class EncodedAttributes : public common::KeyValueIterable {
+public:
+    EncodedAttributes(const uint8_t* attrs, size_t len) : attrs_(attrs), len_(len) {}
+
+    bool ForEachKeyValue(nostd::function_ref<bool(nostd::string_view, common::AttributeValue)> callback)
+        const noexcept override {
+        bool more = true;
+        recorder::for_each_attr(attrs_, len_, [&](uint8_t type, const char* key, const uint8_t* value) {
+            if (more) more = callback(key, recorder::attr_value(type, value));
+        });
+        return more;
+    }
+
+    size_t size() const noexcept override {
+        size_t n = 0;
+        recorder::for_each_attr(attrs_, len_, [&](uint8_t, const char*, const uint8_t*) { n++; });
+        return n;
+    }
+
+private:
+    const uint8_t* attrs_;
+    size_t len_;
+};
+
+} // namespace internal
+
+class Pool;
+
+/**
+ * Span handle over a slot, constructed in the slot's own storage
+ */
+class PooledSpan final : public trace_api::Span {
+public:
+    PooledSpan(Pool& pool, Slot& slot) : pool_(pool), slot_(slot) {}
+
+    // Ended when the last reference goes, like an SDK span
+    ~PooledSpan() override { End(); }
+
+    using trace_api::Span::AddEvent;
+
+    void SetAttribute(nostd::string_view key, const common::AttributeValue& value) noexcept override {
+        std::lock_guard<std::mutex> lock(slot_.mutex);
+        if (!writable()) return;
+        recorder::AttrWriter(slot_.attrs, ATTR_BYTES, slot_.attr_len, slot_.truncated, MAX_STRING_VALUE)
+            .put(key, value);
+    }
+
+    void AddEvent(nostd::string_view name) noexcept override {
+        add_event(name, recorder::internal::unix_ns(), nullptr);
+    }
+
+    void AddEvent(nostd::string_view name, common::SystemTimestamp timestamp) noexcept override {
+        add_event(name, internal::unix_ns(timestamp), nullptr);
+    }
+
+    void AddEvent(nostd::string_view name, common::SystemTimestamp timestamp,
+                  const common::KeyValueIterable& attributes) noexcept override {
+        add_event(name, internal::unix_ns(timestamp), &attributes);
+    }
+
+    void SetStatus(trace_api::StatusCode code, nostd::string_view description = "") noexcept override {
+        std::lock_guard<std::mutex> lock(slot_.mutex);
+        if (!writable()) return;
+        slot_.status = static_cast<uint8_t>(code);
+        recorder::internal::copy_string(slot_.status_message, STATUS_LEN, description);
+    }
+
+    void UpdateName(nostd::string_view name) noexcept override {
+        std::lock_guard<std::mutex> lock(slot_.mutex);
+        if (!writable()) return;
+        recorder::internal::copy_string(slot_.name, NAME_LEN, name);
+    }
+
+    void End(const trace_api::EndSpanOptions& options = {}) noexcept override;
+
+    // Set once before the handle exists
+    trace_api::SpanContext GetContext() const noexcept override { return slot_.context; }
+
+    bool IsRecording() const noexcept override {
+        std::lock_guard<std::mutex> lock(slot_.mutex);
+        return writable();
+    }
+
+private:
+    bool writable() const { return slot_.recording && !slot_.ended; }
+
+    void add_event(nostd::string_view name, int64_t timestamp_ns, const common::KeyValueIterable* attributes) {
+        std::lock_guard<std::mutex> lock(slot_.mutex);
+        if (!writable()) return;
+        if (slot_.events == MAX_EVENTS) {
+            slot_.truncated = 1;
+            return;
+        }
+        Event& event = slot_.event[slot_.events++];
+        recorder::internal::copy_string(event.name, EVENT_NAME_LEN, name);
+        event.timestamp_ns = timestamp_ns;
+        event.attr_len = 0;
+        event.truncated = 0;
+        if (!attributes) return;
+        recorder::AttrWriter writer(event.attrs, EVENT_ATTR_BYTES, event.attr_len, event.truncated,
+                                    MAX_STRING_VALUE);
+        attributes->ForEachKeyValue([&](nostd::string_view key, common::AttributeValue value) {
+            writer.put(key, value);
+            return true;
+        });
+        if (event.truncated) slot_.truncated = 1;
+    }
+
+    Pool& pool_;
+    Slot& slot_;
+};
+
+/**
+ * Allocator placing a span handle (and its shared_ptr control block) in
+ * the slot; deallocation is the handle's last touch of the slot
+ */
+template<typename T>
+struct SlotAllocator {
+    using value_type = T;
+
+    SlotAllocator(Pool* pool, Slot* slot) noexcept : pool(pool), slot(slot) {}
+    template<typename U>
+    SlotAllocator(const SlotAllocator<U>& other) noexcept : pool(other.pool), slot(other.slot) {}
+
+    T* allocate(size_t) {
+        static_assert(sizeof(T) <= HANDLE_BYTES && alignof(T) <= alignof(std::max_align_t),
+                      "span handle does not fit its slot");
+        return reinterpret_cast<T*>(slot->handle);
+    }
+
+    void deallocate(T*, size_t) noexcept;
+
+    Pool* pool;
+    Slot* slot;
+};
+
+template<typename T, typename U>
+bool operator==(const SlotAllocator<T>& a, const SlotAllocator<U>& b) { return a.slot == b.slot; }
+template<typename T, typename U>
+bool operator!=(const SlotAllocator<T>& a, const SlotAllocator<U>& b) { return a.slot != b.slot; }
+
+/**
+ * The slots, their free and ended queues, and the drain thread
+ */
+class Pool {
+public:
+    static Pool& instance() {
+        static Pool pool;
+        return pool;
+    }
+
+    bool enabled() const { return capacity_ > 0; }
+    size_t capacity() const { return capacity_; }
+    size_t in_use() const { return capacity_ - free_count_.load(std::memory_order_relaxed); }
+    uint64_t overflow() const { return overflow_.load(std::memory_order_relaxed); }
+    uint64_t truncated() const { return truncated_.load(std::memory_order_relaxed); }
+
+    // Called once from traced::internal::do_init with the SDK tracer the pool stands in for
+    void start(nostd::shared_ptr<trace_api::Tracer> sdk_tracer) {
+        if (enabled()) return;
+        size_t capacity = runtime::internal::env_size("TRACED_SPAN_POOL", 1024);
+        if (capacity == 0) return;
+        sdk_tracer_ = sdk_tracer;
+        sdk_ = static_cast<trace_sdk::Tracer*>(sdk_tracer_.get());
+
+        slots_.reset(new Slot[capacity]);
+        free_.init(capacity);
+        ended_.init(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            slots_[i].index = static_cast<uint32_t>(i);
+            free_.push(static_cast<uint32_t>(i));
+        }
+        capacity_ = capacity;
+        free_count_.store(capacity, std::memory_order_relaxed);
+        wake_at_ = std::max<size_t>(capacity / 4, 1);
+        {
+            runtime::ScopedPlacement placement(runtime::Role::Exporter);
+            thread_ = std::thread([this]() { run(); });
+        }
+        printf("[traced] Span pool: %zu spans\n", capacity);
+    }
+
+    nostd::shared_ptr<trace_api::Span> start_span(nostd::string_view name,
+                                                  const common::KeyValueIterable& attributes,
+                                                  const trace_api::SpanContextKeyValueIterable& links,
+                                                  const trace_api::StartSpanOptions& options) noexcept {
+        uint32_t index;
+        if (!free_.pop(index)) {
+            overflow_.fetch_add(1, std::memory_order_relaxed);
+            return sdk_tracer_->StartSpan(name, attributes, links, options);
+        }
+        free_count_.fetch_sub(1, std::memory_order_relaxed);
+        Slot& slot = slots_[index];
+
+        trace_api::SpanContext parent = internal::parent_context(options);
+        trace_sdk::IdGenerator& ids = sdk_->GetIdGenerator();
+        trace_api::TraceId trace_id = parent.IsValid() ? parent.trace_id() : ids.GenerateTraceId();
+        trace_sdk::SamplingResult sampling =
+            sdk_->GetSampler().ShouldSample(parent, trace_id, name, options.kind, attributes, links);
+        bool sampled = sampling.decision == trace_sdk::Decision::RECORD_AND_SAMPLE;
+        slot.context = trace_api::SpanContext(
+            trace_id, ids.GenerateSpanId(),
+            trace_api::TraceFlags(sampled ? trace_api::TraceFlags::kIsSampled : 0), false,
+            sampling.trace_state ? sampling.trace_state : trace_api::TraceState::GetDefault());
+        slot.parent = parent;
+
+        slot.recording = sampling.decision != trace_sdk::Decision::DROP;
+        slot.ended = false;
+        slot.kind = static_cast<uint8_t>(options.kind);
+        slot.status = 0;
+        slot.status_message[0] = '\0';
+        slot.truncated = 0;
+        slot.attr_len = 0;
+        slot.events = 0;
+        recorder::internal::copy_string(slot.name, NAME_LEN, name);
+        int64_t start_ns = internal::unix_ns(options.start_system_time);
+        slot.start_ns = start_ns ? start_ns : recorder::internal::unix_ns();
+        slot.start_steady = std::chrono::steady_clock::now();
+        if (options.start_steady_time.time_since_epoch().count()) {
+            slot.start_steady = std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    options.start_steady_time.time_since_epoch()));
+        }
+
+        if (slot.recording) {
+            recorder::AttrWriter writer(slot.attrs, ATTR_BYTES, slot.attr_len, slot.truncated, MAX_STRING_VALUE);
+            attributes.ForEachKeyValue([&](nostd::string_view key, common::AttributeValue value) {
+                writer.put(key, value);
+                return true;
+            });
+            if (sampling.attributes) {
+                for (const auto& attribute : *sampling.attributes) writer.put(attribute.first, attribute.second);
+            }
+        }
+
+        slot.refs.store(2, std::memory_order_relaxed);
+        std::shared_ptr<trace_api::Span> span =
+            std::allocate_shared<PooledSpan>(SlotAllocator<PooledSpan>(this, &slot), *this, slot);
+        return nostd::shared_ptr<trace_api::Span>(std::move(span));
+    }
+
+    // A span ended: recorded ones wait for the drain thread
+    void finish(Slot& slot) {
+        if (!slot.recording) {
+            release(slot);
+            return;
+        }
+        ended_.push(slot.index);
+        if (pending_.fetch_add(1, std::memory_order_relaxed) + 1 == wake_at_) {
+            kick_.store(true, std::memory_order_relaxed);
+            wakeup_.notify_one();
+        }
+    }
+
+    // One of the slot's two holders is done with it
+    void release(Slot& slot) {
+        if (slot.refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        free_count_.fetch_add(1, std::memory_order_relaxed);
+        free_.push(slot.index);
+    }
+
+    // Hand ended spans to the SDK processor now (shutdown, tracer flush)
+    void flush() {
+        if (enabled()) drain();
+    }
+
+    trace_api::Tracer& sdk_tracer() { return *sdk_tracer_; }
+
+    ~Pool() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+        drain();
+    }
+
+private:
+    Pool() = default;
+
+    void run() {
+        pthread_setname_np(pthread_self(), "span-pool");
+        bool stopping = false;
+        while (!stopping) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+                    return stop_ || kick_.load(std::memory_order_relaxed);
+                });
+                stopping = stop_;
+            }
+            kick_.store(false, std::memory_order_relaxed);
+            drain();
+        }
+    }
+
+    void drain() {
+        uint32_t index;
+        while (ended_.pop(index)) {
+            pending_.fetch_sub(1, std::memory_order_relaxed);
+            submit(slots_[index]);
+        }
+    }
+
+    // The span as the SDK span would have built it, started and ended at once
+    void submit(Slot& slot) {
+        if (slot.truncated) truncated_.fetch_add(1, std::memory_order_relaxed);
+        trace_sdk::SpanProcessor& processor = sdk_->GetProcessor();
+        std::unique_ptr<trace_sdk::Recordable> recordable = processor.MakeRecordable();
+        if (recordable) {
+            recordable->SetIdentity(slot.context, slot.parent.IsValid() ? slot.parent.span_id()
+                                                                        : trace_api::SpanId());
+            recordable->SetName(slot.name);
+            recordable->SetInstrumentationScope(sdk_->GetInstrumentationScope());
+            recordable->SetSpanKind(static_cast<trace_api::SpanKind>(slot.kind));
+            recordable->SetResource(sdk_->GetResource());
+            recordable->SetStartTime(internal::system_timestamp(slot.start_ns));
+            recorder::for_each_attr(slot.attrs, slot.attr_len,
+                                    [&](uint8_t type, const char* key, const uint8_t* value) {
+                recordable->SetAttribute(key, recorder::attr_value(type, value));
+            });
+            processor.OnStart(*recordable, slot.parent);
+
+            for (int i = 0; i < slot.events; i++) {
+                const Event& event = slot.event[i];
+                recordable->AddEvent(event.name, internal::system_timestamp(event.timestamp_ns),
+                                     internal::EncodedAttributes(event.attrs, event.attr_len));
+            }
+            if (slot.status) {
+                recordable->SetStatus(static_cast<trace_api::StatusCode>(slot.status), slot.status_message);
+            }
+            recordable->SetDuration(std::chrono::nanoseconds(slot.duration_ns));
+            processor.OnEnd(std::move(recordable));
+        }
+        release(slot);
+    }
+
+    std::unique_ptr<Slot[]> slots_;
+    size_t capacity_ = 0;
+    internal::IndexQueue free_;
+    internal::IndexQueue ended_;
+    std::atomic<size_t> free_count_{0};
+    std::atomic<size_t> pending_{0};
+    size_t wake_at_ = 1;
+    std::atomic<uint64_t> overflow_{0};
+    std::atomic<uint64_t> truncated_{0};
+
+    nostd::shared_ptr<trace_api::Tracer> sdk_tracer_;
+    trace_sdk::Tracer* sdk_ = nullptr;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::atomic<bool> kick_{false};
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+inline void PooledSpan::End(const trace_api::EndSpanOptions& options) noexcept {
+    {
+        std::lock_guard<std::mutex> lock(slot_.mutex);
+        if (slot_.ended) return;
+        slot_.ended = true;
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (options.end_steady_time.time_since_epoch().count()) {
+            end = std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    options.end_steady_time.time_since_epoch()));
+        }
+        slot_.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - slot_.start_steady).count();
+    }
+    pool_.finish(slot_);
+}
+
+template<typename T>
+void SlotAllocator<T>::deallocate(T*, size_t) noexcept {
+    pool->release(*slot);
+}
+
+/**
+ * Tracer handing out pooled spans, in front of the SDK tracer
+ */
+class Tracer final : public trace_api::Tracer {
+public:
+    explicit Tracer(Pool& pool) : pool_(pool) {}
+
+    using trace_api::Tracer::StartSpan;
+
+    nostd::shared_ptr<trace_api::Span> StartSpan(nostd::string_view name,
+                                                 const common::KeyValueIterable& attributes,
+                                                 const trace_api::SpanContextKeyValueIterable& links,
+                                                 const trace_api::StartSpanOptions& options) noexcept override {
+        return pool_.start_span(name, attributes, links, options);
+    }
+
+#if OPENTELEMETRY_ABI_VERSION_NO == 1
+    void ForceFlushWithMicroseconds(uint64_t timeout) noexcept override {
+        pool_.flush();
+        pool_.sdk_tracer().ForceFlushWithMicroseconds(timeout);
+    }
+
+    void CloseWithMicroseconds(uint64_t timeout) noexcept override {
+        pool_.flush();
+        pool_.sdk_tracer().CloseWithMicroseconds(timeout);
+    }
+#endif
+
+private:
+    Pool& pool_;
+};
+
+/**
+ * Put the pool in front of the SDK tracer (called once from
+ * traced::internal::do_init in zero-allocation mode)
+ */
+inline nostd::shared_ptr<trace_api::Tracer> wrap_tracer(nostd::shared_ptr<trace_api::Tracer> sdk_tracer) {
+    Pool& pool = Pool::instance();
+    pool.start(sdk_tracer);
+    if (!pool.enabled()) return sdk_tracer;
+    return nostd::shared_ptr<trace_api::Tracer>(new Tracer(pool));
+}
+
+} // namespace spanpool
+} // namespace traced
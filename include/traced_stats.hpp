@@ -0,0 +1,268 @@
+// DDS Tracing Library - per-process statistics file
+// Discovery time, samples written/taken, take transit latency, CPU time and
+// RSS of the process, rewritten as one JSON line every interval and once
+// more at exit. tools/scale-harness reads the file of every instance it
+// launches; anything else can poll it the same way.
+//
+// Configuration via environment variables:
+//   TRACED_STATS_FILE        - path of the file (unset: no statistics)
+//   TRACED_STATS_INTERVAL_MS - rewrite interval (default: 1000)
+//
+// Fields:
+//   endpoints, matched - traced writers/readers created / matched at least once
+//   discovery_ms       - first traced endpoint created -> all of them matched,
+//                        -1 until then
+//   written, taken     - samples through Writer::write / Reader::take
+//   transit_*_us       - source timestamp -> take, as on the take spans
+//   cpu_ms, rss_kb, max_rss_kb - getrusage / statm of the whole process
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "dds/dds.h"
+#include "traced_runtime.hpp"
+
+namespace traced {
+namespace stats {
+
+inline constexpr int MAX_ENDPOINTS = 64;
+inline constexpr int TRANSIT_BUCKETS = 4 * 40;     // quarter octaves of 1us..~2^40us
+
+struct Endpoint {
+    std::atomic<bool> matched{false};
+};
+
+namespace internal {
+
+inline bool g_enabled = false;
+inline std::atomic<uint64_t> g_written{0};
+inline std::atomic<uint64_t> g_taken{0};
+inline std::atomic<uint64_t> g_transit[TRANSIT_BUCKETS];
+inline std::atomic<int64_t> g_transit_max_ns{0};
+
+inline Endpoint g_endpoints[MAX_ENDPOINTS];
+inline std::atomic<int> g_registered{0};
+inline std::atomic<int> g_matched{0};
+inline std::atomic<int64_t> g_first_endpoint_ns{0};
+inline std::atomic<int64_t> g_discovery_ns{-1};
+
+inline int64_t mono_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Quarter-octave bucket of a latency in us: 4 buckets per power of two
+inline int transit_bucket(int64_t ns) {
+    uint64_t us = ns > 0 ? static_cast<uint64_t>(ns) / 1000 : 0;
+    if (us < 4) return static_cast<int>(us);
+    int msb = 63 - __builtin_clzll(us);
+    int idx = msb * 4 + static_cast<int>((us >> (msb - 2)) & 3);
+    return idx < TRANSIT_BUCKETS ? idx : TRANSIT_BUCKETS - 1;
+}
+
+// Upper bound of a bucket in us
+inline uint64_t transit_bucket_limit(int idx) {
+    if (idx < 8) return static_cast<uint64_t>(idx < 4 ? idx + 1 : 4);   // 4..7 unused
+    int msb = idx / 4;
+    return (static_cast<uint64_t>(4 + idx % 4 + 1)) << (msb - 2);
+}
+
+inline void mark_matched(Endpoint* ep) {
+    if (ep->matched.exchange(true)) return;
+    int matched = g_matched.fetch_add(1) + 1;
+    if (matched == g_registered.load()) {
+        g_discovery_ns.store(mono_ns() - g_first_endpoint_ns.load());
+    }
+}
+
+inline void on_publication_matched(dds_entity_t, const dds_publication_matched_status_t status, void* arg) {
+    if (status.current_count > 0) mark_matched(static_cast<Endpoint*>(arg));
+}
+
+inline void on_subscription_matched(dds_entity_t, const dds_subscription_matched_status_t status, void* arg) {
+    if (status.current_count > 0) mark_matched(static_cast<Endpoint*>(arg));
+}
+
+} // namespace internal
+
+inline bool enabled() { return internal::g_enabled; }
+
+inline void count_write() {
+    if (internal::g_enabled) internal::g_written.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void record_take(int64_t transit_ns) {
+    if (!internal::g_enabled) return;
+    internal::g_taken.fetch_add(1, std::memory_order_relaxed);
+    internal::g_transit[internal::transit_bucket(transit_ns)].fetch_add(1, std::memory_order_relaxed);
+    int64_t max = internal::g_transit_max_ns.load(std::memory_order_relaxed);
+    while (transit_ns > max &&
+           !internal::g_transit_max_ns.compare_exchange_weak(max, transit_ns, std::memory_order_relaxed)) {}
+}
+
+/**
+ * Slot for a traced writer/reader, nullptr when the statistics are off or
+ * more than MAX_ENDPOINTS endpoints exist
+ */
+inline Endpoint* register_endpoint() {
+    if (!internal::g_enabled) return nullptr;
+    int slot = internal::g_registered.fetch_add(1);
+    if (slot >= MAX_ENDPOINTS) {
+        internal::g_registered.fetch_sub(1);
+        return nullptr;
+    }
+    int64_t expected = 0;
+    internal::g_first_endpoint_ns.compare_exchange_strong(expected, internal::mono_ns());
+    internal::g_discovery_ns.store(-1);
+    return &internal::g_endpoints[slot];
+}
+
+/**
+ * Listener marking the endpoint matched on its first match, nullptr without
+ * a slot. The caller deletes it after creating the entity.
+ */
+inline dds_listener_t* matched_listener(Endpoint* ep) {
+    if (!ep) return nullptr;
+    dds_listener_t* listener = dds_create_listener(ep);
+    dds_lset_publication_matched(listener, internal::on_publication_matched);
+    dds_lset_subscription_matched(listener, internal::on_subscription_matched);
+    return listener;
+}
+
+/**
+ * Rewrites TRACED_STATS_FILE from a background thread
+ */
+class Stats {
+public:
+    static Stats& instance() {
+        static Stats stats;
+        return stats;
+    }
+
+    // Called once from traced::internal::do_init
+    void start(const std::string& service_name) {
+        const char* path = getenv("TRACED_STATS_FILE");
+        if (thread_.joinable() || !path || !*path) return;
+        path_ = path;
+        tmp_path_ = path_ + ".tmp";
+        service_name_ = service_name;
+        interval_ms_ = runtime::internal::env_size("TRACED_STATS_INTERVAL_MS", 1000);
+        if (interval_ms_ == 0) interval_ms_ = 1000;
+        start_ns_ = internal::mono_ns();
+        internal::g_enabled = true;
+
+        runtime::ScopedPlacement placement(runtime::Role::Exporter);
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~Stats() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+private:
+    Stats() = default;
+
+    void run() {
+        pthread_setname_np(pthread_self(), "traced-stats");
+        bool stopping = false;
+        while (!stopping) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, std::chrono::milliseconds(interval_ms_), [this]() { return stop_; });
+                stopping = stop_;
+            }
+            write();
+        }
+    }
+
+    static uint64_t transit_percentile_us(const uint64_t* buckets, uint64_t total, double q) {
+        if (total == 0) return 0;
+        uint64_t target = static_cast<uint64_t>(q * total);
+        uint64_t seen = 0;
+        for (int i = 0; i < TRANSIT_BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen > target) return internal::transit_bucket_limit(i);
+        }
+        return internal::transit_bucket_limit(TRANSIT_BUCKETS - 1);
+    }
+
+    // Written to a temporary file and renamed, so readers never see half a line
+    void write() {
+        uint64_t buckets[TRANSIT_BUCKETS];
+        uint64_t total = 0;
+        for (int i = 0; i < TRANSIT_BUCKETS; i++) {
+            buckets[i] = internal::g_transit[i].load(std::memory_order_relaxed);
+            total += buckets[i];
+        }
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        long cpu_ms = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000L +
+                      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000L;
+        long rss_pages = 0;
+        if (FILE* statm = fopen("/proc/self/statm", "r")) {
+            long size_pages = 0;
+            if (fscanf(statm, "%ld %ld", &size_pages, &rss_pages) != 2) rss_pages = 0;
+            fclose(statm);
+        }
+        long rss_kb = rss_pages * (sysconf(_SC_PAGESIZE) / 1024);
+        int64_t discovery_ns = internal::g_discovery_ns.load();
+
+        FILE* f = fopen(tmp_path_.c_str(), "w");
+        if (!f) {
+            if (!open_failed_) fprintf(stderr, "[traced] Cannot write %s\n", tmp_path_.c_str());
+            open_failed_ = true;
+            return;
+        }
+        fprintf(f,
+                "{\"service\":\"%s\",\"pid\":%d,\"uptime_ms\":%lld,\"endpoints\":%d,\"matched\":%d,"
+                "\"discovery_ms\":%.1f,\"written\":%llu,\"taken\":%llu,"
+                "\"transit_p50_us\":%llu,\"transit_p99_us\":%llu,\"transit_max_us\":%lld,"
+                "\"cpu_ms\":%ld,\"rss_kb\":%ld,\"max_rss_kb\":%ld}\n",
+                service_name_.c_str(), static_cast<int>(getpid()),
+                static_cast<long long>((internal::mono_ns() - start_ns_) / 1000000),
+                internal::g_registered.load(), internal::g_matched.load(),
+                discovery_ns < 0 ? -1.0 : discovery_ns / 1e6,
+                static_cast<unsigned long long>(internal::g_written.load(std::memory_order_relaxed)),
+                static_cast<unsigned long long>(internal::g_taken.load(std::memory_order_relaxed)),
+                static_cast<unsigned long long>(transit_percentile_us(buckets, total, 0.50)),
+                static_cast<unsigned long long>(transit_percentile_us(buckets, total, 0.99)),
+                static_cast<long long>(internal::g_transit_max_ns.load(std::memory_order_relaxed) / 1000),
+                cpu_ms, rss_kb, usage.ru_maxrss);
+        fclose(f);
+        rename(tmp_path_.c_str(), path_.c_str());
+    }
+
+    std::string path_;
+    std::string tmp_path_;
+    std::string service_name_;
+    size_t interval_ms_ = 1000;
+    int64_t start_ns_ = 0;
+    bool open_failed_ = false;
+
+    std::mutex mutex_;                  // writer thread wakeup only
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace stats
+} // namespace traced
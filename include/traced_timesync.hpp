@@ -0,0 +1,449 @@
+// DDS Tracing Library - cross-node clock offset estimation
+// Source timestamps are stamped with the writer host's wall clock, so transit
+// latency across hosts is off by the clocks' offset. Every traced service pings
+// the TracedTimeSync topic; every other traced service answers with a pong,
+// NTP-style, and the pinger estimates each peer's offset and drift:
+//
+//   offset = ((t2 - t1) + (t3 - t4)) / 2     peer clock minus local clock
+//   delay  = (t4 - t1) - (t3 - t2)           round trip without responder time
+//
+// Filtering per peer, after NTP:
+//   - clock filter: of the last 8 exchanges only the lowest-delay one is used
+//   - popcorn spikes: offsets far off the current fit are dropped, unless
+//     they persist (a real clock step)
+//   - drift: least squares fit over the last 16 filtered offsets
+//
+// Pings go out in the default partition. Pongs go to the pinger's partition,
+// traced.timesync.<origin id>, from one writer per peer, so a process receives
+// only the pongs to its own pings: N processes exchange N * (N - 1) pongs per
+// interval, not N^3 as on a shared topic. A peer's pong writer is created by
+// the ping thread; pings arriving before it exists stay unanswered.
+//
+// Configuration via environment variables:
+//   TRACED_TIMESYNC             - "0" disables pinging and corrections
+//   TRACED_TIMESYNC_INTERVAL_MS - ping interval (default: 1000)
+//   TRACED_TIMESYNC_MAX_PEERS   - peer table size (default: 64); processes
+//                                 beyond it are not synchronized (logged once)
+//
+// Peers are keyed by origin_id(), random per process, so every instance of a
+// scaled-out service has an estimate of its own. traced_topology.hpp puts it
+// into the writers' user data next to the service name.
+
+#pragma once
+
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "dds/dds.h"
+#include "TracedTopics.h"
+
+#include "traced_runtime.hpp"
+
+namespace traced {
+namespace timesync {
+
+inline constexpr const char* TIMESYNC_TOPIC = "TracedTimeSync";
+inline constexpr int FILTER_SAMPLES = 8;        // NTP clock filter register
+inline constexpr int FIT_SAMPLES = 16;          // filtered offsets in the drift fit
+inline constexpr int MAX_SPIKES = 3;            // consecutive outliers accepted as a clock step
+inline constexpr size_t DEFAULT_MAX_PEERS = 64;
+inline constexpr double MAX_DRIFT = 500e-6;     // 500 ppm, beyond any sane oscillator
+
+namespace internal {
+
+inline bool g_enabled = true;
+
+} // namespace internal
+
+/**
+ * This process's id in pings, pongs and endpoint user data; never 0
+ */
+inline int64_t origin_id() {
+    static const int64_t id = []() {
+        int64_t id = (static_cast<int64_t>(getpid()) << 32) ^ dds_time();
+        return id ? id : 1;
+    }();
+    return id;
+}
+
+/**
+ * Clock estimate for one peer process. Exchanges are added by the pong
+ * listener only; readers get the current fit lock-free through a seqlock.
+ */
+class Peer {
+public:
+    int64_t origin_id() const { return origin_id_; }
+    const char* service() const { return service_; }
+
+    /**
+     * Peer clock minus local clock at local time now_ns. False until the
+     * first filtered exchange.
+     */
+    bool offset_at(int64_t now_ns, int64_t& offset_ns) const {
+        uint32_t seq;
+        int64_t ref, offset;
+        double drift;
+        do {
+            seq = seq_.load(std::memory_order_acquire);
+            if (seq == 0) return false;
+            ref = ref_ns_.load(std::memory_order_relaxed);
+            offset = offset_ns_.load(std::memory_order_relaxed);
+            drift = drift_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != seq_.load(std::memory_order_relaxed));
+        offset_ns = offset + static_cast<int64_t>(drift * (now_ns - ref));
+        return true;
+    }
+
+    int64_t delay_ns() const { return delay_ns_.load(std::memory_order_relaxed); }
+    double jitter_ns() const { return jitter_ns_; }
+    double drift() const { return drift_.load(std::memory_order_relaxed); }
+    uint64_t exchanges() const { return exchanges_; }
+    uint64_t rejected() const { return rejected_; }
+
+    // One completed ping-pong, t1/t4 local clock, t2/t3 peer clock
+    void add_exchange(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+        exchanges_++;
+        int64_t delay = (t4 - t1) - (t3 - t2);
+        if (delay < 0 || t4 < t1) {
+            rejected_++;  // a clock stepped mid-exchange
+            return;
+        }
+        Sample& s = filter_[filter_next_++ % FILTER_SAMPLES];
+        s.t = t4;
+        s.offset = ((t2 - t1) + (t3 - t4)) / 2;
+        s.delay = delay;
+
+        const Sample* best = nullptr;
+        for (const Sample& f : filter_) {
+            if (f.t && (!best || f.delay < best->delay)) best = &f;
+        }
+        if (best->t <= last_used_t_) return;  // NTP: never reuse or go back to an older sample
+        last_used_t_ = best->t;
+        delay_ns_.store(best->delay, std::memory_order_relaxed);
+
+        int64_t predicted;
+        if (fit_count_ >= 4 && offset_at(best->t, predicted)) {
+            double residual = std::fabs(static_cast<double>(best->offset - predicted));
+            // An exchange's offset error is bounded by half its delay
+            bool spike = residual > 4.0 * jitter_ns_ + best->delay / 2.0 + 50000.0;
+            if (spike && spikes_ < MAX_SPIKES) {
+                spikes_++;
+                rejected_++;
+                return;
+            }
+            if (spike) {
+                fit_count_ = 0;  // persistent: the peer clock stepped, refit from here
+                jitter_ns_ = 0.0;
+            } else {
+                jitter_ns_ += (residual - jitter_ns_) / 8.0;
+            }
+        }
+        spikes_ = 0;
+
+        fit_[fit_next_++ % FIT_SAMPLES] = {best->t, best->offset, best->delay};
+        fit_count_ = std::min(fit_count_ + 1, FIT_SAMPLES);
+        refit();
+    }
+
+private:
+    friend class Sync;
+
+    struct Sample {
+        int64_t t = 0;          // t4, local clock
+        int64_t offset = 0;
+        int64_t delay = 0;
+    };
+
+    // Least squares line through the fit window, anchored at its mean time
+    void refit() {
+        int n = fit_count_;
+        int first = fit_next_ - n;
+        int64_t t0 = fit_[(first + FIT_SAMPLES) % FIT_SAMPLES].t;
+        double mean_t = 0.0, mean_o = 0.0;  // mean_t relative to t0: epoch ns overflow double precision
+        for (int i = 0; i < n; i++) {
+            const Sample& s = fit_[(first + i + FIT_SAMPLES) % FIT_SAMPLES];
+            mean_t += static_cast<double>(s.t - t0) / n;
+            mean_o += static_cast<double>(s.offset) / n;
+        }
+        double stt = 0.0, sto = 0.0;
+        for (int i = 0; i < n; i++) {
+            const Sample& s = fit_[(first + i + FIT_SAMPLES) % FIT_SAMPLES];
+            double dt = static_cast<double>(s.t - t0) - mean_t;
+            stt += dt * dt;
+            sto += dt * (s.offset - mean_o);
+        }
+        // Drift needs a few samples over at least a few seconds to mean anything
+        double drift = (n >= 4 && stt > 0.0 && std::sqrt(stt / n) > 1e9) ? sto / stt : 0.0;
+        drift = std::max(-MAX_DRIFT, std::min(MAX_DRIFT, drift));
+
+        uint32_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        ref_ns_.store(t0 + static_cast<int64_t>(mean_t), std::memory_order_relaxed);
+        offset_ns_.store(static_cast<int64_t>(mean_o), std::memory_order_relaxed);
+        drift_.store(drift, std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    int64_t origin_id_ = 0;
+    char service_[48] = {0};
+    std::atomic<dds_entity_t> pong_writer_{0};  // 0 until the ping thread created it
+
+    // Published fit: offset(t) = offset_ns_ + drift_ * (t - ref_ns_); seq_ 0 = none yet
+    std::atomic<uint32_t> seq_{0};
+    std::atomic<int64_t> ref_ns_{0};
+    std::atomic<int64_t> offset_ns_{0};
+    std::atomic<double> drift_{0.0};
+    std::atomic<int64_t> delay_ns_{0};
+
+    // Pong listener only
+    Sample filter_[FILTER_SAMPLES];
+    int filter_next_ = 0;
+    int64_t last_used_t_ = 0;
+    Sample fit_[FIT_SAMPLES];
+    int fit_next_ = 0;
+    int fit_count_ = 0;
+    int spikes_ = 0;
+    double jitter_ns_ = 0.0;
+    uint64_t exchanges_ = 0;
+    uint64_t rejected_ = 0;
+};
+
+/**
+ * Pings the TracedTimeSync topic from a background thread and answers the
+ * pings of other services from the CycloneDDS listener thread, so t2/t3 and
+ * t4 are taken as close to the wire as the process gets.
+ */
+class Sync {
+public:
+    static Sync& instance() {
+        static Sync sync;
+        return sync;
+    }
+
+    // Called once with the first participant a traced endpoint is created on
+    void start(dds_entity_t participant, const std::string& service_name) {
+        if (writer_ > 0 || !internal::g_enabled) return;
+        service_name_ = service_name;
+        interval_ms_ = static_cast<int>(runtime::internal::env_size("TRACED_TIMESYNC_INTERVAL_MS", 1000));
+        if (interval_ms_ <= 0) interval_ms_ = 1000;
+        max_peers_ = runtime::internal::env_size("TRACED_TIMESYNC_MAX_PEERS", DEFAULT_MAX_PEERS);
+        if (max_peers_ == 0) max_peers_ = DEFAULT_MAX_PEERS;
+        peers_.reset(new Peer[max_peers_]);
+        origin_id_ = origin_id();
+
+        participant_ = participant;
+        topic_ = dds_create_topic(participant, &traced_TimeSync_desc, TIMESYNC_TOPIC, nullptr, nullptr);
+        if (topic_ < 0) return;
+        dds_qos_t* qos = create_qos();
+        dds_qos_t* pong_qos = create_qos(origin_id_);
+        writer_ = dds_create_writer(participant, topic_, qos, nullptr);
+        dds_listener_t* listener = dds_create_listener(this);
+        dds_lset_data_available(listener, on_data);
+        dds_entity_t ping_reader = dds_create_reader(participant, topic_, qos, listener);
+        dds_entity_t pong_reader = dds_create_reader(participant, topic_, pong_qos, listener);
+        dds_delete_listener(listener);
+        dds_delete_qos(pong_qos);
+        dds_delete_qos(qos);
+        if (writer_ < 0 || ping_reader < 0 || pong_reader < 0) return;
+
+        runtime::ScopedPlacement ping_placement(runtime::Role::Exporter);
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~Sync() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+    /**
+     * Estimate for a peer process by its origin_id(), nullptr until it was
+     * heard from (or with the table full). Lock-free; the pointer stays valid
+     * for the life of the process.
+     */
+    const Peer* find(int64_t origin) const {
+        if (origin == 0) return nullptr;
+        size_t n = peer_count_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; i++) {
+            if (peers_[i].origin_id_ == origin) return &peers_[i];
+        }
+        return nullptr;
+    }
+
+    // Peers known so far: a cached miss from find() is stale once this grows
+    size_t peer_count() const { return peer_count_.load(std::memory_order_acquire); }
+
+    /**
+     * Best-effort and volatile: a lost ping is just one exchange less. Pongs
+     * to the process pong_origin go to its partition, pings to the default one.
+     */
+    static dds_qos_t* create_qos(int64_t pong_origin = 0) {
+        dds_qos_t* qos = dds_create_qos();
+        dds_qset_reliability(qos, DDS_RELIABILITY_BEST_EFFORT, 0);
+        dds_qset_history(qos, DDS_HISTORY_KEEP_LAST, 16);
+        if (pong_origin) {
+            char partition[40];
+            snprintf(partition, sizeof(partition), "traced.timesync.%016llx",
+                     static_cast<unsigned long long>(pong_origin));
+            dds_qset_partition1(qos, partition);
+        }
+        return qos;
+    }
+
+private:
+    Sync() = default;
+
+    // Listener threads: find or append; nullptr once the table is full
+    Peer* peer(int64_t origin, const char* service) {
+        Peer* found = const_cast<Peer*>(find(origin));
+        if (found) return found;
+        std::lock_guard<std::mutex> lock(append_mutex_);
+        found = const_cast<Peer*>(find(origin));
+        if (found) return found;
+        size_t n = peer_count_.load(std::memory_order_relaxed);
+        if (n == max_peers_) {
+            if (!overflow_logged_) {
+                overflow_logged_ = true;
+                fprintf(stderr, "[traced] Clock sync: more than %zu peers, '%s' and later ones stay "
+                        "uncorrected (TRACED_TIMESYNC_MAX_PEERS)\n", max_peers_, service);
+            }
+            return nullptr;
+        }
+        peers_[n].origin_id_ = origin;
+        size_t len = strnlen(service, sizeof(peers_[n].service_) - 1);
+        memcpy(peers_[n].service_, service, len);
+        peers_[n].service_[len] = '\0';
+        peer_count_.store(n + 1, std::memory_order_release);
+        return &peers_[n];
+    }
+
+    // Ping thread: a pong writer into the partition of every peer heard from
+    void create_pong_writers() {
+        size_t n = peer_count_.load(std::memory_order_acquire);
+        for (; pong_writers_ < n; pong_writers_++) {
+            Peer& p = peers_[pong_writers_];
+            dds_qos_t* qos = create_qos(p.origin_id_);
+            p.pong_writer_.store(dds_create_writer(participant_, topic_, qos, nullptr), std::memory_order_release);
+            dds_delete_qos(qos);
+        }
+    }
+
+    static void on_data(dds_entity_t reader, void* arg) {
+        static_cast<Sync*>(arg)->handle(reader);
+    }
+
+    void handle(dds_entity_t reader) {
+        void* samples[8];
+        dds_sample_info_t infos[8];
+        while (true) {
+            samples[0] = nullptr;  // loan from DDS
+            dds_return_t n = dds_take(reader, samples, infos, 8, 8);
+            int64_t received = dds_time();  // t2 for pings, t4 for pongs
+            if (n <= 0) break;
+            for (int i = 0; i < n; i++) {
+                if (!infos[i].valid_data) continue;
+                const traced_TimeSync& msg = *static_cast<traced_TimeSync*>(samples[i]);
+                if (msg.origin_id == origin_id_ || msg.origin_id == 0 || !msg.origin_service) continue;
+
+                if (msg.target_id == 0) {
+                    Peer* p = peer(msg.origin_id, msg.origin_service);
+                    dds_entity_t pong_writer = p ? p->pong_writer_.load(std::memory_order_acquire) : 0;
+                    if (pong_writer <= 0) continue;
+                    traced_TimeSync pong;
+                    memset(&pong, 0, sizeof(pong));
+                    pong.origin_service = const_cast<char*>(service_name_.c_str());
+                    pong.origin_id = origin_id_;
+                    pong.target_id = msg.origin_id;
+                    pong.sequence = msg.sequence;
+                    pong.t1 = msg.t1;
+                    pong.t2 = received;
+                    pong.t3 = dds_time();
+                    dds_write(pong_writer, &pong);
+                } else if (msg.target_id == origin_id_) {
+                    Peer* p = peer(msg.origin_id, msg.origin_service);
+                    if (p) p->add_exchange(msg.t1, msg.t2, msg.t3, received);
+                }
+            }
+            dds_return_loan(reader, samples, n);
+        }
+    }
+
+    void run() {
+        pthread_setname_np(pthread_self(), "timesync");
+        int32_t sequence = 0;
+        while (true) {
+            create_pong_writers();
+            traced_TimeSync ping;
+            memset(&ping, 0, sizeof(ping));
+            ping.origin_service = const_cast<char*>(service_name_.c_str());
+            ping.origin_id = origin_id_;
+            ping.sequence = sequence++;
+            ping.t1 = dds_time();
+            dds_write(writer_, &ping);
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (wakeup_.wait_for(lock, std::chrono::milliseconds(interval_ms_),
+                                 [this]() { return stop_; })) {
+                break;
+            }
+        }
+    }
+
+    std::string service_name_;
+    int interval_ms_ = 1000;
+    int64_t origin_id_ = 0;
+    dds_entity_t participant_ = 0;
+    dds_entity_t topic_ = 0;
+    dds_entity_t writer_ = 0;           // pings
+
+    std::unique_ptr<Peer[]> peers_;     // TRACED_TIMESYNC_MAX_PEERS, fixed after start
+    size_t max_peers_ = 0;
+    std::atomic<size_t> peer_count_{0};
+    std::mutex append_mutex_;           // peers_ appends from the ping and pong listeners
+    bool overflow_logged_ = false;
+    size_t pong_writers_ = 0;           // ping thread: peers with a pong writer
+
+    std::mutex mutex_;                  // ping thread wakeup only
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+struct Latency {
+    int64_t ns;
+    int64_t clock_offset_ns;    // applied correction, 0 when not corrected
+    bool corrected;
+};
+
+/**
+ * Local time minus a peer-stamped time (e.g. the DDS source timestamp), with
+ * the peer's clock offset removed once it is known
+ */
+inline Latency latency_since(const Peer* peer, int64_t local_ns, int64_t peer_stamp_ns) {
+    Latency l{local_ns - peer_stamp_ns, 0, false};
+    if (peer && internal::g_enabled && peer->offset_at(local_ns, l.clock_offset_ns)) {
+        l.ns += l.clock_offset_ns;
+        l.corrected = true;
+    }
+    return l;
+}
+
+} // namespace timesync
+} // namespace traced
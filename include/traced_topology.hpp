@@ -0,0 +1,482 @@
+// DDS Tracing Library - live service dependency graph
+// Every traced service counts the caller -> callee edges it receives through
+// (topic, upstream service) and publishes the table on the TracedTopology topic.
+// tools/topology (or topology::Graph) assembles the system graph from them.
+//
+// Configuration via environment variables:
+//   TRACED_TOPOLOGY             - "0" disables edge tracking and publishing
+//   TRACED_TOPOLOGY_INTERVAL_MS - publish interval (default: 5000)
+//
+// Upstream services are identified by the "traced.service=<name>" user data
+// every traced endpoint carries; samples from other writers count as "unknown".
+// Latency is DDS source timestamp -> receive, corrected for the upstream
+// host's clock offset once traced_timesync.hpp has an estimate.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "dds/dds.h"
+#include "TracedTopics.h"
+
+#include "traced_runtime.hpp"
+#include "traced_metrics.hpp"
+#include "traced_timesync.hpp"
+
+namespace traced {
+namespace topology {
+
+enum class EdgeKind : uint8_t { Take = 0, Link = 1 };
+
+inline const char* edge_kind_name(EdgeKind kind) {
+    return kind == EdgeKind::Link ? "link" : "take";
+}
+
+inline constexpr const char* TOPOLOGY_TOPIC = "TracedTopology";
+inline constexpr const char* USERDATA_PREFIX = "traced.service=";
+inline constexpr const char* USERDATA_ORIGIN = ";origin=";     // then timesync::origin_id() in hex
+inline constexpr int LATENCY_BUCKETS = 32;      // bucket i: latency < 2^i us
+inline constexpr size_t EDGES_PER_THREAD = 64;
+
+namespace internal {
+
+inline bool g_enabled = true;
+
+// Same single-writer scheme as the RED tables (traced_metrics.hpp)
+struct Edge {
+    std::atomic<bool> used{false};
+    uint64_t hash = 0;
+    char topic[48];
+    char upstream[48];
+    EdgeKind kind = EdgeKind::Take;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> latency[LATENCY_BUCKETS];
+
+    Edge() {
+        for (auto& b : latency) b.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct Shard {
+    Edge edges[EDGES_PER_THREAD];
+    Shard* next = nullptr;
+};
+
+inline std::atomic<Shard*> g_shards{nullptr};
+inline thread_local Shard* t_shard = nullptr;
+
+inline Shard* local_shard() {
+    if (t_shard) return t_shard;
+    Shard* shard = new Shard();
+    shard->next = g_shards.load(std::memory_order_relaxed);
+    while (!g_shards.compare_exchange_weak(shard->next, shard,
+                                           std::memory_order_release, std::memory_order_relaxed)) {}
+    t_shard = shard;
+    return shard;
+}
+
+inline void copy_name(char* dst, size_t size, const char* src) {
+    size_t n = strnlen(src, size - 1);
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+}
+
+inline Edge* find_edge(const char* topic, const char* upstream, EdgeKind kind) {
+    using metrics::internal::fnv1a;
+    uint64_t h = fnv1a(14695981039346656037ULL, topic, strlen(topic));
+    h = fnv1a(h, upstream, strlen(upstream));
+    h = fnv1a(h, &kind, 1);
+
+    Shard* shard = local_shard();
+    for (size_t probe = 0; probe < EDGES_PER_THREAD; probe++) {
+        Edge& e = shard->edges[(h + probe) % EDGES_PER_THREAD];
+        if (!e.used.load(std::memory_order_relaxed)) {
+            e.hash = h;
+            copy_name(e.topic, sizeof(e.topic), topic);
+            copy_name(e.upstream, sizeof(e.upstream), upstream);
+            e.kind = kind;
+            e.used.store(true, std::memory_order_release);
+            return &e;
+        }
+        if (e.hash == h && e.kind == kind && strncmp(e.topic, topic, sizeof(e.topic) - 1) == 0 &&
+            strncmp(e.upstream, upstream, sizeof(e.upstream) - 1) == 0) {
+            return &e;
+        }
+    }
+    return nullptr;  // table full: edge not tracked
+}
+
+inline int latency_bucket(int64_t latency_ns) {
+    uint64_t us = static_cast<uint64_t>(latency_ns / 1000);
+    int b = 0;
+    while (b < LATENCY_BUCKETS - 1 && us >= (1ULL << b)) b++;
+    return b;
+}
+
+// Quantile q in ms, interpolated linearly inside the bucket that holds it:
+// the bucket bound alone would be up to twice the true value
+inline double quantile_ms(const uint64_t* buckets, double q) {
+    uint64_t total = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) total += buckets[i];
+    if (total == 0) return 0.0;
+    double rank = q * (total - 1);
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        if (buckets[i] == 0 || seen + buckets[i] <= rank) {
+            seen += buckets[i];
+            continue;
+        }
+        double lower_us = i == 0 ? 0.0 : static_cast<double>(1ULL << (i - 1));
+        double upper_us = static_cast<double>(1ULL << i);
+        // Samples spread evenly over the bucket, each in the middle of its share
+        double fraction = (rank - seen + 0.5) / buckets[i];
+        return (lower_us + (upper_us - lower_us) * fraction) / 1000.0;
+    }
+    return (1ULL << (LATENCY_BUCKETS - 1)) / 1000.0;
+}
+
+} // namespace internal
+
+/**
+ * Count one received sample on an edge. latency_ns < 0 counts without latency.
+ */
+inline void record_edge(const char* topic, const char* upstream, EdgeKind kind, int64_t latency_ns) {
+    if (!internal::g_enabled) return;
+    internal::Edge* e = internal::find_edge(topic, upstream, kind);
+    if (!e) return;
+    metrics::internal::bump(e->count, 1);
+    if (latency_ns >= 0) metrics::internal::bump(e->latency[internal::latency_bucket(latency_ns)], 1);
+}
+
+/**
+ * Tag an endpoint QoS with the local service name and process (read back by
+ * PublisherCache)
+ */
+inline void set_service_userdata(dds_qos_t* qos, const char* service_name) {
+    char data[128];
+    int n = snprintf(data, sizeof(data), "%s%.80s%s%016llx", USERDATA_PREFIX, service_name, USERDATA_ORIGIN,
+                     static_cast<unsigned long long>(timesync::origin_id()));
+    if (n > 0) dds_qset_userdata(qos, data, std::min(static_cast<size_t>(n), sizeof(data) - 1));
+}
+
+/**
+ * Writer of a received sample: its service and process, and that process's
+ * clock estimate
+ */
+struct Upstream {
+    dds_instance_handle_t handle;
+    uint64_t writer_id;             // from the writer's GUID, kept when the handle changes
+    char service[48];
+    int64_t origin_id;              // writer's timesync::origin_id(), 0 if it sent none
+    const timesync::Peer* clock;    // nullptr until the timesync peer is known
+    size_t clock_peers;             // Sync::peer_count() at the last clock lookup
+};
+
+/**
+ * Maps publication handles of one DDS reader to the writers' service names.
+ * Lookups hit the matched-publication data once per writer.
+ */
+class PublisherCache {
+public:
+    PublisherCache() { entries_.reserve(MAX_ENTRIES); }
+
+    const char* service(dds_entity_t reader, dds_instance_handle_t handle) {
+        return lookup(reader, handle).service;
+    }
+
+    // Valid until the next lookup
+    const Upstream& lookup(dds_entity_t reader, dds_instance_handle_t handle) {
+        for (Upstream& e : entries_) {
+            if (e.handle != handle) continue;
+            if (!e.clock) resolve_clock(e);
+            return e;
+        }
+        if (entries_.size() == MAX_ENTRIES) entries_.clear();
+
+        Upstream e;
+        e.handle = handle;
+        e.writer_id = handle;
+        e.origin_id = 0;
+        e.clock = nullptr;
+        e.clock_peers = 0;
+        internal::copy_name(e.service, sizeof(e.service), "unknown");
+        dds_builtintopic_endpoint_t* ep = dds_get_matched_publication_data(reader, handle);
+        if (ep) {
+            e.writer_id = guid_id(ep->key);
+            void* data = nullptr;
+            size_t size = 0;
+            size_t prefix = strlen(USERDATA_PREFIX);
+            if (ep->qos && dds_qget_userdata(ep->qos, &data, &size) && data &&
+                size > prefix && memcmp(data, USERDATA_PREFIX, prefix) == 0) {
+                // dds_qget_userdata adds a terminating 0
+                const char* value = static_cast<char*>(data) + prefix;
+                const char* origin = strstr(value, USERDATA_ORIGIN);
+                size_t n = std::min(origin ? static_cast<size_t>(origin - value) : strlen(value),
+                                    sizeof(e.service) - 1);
+                memcpy(e.service, value, n);
+                e.service[n] = '\0';
+                if (origin) e.origin_id = static_cast<int64_t>(strtoull(origin + strlen(USERDATA_ORIGIN), nullptr, 16));
+            }
+            dds_free(data);
+            dds_builtintopic_free_endpoint(ep);
+        }
+        resolve_clock(e);
+        entries_.push_back(e);
+        return entries_.back();
+    }
+
+private:
+    static constexpr size_t MAX_ENTRIES = 64;
+
+    // FNV-1a over the 16 GUID bytes
+    static uint64_t guid_id(const dds_guid_t& guid) {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char b : guid.v) h = (h ^ b) * 1099511628211ULL;
+        return h;
+    }
+
+    // Retried only when a new timesync peer appeared since the last miss
+    static void resolve_clock(Upstream& e) {
+        timesync::Sync& sync = timesync::Sync::instance();
+        size_t peers = sync.peer_count();
+        if (peers == e.clock_peers) return;
+        e.clock_peers = peers;
+        e.clock = sync.find(e.origin_id);
+    }
+
+    std::vector<Upstream> entries_;
+};
+
+/**
+ * Publishes this service's edge table: count, rate and latency quantiles of
+ * every edge active in the last interval.
+ */
+class Publisher {
+public:
+    static Publisher& instance() {
+        static Publisher publisher;
+        return publisher;
+    }
+
+    // Called once with the first participant a traced endpoint is created on
+    void start(dds_entity_t participant, const std::string& service_name) {
+        if (writer_ > 0 || !internal::g_enabled) return;
+        service_name_ = service_name;
+        interval_ms_ = static_cast<int>(runtime::internal::env_size("TRACED_TOPOLOGY_INTERVAL_MS", 5000));
+        if (interval_ms_ <= 0) interval_ms_ = 5000;
+
+        dds_entity_t topic = dds_create_topic(participant, &traced_ServiceTopology_desc,
+                                              TOPOLOGY_TOPIC, nullptr, nullptr);
+        if (topic < 0) return;
+        dds_qos_t* qos = create_qos();
+        writer_ = dds_create_writer(participant, topic, qos, nullptr);
+        dds_delete_qos(qos);
+        if (writer_ < 0) return;
+
+        runtime::ScopedPlacement publish_placement(runtime::Role::Exporter);
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~Publisher() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+    // Reliable, transient-local, last table per service: late joiners see the graph at once
+    static dds_qos_t* create_qos() {
+        dds_qos_t* qos = dds_create_qos();
+        dds_qset_reliability(qos, DDS_RELIABILITY_RELIABLE, DDS_SECS(1));
+        dds_qset_durability(qos, DDS_DURABILITY_TRANSIENT_LOCAL);
+        dds_qset_history(qos, DDS_HISTORY_KEEP_LAST, 1);
+        return qos;
+    }
+
+private:
+    // (topic, upstream service, kind)
+    using Key = std::tuple<std::string, std::string, uint8_t>;
+
+    struct Totals {
+        uint64_t count = 0;
+        uint64_t latency[LATENCY_BUCKETS] = {0};
+    };
+
+    Publisher() = default;
+
+    std::map<Key, Totals> merge() {
+        std::map<Key, Totals> merged;
+        for (internal::Shard* shard = internal::g_shards.load(std::memory_order_acquire);
+             shard; shard = shard->next) {
+            for (const internal::Edge& e : shard->edges) {
+                if (!e.used.load(std::memory_order_acquire)) continue;
+                Totals& t = merged[Key(e.topic, e.upstream, static_cast<uint8_t>(e.kind))];
+                t.count += e.count.load(std::memory_order_relaxed);
+                for (int i = 0; i < LATENCY_BUCKETS; i++) {
+                    t.latency[i] += e.latency[i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        return merged;
+    }
+
+    void publish() {
+        std::map<Key, Totals> current = merge();
+
+        // Strings stay owned by `current` until dds_write returns
+        std::vector<traced_TopologyEdge> edges;
+        for (const auto& entry : current) {
+            const Totals& now = entry.second;
+            Totals delta = now;
+            auto prev = previous_.find(entry.first);
+            if (prev != previous_.end()) {
+                delta.count -= prev->second.count;
+                for (int i = 0; i < LATENCY_BUCKETS; i++) delta.latency[i] -= prev->second.latency[i];
+            }
+            if (delta.count == 0) continue;
+
+            traced_TopologyEdge edge;
+            memset(&edge, 0, sizeof(edge));
+            edge.topic = const_cast<char*>(std::get<0>(entry.first).c_str());
+            edge.upstream_service = const_cast<char*>(std::get<1>(entry.first).c_str());
+            edge.kind = const_cast<char*>(edge_kind_name(static_cast<EdgeKind>(std::get<2>(entry.first))));
+            edge.count = static_cast<int64_t>(delta.count);
+            edge.rate_hz = delta.count * 1000.0 / interval_ms_;
+            edge.p50_ms = internal::quantile_ms(delta.latency, 0.50);
+            edge.p99_ms = internal::quantile_ms(delta.latency, 0.99);
+            edges.push_back(edge);
+        }
+
+        traced_ServiceTopology msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.service = const_cast<char*>(service_name_.c_str());
+        msg.timestamp_ns = dds_time();
+        msg.interval_ms = interval_ms_;
+        msg.edges._length = msg.edges._maximum = static_cast<uint32_t>(edges.size());
+        msg.edges._buffer = edges.data();
+        msg.edges._release = false;
+        dds_write(writer_, &msg);
+
+        previous_ = std::move(current);
+    }
+
+    void run() {
+        pthread_setname_np(pthread_self(), "topology");
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (wakeup_.wait_for(lock, std::chrono::milliseconds(interval_ms_),
+                                     [this]() { return stop_; })) {
+                    break;
+                }
+            }
+            publish();
+        }
+    }
+
+    std::string service_name_;
+    int interval_ms_ = 5000;
+    dds_entity_t writer_ = 0;
+    std::map<Key, Totals> previous_;
+
+    std::mutex mutex_;                  // publish thread wakeup only
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+/**
+ * Current system graph assembled from the services' edge tables. Services not
+ * heard from for three of their intervals drop out.
+ */
+class Graph {
+public:
+    struct Edge {
+        std::string upstream;
+        std::string service;
+        std::string topic;
+        std::string kind;
+        int64_t count;
+        double rate_hz;
+        double p50_ms;
+        double p99_ms;
+    };
+
+    void update(const traced_ServiceTopology& msg, int64_t now_ns) {
+        ServiceState& state = services_[msg.service ? msg.service : ""];
+        state.last_seen_ns = now_ns;
+        state.interval_ms = msg.interval_ms;
+        state.edges.clear();
+        for (uint32_t i = 0; i < msg.edges._length; i++) {
+            const traced_TopologyEdge& e = msg.edges._buffer[i];
+            state.edges.push_back({e.upstream_service ? e.upstream_service : "",
+                                   msg.service ? msg.service : "",
+                                   e.topic ? e.topic : "", e.kind ? e.kind : "",
+                                   e.count, e.rate_hz, e.p50_ms, e.p99_ms});
+        }
+    }
+
+    void expire(int64_t now_ns) {
+        for (auto it = services_.begin(); it != services_.end();) {
+            int64_t ttl = 3LL * it->second.interval_ms * 1000000LL;
+            if (now_ns - it->second.last_seen_ns > ttl) it = services_.erase(it);
+            else ++it;
+        }
+    }
+
+    std::vector<Edge> edges() const {
+        std::vector<Edge> out;
+        for (const auto& s : services_) out.insert(out.end(), s.second.edges.begin(), s.second.edges.end());
+        return out;
+    }
+
+    size_t service_count() const { return services_.size(); }
+
+    void print(FILE* out) const {
+        fprintf(out, "%-18s    %-18s %-22s %-5s %9s %9s %9s\n",
+                "upstream", "service", "topic", "kind", "rate/s", "p50 ms", "p99 ms");
+        for (const Edge& e : edges()) {
+            fprintf(out, "%-18s -> %-18s %-22s %-5s %9.1f %9.3f %9.3f\n",
+                    e.upstream.c_str(), e.service.c_str(), e.topic.c_str(), e.kind.c_str(),
+                    e.rate_hz, e.p50_ms, e.p99_ms);
+        }
+    }
+
+    void print_dot(FILE* out) const {
+        fprintf(out, "digraph traced {\n  rankdir=LR;\n");
+        for (const Edge& e : edges()) {
+            fprintf(out, "  \"%s\" -> \"%s\" [label=\"%s\\n%.1f/s p99 %.1fms\"%s];\n",
+                    e.upstream.c_str(), e.service.c_str(), e.topic.c_str(), e.rate_hz, e.p99_ms,
+                    e.kind == "link" ? " style=dashed" : "");
+        }
+        fprintf(out, "}\n");
+    }
+
+private:
+    struct ServiceState {
+        int64_t last_seen_ns = 0;
+        int32_t interval_ms = 5000;
+        std::vector<Edge> edges;
+    };
+
+    std::map<std::string, ServiceState> services_;
+};
+
+} // namespace topology
+} // namespace traced
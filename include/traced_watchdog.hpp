@@ -0,0 +1,678 @@
+// DDS Tracing Library - dispatch loop stall watchdog
+// A blocking callback (a sleep, a lock, an inline span export that hangs on
+// the collector) stops everything else its thread dispatches, and nothing
+// says so: samples just wait in the readers. Every Reader::take / lane pass
+// is a heartbeat of the thread running it, and a watchdog thread per
+// service checks the heartbeats and the readers' backlog:
+//
+//   stall   - a pass has been running longer than TRACED_WATCHDOG_STALL_MS.
+//             Reported once per stall as a loop-stall span, a child of the
+//             trace whose callback is blocked (so it shows up inside the
+//             slow trace), with the topic, every reader's backlog and,
+//             with TRACED_WATCHDOG_STACKS=1, the thread's stack.
+//   backlog - the oldest untaken sample of a reader is older than
+//             TRACED_WATCHDOG_BACKLOG_MS without a stalled pass: the loop
+//             does not come round often enough. Reported once per episode
+//             as a reader-backlog span.
+//
+// Configuration via environment variables:
+//   TRACED_WATCHDOG                  - "0" disables the watchdog
+//   TRACED_WATCHDOG_STALL_MS         - pass duration reported as a stall (default: 1000)
+//   TRACED_WATCHDOG_BACKLOG_MS       - backlog age reported (default: 5000)
+//   TRACED_WATCHDOG_STACKS           - "1" samples the stalled thread's stack (default: off)
+//   TRACED_LOOP_METRICS              - "1" exports the metrics below over OTLP
+//   TRACED_LOOP_METRICS_INTERVAL_MS  - export interval (default: 10000)
+//
+// Span attributes: loop.thread, loop.stall_ms, messaging.destination.name
+// (topic of the blocked pass), loop.stack (one frame per line; without
+// -rdynamic as binary(+offset), for addr2line), and one dds.backlog event
+// per reader with messaging.destination.name, messaging.dds.lane,
+// backlog.samples (counted up to 256) and backlog.age_ms.
+//
+// The stack is sampled by signalling the stalled thread (SIGRTMIN+3); the
+// thread resumes right after, but a sleep it was blocked in returns early,
+// which changes the timing of the code being diagnosed. Hence opt-in.
+//
+// Metrics (cumulative), attributes service.name and loop.thread or topic:
+//   traced.loop.lag          - histogram, duration of each pass that took
+//                              samples, in ms: how long the thread kept its
+//                              other readers waiting (+ messaging.destination.name)
+//   traced.loop.stalls       - counter, stalls reported (+ messaging.destination.name)
+//   traced.reader.backlog_age - histogram, age of the oldest untaken sample
+//                              at each check, in ms (+ messaging.dds.lane)
+
+#pragma once
+
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "dds/dds.h"
+#include "opentelemetry/trace/provider.h"
+#include "traced_runtime.hpp"
+#include "traced_recorder.hpp"
+#include "traced_metrics.hpp"
+#include "traced_config.hpp"
+
+namespace traced {
+namespace watchdog {
+
+namespace trace_api = opentelemetry::trace;
+namespace metrics_sdk = opentelemetry::sdk::metrics;
+namespace otlp = opentelemetry::exporter::otlp;
+namespace resource = opentelemetry::sdk::resource;
+
+inline constexpr int MAX_LOOPS = 32;
+inline constexpr int TOPICS_PER_LOOP = 16;
+inline constexpr int MAX_FRAMES = 32;
+inline constexpr int BACKLOG_READ = 256;
+
+namespace internal {
+
+inline int64_t mono_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Histogram over metrics::BUCKET_BOUNDS_NS with a single writer
+struct Histogram {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum_ns{0};
+    std::atomic<int64_t> max_ns{0};
+    std::atomic<uint64_t> buckets[metrics::BUCKET_COUNT + 1];
+
+    Histogram() {
+        for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+    }
+
+    void record(int64_t ns) {
+        if (ns < 0) ns = 0;
+        metrics::internal::bump(count, 1);
+        metrics::internal::bump(sum_ns, static_cast<uint64_t>(ns));
+        metrics::internal::bump(buckets[metrics::internal::bucket_index(ns)], 1);
+        if (ns > max_ns.load(std::memory_order_relaxed)) max_ns.store(ns, std::memory_order_relaxed);
+    }
+};
+
+// Passes of one thread over one topic. The topic is written once before
+// `used` is published.
+struct Series {
+    std::atomic<bool> used{false};
+    char topic[64];
+    Histogram lag;
+    std::atomic<uint64_t> stalls{0};    // counted by the watchdog thread
+};
+
+// One dispatching thread. busy_since_ns, topic and the trace context are
+// written by the owning thread and read by the watchdog.
+struct Loop {
+    pthread_t thread;
+    char name[16];
+    std::atomic<int64_t> busy_since_ns{0};      // 0: not in a pass
+    std::atomic<Series*> series{nullptr};       // of the running pass
+    Series topics[TOPICS_PER_LOOP];
+    Series other;                               // topics that did not fit
+
+    // Trace context of the running callback, behind a seqlock
+    std::atomic<uint32_t> ctx_seq{0};
+    std::atomic<uint64_t> trace_hi{0};
+    std::atomic<uint64_t> trace_lo{0};
+    std::atomic<uint64_t> span_id{0};
+    std::atomic<uint8_t> trace_flags{0};
+
+    // Stack sample, filled by the signal handler on this thread
+    void* frames[MAX_FRAMES];
+    std::atomic<int> frame_count{-1};
+
+    int64_t reported_since_ns = 0;              // watchdog thread only
+};
+
+inline Loop g_loops[MAX_LOOPS];
+inline std::atomic<int> g_loop_count{0};
+inline thread_local Loop* t_loop = nullptr;
+inline thread_local bool t_loop_full = false;
+inline bool g_enabled = false;
+inline std::atomic<Loop*> g_sampling{nullptr};  // loop whose stack is requested
+
+inline Loop* local_loop() {
+    if (t_loop || t_loop_full) return t_loop;
+    int idx = g_loop_count.load(std::memory_order_relaxed);
+    while (idx < MAX_LOOPS && !g_loop_count.compare_exchange_weak(idx, idx + 1)) {}
+    if (idx >= MAX_LOOPS) {
+        t_loop_full = true;
+        return nullptr;
+    }
+    Loop* loop = &g_loops[idx];
+    loop->thread = pthread_self();
+    if (pthread_getname_np(loop->thread, loop->name, sizeof(loop->name)) != 0) {
+        snprintf(loop->name, sizeof(loop->name), "thread-%d", idx);
+    }
+    t_loop = loop;
+    return loop;
+}
+
+inline Series* find_series(Loop* loop, const char* topic) {
+    Series* current = loop->series.load(std::memory_order_relaxed);
+    if (current && strcmp(current->topic, topic) == 0) return current;
+    for (Series& s : loop->topics) {
+        if (!s.used.load(std::memory_order_relaxed)) {
+            snprintf(s.topic, sizeof(s.topic), "%s", topic);
+            s.used.store(true, std::memory_order_release);
+            return &s;
+        }
+        if (strcmp(s.topic, topic) == 0) return &s;
+    }
+    return &loop->other;
+}
+
+inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+inline void store_be64(uint64_t v, uint8_t* p) {
+    for (int i = 7; i >= 0; i--, v >>= 8) p[i] = static_cast<uint8_t>(v);
+}
+
+inline void on_sample_signal(int) {
+    Loop* loop = g_sampling.load(std::memory_order_acquire);
+    if (!loop || !pthread_equal(loop->thread, pthread_self())) return;
+    loop->frame_count.store(backtrace(loop->frames, MAX_FRAMES), std::memory_order_release);
+}
+
+} // namespace internal
+
+inline bool enabled() { return internal::g_enabled; }
+
+/**
+ * One Reader take pass: the heartbeat of the calling thread. Passes may
+ * nest (a callback taking from another reader); the outer one is restored.
+ */
+class Pass {
+public:
+    explicit Pass(const char* topic) {
+        if (!internal::g_enabled) return;
+        loop_ = internal::local_loop();
+        if (!loop_) return;
+        started_ns_ = internal::mono_ns();
+        outer_series_ = loop_->series.load(std::memory_order_relaxed);
+        outer_since_ns_ = loop_->busy_since_ns.load(std::memory_order_relaxed);
+        series_ = internal::find_series(loop_, topic);
+        loop_->series.store(series_, std::memory_order_relaxed);
+        if (outer_since_ns_ == 0) loop_->busy_since_ns.store(started_ns_, std::memory_order_release);
+    }
+
+    ~Pass() { finish(); }
+
+    Pass(const Pass&) = delete;
+    Pass& operator=(const Pass&) = delete;
+
+    // End the pass before the scope does, e.g. ahead of the loop's sleep
+    void finish() {
+        if (!loop_) return;
+        if (taken_) series_->lag.record(internal::mono_ns() - started_ns_);
+        if (outer_since_ns_ == 0) {
+            set_context(trace_api::SpanContext::GetInvalid());
+            loop_->busy_since_ns.store(0, std::memory_order_release);
+        }
+        loop_->series.store(outer_series_, std::memory_order_relaxed);
+        loop_ = nullptr;
+    }
+
+    void taken(int n) { taken_ = n > 0; }
+
+    // Trace context of the callback about to run
+    void set_context(const trace_api::SpanContext& ctx) {
+        if (!loop_) return;
+        uint8_t trace_id[16] = {0};
+        uint8_t span_id[8] = {0};
+        if (ctx.IsValid()) {
+            memcpy(trace_id, ctx.trace_id().Id().data(), sizeof(trace_id));
+            memcpy(span_id, ctx.span_id().Id().data(), sizeof(span_id));
+        }
+        uint32_t seq = loop_->ctx_seq.load(std::memory_order_relaxed);
+        loop_->ctx_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        loop_->trace_hi.store(internal::load_be64(trace_id), std::memory_order_relaxed);
+        loop_->trace_lo.store(internal::load_be64(trace_id + 8), std::memory_order_relaxed);
+        loop_->span_id.store(internal::load_be64(span_id), std::memory_order_relaxed);
+        loop_->trace_flags.store(ctx.IsValid() ? ctx.trace_flags().flags() : 0, std::memory_order_relaxed);
+        loop_->ctx_seq.store(seq + 2, std::memory_order_release);
+    }
+
+private:
+    internal::Loop* loop_ = nullptr;
+    internal::Series* series_ = nullptr;
+    internal::Series* outer_series_ = nullptr;
+    int64_t outer_since_ns_ = 0;
+    int64_t started_ns_ = 0;
+    bool taken_ = false;
+};
+
+/**
+ * A DDS reader whose backlog the watchdog follows
+ */
+struct Backlog {
+    std::atomic<dds_entity_t> reader{0};    // 0 once removed; read by the watchdog unlocked
+    std::string topic;
+    const char* lane;
+    internal::Histogram age;
+    bool reported = false;          // watchdog thread only
+};
+
+/**
+ * Stall and backlog checks plus the loop metrics export
+ */
+class Watchdog {
+public:
+    static Watchdog& instance() {
+        static Watchdog watchdog;
+        return watchdog;
+    }
+
+    // Called once from traced::internal::do_init
+    void start(const std::string& service_name, const std::string& traces_endpoint) {
+        if (started_ || !recorder::internal::env_flag("TRACED_WATCHDOG", true)) return;
+        started_ = true;
+        service_name_ = service_name;
+        stall_ns_ = static_cast<int64_t>(runtime::internal::env_size("TRACED_WATCHDOG_STALL_MS", 1000)) * 1000000;
+        backlog_ns_ = static_cast<int64_t>(runtime::internal::env_size("TRACED_WATCHDOG_BACKLOG_MS", 5000)) * 1000000;
+        if (stall_ns_ <= 0) stall_ns_ = 1000000000;
+        if (backlog_ns_ <= 0) backlog_ns_ = 5000000000LL;
+        check_ns_ = std::max<int64_t>(stall_ns_ / 4, 10000000);
+
+        if (recorder::internal::env_flag("TRACED_WATCHDOG_STACKS", false)) {
+            // backtrace() loads libgcc on first use; not in a signal handler
+            void* frame;
+            backtrace(&frame, 1);
+            struct sigaction old_action;
+            int sig = SIGRTMIN + 3;
+            if (sigaction(sig, nullptr, &old_action) == 0 && old_action.sa_handler == SIG_DFL) {
+                struct sigaction action;
+                memset(&action, 0, sizeof(action));
+                action.sa_handler = internal::on_sample_signal;
+                sigemptyset(&action.sa_mask);
+                action.sa_flags = SA_RESTART;
+                sigaction(sig, &action, nullptr);
+                stack_signal_ = sig;
+            }
+        }
+
+        if (recorder::internal::env_flag("TRACED_LOOP_METRICS", false)) {
+            export_interval_ns_ = static_cast<int64_t>(
+                runtime::internal::env_size("TRACED_LOOP_METRICS_INTERVAL_MS", 10000)) * 1000000;
+            if (export_interval_ns_ <= 0) export_interval_ns_ = 10000000000LL;
+            otlp::OtlpHttpMetricExporterOptions opts;
+            opts.url = metrics::metrics_endpoint(traces_endpoint);
+            opts.aggregation_temporality = otlp::PreferredAggregationTemporality::kCumulative;
+            exporter_ = otlp::OtlpHttpMetricExporterFactory::Create(opts);
+            resource_ = std::make_unique<resource::Resource>(resource::Resource::Create({
+                {"service.name", service_name_},
+                {"service.version", "1.0.0"}
+            }));
+            scope_ = opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create(
+                "traced.loop", "1.0.0");
+            start_time_ = std::chrono::system_clock::now();
+            printf("[traced] Loop metrics every %lldms -> %s\n",
+                   (long long)(export_interval_ns_ / 1000000), opts.url.c_str());
+        }
+
+        printf("[traced] Watchdog: stalls over %lldms, backlogs over %lldms%s\n",
+               (long long)(stall_ns_ / 1000000), (long long)(backlog_ns_ / 1000000),
+               stack_signal_ ? ", with stacks" : "");
+        internal::g_enabled = true;
+        {
+            runtime::ScopedPlacement watchdog_placement(runtime::Role::Exporter);
+            thread_ = std::thread([this]() { run(); });
+        }
+    }
+
+    ~Watchdog() {
+        if (!thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+    /**
+     * Follow a DDS reader's backlog; nullptr while the watchdog is off
+     */
+    Backlog* add(dds_entity_t reader, const std::string& topic, const char* lane) {
+        if (!started_) return nullptr;
+        auto backlog = std::make_unique<Backlog>();
+        backlog->reader.store(reader, std::memory_order_relaxed);
+        backlog->topic = topic;
+        backlog->lane = lane;
+        std::lock_guard<std::mutex> lock(mutex_);
+        backlogs_.push_back(std::move(backlog));
+        return backlogs_.back().get();
+    }
+
+    // Before the reader is deleted; the entry keeps its histogram
+    void remove(Backlog* backlog) {
+        if (!backlog) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        backlog->reader.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Snapshot {
+        const Backlog* backlog;
+        int samples;
+        int64_t age_ns;
+    };
+
+    Watchdog() = default;
+
+    std::vector<Backlog*> backlogs() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<Backlog*> out;
+        for (auto& b : backlogs_) {
+            if (b->reader.load(std::memory_order_relaxed)) out.push_back(b.get());
+        }
+        return out;
+    }
+
+    // Untaken samples (up to BACKLOG_READ) and the age of the oldest, by
+    // source timestamp. Reading leaves them for the owner's take.
+    static Snapshot measure(const Backlog* backlog, int max_samples) {
+        Snapshot snap{backlog, 0, 0};
+        // Skip a reader removed since the list was taken. One deleted after
+        // this load only fails dds_read: CycloneDDS checks every handle.
+        dds_entity_t reader = backlog->reader.load(std::memory_order_relaxed);
+        if (!reader) return snap;
+        void* samples[BACKLOG_READ] = {nullptr};
+        dds_sample_info_t infos[BACKLOG_READ];
+        dds_return_t n = dds_read(reader, samples, infos, max_samples, max_samples);
+        if (n <= 0) return snap;
+        dds_time_t now = dds_time();
+        for (int i = 0; i < n; i++) {
+            if (!infos[i].valid_data) continue;
+            snap.samples++;
+            snap.age_ns = std::max<int64_t>(snap.age_ns, now - infos[i].source_timestamp);
+        }
+        dds_return_loan(reader, samples, n);
+        return snap;
+    }
+
+    trace_api::SpanContext context(const internal::Loop& loop) const {
+        uint32_t seq;
+        uint8_t trace_id[16];
+        uint8_t span_id[8];
+        uint8_t flags;
+        do {
+            seq = loop.ctx_seq.load(std::memory_order_acquire);
+            internal::store_be64(loop.trace_hi.load(std::memory_order_relaxed), trace_id);
+            internal::store_be64(loop.trace_lo.load(std::memory_order_relaxed), trace_id + 8);
+            internal::store_be64(loop.span_id.load(std::memory_order_relaxed), span_id);
+            flags = loop.trace_flags.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || seq != loop.ctx_seq.load(std::memory_order_relaxed));
+        return trace_api::SpanContext(trace_api::TraceId(trace_id), trace_api::SpanId(span_id),
+                                      trace_api::TraceFlags(flags), false);
+    }
+
+    // Frames of the stalled thread, one per line; empty if it did not answer
+    std::string sample_stack(internal::Loop& loop) {
+        if (!stack_signal_) return "";
+        loop.frame_count.store(-1, std::memory_order_relaxed);
+        internal::g_sampling.store(&loop, std::memory_order_release);
+        std::string out;
+        if (pthread_kill(loop.thread, stack_signal_) == 0) {
+            for (int i = 0; i < 50 && loop.frame_count.load(std::memory_order_acquire) < 0; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            int n = loop.frame_count.load(std::memory_order_acquire);
+            if (n > 0) {
+                char** symbols = backtrace_symbols(loop.frames, n);
+                // Frame 0 is the handler, 1 the signal trampoline
+                for (int i = 2; symbols && i < n; i++) {
+                    out += symbols[i];
+                    out += '\n';
+                }
+                free(symbols);
+            }
+        }
+        internal::g_sampling.store(nullptr, std::memory_order_release);
+        return out;
+    }
+
+    void add_backlog_events(trace_api::Span& span, const std::vector<Snapshot>& snapshots) {
+        for (const Snapshot& s : snapshots) {
+            span.AddEvent("dds.backlog", {
+                {"messaging.destination.name", s.backlog->topic.c_str()},
+                {"messaging.dds.lane", s.backlog->lane},
+                {"backlog.samples", static_cast<int64_t>(s.samples)},
+                {"backlog.age_ms", s.age_ns / 1000000}});
+        }
+    }
+
+    std::vector<Snapshot> snapshot_all(const std::vector<Backlog*>& readers) {
+        std::vector<Snapshot> out;
+        for (Backlog* b : readers) out.push_back(measure(b, BACKLOG_READ));
+        return out;
+    }
+
+    void report_stall(internal::Loop& loop, int64_t since_ns, int64_t now_ns,
+                      const std::vector<Backlog*>& readers) {
+        internal::Series* series = loop.series.load(std::memory_order_relaxed);
+        const char* topic = series ? series->topic : "";
+        if (series) series->stalls.fetch_add(1, std::memory_order_relaxed);
+        int64_t stalled_ns = now_ns - since_ns;
+        std::string stack = sample_stack(loop);
+        trace_api::SpanContext blocked = context(loop);
+
+        trace_api::StartSpanOptions opts;
+        opts.start_system_time = opentelemetry::common::SystemTimestamp(
+            std::chrono::system_clock::now() - std::chrono::nanoseconds(stalled_ns));
+        if (blocked.trace_id().IsValid()) opts.parent = blocked;
+        auto span = tracer()->StartSpan("loop-stall", opts);
+        span->SetAttribute("loop.thread", loop.name);
+        span->SetAttribute("loop.stall_ms", stalled_ns / 1000000);
+        span->SetAttribute("messaging.destination.name", topic);
+        if (!stack.empty()) span->SetAttribute("loop.stack", stack);
+        add_backlog_events(*span, snapshot_all(readers));
+        span->End();
+
+        if (config::log_enabled(config::LogLevel::Info)) {
+            char trace_hex[33] = "";
+            if (blocked.trace_id().IsValid()) {
+                blocked.trace_id().ToLowerBase16(opentelemetry::nostd::span<char, 32>(trace_hex, 32));
+            }
+            fprintf(stderr, "[traced] Thread %s stalled %lldms in %s%s%s\n", loop.name,
+                    (long long)(stalled_ns / 1000000), topic, trace_hex[0] ? ", trace " : "", trace_hex);
+        }
+    }
+
+    void report_backlog(const Backlog& backlog, int64_t age_ns, const std::vector<Backlog*>& readers) {
+        auto span = tracer()->StartSpan("reader-backlog");
+        span->SetAttribute("messaging.destination.name", backlog.topic.c_str());
+        span->SetAttribute("messaging.dds.lane", backlog.lane);
+        span->SetAttribute("backlog.age_ms", age_ns / 1000000);
+        add_backlog_events(*span, snapshot_all(readers));
+        span->End();
+        TRACED_LOG(Info, "[traced] %s backlog %lldms old\n", backlog.topic.c_str(), (long long)(age_ns / 1000000));
+    }
+
+    void check() {
+        int64_t now = internal::mono_ns();
+        std::vector<Backlog*> readers = backlogs();
+        bool stalled = false;
+        int loops = std::min(internal::g_loop_count.load(std::memory_order_acquire), MAX_LOOPS);
+        for (int i = 0; i < loops; i++) {
+            internal::Loop& loop = internal::g_loops[i];
+            int64_t since = loop.busy_since_ns.load(std::memory_order_acquire);
+            if (since == 0 || now - since < stall_ns_) continue;
+            stalled = true;
+            if (loop.reported_since_ns == since) continue;
+            loop.reported_since_ns = since;
+            report_stall(loop, since, now, readers);
+        }
+
+        // The oldest sample only: one deserialization per reader and check
+        for (Backlog* b : readers) {
+            Snapshot snap = measure(b, 1);
+            if (snap.samples > 0) b->age.record(snap.age_ns);
+            if (snap.age_ns < backlog_ns_) {
+                b->reported = false;
+            } else if (!b->reported && !stalled) {
+                b->reported = true;
+                report_backlog(*b, snap.age_ns, readers);
+            }
+        }
+    }
+
+    opentelemetry::nostd::shared_ptr<trace_api::Tracer> tracer() {
+        return trace_api::Provider::GetTracerProvider()->GetTracer(service_name_, "1.0.0");
+    }
+
+    static metrics_sdk::HistogramPointData histogram(const internal::Histogram& h) {
+        metrics_sdk::HistogramPointData hist;
+        for (int64_t bound : metrics::BUCKET_BOUNDS_NS) hist.boundaries_.push_back(bound / 1e6);
+        for (const auto& b : h.buckets) hist.counts_.push_back(b.load(std::memory_order_relaxed));
+        hist.count_ = h.count.load(std::memory_order_relaxed);
+        hist.sum_ = h.sum_ns.load(std::memory_order_relaxed) / 1e6;
+        hist.min_ = 0.0;
+        hist.max_ = h.max_ns.load(std::memory_order_relaxed) / 1e6;
+        hist.record_min_max_ = false;
+        return hist;
+    }
+
+    metrics_sdk::ResourceMetrics collect() {
+        opentelemetry::common::SystemTimestamp start(start_time_);
+        opentelemetry::common::SystemTimestamp now(std::chrono::system_clock::now());
+        auto metric = [&](const char* name, const char* description, const char* unit,
+                          metrics_sdk::InstrumentType type) {
+            metrics_sdk::MetricData data;
+            data.instrument_descriptor = {name, description, unit, type,
+                                          type == metrics_sdk::InstrumentType::kCounter
+                                              ? metrics_sdk::InstrumentValueType::kLong
+                                              : metrics_sdk::InstrumentValueType::kDouble};
+            data.aggregation_temporality = metrics_sdk::AggregationTemporality::kCumulative;
+            data.start_ts = start;
+            data.end_ts = now;
+            return data;
+        };
+        metrics_sdk::MetricData lag = metric("traced.loop.lag", "Duration of dispatch passes that took samples",
+                                             "ms", metrics_sdk::InstrumentType::kHistogram);
+        metrics_sdk::MetricData stalls = metric("traced.loop.stalls", "Dispatch passes reported as stalled",
+                                                "{stall}", metrics_sdk::InstrumentType::kCounter);
+        metrics_sdk::MetricData backlog_age = metric("traced.reader.backlog_age", "Age of the oldest untaken sample",
+                                                     "ms", metrics_sdk::InstrumentType::kHistogram);
+
+        int loops = std::min(internal::g_loop_count.load(std::memory_order_acquire), MAX_LOOPS);
+        for (int i = 0; i < loops; i++) {
+            internal::Loop& loop = internal::g_loops[i];
+            auto add = [&](const internal::Series& s, const char* topic) {
+                if (s.lag.count.load(std::memory_order_relaxed) == 0 &&
+                    s.stalls.load(std::memory_order_relaxed) == 0) return;
+                metrics_sdk::PointAttributes attrs;
+                attrs.SetAttribute("service.name", service_name_);
+                attrs.SetAttribute("loop.thread", loop.name);
+                attrs.SetAttribute("messaging.destination.name", topic);
+                lag.point_data_attr_.push_back({attrs, histogram(s.lag)});
+                metrics_sdk::SumPointData sum;
+                sum.value_ = static_cast<int64_t>(s.stalls.load(std::memory_order_relaxed));
+                sum.is_monotonic_ = true;
+                stalls.point_data_attr_.push_back({attrs, sum});
+            };
+            for (const internal::Series& s : loop.topics) {
+                if (s.used.load(std::memory_order_acquire)) add(s, s.topic);
+            }
+            add(loop.other, "other");
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& b : backlogs_) {
+                if (b->age.count.load(std::memory_order_relaxed) == 0) continue;
+                metrics_sdk::PointAttributes attrs;
+                attrs.SetAttribute("service.name", service_name_);
+                attrs.SetAttribute("messaging.destination.name", b->topic);
+                attrs.SetAttribute("messaging.dds.lane", b->lane);
+                backlog_age.point_data_attr_.push_back({attrs, histogram(b->age)});
+            }
+        }
+
+        metrics_sdk::ScopeMetrics scope_metrics;
+        scope_metrics.scope_ = scope_.get();
+        scope_metrics.metric_data_.push_back(std::move(lag));
+        scope_metrics.metric_data_.push_back(std::move(stalls));
+        scope_metrics.metric_data_.push_back(std::move(backlog_age));
+
+        metrics_sdk::ResourceMetrics out;
+        out.resource_ = resource_.get();
+        out.scope_metric_data_.push_back(std::move(scope_metrics));
+        return out;
+    }
+
+    void export_metrics() {
+        auto result = exporter_->Export(collect());
+        bool ok = result == opentelemetry::sdk::common::ExportResult::kSuccess;
+        if (!ok && !export_failed_) {
+            fprintf(stderr, "[traced] Loop metrics export failed (is the endpoint an OTLP metrics receiver?)\n");
+        }
+        export_failed_ = !ok;
+    }
+
+    void run() {
+        pthread_setname_np(pthread_self(), "watchdog");
+        int64_t next_export = internal::mono_ns() + export_interval_ns_;
+        bool stopping = false;
+        while (!stopping) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wakeup_.wait_for(lock, std::chrono::nanoseconds(check_ns_), [this]() { return stop_; });
+                stopping = stop_;
+            }
+            check();
+            if (exporter_ && (stopping || internal::mono_ns() >= next_export)) {
+                export_metrics();
+                next_export += export_interval_ns_;
+            }
+        }
+        if (exporter_) exporter_->Shutdown();
+    }
+
+    bool started_ = false;
+    std::string service_name_;
+    int64_t stall_ns_ = 1000000000;
+    int64_t backlog_ns_ = 5000000000LL;
+    int64_t check_ns_ = 250000000;
+    int stack_signal_ = 0;
+
+    int64_t export_interval_ns_ = 0;
+    std::chrono::system_clock::time_point start_time_;
+    std::unique_ptr<metrics_sdk::PushMetricExporter> exporter_;
+    std::unique_ptr<resource::Resource> resource_;
+    std::unique_ptr<opentelemetry::sdk::instrumentationscope::InstrumentationScope> scope_;
+    bool export_failed_ = false;
+
+    std::mutex mutex_;                  // backlog list and thread wakeup
+    std::condition_variable wakeup_;
+    bool stop_ = false;
+    std::thread thread_;
+    std::vector<std::unique_ptr<Backlog>> backlogs_;
+};
+
+} // namespace watchdog
+} // namespace traced
@@ -11,6 +11,10 @@
 #include "CombatMessages.h"
 
 TRACED_DDS_TYPE(combat_MissionOrder);
+TRACED_DDS_TYPE(combat_CombatAlert);
+TRACED_DDS_FIELD(combat_MissionOrder, priority);
+TRACED_DDS_FIELD(combat_MissionOrder, mission_type);
+TRACED_DDS_FIELD(combat_MissionOrder, mission_id);
 
 #define SERVICE_NAME "command-center"
 
@@ -22,6 +26,17 @@ static const char* ZONES[] = {"Alpha", "Bravo", "Charlie", "Delta"};
 
 void handle_signal(int sig) { running = 0; }
 
+void handle_alert(combat_CombatAlert& alert, traced::trace_api::Span& span) {
+    span.SetAttribute("alert.type", alert.alert_type ? alert.alert_type : "");
+    span.SetAttribute("alert.severity", alert.severity ? alert.severity : "");
+
+    TRACED_LOG(Info, "[ALERT] %s | %s | Zone: %s | %s\n",
+                     alert.severity ? alert.severity : "?",
+                     alert.alert_type ? alert.alert_type : "?",
+                     alert.affected_zone ? alert.affected_zone : "?",
+                     alert.message ? alert.message : "");
+}
+
 int main() {
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
@@ -38,6 +53,10 @@ int main() {
     // Traced writer - handles trace injection automatically
     auto writer = TRACED_WRITER(combat_MissionOrder, participant, "MissionOrderTopic");
 
+    // Urgent alerts get a dedicated receive thread, the rest is polled below
+    auto alert_reader = TRACED_READER(combat_CombatAlert, participant, "CombatAlertTopic");
+    alert_reader.serve_lane(traced::Lane::Urgent, "receive-urgent-alert", handle_alert);
+
     printf("[%s] DDS connected, waiting for discovery...\n", SERVICE_NAME);
     sleep(3);
 
@@ -82,10 +101,12 @@ int main() {
 
         // Write with automatic trace injection
         if (writer.write(msg, "issue-mission")) {
-            printf("[ORDER] %s | Zone: %s | Priority: %s | ID: %s\n",
-                   mission_type, zone, priority, mission_id);
+            TRACED_LOG(Messages, "[ORDER] %s | Zone: %s | Priority: %s | ID: %s\n",
+                                 mission_type, zone, priority, mission_id);
         }
 
+        alert_reader.take("receive-alert", handle_alert);
+
         sequence++;
         sleep(3);
     }
@@ -11,6 +11,7 @@
 #include "CombatMessages.h"
 
 TRACED_DDS_TYPE(combat_SourceTrack);
+TRACED_DDS_FIELD(combat_SourceTrack, classification);
 
 #define SERVICE_NAME "esm-sensor"
 #define SENSOR_ID "ESM-2"
@@ -24,6 +25,15 @@ int main() {
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
 
+    // Overridable to run many instances side by side (tools/scale-harness)
+    const char* sensor_id = getenv("SENSOR_ID");
+    if (!sensor_id) sensor_id = SENSOR_ID;
+    const char* interval = getenv("SENSOR_INTERVAL_MS");
+    int interval_ms = interval ? atoi(interval) : 2000;
+    // Targets followed: detections cycle through their IDs (0 = new ID every time)
+    const char* tracks = getenv("SENSOR_TRACKS");
+    int num_tracks = tracks ? atoi(tracks) : 0;
+
     printf("[%s] Starting ESM sensor...\n", SERVICE_NAME);
 
     dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
@@ -55,12 +65,13 @@ int main() {
 
     while (running) {
         char track_id[32];
-        snprintf(track_id, sizeof(track_id), "E-%d", track_num);
+        snprintf(track_id, sizeof(track_id), "E-%d",
+                 num_tracks > 0 ? (track_num - 1) % num_tracks + 1 : track_num);
 
         combat_SourceTrack msg;
         memset(&msg, 0, sizeof(msg));
 
-        msg.sensor_id = (char*)SENSOR_ID;
+        msg.sensor_id = (char*)sensor_id;
         msg.sensor_type = (char*)SENSOR_TYPE;
         msg.timestamp_ns = time(NULL) * 1000000000LL;
         msg.source_track_id = track_id;
@@ -72,14 +83,14 @@ int main() {
         msg.confidence = conf_dis(gen);
         msg.classification = (char*)classifications[class_dis(gen)];
 
-        if (writer.write(msg, "esm-detect")) {
-            printf("[ESM] Track %s | Pos: %.2f, %.2f | Alt: %.0fm | Conf: %.2f\n",
-                   track_id, msg.position_lat, msg.position_lon, 
-                   msg.altitude_m, msg.confidence);
+        if (writer.write_keyed(msg, track_id, "esm-detect")) {
+            TRACED_LOG(Messages, "[ESM] Track %s | Pos: %.2f, %.2f | Alt: %.0fm | Conf: %.2f\n",
+                                 track_id, msg.position_lat, msg.position_lon, 
+                                 msg.altitude_m, msg.confidence);
         }
 
         track_num++;
-        sleep(2);
+        usleep(interval_ms * 1000);
     }
 
     printf("[%s] Shutting down...\n", SERVICE_NAME);
@@ -0,0 +1,390 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "traced_dds.hpp"
+
+// Round-trip probe: pings the echo responder of every traced service
+// (traced_echo.hpp) through each QoS profile and payload size, independent
+// of business traffic.
+//
+// Environment:
+//   PROBE_PROFILES            - comma-separated echo profiles (default: all)
+//   PROBE_PAYLOAD_SIZES       - comma-separated payload bytes (default: 64,1024,16384)
+//   PROBE_INTERVAL_MS         - ping interval per profile and size (default: 1000)
+//   PROBE_REPORT_INTERVAL_MS  - metrics export and summary interval (default: 10000)
+//   PROBE_METRICS             - "0" disables the OTLP metrics export
+//   PROBE_SPANS               - "0" disables the probe-rtt spans
+
+#define SERVICE_NAME "latency-probe"
+#define MAX_PAYLOAD_SIZES 8
+
+namespace metrics_sdk = opentelemetry::sdk::metrics;
+
+static volatile sig_atomic_t running = 1;
+
+void handle_signal(int sig) { running = 0; }
+
+static const double RTT_BOUNDS_MS[] = {0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 50, 100, 250, 1000};
+#define RTT_BUCKETS (sizeof(RTT_BOUNDS_MS) / sizeof(RTT_BOUNDS_MS[0]))
+
+// Round trips of one (peer, profile, payload size)
+struct PeerStats {
+    uint64_t replies = 0;
+    int32_t first_sequence = -1;
+    int32_t last_sequence = -1;
+    double sum_ms = 0.0;
+    double min_ms = 0.0;
+    double max_ms = 0.0;
+    double jitter_ms = 0.0;         // RFC 3550 interarrival jitter of the RTT
+    double last_ms = -1.0;
+    double responder_sum_ms = 0.0;  // request taken -> reply written, inside the responder
+    uint64_t buckets[RTT_BUCKETS + 1] = {0};
+
+    // Gaps in the replied sequence numbers; a trailing loss shows up with the next reply
+    uint64_t lost() const {
+        if (replies == 0) return 0;
+        uint64_t expected = (uint64_t)(last_sequence - first_sequence + 1);
+        return expected > replies ? expected - replies : 0;
+    }
+};
+
+// A reply waiting for its span; spans are exported from the main loop, never
+// from the listener thread the next reply is timestamped on
+struct RoundTrip {
+    std::string peer;
+    std::string profile;
+    uint32_t payload_bytes;
+    int32_t sequence;
+    int64_t sent_ns;
+    int64_t replied_ns;     // local clock
+    int64_t responder_ns;
+};
+
+// (peer, profile, payload bytes)
+typedef std::tuple<std::string, std::string, uint32_t> StatsKey;
+
+static std::mutex stats_mutex;
+static std::map<StatsKey, PeerStats> stats;
+static std::vector<RoundTrip> pending_spans;
+static bool spans_enabled = true;
+static int64_t probe_id = 0;
+
+static size_t env_list_sizes(const char* name, const char* fallback, uint32_t* out, size_t max) {
+    const char* value = getenv(name);
+    std::string list = value ? value : fallback;
+    size_t n = 0;
+    for (const char* p = list.c_str(); *p && n < max;) {
+        long size = strtol(p, NULL, 10);
+        if (size >= 0) out[n++] = (uint32_t)size;
+        const char* comma = strchr(p, ',');
+        if (!comma) break;
+        p = comma + 1;
+    }
+    return n;
+}
+
+static long env_long(const char* name, long fallback) {
+    const char* value = getenv(name);
+    return value && atol(value) > 0 ? atol(value) : fallback;
+}
+
+static void on_reply(dds_entity_t reader, void*) {
+    void* samples[16];
+    dds_sample_info_t infos[16];
+    while (true) {
+        samples[0] = NULL;  // loan from DDS
+        dds_return_t n = dds_take(reader, samples, infos, 16, 16);
+        int64_t received = dds_time();
+        if (n <= 0) break;
+
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        for (int i = 0; i < n; i++) {
+            if (!infos[i].valid_data) continue;
+            const traced_EchoSample& reply = *(traced_EchoSample*)samples[i];
+            if (reply.probe_id != probe_id || !reply.responder_service || !reply.profile) continue;
+
+            double rtt_ms = (received - reply.sent_ns) / 1e6;
+            double responder_ms = (reply.replied_ns - reply.received_ns) / 1e6;
+            PeerStats& s = stats[StatsKey(reply.responder_service, reply.profile, reply.payload._length)];
+            if (s.replies == 0) {
+                s.first_sequence = reply.sequence;
+                s.min_ms = s.max_ms = rtt_ms;
+            }
+            s.replies++;
+            if (reply.sequence > s.last_sequence) s.last_sequence = reply.sequence;
+            s.sum_ms += rtt_ms;
+            s.responder_sum_ms += responder_ms;
+            if (rtt_ms < s.min_ms) s.min_ms = rtt_ms;
+            if (rtt_ms > s.max_ms) s.max_ms = rtt_ms;
+            if (s.last_ms >= 0.0) {
+                double d = rtt_ms > s.last_ms ? rtt_ms - s.last_ms : s.last_ms - rtt_ms;
+                s.jitter_ms += (d - s.jitter_ms) / 16.0;
+            }
+            s.last_ms = rtt_ms;
+            size_t b = 0;
+            while (b < RTT_BUCKETS && rtt_ms > RTT_BOUNDS_MS[b]) b++;
+            s.buckets[b]++;
+
+            if (spans_enabled) {
+                pending_spans.push_back({reply.responder_service, reply.profile, reply.payload._length,
+                                         reply.sequence, reply.sent_ns, received,
+                                         reply.replied_ns - reply.received_ns});
+            }
+        }
+        dds_return_loan(reader, samples, n);
+    }
+}
+
+// One probe-rtt span per round trip, back-dated to the request
+static void export_spans() {
+    std::vector<RoundTrip> trips;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        trips.swap(pending_spans);
+    }
+    if (trips.empty()) return;
+
+    auto steady_now = std::chrono::steady_clock::now();
+    int64_t real_now = dds_time();
+    for (const RoundTrip& t : trips) {
+        traced::trace_api::StartSpanOptions opts;
+        opts.kind = traced::trace_api::SpanKind::kClient;
+        opts.start_system_time = opentelemetry::common::SystemTimestamp(
+            std::chrono::system_clock::time_point(std::chrono::nanoseconds(t.sent_ns)));
+        opts.start_steady_time = opentelemetry::common::SteadyTimestamp(
+            steady_now - std::chrono::nanoseconds(real_now - t.sent_ns));
+
+        auto span = traced::g_tracer->StartSpan("probe-rtt", opts);
+        span->SetAttribute("messaging.system", "dds");
+        span->SetAttribute("peer.service", t.peer);
+        span->SetAttribute("probe.profile", t.profile);
+        span->SetAttribute("probe.payload_bytes", (int64_t)t.payload_bytes);
+        span->SetAttribute("probe.sequence", (int64_t)t.sequence);
+        span->SetAttribute("probe.responder_ns", t.responder_ns);
+        span->SetStatus(traced::trace_api::StatusCode::kOk);
+
+        traced::trace_api::EndSpanOptions end;
+        end.end_steady_time = opentelemetry::common::SteadyTimestamp(
+            steady_now - std::chrono::nanoseconds(real_now - t.replied_ns));
+        span->End(end);
+    }
+}
+
+// Cumulative rtt histogram, jitter gauge and loss counter per peer/profile/size
+static metrics_sdk::ResourceMetrics collect(const std::map<StatsKey, PeerStats>& snapshot,
+                                            const opentelemetry::sdk::resource::Resource& resource,
+                                            const opentelemetry::sdk::instrumentationscope::InstrumentationScope& scope,
+                                            std::chrono::system_clock::time_point start_time) {
+    opentelemetry::common::SystemTimestamp start(start_time);
+    opentelemetry::common::SystemTimestamp now(std::chrono::system_clock::now());
+
+    metrics_sdk::MetricData rtt;
+    rtt.instrument_descriptor = {"traced.probe.rtt", "DDS round-trip time", "ms",
+                                 metrics_sdk::InstrumentType::kHistogram,
+                                 metrics_sdk::InstrumentValueType::kDouble};
+    metrics_sdk::MetricData jitter;
+    jitter.instrument_descriptor = {"traced.probe.jitter", "RTT interarrival jitter (RFC 3550)", "ms",
+                                    metrics_sdk::InstrumentType::kObservableGauge,
+                                    metrics_sdk::InstrumentValueType::kDouble};
+    metrics_sdk::MetricData lost;
+    lost.instrument_descriptor = {"traced.probe.lost", "Probe requests without a reply", "{request}",
+                                  metrics_sdk::InstrumentType::kCounter,
+                                  metrics_sdk::InstrumentValueType::kLong};
+    for (metrics_sdk::MetricData* m : {&rtt, &jitter, &lost}) {
+        m->aggregation_temporality = metrics_sdk::AggregationTemporality::kCumulative;
+        m->start_ts = start;
+        m->end_ts = now;
+    }
+
+    std::vector<double> boundaries(RTT_BOUNDS_MS, RTT_BOUNDS_MS + RTT_BUCKETS);
+    for (const auto& entry : snapshot) {
+        const PeerStats& s = entry.second;
+        metrics_sdk::PointAttributes attrs;
+        attrs.SetAttribute("service.name", traced::g_service_name);
+        attrs.SetAttribute("peer.service", std::get<0>(entry.first));
+        attrs.SetAttribute("probe.profile", std::get<1>(entry.first));
+        attrs.SetAttribute("probe.payload_bytes", (int64_t)std::get<2>(entry.first));
+
+        metrics_sdk::HistogramPointData hist;
+        hist.boundaries_ = boundaries;
+        hist.counts_.assign(s.buckets, s.buckets + RTT_BUCKETS + 1);
+        hist.count_ = s.replies;
+        hist.sum_ = s.sum_ms;
+        hist.min_ = s.min_ms;
+        hist.max_ = s.max_ms;
+        hist.record_min_max_ = true;
+        rtt.point_data_attr_.push_back({attrs, hist});
+
+        metrics_sdk::LastValuePointData last;
+        last.value_ = s.jitter_ms;
+        last.is_lastvalue_valid_ = true;
+        last.sample_ts_ = now;
+        jitter.point_data_attr_.push_back({attrs, last});
+
+        metrics_sdk::SumPointData sum;
+        sum.value_ = (int64_t)s.lost();
+        sum.is_monotonic_ = true;
+        lost.point_data_attr_.push_back({attrs, sum});
+    }
+
+    metrics_sdk::ScopeMetrics scope_metrics;
+    scope_metrics.scope_ = &scope;
+    scope_metrics.metric_data_.push_back(std::move(rtt));
+    scope_metrics.metric_data_.push_back(std::move(jitter));
+    scope_metrics.metric_data_.push_back(std::move(lost));
+
+    metrics_sdk::ResourceMetrics out;
+    out.resource_ = &resource;
+    out.scope_metric_data_.push_back(std::move(scope_metrics));
+    return out;
+}
+
+static void print_summary(const std::map<StatsKey, PeerStats>& snapshot) {
+    printf("[%s] %-18s %-12s %7s %8s %6s %9s %9s %9s %9s\n", SERVICE_NAME,
+           "peer", "profile", "bytes", "replies", "lost", "mean ms", "max ms", "jitter", "resp ms");
+    for (const auto& entry : snapshot) {
+        const PeerStats& s = entry.second;
+        printf("[%s] %-18s %-12s %7u %8llu %6llu %9.3f %9.3f %9.3f %9.3f\n", SERVICE_NAME,
+               std::get<0>(entry.first).c_str(), std::get<1>(entry.first).c_str(), std::get<2>(entry.first),
+               (unsigned long long)s.replies, (unsigned long long)s.lost(),
+               s.sum_ms / s.replies, s.max_ms, s.jitter_ms, s.responder_sum_ms / s.replies);
+    }
+}
+
+int main() {
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    printf("[%s] Starting latency probe...\n", SERVICE_NAME);
+
+    dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    if (participant < 0) {
+        fprintf(stderr, "Failed to create participant!\n");
+        return 1;
+    }
+
+    traced::internal::ensure_init();
+    probe_id = ((int64_t)getpid() << 32) ^ dds_time();
+    spans_enabled = traced::recorder::internal::env_flag("PROBE_SPANS", true);
+
+    uint32_t sizes[MAX_PAYLOAD_SIZES];
+    size_t size_count = env_list_sizes("PROBE_PAYLOAD_SIZES", "64,1024,16384", sizes, MAX_PAYLOAD_SIZES);
+    long interval_ms = env_long("PROBE_INTERVAL_MS", 1000);
+    long report_ms = env_long("PROBE_REPORT_INTERVAL_MS", 10000);
+
+    dds_entity_t requests = dds_create_topic(participant, &traced_EchoSample_desc,
+                                             traced::echo::REQUEST_TOPIC, NULL, NULL);
+    dds_entity_t replies = dds_create_topic(participant, &traced_EchoSample_desc,
+                                            traced::echo::REPLY_TOPIC, NULL, NULL);
+
+    const char* profile_list = getenv("PROBE_PROFILES");
+    dds_entity_t writers[traced::echo::PROFILE_COUNT] = {0};
+    for (int i = 0; i < traced::echo::PROFILE_COUNT; i++) {
+        const traced::echo::Profile& profile = traced::echo::profile(i);
+        if (!traced::echo::listed(profile_list, profile.name)) continue;
+        dds_qos_t* qos = traced::echo::create_qos(profile);
+        writers[i] = dds_create_writer(participant, requests, qos, NULL);
+        dds_listener_t* listener = dds_create_listener(NULL);
+        dds_lset_data_available(listener, on_reply);
+        dds_create_reader(participant, replies, qos, listener);
+        dds_delete_listener(listener);
+        dds_delete_qos(qos);
+        printf("[%s] Profile %s enabled\n", SERVICE_NAME, profile.name);
+    }
+
+    std::unique_ptr<metrics_sdk::PushMetricExporter> exporter;
+    if (traced::recorder::internal::env_flag("PROBE_METRICS", true)) {
+        const char* traces_endpoint = getenv("OTEL_EXPORTER_OTLP_ENDPOINT");
+        opentelemetry::exporter::otlp::OtlpHttpMetricExporterOptions opts;
+        opts.url = traced::metrics::metrics_endpoint(traces_endpoint ? traces_endpoint
+                                                                     : "http://localhost:4318/v1/traces");
+        opts.aggregation_temporality = opentelemetry::exporter::otlp::PreferredAggregationTemporality::kCumulative;
+        exporter = opentelemetry::exporter::otlp::OtlpHttpMetricExporterFactory::Create(opts);
+        printf("[%s] Metrics every %ldms -> %s\n", SERVICE_NAME, report_ms, opts.url.c_str());
+    }
+    auto resource = opentelemetry::sdk::resource::Resource::Create({
+        {"service.name", traced::g_service_name},
+        {"service.version", "1.0.0"}
+    });
+    auto scope = opentelemetry::sdk::instrumentationscope::InstrumentationScope::Create("traced.probe", "1.0.0");
+    auto start_time = std::chrono::system_clock::now();
+    bool export_failed = false;
+
+    printf("[%s] DDS connected, waiting for discovery...\n", SERVICE_NAME);
+    sleep(3);
+
+    std::vector<uint8_t> payload(1, 0);
+    for (size_t s = 0; s < size_count; s++) {
+        if (sizes[s] > payload.size()) payload.resize(sizes[s], 0xA5);
+    }
+
+    printf("[%s] Probe operational - %zu payload sizes every %ldms\n", SERVICE_NAME, size_count, interval_ms);
+
+    int32_t sequence = 0;
+    int64_t next_ping = dds_time();
+    int64_t next_report = next_ping + DDS_MSECS(report_ms);
+
+    while (running) {
+        int64_t now = dds_time();
+        if (now >= next_ping) {
+            for (int i = 0; i < traced::echo::PROFILE_COUNT; i++) {
+                if (writers[i] <= 0) continue;
+                for (size_t s = 0; s < size_count; s++) {
+                    traced_EchoSample request;
+                    memset(&request, 0, sizeof(request));
+                    request.probe_id = probe_id;
+                    request.profile = (char*)traced::echo::profile(i).name;
+                    request.sequence = sequence;
+                    request.responder_service = (char*)"";
+                    request.payload._buffer = payload.data();
+                    request.payload._length = request.payload._maximum = sizes[s];
+                    request.payload._release = false;
+                    request.sent_ns = dds_time();
+                    dds_write(writers[i], &request);
+                }
+            }
+            sequence++;
+            next_ping += DDS_MSECS(interval_ms);
+            if (next_ping < now) next_ping = now + DDS_MSECS(interval_ms);  // fell behind
+        }
+
+        export_spans();
+
+        if (now >= next_report) {
+            std::map<StatsKey, PeerStats> snapshot;
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                snapshot = stats;
+            }
+            print_summary(snapshot);
+            if (exporter) {
+                auto result = exporter->Export(collect(snapshot, resource, *scope, start_time));
+                bool ok = result == opentelemetry::sdk::common::ExportResult::kSuccess;
+                if (!ok && !export_failed) {
+                    fprintf(stderr, "[%s] Metrics export failed (is the endpoint an OTLP metrics receiver?)\n",
+                            SERVICE_NAME);
+                }
+                export_failed = !ok;
+            }
+            next_report = now + DDS_MSECS(report_ms);
+        }
+
+        usleep(10000);
+    }
+
+    printf("[%s] Shutting down...\n", SERVICE_NAME);
+    if (exporter) exporter->Shutdown();
+    dds_delete(participant);
+
+    return 0;
+}
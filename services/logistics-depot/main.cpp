@@ -13,6 +13,9 @@
 
 TRACED_DDS_TYPE(combat_ReconReport);
 TRACED_DDS_TYPE(combat_SupplyUpdate);
+TRACED_DDS_FIELD(combat_ReconReport, mission_id);
+TRACED_DDS_FIELD(combat_ReconReport, report_id);
+TRACED_DDS_FIELD(combat_SupplyUpdate, mission_id);
 
 #define SERVICE_NAME "logistics-depot"
 
@@ -24,7 +27,7 @@ struct SupplyStock {
     std::string depot;
 };
 
-std::map<std::string, SupplyStock> supplies = {
+std::map<std::string, SupplyStock, std::less<>> supplies = {
     {"AMMO", {100, 0, "DEPOT_A"}},
     {"FUEL", {200, 0, "DEPOT_A"}},
     {"MEDICAL", {50, 0, "DEPOT_B"}},
@@ -64,6 +67,8 @@ int main() {
     if (participant < 0) { fprintf(stderr, "Failed to create participant!\n"); return 1; }
 
     auto reader = TRACED_READER(combat_ReconReport, participant, "ReconReportTopic");
+    // Supplies go out once per recon report, also when it is delivered again
+    reader.set_dedup({traced::dedup::Key::Field, "report_id"});
     auto writer = TRACED_WRITER(combat_SupplyUpdate, participant, "SupplyUpdateTopic");
 
     printf("[%s] DDS connected...\n", SERVICE_NAME);
@@ -85,8 +90,8 @@ int main() {
             const char* supply_type = SUPPLY_TYPES[supply_type_dis(gen)];
             int dispatch_qty = quantity_dis(gen);
 
-            std::string threat = report.threat_level ? report.threat_level : "LOW";
-            if (threat == "HIGH" || threat == "EXTREME") {
+            const char* threat = report.threat_level ? report.threat_level : "LOW";
+            if (strcmp(threat, "HIGH") == 0 || strcmp(threat, "EXTREME") == 0) {
                 dispatch_qty *= 2;
             }
 
@@ -95,32 +100,31 @@ int main() {
             span.SetAttribute("supply.type", supply_type);
             span.SetAttribute("supply.quantity", dispatch_qty);
 
-            std::string supply_key = supply_type;
-            if (supplies.find(supply_key) != supplies.end()) {
-                if (supplies[supply_key].quantity >= dispatch_qty) {
-                    supplies[supply_key].quantity -= dispatch_qty;
-                    supplies[supply_key].dispatched += dispatch_qty;
-                } else {
-                    dispatch_qty = supplies[supply_key].quantity;
-                    supplies[supply_key].quantity = 0;
-                    supplies[supply_key].dispatched += dispatch_qty;
-                }
+            // All supply types are stocked, so lookup never inserts
+            SupplyStock& stock = supplies.find(supply_type)->second;
+            if (stock.quantity >= dispatch_qty) {
+                stock.quantity -= dispatch_qty;
+                stock.dispatched += dispatch_qty;
+            } else {
+                dispatch_qty = stock.quantity;
+                stock.quantity = 0;
+                stock.dispatched += dispatch_qty;
             }
 
             usleep(200000 + (rand() % 300000));
 
-            span.SetAttribute("depot.location", supplies[supply_key].depot);
-            span.SetAttribute("depot.remaining_stock", supplies[supply_key].quantity);
+            span.SetAttribute("depot.location", stock.depot.c_str());
+            span.SetAttribute("depot.remaining_stock", stock.quantity);
 
-            bool low_stock = supplies[supply_key].quantity < 20;
+            bool low_stock = stock.quantity < 20;
 
-            printf("[DISPATCH] %s x%d -> Mission %s | Stock: %d\n",
-                   supply_type, dispatch_qty,
-                   report.mission_id ? report.mission_id : "?",
-                   supplies[supply_key].quantity);
+            TRACED_LOG(Messages, "[DISPATCH] %s x%d -> Mission %s | Stock: %d\n",
+                                 supply_type, dispatch_qty,
+                                 report.mission_id ? report.mission_id : "?",
+                                 stock.quantity);
 
             if (low_stock) {
-                printf("[WARNING] Low stock alert for %s!\n", supply_type);
+                TRACED_LOG(Info, "[WARNING] Low stock alert for %s!\n", supply_type);
                 span.AddEvent("low_stock_warning");
             }
 
@@ -133,9 +137,9 @@ int main() {
             update.mission_id = report.mission_id;
             update.supply_type = (char*)supply_type;
             update.action = (char*)"DISPATCH";
-            update.depot_location = (char*)supplies[supply_key].depot.c_str();
+            update.depot_location = (char*)stock.depot.c_str();
             update.quantity = dispatch_qty;
-            update.current_stock = supplies[supply_key].quantity;
+            update.current_stock = stock.quantity;
             update.low_stock_alert = low_stock;
 
             // Forward - trace context automatically propagated by middleware
@@ -143,7 +147,7 @@ int main() {
         });
 
         if (time(NULL) - last_report >= 20) {
-            print_supply_status();
+            if (traced::config::log_enabled(traced::config::LogLevel::Info)) print_supply_status();
             last_report = time(NULL);
         }
 
@@ -12,6 +12,8 @@
 
 TRACED_DDS_TYPE(combat_MissionOrder);
 TRACED_DDS_TYPE(combat_ReconReport);
+TRACED_DDS_FIELD(combat_MissionOrder, mission_id);
+TRACED_DDS_FIELD(combat_ReconReport, mission_id);
 
 #define SERVICE_NAME "recon-unit"
 
@@ -32,6 +34,8 @@ int main() {
     if (participant < 0) { fprintf(stderr, "Failed to create participant!\n"); return 1; }
 
     auto reader = TRACED_READER(combat_MissionOrder, participant, "MissionOrderTopic");
+    // One recon run per mission, whichever command-center copy arrives first
+    reader.set_dedup({traced::dedup::Key::Field, "mission_id"});
     auto writer = TRACED_WRITER(combat_ReconReport, participant, "ReconReportTopic");
 
     printf("[%s] DDS connected, waiting for discovery...\n", SERVICE_NAME);
@@ -50,8 +54,8 @@ int main() {
     while (running) {
         // Take messages with automatic trace extraction and child span creation
         reader.take("execute-recon", [&](combat_MissionOrder& order, traced::trace_api::Span& span) {
-            printf("[RECON] Mission: %s | Zone: %s | Priority: %s\n",
-                   order.mission_type, order.target_zone, order.priority);
+            TRACED_LOG(Messages, "[RECON] Mission: %s | Zone: %s | Priority: %s\n",
+                                 order.mission_type, order.target_zone, order.priority);
 
             span.SetAttribute("mission.id", order.mission_id ? order.mission_id : "");
             span.SetAttribute("mission.type", order.mission_type ? order.mission_type : "");
@@ -69,9 +73,9 @@ int main() {
             span.SetAttribute("recon.enemy_count", enemy_count);
             span.SetAttribute("recon.threat_level", threat_level);
 
-            printf("[INTEL] %s | Enemies: %d | Threat: %s | Terrain: %s\n",
-                   target_confirmed ? "TARGET CONFIRMED" : "TARGET NOT FOUND",
-                   enemy_count, threat_level, terrain);
+            TRACED_LOG(Messages, "[INTEL] %s | Enemies: %d | Threat: %s | Terrain: %s\n",
+                                 target_confirmed ? "TARGET CONFIRMED" : "TARGET NOT FOUND",
+                                 enemy_count, threat_level, terrain);
 
             // Create report
             combat_ReconReport report;
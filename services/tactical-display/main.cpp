@@ -13,9 +13,29 @@
 TRACED_DDS_TYPE(combat_MissionOrder);
 TRACED_DDS_TYPE(combat_ReconReport);
 TRACED_DDS_TYPE(combat_SupplyUpdate);
+TRACED_DDS_TYPE(combat_CombatAlert);
+TRACED_DDS_FIELD(combat_MissionOrder, mission_id);
+TRACED_DDS_FIELD(combat_ReconReport, mission_id);
+TRACED_DDS_FIELD(combat_SupplyUpdate, mission_id);
+TRACED_DDS_FIELD(combat_ReconReport, threat_level);
+TRACED_DDS_FIELD(combat_SupplyUpdate, supply_type);
+TRACED_DDS_FIELD(combat_SupplyUpdate, depot_location);
+TRACED_DDS_NUMBER(combat_ReconReport, target_confirmed);
+TRACED_DDS_NUMBER(combat_ReconReport, enemy_count);
+TRACED_DDS_NUMBER(combat_SupplyUpdate, current_stock);
+TRACED_DDS_NUMBER(combat_SupplyUpdate, low_stock_alert);
 
 #define SERVICE_NAME "tactical-display"
 
+// Alert rules (traced_rules.hpp); TRACED_ALERT_RULES replaces them
+#define ALERT_RULES \
+    "extreme-threat: recon threat_level == EXTREME => ENEMY_SPOTTED EMERGENCY key=mission_id;" \
+    "high-threat: recon threat_level == HIGH => ENEMY_SPOTTED CRITICAL key=mission_id;" \
+    "failed-recon: recon target_confirmed == false count 5 in 60s => MISSION_FAILED WARNING;" \
+    "low-stock: supply low_stock_alert == true => LOW_STOCK WARNING zone=depot_location key=supply_type quiet=60s;" \
+    "supply-at-risk: supply current_stock < 100 with recon threat_level == EXTREME in 2m" \
+    " => SUPPLY_AT_RISK CRITICAL zone=depot_location key=supply_type"
+
 static volatile sig_atomic_t running = 1;
 
 struct CombatStats {
@@ -24,14 +44,55 @@ struct CombatStats {
     int targets_not_found = 0;
     int supplies_dispatched = 0;
     int alerts_generated = 0;
-    std::map<std::string, int> by_zone;
-    std::map<std::string, int> by_threat;
+    std::map<std::string, int, std::less<>> by_zone;
+    std::map<std::string, int, std::less<>> by_threat;
     time_t start_time;
 } combat_stats;
 
+// Heterogeneous lookup: only the first sighting of a key allocates
+void count_key(std::map<std::string, int, std::less<>>& counts, const char* key) {
+    auto it = counts.find(key);
+    if (it == counts.end()) it = counts.emplace(key, 0).first;
+    it->second++;
+}
+
 void handle_signal(int sig) { running = 0; }
 
-void print_tactical_display() {
+// Emergency and critical alerts bypass bulk traffic on the urgent lane
+traced::Lane alert_priority(const combat_CombatAlert& alert) {
+    if (alert.severity && (strcmp(alert.severity, "EMERGENCY") == 0 ||
+                           strcmp(alert.severity, "CRITICAL") == 0)) {
+        return traced::Lane::Urgent;
+    }
+    return traced::Lane::Normal;
+}
+
+void publish_alert(traced::Writer<combat_CombatAlert, decltype(combat_CombatAlert_desc)>& writer,
+                   const traced::rules::Alert& raised) {
+    combat_stats.alerts_generated++;
+    TRACED_LOG(Info, "\n[ALERT] %s %s (%s) in %s: %s\n\n",
+                     raised.severity, raised.type, raised.rule, raised.zone, raised.message);
+
+    char alert_id[64];
+    snprintf(alert_id, sizeof(alert_id), "ALR-%ld-%d", time(NULL), combat_stats.alerts_generated);
+
+    combat_CombatAlert alert;
+    memset(&alert, 0, sizeof(alert));
+
+    alert.source_service = (char*)SERVICE_NAME;
+    alert.timestamp_ns = time(NULL) * 1000000000LL;
+    alert.alert_id = alert_id;
+    alert.alert_type = (char*)raised.type;
+    alert.severity = (char*)raised.severity;
+    alert.affected_zone = (char*)raised.zone;
+    alert.message = (char*)raised.message;
+    alert.details = (char*)raised.details;
+
+    // Continues the trace of the sample that raised the alert
+    writer.write(alert, "raise-alert");
+}
+
+void print_tactical_display(uint64_t suppressed) {
     int uptime = (int)(time(NULL) - combat_stats.start_time);
     float success_rate = combat_stats.targets_confirmed + combat_stats.targets_not_found > 0
         ? (float)combat_stats.targets_confirmed / (combat_stats.targets_confirmed + combat_stats.targets_not_found) * 100
@@ -48,6 +109,7 @@ void print_tactical_display() {
     printf("|  Targets Not Found: %5d                                  |\n", combat_stats.targets_not_found);
     printf("|  Supplies Sent:     %5d                                  |\n", combat_stats.supplies_dispatched);
     printf("|  Total Alerts:      %5d                                  |\n", combat_stats.alerts_generated);
+    printf("|  Alerts Suppressed: %5llu                                  |\n", (unsigned long long)suppressed);
     printf("+------------------------------------------------------------+\n");
     printf("|  Operations by Zone:                                       |\n");
 
@@ -82,6 +144,14 @@ int main() {
     auto mission_reader = TRACED_READER(combat_MissionOrder, participant, "MissionOrderTopic");
     auto recon_reader = TRACED_READER(combat_ReconReport, participant, "ReconReportTopic");
     auto supply_reader = TRACED_READER(combat_SupplyUpdate, participant, "SupplyUpdateTopic");
+    auto alert_writer = TRACED_WRITER(combat_CombatAlert, participant, "CombatAlertTopic");
+    alert_writer.set_priority(alert_priority);
+
+    traced::rules::Engine alert_rules;
+    int recon_source = alert_rules.source<combat_ReconReport>("recon");
+    int supply_source = alert_rules.source<combat_SupplyUpdate>("supply");
+    alert_rules.compile(ALERT_RULES);
+    auto raise = [&](const traced::rules::Alert& alert) { publish_alert(alert_writer, alert); };
 
     printf("[%s] DDS connected...\n", SERVICE_NAME);
     sleep(3);
@@ -94,67 +164,58 @@ int main() {
         // Process mission orders
         mission_reader.take("display-mission", [](combat_MissionOrder& order, traced::trace_api::Span& span) {
             combat_stats.total_missions++;
-            std::string zone = order.target_zone ? order.target_zone : "Unknown";
-            combat_stats.by_zone[zone]++;
+            const char* zone = order.target_zone ? order.target_zone : "Unknown";
+            count_key(combat_stats.by_zone, zone);
 
             span.SetAttribute("mission.type", order.mission_type ? order.mission_type : "");
             span.SetAttribute("mission.zone", zone);
             span.SetAttribute("display.total_missions", combat_stats.total_missions);
 
-            printf("[DISPLAY] NEW MISSION: %s | Zone: %s | Priority: %s\n",
-                   order.mission_type, zone.c_str(),
-                   order.priority ? order.priority : "?");
+            TRACED_LOG(Messages, "[DISPLAY] NEW MISSION: %s | Zone: %s | Priority: %s\n",
+                                 order.mission_type, zone,
+                                 order.priority ? order.priority : "?");
         });
 
         // Process recon reports
-        recon_reader.take("display-intel", [](combat_ReconReport& report, traced::trace_api::Span& span) {
+        recon_reader.take("display-intel", [&](combat_ReconReport& report, traced::trace_api::Span& span) {
             if (report.target_confirmed) {
                 combat_stats.targets_confirmed++;
             } else {
                 combat_stats.targets_not_found++;
             }
 
-            std::string threat = report.threat_level ? report.threat_level : "UNKNOWN";
-            combat_stats.by_threat[threat]++;
+            const char* threat = report.threat_level ? report.threat_level : "UNKNOWN";
+            count_key(combat_stats.by_threat, threat);
 
             span.SetAttribute("recon.target_confirmed", report.target_confirmed);
             span.SetAttribute("recon.threat_level", threat);
             span.SetAttribute("recon.enemy_count", report.enemy_count);
 
-            printf("[DISPLAY] INTEL: %s | Threat: %s | Enemies: %d\n",
-                   report.target_confirmed ? "TARGET CONFIRMED" : "NOT FOUND",
-                   threat.c_str(), report.enemy_count);
+            TRACED_LOG(Messages, "[DISPLAY] INTEL: %s | Threat: %s | Enemies: %d\n",
+                                 report.target_confirmed ? "TARGET CONFIRMED" : "NOT FOUND",
+                                 threat, report.enemy_count);
 
-            if (threat == "EXTREME" || threat == "HIGH") {
-                combat_stats.alerts_generated++;
-                printf("\n[ALERT] High threat detected: %s level!\n\n", threat.c_str());
-                span.AddEvent("high_threat_alert");
-            }
+            alert_rules.evaluate(recon_source, &report, span, raise);
         });
 
         // Process supply updates
-        supply_reader.take("display-logistics", [](combat_SupplyUpdate& update, traced::trace_api::Span& span) {
+        supply_reader.take("display-logistics", [&](combat_SupplyUpdate& update, traced::trace_api::Span& span) {
             combat_stats.supplies_dispatched += update.quantity;
 
             span.SetAttribute("supply.type", update.supply_type ? update.supply_type : "");
             span.SetAttribute("supply.quantity", update.quantity);
             span.SetAttribute("depot.stock", update.current_stock);
 
-            printf("[DISPLAY] SUPPLY: %s x%d from %s | Stock: %d\n",
-                   update.supply_type, update.quantity,
-                   update.depot_location ? update.depot_location : "?",
-                   update.current_stock);
+            TRACED_LOG(Messages, "[DISPLAY] SUPPLY: %s x%d from %s | Stock: %d\n",
+                                 update.supply_type, update.quantity,
+                                 update.depot_location ? update.depot_location : "?",
+                                 update.current_stock);
 
-            if (update.low_stock_alert) {
-                combat_stats.alerts_generated++;
-                printf("\n[WARNING] Low stock for %s at %s!\n\n",
-                       update.supply_type, update.depot_location);
-                span.AddEvent("low_stock_alert");
-            }
+            alert_rules.evaluate(supply_source, &update, span, raise);
         });
 
         if (time(NULL) - last_display >= 25) {
-            print_tactical_display();
+            if (traced::config::log_enabled(traced::config::LogLevel::Info)) print_tactical_display(alert_rules.suppressed());
             last_display = time(NULL);
         }
 
@@ -10,6 +10,7 @@
 #include "CombatMessages.h"
 
 TRACED_DDS_TYPE(combat_TacticalTrack);
+TRACED_DDS_FIELD(combat_TacticalTrack, tactical_track_id);
 
 #define SERVICE_NAME "track-consumer"
 
@@ -39,6 +40,7 @@ int main() {
     while (running) {
         // Simple callback - no span parameter needed, tracing is automatic!
         reader.take_simple("process-tactical", [](combat_TacticalTrack& msg) {
+            if (!traced::config::log_enabled(traced::config::LogLevel::Messages)) return;
             printf("\n[CONSUMER] ════════════════════════════════════════\n");
             printf("[CONSUMER] Received Tactical Track: %s\n", 
                    msg.tactical_track_id ? msg.tactical_track_id : "?");
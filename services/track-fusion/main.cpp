@@ -4,18 +4,20 @@
 #include <signal.h>
 #include <unistd.h>
 #include <time.h>
+#include <algorithm>
 #include <vector>
 #include <string>
-#include <sstream>
 
 #include "traced_dds.hpp"
 #include "CombatMessages.h"
 
 TRACED_DDS_TYPE(combat_SourceTrack);
 TRACED_DDS_TYPE(combat_TacticalTrack);
+TRACED_DDS_FIELD(combat_TacticalTrack, tactical_track_id);
 
 #define SERVICE_NAME "track-fusion"
-#define FUSION_WINDOW_SEC 3  // Collect tracks for N seconds before fusing
+#define FUSION_WINDOW_MS 3000  // Collect tracks this long before fusing (fusion-window-ms)
+#define MAX_TAKE 64
 
 static volatile sig_atomic_t running = 1;
 
@@ -42,10 +44,31 @@ struct CollectedTrack {
     traced::TraceLink link;
 };
 
+// Shard owning a sensor (FNV-1a of the sensor ID)
+static uint32_t sensor_shard(const char* sensor_id, uint32_t shards) {
+    uint32_t h = 2166136261u;
+    for (const char* p = sensor_id ? sensor_id : ""; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    return h % shards;
+}
+
 int main() {
     signal(SIGINT, handle_signal);
     signal(SIGTERM, handle_signal);
 
+    // Sharding by sensor to run several instances (tools/scale-harness).
+    // Every shard still receives all source tracks and drops the others.
+    const char* shard_env = getenv("FUSION_SHARD");
+    const char* shards_env = getenv("FUSION_SHARDS");
+    uint32_t shard = shard_env ? atoi(shard_env) : 0;
+    uint32_t shards = shards_env ? atoi(shards_env) : 1;
+    if (shards == 0) shards = 1;
+    const char* fusion_id = getenv("TRACED_SERVICE_NAME");
+    if (!fusion_id) fusion_id = SERVICE_NAME;
+    // Settable at runtime: traced-ctl set track-fusion fusion-window-ms=5000
+    traced::config::Param fusion_window_ms = traced::config::param("fusion-window-ms", FUSION_WINDOW_MS);
+
     printf("[%s] Starting track fusion service...\n", SERVICE_NAME);
 
     dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
@@ -65,22 +88,33 @@ int main() {
 
     std::vector<CollectedTrack> collected_tracks;
     int tactical_track_num = 1;
-    time_t last_fusion_time = time(NULL);
+    dds_time_t last_fusion_time = dds_time();
 
     printf("[%s] Fusion service operational - collecting source tracks\n", SERVICE_NAME);
 
     while (running) {
+        // Plain dds_take instead of Reader::take: tracks are only buffered here,
+        // and the fuse span links to their traces, so there is no receive span
+        // per sample. What Reader::take does besides is repeated: the watchdog
+        // heartbeat, the live take-batch and the take statistics.
+        traced::watchdog::Pass pass("SourceTrackTopic");
+
         // Collect incoming tracks (don't process in callback - just store)
-        void* samples[10] = {nullptr};
-        dds_sample_info_t infos[10];
+        int live_batch = traced::config::current()->take_batch;
+        int batch = live_batch > 0 ? std::min(live_batch, MAX_TAKE) : 10;
+        void* samples[MAX_TAKE] = {nullptr};
+        dds_sample_info_t infos[MAX_TAKE];
         
-        dds_return_t n = dds_take(reader.get(), samples, infos, 10, 10);
+        dds_return_t n = dds_take(reader.get(), samples, infos, batch, batch);
+        pass.taken(n);
         
         if (n > 0) {
             for (int i = 0; i < n; i++) {
                 if (!infos[i].valid_data) continue;
                 
                 combat_SourceTrack* msg = static_cast<combat_SourceTrack*>(samples[i]);
+                if (shards > 1 && sensor_shard(msg->sensor_id, shards) != shard) continue;
+                traced::stats::record_take(dds_time() - infos[i].source_timestamp);
                 
                 CollectedTrack ct;
                 
@@ -107,18 +141,24 @@ int main() {
                 ct.link.trace_id = msg->trace_ctx.trace_id ? msg->trace_ctx.trace_id : "";
                 ct.link.span_id = msg->trace_ctx.span_id ? msg->trace_ctx.span_id : "";
                 ct.link.sensor_id = ct.sensor_id;
+                ct.link.service = reader.publisher_service(infos[i]);
+                ct.link.origin_id = reader.publisher_origin(infos[i]);
+                ct.link.topic = "SourceTrackTopic";
+                ct.link.source_timestamp = infos[i].source_timestamp;
                 
                 collected_tracks.push_back(ct);
                 
-                printf("[COLLECT] %s track %s | Pos: %.2f, %.2f\n",
-                       ct.sensor_type, ct.track_id,
-                       ct.position_lat, ct.position_lon);
+                TRACED_LOG(Messages, "[COLLECT] %s track %s | Pos: %.2f, %.2f\n",
+                                     ct.sensor_type, ct.track_id,
+                                     ct.position_lat, ct.position_lon);
             }
+            dds_return_loan(reader.get(), samples, n);
         }
         
         // Check if it's time to fuse
         time_t now = time(NULL);
-        if (now - last_fusion_time >= FUSION_WINDOW_SEC && !collected_tracks.empty()) {
+        dds_time_t now_ns = dds_time();
+        if (now_ns - last_fusion_time >= DDS_MSECS(fusion_window_ms.get()) && !collected_tracks.empty()) {
             
             // ========== FUSION PROCESS WITH TRACING ==========
             
@@ -131,13 +171,15 @@ int main() {
             // 2. Create root span with links to all source traces
             auto [fuse_span, fuse_scope] = traced::create_linked_span("fuse-tracks", links);
             fuse_span->SetAttribute("fusion.num_sources", (int64_t)collected_tracks.size());
+            pass.set_context(fuse_span->GetContext());
             
             // 3. Receive spans for each sensor (child spans for timing)
             for (const auto& ct : collected_tracks) {
-                std::string span_name = std::string("receive-") + ct.sensor_type;
+                char span_name[48];
+                snprintf(span_name, sizeof(span_name), "receive-%s", ct.sensor_type);
                 auto [recv_span, recv_scope] = traced::create_child_span(span_name);
-                recv_span->SetAttribute("sensor.id", std::string(ct.sensor_id));
-                recv_span->SetAttribute("track.id", std::string(ct.track_id));
+                recv_span->SetAttribute("sensor.id", ct.sensor_id);
+                recv_span->SetAttribute("track.id", ct.track_id);
                 recv_span->SetAttribute("track.confidence", ct.confidence);
                 recv_span->End();
             }
@@ -146,11 +188,13 @@ int main() {
             {
                 auto [corr_span, corr_scope] = traced::create_child_span("correlate");
                 corr_span->SetAttribute("algorithm", "centroid-fusion");
+                traced::CpuProfile corr_profile;
                 
                 // Simple fusion: average positions, max confidence
                 // (In real system this would be Kalman filter etc.)
                 usleep(10000);  // Simulate processing
                 
+                corr_profile.finish(*corr_span);
                 corr_span->End();
             }
             
@@ -160,12 +204,19 @@ int main() {
                 
                 // Build tactical track
                 char tac_id[32];
-                snprintf(tac_id, sizeof(tac_id), "TT-%03d", tactical_track_num);
+                if (shards > 1) {
+                    snprintf(tac_id, sizeof(tac_id), "TT-%u-%03d", shard, tactical_track_num);
+                } else {
+                    snprintf(tac_id, sizeof(tac_id), "TT-%03d", tactical_track_num);
+                }
                 
                 // Aggregate data
                 float avg_lat = 0, avg_lon = 0, avg_alt = 0;
                 float avg_hdg = 0, avg_spd = 0, max_conf = 0;
-                std::stringstream sensors_ss, track_ids_ss;
+                // Comma-separated lists, truncated rather than reallocated
+                char sensors_str[512] = "";
+                char track_ids_str[512] = "";
+                size_t sensors_len = 0, track_ids_len = 0;
                 char best_class_buf[32] = "UNKNOWN";
                 
                 for (size_t i = 0; i < collected_tracks.size(); i++) {
@@ -182,12 +233,15 @@ int main() {
                         best_class_buf[sizeof(best_class_buf)-1] = '\0';
                     }
                     
-                    if (i > 0) {
-                        sensors_ss << ",";
-                        track_ids_ss << ",";
+                    const char* sep = i > 0 ? "," : "";
+                    if (sensors_len < sizeof(sensors_str)) {
+                        sensors_len += snprintf(sensors_str + sensors_len, sizeof(sensors_str) - sensors_len,
+                                                "%s%s", sep, ct.sensor_id);
+                    }
+                    if (track_ids_len < sizeof(track_ids_str)) {
+                        track_ids_len += snprintf(track_ids_str + track_ids_len, sizeof(track_ids_str) - track_ids_len,
+                                                  "%s%s", sep, ct.track_id);
                     }
-                    sensors_ss << ct.sensor_id;
-                    track_ids_ss << ct.track_id;
                 }
                 
                 size_t n_tracks = collected_tracks.size();
@@ -197,13 +251,10 @@ int main() {
                 avg_hdg /= n_tracks;
                 avg_spd /= n_tracks;
                 
-                std::string sensors_str = sensors_ss.str();
-                std::string track_ids_str = track_ids_ss.str();
-                
                 combat_TacticalTrack tac;
                 memset(&tac, 0, sizeof(tac));
                 
-                tac.fusion_service_id = (char*)SERVICE_NAME;
+                tac.fusion_service_id = (char*)fusion_id;
                 tac.timestamp_ns = now * 1000000000LL;
                 tac.tactical_track_id = tac_id;
                 tac.position_lat = avg_lat;
@@ -214,18 +265,19 @@ int main() {
                 tac.confidence = max_conf;
                 tac.classification = best_class_buf;
                 tac.num_sources = (int32_t)n_tracks;
-                tac.contributing_sensors = (char*)sensors_str.c_str();
-                tac.contributing_track_ids = (char*)track_ids_str.c_str();
+                tac.contributing_sensors = sensors_str;
+                tac.contributing_track_ids = track_ids_str;
                 
                 pub_span->SetAttribute("tactical.track_id", tac_id);
                 pub_span->SetAttribute("tactical.num_sources", (int64_t)n_tracks);
                 pub_span->SetAttribute("tactical.confidence", (double)max_conf);
                 
                 // Write will continue the trace
-                if (writer.write(tac, "emit-tactical-track")) {
+                if (writer.write(tac, "emit-tactical-track") &&
+                    traced::config::log_enabled(traced::config::LogLevel::Messages)) {
                     printf("\n[FUSION] ══════════════════════════════════════════\n");
                     printf("[FUSION] Tactical Track: %s\n", tac_id);
-                    printf("[FUSION] Sources: %s\n", sensors_str.c_str());
+                    printf("[FUSION] Sources: %s\n", sensors_str);
                     printf("[FUSION] Position: %.4f, %.4f | Alt: %.0fm\n", 
                            avg_lat, avg_lon, avg_alt);
                     printf("[FUSION] Classification: %s | Confidence: %.2f\n",
@@ -241,9 +293,10 @@ int main() {
             // Clear for next window
             collected_tracks.clear();
             tactical_track_num++;
-            last_fusion_time = now;
+            last_fusion_time = now_ns;
         }
         
+        pass.finish();
         usleep(100000);  // 100ms poll interval
     }
 
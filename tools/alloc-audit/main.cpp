@@ -0,0 +1,228 @@
+// Allocation audit for the traced write/take path.
+//
+// Counts heap allocations per message after warm-up, with the allocator
+// interposed by TRACED_ALLOC_AUDIT(): operator new as well as malloc, calloc
+// and realloc. By default the OTel SDK is installed in zero-allocation mode
+// (TRACED_ZERO_ALLOC=1: pooled spans, batch export), so the gate covers the
+// real span, sampling and propagation path. The same pipeline is first run
+// over plain DDS writers and readers; CycloneDDS's own allocations are the
+// baseline. Exits non-zero if the traced path allocates more than that
+// baseline per message, or if the reader does not receive the writer's
+// (non-zero) trace id. Every other order is written with write_keyed() and
+// track traces on, cycling over a fixed set of mission ids.
+//
+// Usage: app [--messages N] [--warmup N] [--sdk]
+//   --sdk uses the SDK's own spans and only reports (SDK spans allocate)
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "traced_alloc.hpp"
+#include "traced_dds.hpp"
+#include "CombatMessages.h"
+
+TRACED_ALLOC_AUDIT();
+
+TRACED_DDS_TYPE(combat_MissionOrder);
+TRACED_DDS_TYPE(combat_ReconReport);
+
+#define SERVICE_NAME "alloc-audit"
+#define MAX_SAMPLES 10
+#define MISSION_KEYS 16
+
+// Allocations per message the traced path may add to the baseline: an
+// allocation per span or per message shows up as 1 or more
+#define TOLERANCE 0.1
+
+static void print_row(const char* name, const traced::alloc::Snapshot& s, int messages) {
+    printf("%-14s %10.2f %12.1f %10.2f %12.1f\n", name,
+           (double)s.count / messages, (double)s.bytes / messages,
+           (double)s.c_count / messages, (double)s.c_bytes / messages);
+}
+
+static bool exceeds(uint64_t traced_count, uint64_t baseline_count, int messages) {
+    return (double)traced_count / messages > (double)baseline_count / messages + TOLERANCE;
+}
+
+static bool nonzero_id(const char* hex) {
+    if (!hex || !*hex) return false;
+    for (; *hex; hex++) {
+        if (*hex != '0') return true;
+    }
+    return false;
+}
+
+static void take_plain(dds_entity_t reader) {
+    void* samples[MAX_SAMPLES] = {nullptr};
+    dds_sample_info_t infos[MAX_SAMPLES];
+    dds_return_t n = dds_take(reader, samples, infos, MAX_SAMPLES, MAX_SAMPLES);
+    if (n > 0) dds_return_loan(reader, samples, n);
+}
+
+int main(int argc, char** argv) {
+    int messages = 10000;
+    int warmup = 1000;
+    bool sdk = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--messages") == 0 && i + 1 < argc) messages = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sdk") == 0) sdk = true;
+        else {
+            fprintf(stderr, "usage: %s [--messages N] [--warmup N] [--sdk]\n", argv[0]);
+            return 2;
+        }
+    }
+    setenv("TRACED_SERVICE_NAME", SERVICE_NAME, 0);
+    setenv("TRACED_ZERO_ALLOC", sdk ? "0" : "1", 1);
+    // Export allocates on the exporter thread, not on the measured one
+    setenv("TRACED_SPAN_PROCESSOR", "batch", 0);
+    setenv("TRACED_TRACK_TRACES", "1", 0);
+
+    dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    if (participant < 0) {
+        fprintf(stderr, "Failed to create participant!\n");
+        return 2;
+    }
+
+    // Two hops: take an order, forward a report from inside the callback
+    auto order_writer = TRACED_WRITER(combat_MissionOrder, participant, "AllocAuditOrderTopic");
+    auto order_reader = TRACED_READER(combat_MissionOrder, participant, "AllocAuditOrderTopic");
+    auto report_writer = TRACED_WRITER(combat_ReconReport, participant, "AllocAuditReportTopic");
+    auto report_reader = TRACED_READER(combat_ReconReport, participant, "AllocAuditReportTopic");
+
+    // The same two hops over plain DDS endpoints
+    dds_entity_t plain_order_topic = dds_create_topic(participant, &combat_MissionOrder_desc,
+                                                      "AllocAuditPlainOrderTopic", NULL, NULL);
+    dds_entity_t plain_report_topic = dds_create_topic(participant, &combat_ReconReport_desc,
+                                                       "AllocAuditPlainReportTopic", NULL, NULL);
+    dds_entity_t plain_order_writer = dds_create_writer(participant, plain_order_topic, NULL, NULL);
+    dds_entity_t plain_order_reader = dds_create_reader(participant, plain_order_topic, NULL, NULL);
+    dds_entity_t plain_report_writer = dds_create_writer(participant, plain_report_topic, NULL, NULL);
+    dds_entity_t plain_report_reader = dds_create_reader(participant, plain_report_topic, NULL, NULL);
+    sleep(1);  // local endpoint matching
+
+    combat_MissionOrder order;
+    memset(&order, 0, sizeof(order));
+    order.source_service = (char*)SERVICE_NAME;
+    order.mission_id = (char*)"MSN-1734112800-42";
+    // Keys of the keyed hop, all seen during warm-up
+    char mission_ids[MISSION_KEYS][24];
+    for (int k = 0; k < MISSION_KEYS; k++) snprintf(mission_ids[k], sizeof(mission_ids[k]), "MSN-1734112800-%02d", k);
+    order.mission_type = (char*)"STRIKE";
+    order.priority = (char*)"CRITICAL";
+    order.target_zone = (char*)"Charlie";
+    order.commander_id = (char*)"CMD-3";
+
+    combat_ReconReport report;
+    memset(&report, 0, sizeof(report));
+    report.source_service = (char*)SERVICE_NAME;
+    report.report_id = (char*)"RPT-1734112800";
+    report.unit_id = (char*)"UNIT-2";
+    report.threat_level = (char*)"HIGH";
+    report.terrain_type = (char*)"URBAN";
+    report.intel_details = (char*)"{}";
+
+    // Plain samples carry trace context strings of the traced size
+    combat_MissionOrder plain_order = order;
+    combat_ReconReport plain_report = report;
+    plain_order.trace_ctx.trace_id = plain_report.trace_ctx.trace_id = (char*)"0123456789abcdef0123456789abcdef";
+    plain_order.trace_ctx.span_id = plain_report.trace_ctx.span_id = (char*)"0123456789abcdef";
+    plain_order.trace_ctx.parent_span_id = plain_report.trace_ctx.parent_span_id = (char*)"";
+    plain_report.mission_id = order.mission_id;
+
+    traced::alloc::Snapshot baseline;
+    for (int i = 0; i < warmup + messages; i++) {
+        plain_order.sequence_num = i;
+        traced::alloc::Snapshot t0 = traced::alloc::snapshot();
+        dds_write(plain_order_writer, &plain_order);
+        take_plain(plain_order_reader);
+        dds_write(plain_report_writer, &plain_report);
+        take_plain(plain_report_reader);
+        if (i >= warmup) baseline = baseline + (traced::alloc::snapshot() - t0);
+    }
+
+    traced::alloc::Snapshot write_total, keyed_total, take_total;
+    int keyed_writes = 0;
+    int delivered = 0;
+    int propagated = 0;
+    char order_trace_id[33] = "";
+    traced::spanpool::Pool& pool = traced::spanpool::Pool::instance();
+
+    for (int i = 0; i < warmup + messages; i++) {
+        bool measure = i >= warmup;
+        order.sequence_num = i;
+        // Stay clear of the pool's overflow path, which allocates by design
+        while (pool.enabled() && pool.in_use() > pool.capacity() / 2) sched_yield();
+
+        bool keyed = i % 2 == 1;
+        order.mission_id = mission_ids[(i / 2) % MISSION_KEYS];
+
+        traced::alloc::Snapshot t0 = traced::alloc::snapshot();
+        if (keyed) order_writer.write_keyed(order, order.mission_id, "audit-issue-mission");
+        else order_writer.write(order, "audit-issue-mission");
+        traced::alloc::Snapshot t1 = traced::alloc::snapshot();
+
+        order_reader.take("audit-execute-recon", [&](combat_MissionOrder& o, traced::trace_api::Span& span) {
+            span.SetAttribute("mission.id", o.mission_id ? o.mission_id : "");
+            snprintf(order_trace_id, sizeof(order_trace_id), "%s", o.trace_ctx.trace_id ? o.trace_ctx.trace_id : "");
+            report.mission_id = o.mission_id;
+            report_writer.write(report, "audit-send-report");
+        });
+        report_reader.take("audit-dispatch-supplies", [&](combat_ReconReport& r, traced::trace_api::Span&) {
+            if (!measure) return;
+            delivered++;
+            // The report continues the order's trace: same non-zero id after two hops
+            const char* trace_id = r.trace_ctx.trace_id;
+            if (nonzero_id(trace_id) && strcmp(trace_id, order_trace_id) == 0) propagated++;
+        });
+        traced::alloc::Snapshot t2 = traced::alloc::snapshot();
+
+        if (!measure) continue;
+        if (keyed) {
+            keyed_total = keyed_total + (t1 - t0);
+            keyed_writes++;
+        } else {
+            write_total = write_total + (t1 - t0);
+        }
+        take_total = take_total + (t2 - t1);
+    }
+    traced::alloc::Snapshot traced_total = write_total + keyed_total + take_total;
+
+    printf("\n[%s] %d messages after %d warm-up (%s)\n", SERVICE_NAME, messages, warmup,
+           sdk ? "SDK spans" : "zero-allocation mode, pooled spans");
+    printf("%-14s %10s %12s %10s %12s\n", "per message", "new", "new bytes", "malloc", "malloc bytes");
+    print_row("plain DDS", baseline, messages);
+    print_row("write", write_total, messages - keyed_writes);
+    print_row("write_keyed", keyed_total, keyed_writes);
+    print_row("take+forward", take_total, messages);
+    print_row("traced total", traced_total, messages);
+    printf("trace id propagated: %d of %d\n", propagated, delivered);
+    if (pool.enabled()) {
+        printf("span pool: %zu slots, %llu overflow, %llu truncated\n", pool.capacity(),
+               (unsigned long long)pool.overflow(), (unsigned long long)pool.truncated());
+    }
+
+    dds_delete(participant);
+
+    if (delivered != messages) {
+        fprintf(stderr, "[%s] FAIL: %d of %d messages delivered\n", SERVICE_NAME, delivered, messages);
+        return 1;
+    }
+    if (propagated != delivered) {
+        fprintf(stderr, "[%s] FAIL: %d of %d reports without the order's trace id\n",
+                SERVICE_NAME, delivered - propagated, delivered);
+        return 1;
+    }
+    if (!sdk && (exceeds(traced_total.count, baseline.count, messages) ||
+                 exceeds(traced_total.c_count, baseline.c_count, messages))) {
+        fprintf(stderr, "[%s] FAIL: heap allocations on the traced write/take path beyond plain DDS\n",
+                SERVICE_NAME);
+        return 1;
+    }
+    printf("[%s] OK\n", SERVICE_NAME);
+    return 0;
+}
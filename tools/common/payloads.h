@@ -0,0 +1,95 @@
+// Sample payloads of the CombatMessages types, shared by the benchmarks.
+//
+// fill_payload() sets the business fields only. Trace context, timestamps
+// and sequence numbers are left to the caller, which either injects them
+// (traced::Writer) or fills fixed values.
+
+#pragma once
+
+#include "CombatMessages.h"
+
+// String sizes follow what the services actually publish
+static const char* INTEL_JSON =
+    "{\"observations\":[{\"grid\":\"NV 4512 8834\",\"type\":\"armor\",\"count\":4,"
+    "\"heading\":270,\"confidence\":0.82},{\"grid\":\"NV 4518 8841\",\"type\":\"infantry\","
+    "\"count\":23,\"heading\":265,\"confidence\":0.67}],\"source\":\"UAV-3\","
+    "\"weather\":\"clear\",\"visibility_km\":12}";
+static const char* ALERT_JSON =
+    "{\"sensor\":\"RADAR-1\",\"track\":\"TT-042\",\"grid\":\"NV 4512 8834\","
+    "\"eta_s\":340,\"recommended_action\":\"raise readiness to REDCON-1\"}";
+
+static void fill_payload(combat_MissionOrder& m) {
+    m.source_service = (char*)"command-center";
+    m.mission_id = (char*)"MSN-2026-000417";
+    m.mission_type = (char*)"STRIKE";
+    m.priority = (char*)"CRITICAL";
+    m.target_zone = (char*)"Charlie";
+    m.target_lat = 48.137f;
+    m.target_lon = 11.575f;
+    m.commander_id = (char*)"CMD-ALPHA-7";
+}
+
+static void fill_payload(combat_ReconReport& m) {
+    m.source_service = (char*)"recon-unit";
+    m.mission_id = (char*)"MSN-2026-000417";
+    m.report_id = (char*)"RPT-2026-004211";
+    m.unit_id = (char*)"RECON-TEAM-3";
+    m.target_confirmed = true;
+    m.enemy_count = 27;
+    m.threat_level = (char*)"HIGH";
+    m.terrain_type = (char*)"URBAN";
+    m.intel_details = (char*)INTEL_JSON;
+}
+
+static void fill_payload(combat_SupplyUpdate& m) {
+    m.source_service = (char*)"logistics-depot";
+    m.mission_id = (char*)"MSN-2026-000417";
+    m.supply_type = (char*)"AMMO";
+    m.action = (char*)"DISPATCH";
+    m.depot_location = (char*)"DEPOT_B";
+    m.quantity = 1200;
+    m.current_stock = 8800;
+    m.low_stock_alert = false;
+}
+
+static void fill_payload(combat_CombatAlert& m) {
+    m.source_service = (char*)"tactical-display";
+    m.alert_id = (char*)"ALR-2026-000093";
+    m.alert_type = (char*)"ENEMY_SPOTTED";
+    m.severity = (char*)"CRITICAL";
+    m.affected_zone = (char*)"Charlie";
+    m.message = (char*)"Hostile armor column approaching Charlie from the west, 4 vehicles";
+    m.details = (char*)ALERT_JSON;
+}
+
+// Also fills the SourceTrack variants of shared/TraceContextVariants.idl
+template<typename T>
+static void fill_source_track_payload(T& m) {
+    m.sensor_id = (char*)"RADAR-1";
+    m.sensor_type = (char*)"RADAR";
+    m.source_track_id = (char*)"RADAR-1-T0042";
+    m.position_lat = 48.137f;
+    m.position_lon = 11.575f;
+    m.altitude_m = 1500.0f;
+    m.heading_deg = 270.0f;
+    m.speed_mps = 220.0f;
+    m.confidence = 0.91f;
+    m.classification = (char*)"HOSTILE";
+}
+
+static void fill_payload(combat_SourceTrack& m) { fill_source_track_payload(m); }
+
+static void fill_payload(combat_TacticalTrack& m) {
+    m.fusion_service_id = (char*)"track-fusion";
+    m.tactical_track_id = (char*)"TT-042";
+    m.position_lat = 48.137f;
+    m.position_lon = 11.575f;
+    m.altitude_m = 1500.0f;
+    m.heading_deg = 270.0f;
+    m.speed_mps = 220.0f;
+    m.confidence = 0.97f;
+    m.classification = (char*)"HOSTILE";
+    m.num_sources = 3;
+    m.contributing_sensors = (char*)"RADAR-1,ESM-2,OPTIK-3";
+    m.contributing_track_ids = (char*)"RADAR-1-T0042,ESM-2-T0017,OPTIK-3-T0108";
+}
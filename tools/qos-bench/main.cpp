@@ -0,0 +1,410 @@
+// QoS matrix throughput benchmark for traced::Writer / traced::Reader.
+//
+// Sweeps reliability, history depth, write batching, payload type, tracing
+// mode and take batch size. Every combination runs a writer and a reader in
+// two forked processes on the same host, so samples cross the loopback
+// interface as they do between containers. The writer sends as fast as it
+// can (or at --rate), the reader stamps each sample against the timestamp_ns
+// the writer put in it. One table row per combination:
+//   sent/s, recv/s - offered and delivered throughput; with an unpaced writer
+//                    recv/s is the max sustainable rate of that combination
+//   loss           - samples never delivered (best effort, or KEEP_LAST
+//                    history overwritten before the reader took them)
+//   p50..max       - write -> take callback latency in us, queueing included
+//
+// Usage: app [--types all|MissionOrder,...] [--reliability reliable,best-effort]
+//            [--history 1,100,all] [--write-batch 0,32] [--take-batch 1,10,64]
+//            [--tracing full,sampled,off] [--duration-ms N] [--rate N]
+//            [--sample-ratio R] [--csv]
+//   --write-batch 0 writes unbatched, N > 0 batches and flushes every N writes
+//   --rate 0 (default) is unpaced; N paces the writer to N samples/s
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "traced_dds.hpp"
+#include "CombatMessages.h"
+#include "payloads.h"
+
+TRACED_DDS_TYPE(combat_MissionOrder);
+TRACED_DDS_TYPE(combat_ReconReport);
+TRACED_DDS_TYPE(combat_SupplyUpdate);
+TRACED_DDS_TYPE(combat_CombatAlert);
+TRACED_DDS_TYPE(combat_SourceTrack);
+TRACED_DDS_TYPE(combat_TacticalTrack);
+
+#define SERVICE_NAME "qos-bench"
+#define MATCH_TIMEOUT_S 5
+#define IDLE_TIMEOUT_MS 500
+#define MAX_LATENCIES 4000000
+
+struct Combo {
+    int type;
+    dds_reliability_kind_t reliability;
+    int history;        // 0 = KEEP_ALL
+    int write_batch;    // 0 = unbatched
+    int take_batch;
+    int tracing;
+};
+
+struct Settings {
+    int duration_ms = 1000;
+    int rate = 0;
+    const char* sample_ratio = "0.01";
+};
+
+struct WriterResult {
+    int ok;
+    uint64_t sent;
+    uint64_t failed;
+    double elapsed_s;
+};
+
+struct ReaderResult {
+    int ok;
+    uint64_t received;
+    double elapsed_s;
+    double p50_us, p99_us, p999_us, max_us;
+};
+
+// ============ Payloads ============
+
+// fill_payload() from payloads.h; the writer loop stamps sequence and time
+static void set_sequence(combat_MissionOrder& m, uint64_t seq) { m.sequence_num = (int32_t)seq; }
+template<typename T> static void set_sequence(T&, uint64_t) {}
+
+// ============ Writer / Reader processes ============
+
+static int64_t mono_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static traced::EndpointQos endpoint_qos(const Combo& c) {
+    traced::EndpointQos qos;
+    qos.reliability = c.reliability;
+    qos.history_depth = c.history;
+    qos.take_batch = c.take_batch;
+    return qos;
+}
+
+template<typename T, typename Desc>
+static WriterResult run_writer(dds_entity_t participant, const char* topic, const Desc& desc,
+                               const Combo& c, const Settings& s) {
+    WriterResult result = {0, 0, 0, 0};
+    traced::Writer<T, Desc> writer(participant, topic, desc, endpoint_qos(c));
+    if (c.write_batch > 0) dds_write_set_batch(true);
+
+    dds_publication_matched_status_t matched;
+    int64_t give_up = mono_ns() + MATCH_TIMEOUT_S * 1000000000LL;
+    do {
+        dds_get_publication_matched_status(writer.get(), &matched);
+        if (matched.current_count > 0) break;
+        usleep(10000);
+    } while (mono_ns() < give_up);
+    if (matched.current_count == 0) return result;
+
+    T msg;
+    memset(&msg, 0, sizeof(msg));
+    fill_payload(msg);
+
+    int64_t start = mono_ns();
+    int64_t end = start + s.duration_ms * 1000000LL;
+    int64_t period = s.rate > 0 ? 1000000000LL / s.rate : 0;
+    int64_t now = start;
+    while (now < end) {
+        if (period) {
+            int64_t due = start + (int64_t)result.sent * period;
+            while ((now = mono_ns()) < due) {}
+        }
+        set_sequence(msg, result.sent);
+        msg.timestamp_ns = dds_time();
+        if (!writer.write(msg, "bench-write")) result.failed++;
+        result.sent++;
+        if (c.write_batch > 0 && result.sent % c.write_batch == 0) writer.flush();
+        now = mono_ns();
+    }
+    writer.flush();
+    result.elapsed_s = (now - start) / 1e9;
+    result.ok = 1;
+    return result;
+}
+
+static double percentile_us(const std::vector<int64_t>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t i = std::min(sorted.size() - 1, (size_t)(q * sorted.size()));
+    return sorted[i] / 1000.0;
+}
+
+template<typename T, typename Desc>
+static ReaderResult run_reader(dds_entity_t participant, const char* topic, const Desc& desc,
+                               const Combo& c, const Settings& s) {
+    ReaderResult result = {0, 0, 0, 0, 0, 0, 0};
+    traced::Reader<T, Desc> reader(participant, topic, desc, endpoint_qos(c));
+
+    dds_entity_t waitset = dds_create_waitset(participant);
+    dds_waitset_attach(waitset, dds_create_readcondition(reader.get(), DDS_ANY_STATE), 0);
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(1 << 20);
+    int64_t first = 0, last = 0;
+    int64_t deadline = mono_ns() + (MATCH_TIMEOUT_S * 1000LL + s.duration_ms) * 1000000LL
+                       + IDLE_TIMEOUT_MS * 1000000LL;
+
+    while (true) {
+        dds_waitset_wait(waitset, nullptr, 0, DDS_MSECS(50));
+        int n;
+        while ((n = reader.take_simple("bench-take", [&](T& msg) {
+                    if (latencies.size() < MAX_LATENCIES) {
+                        latencies.push_back(dds_time() - msg.timestamp_ns);
+                    }
+                    result.received++;
+                })) > 0) {
+            last = mono_ns();
+            if (!first) first = last;
+        }
+        int64_t now = mono_ns();
+        if (first && now - last > IDLE_TIMEOUT_MS * 1000000LL) break;
+        if (now > deadline) break;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    result.elapsed_s = first ? (last - first) / 1e9 : 0;
+    result.p50_us = percentile_us(latencies, 0.50);
+    result.p99_us = percentile_us(latencies, 0.99);
+    result.p999_us = percentile_us(latencies, 0.999);
+    result.max_us = latencies.empty() ? 0 : latencies.back() / 1000.0;
+    result.ok = 1;
+    return result;
+}
+
+struct PayloadType {
+    const char* name;
+    WriterResult (*writer)(dds_entity_t, const char*, const Combo&, const Settings&);
+    ReaderResult (*reader)(dds_entity_t, const char*, const Combo&, const Settings&);
+};
+
+#define PAYLOAD(Type) \
+    {#Type, \
+     [](dds_entity_t p, const char* t, const Combo& c, const Settings& s) { \
+         return run_writer<combat_##Type>(p, t, combat_##Type##_desc, c, s); }, \
+     [](dds_entity_t p, const char* t, const Combo& c, const Settings& s) { \
+         return run_reader<combat_##Type>(p, t, combat_##Type##_desc, c, s); }}
+
+static const PayloadType PAYLOADS[] = {
+    PAYLOAD(MissionOrder),
+    PAYLOAD(ReconReport),
+    PAYLOAD(SupplyUpdate),
+    PAYLOAD(CombatAlert),
+    PAYLOAD(SourceTrack),
+    PAYLOAD(TacticalTrack),
+};
+static const int PAYLOAD_COUNT = sizeof(PAYLOADS) / sizeof(PAYLOADS[0]);
+
+static const char* TRACING_MODES[] = {"full", "sampled", "off"};
+
+// Runs in the forked child, before it creates any DDS or OTel state
+static void configure_tracing(int mode, const Settings& s) {
+    setenv("TRACED_TOPOLOGY", "0", 0);
+    setenv("TRACED_TIMESYNC", "0", 0);
+    setenv("TRACED_ECHO", "0", 0);
+    if (mode == 0) {
+        setenv("OTEL_TRACES_SAMPLER", "parentbased_always_on", 1);
+    } else if (mode == 1) {
+        setenv("OTEL_TRACES_SAMPLER", "parentbased_traceidratio", 1);
+        setenv("OTEL_TRACES_SAMPLER_ARG", s.sample_ratio, 1);
+    } else {
+        setenv("TRACED_TRACING", "off", 1);
+    }
+}
+
+// Fork a writer or reader; the result comes back over a pipe
+static pid_t spawn(bool is_writer, const Combo& c, const Settings& s, const char* topic, int* fd) {
+    int fds[2];
+    if (pipe(fds) < 0) return -1;
+    pid_t pid = fork();
+    if (pid != 0) {
+        close(fds[1]);
+        *fd = fds[0];
+        return pid;
+    }
+
+    close(fds[0]);
+    configure_tracing(c.tracing, s);
+    setenv("TRACED_SERVICE_NAME", is_writer ? SERVICE_NAME "-writer" : SERVICE_NAME "-reader", 1);
+
+    dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    if (participant < 0) _exit(1);
+    const PayloadType& type = PAYLOADS[c.type];
+    if (is_writer) {
+        WriterResult r = type.writer(participant, topic, c, s);
+        if (write(fds[1], &r, sizeof(r)) < 0) _exit(1);
+    } else {
+        ReaderResult r = type.reader(participant, topic, c, s);
+        if (write(fds[1], &r, sizeof(r)) < 0) _exit(1);
+    }
+    close(fds[1]);
+    dds_delete(participant);
+    _exit(0);
+}
+
+template<typename R>
+static bool collect(pid_t pid, int fd, R* result) {
+    memset(result, 0, sizeof(*result));
+    ssize_t n = pid > 0 ? read(fd, result, sizeof(*result)) : -1;
+    if (pid > 0) {
+        close(fd);
+        waitpid(pid, nullptr, 0);
+    }
+    return n == (ssize_t)sizeof(*result) && result->ok;
+}
+
+// ============ Matrix ============
+
+static std::vector<std::string> split(const char* list) {
+    std::vector<std::string> out;
+    for (const char* p = list; *p;) {
+        const char* end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len) out.emplace_back(p, len);
+        if (!end) break;
+        p = end + 1;
+    }
+    return out;
+}
+
+static bool parse_matrix(const char* types, const char* reliability, const char* history,
+                         const char* write_batch, const char* take_batch, const char* tracing,
+                         std::vector<Combo>& combos) {
+    std::vector<int> t_list, rel_list, hist_list, wb_list, tb_list, tr_list;
+    for (auto& name : split(types)) {
+        for (int i = 0; i < PAYLOAD_COUNT; i++) {
+            if (name == "all" || name == PAYLOADS[i].name) t_list.push_back(i);
+        }
+    }
+    for (auto& r : split(reliability)) {
+        if (r == "reliable") rel_list.push_back(DDS_RELIABILITY_RELIABLE);
+        else if (r == "best-effort") rel_list.push_back(DDS_RELIABILITY_BEST_EFFORT);
+        else return false;
+    }
+    for (auto& h : split(history)) hist_list.push_back(h == "all" ? 0 : atoi(h.c_str()));
+    for (auto& b : split(write_batch)) wb_list.push_back(atoi(b.c_str()));
+    for (auto& b : split(take_batch)) tb_list.push_back(atoi(b.c_str()));
+    for (auto& m : split(tracing)) {
+        int mode = -1;
+        for (int i = 0; i < 3; i++) {
+            if (m == TRACING_MODES[i]) mode = i;
+        }
+        if (mode < 0) return false;
+        tr_list.push_back(mode);
+    }
+
+    for (int tr : tr_list)
+        for (int t : t_list)
+            for (int rel : rel_list)
+                for (int hist : hist_list)
+                    for (int wb : wb_list)
+                        for (int tb : tb_list)
+                            combos.push_back({t, (dds_reliability_kind_t)rel, hist, wb, tb, tr});
+    return !combos.empty();
+}
+
+static void print_row(const Combo& c, bool ok, const WriterResult& w, const ReaderResult& r,
+                      bool csv) {
+    const char* rel = c.reliability == DDS_RELIABILITY_RELIABLE ? "reliable" : "best-effort";
+    char hist[16];
+    if (c.history > 0) snprintf(hist, sizeof(hist), "%d", c.history);
+    else snprintf(hist, sizeof(hist), "all");
+
+    double sent_rate = w.elapsed_s > 0 ? w.sent / w.elapsed_s : 0;
+    double recv_rate = r.elapsed_s > 0 ? r.received / r.elapsed_s : 0;
+    double loss = w.sent ? 100.0 * (double)(w.sent - std::min(w.sent, r.received)) / w.sent : 0;
+
+    if (csv) {
+        printf("%s,%s,%s,%s,%d,%d,%d,%.0f,%.0f,%.2f,%.1f,%.1f,%.1f,%.1f\n",
+               ok ? "ok" : "failed", PAYLOADS[c.type].name, TRACING_MODES[c.tracing], rel, c.history,
+               c.write_batch, c.take_batch, sent_rate, recv_rate, loss,
+               r.p50_us, r.p99_us, r.p999_us, r.max_us);
+    } else if (!ok) {
+        printf("%-14s %-7s %-11s %4s %6d %6d   (no match or child failed)\n",
+               PAYLOADS[c.type].name, TRACING_MODES[c.tracing], rel, hist, c.write_batch, c.take_batch);
+    } else {
+        printf("%-14s %-7s %-11s %4s %6d %6d %9.0f %9.0f %6.2f %8.1f %8.1f %8.1f %9.1f\n",
+               PAYLOADS[c.type].name, TRACING_MODES[c.tracing], rel, hist, c.write_batch, c.take_batch,
+               sent_rate, recv_rate, loss, r.p50_us, r.p99_us, r.p999_us, r.max_us);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    const char* types = "all";
+    const char* reliability = "reliable,best-effort";
+    const char* history = "1,100";
+    const char* write_batch = "0,32";
+    const char* take_batch = "1,10";
+    const char* tracing = "full,sampled,off";
+    bool csv = false;
+    Settings settings;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--types") == 0 && i + 1 < argc) types = argv[++i];
+        else if (strcmp(argv[i], "--reliability") == 0 && i + 1 < argc) reliability = argv[++i];
+        else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) history = argv[++i];
+        else if (strcmp(argv[i], "--write-batch") == 0 && i + 1 < argc) write_batch = argv[++i];
+        else if (strcmp(argv[i], "--take-batch") == 0 && i + 1 < argc) take_batch = argv[++i];
+        else if (strcmp(argv[i], "--tracing") == 0 && i + 1 < argc) tracing = argv[++i];
+        else if (strcmp(argv[i], "--duration-ms") == 0 && i + 1 < argc) settings.duration_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) settings.rate = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sample-ratio") == 0 && i + 1 < argc) settings.sample_ratio = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0) csv = true;
+        else {
+            fprintf(stderr, "usage: %s [--types all|MissionOrder,...] [--reliability reliable,best-effort]\n"
+                            "          [--history 1,100,all] [--write-batch 0,32] [--take-batch 1,10,64]\n"
+                            "          [--tracing full,sampled,off] [--duration-ms N] [--rate N]\n"
+                            "          [--sample-ratio R] [--csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Combo> combos;
+    if (!parse_matrix(types, reliability, history, write_batch, take_batch, tracing, combos)) {
+        fprintf(stderr, "[%s] Empty or invalid matrix\n", SERVICE_NAME);
+        return 1;
+    }
+
+    if (csv) {
+        printf("status,type,tracing,reliability,history,write_batch,take_batch,"
+               "sent_per_s,recv_per_s,loss_pct,p50_us,p99_us,p999_us,max_us\n");
+    } else {
+        printf("[%s] %zu combinations, %dms each, %s\n", SERVICE_NAME, combos.size(),
+               settings.duration_ms, settings.rate > 0 ? "paced" : "unpaced");
+        printf("\n%-14s %-7s %-11s %4s %6s %6s %9s %9s %6s %8s %8s %8s %9s\n",
+               "type", "tracing", "reliability", "hist", "wbatch", "tbatch",
+               "sent/s", "recv/s", "loss%", "p50 us", "p99 us", "p99.9 us", "max us");
+    }
+
+    for (size_t i = 0; i < combos.size(); i++) {
+        const Combo& c = combos[i];
+        char topic[64];
+        snprintf(topic, sizeof(topic), "QosBench%d_%zu", (int)getpid(), i);
+
+        int reader_fd = -1, writer_fd = -1;
+        pid_t reader_pid = spawn(false, c, settings, topic, &reader_fd);
+        pid_t writer_pid = spawn(true, c, settings, topic, &writer_fd);
+
+        WriterResult w;
+        ReaderResult r;
+        bool ok = collect(writer_pid, writer_fd, &w);
+        ok = collect(reader_pid, reader_fd, &r) && ok;
+        print_row(c, ok, w, r, csv);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Cyclictest-style jitter benchmark for the traced write/take path.
+//
+// Wakes up on an absolute periodic timer, writes a sample through
+// traced::Writer and takes it back through traced::Reader in the same
+// process. Reports worst case and tail percentiles, not just averages.
+//
+// Usage: app [--interval-us N] [--loops N] [--warmup N] [--rt]
+//   --rt sets TRACED_RT=1 (mlockall, prefaulting, SCHED_FIFO dispatch loop)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+
+#include "traced_dds.hpp"
+#include "CombatMessages.h"
+
+TRACED_DDS_TYPE(combat_MissionOrder);
+
+#define SERVICE_NAME "rt-jitter"
+#define HIST_MAX_US 100000  // 1us buckets up to 100ms, overflow above
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct Histogram {
+    const char* name;
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(HIST_MAX_US + 1, 0);
+    uint64_t count = 0;
+    int64_t min_ns = INT64_MAX;
+    int64_t max_ns = 0;
+    double sum_ns = 0;
+
+    explicit Histogram(const char* n) : name(n) {}
+
+    void record(int64_t ns) {
+        if (ns < 0) ns = 0;
+        int64_t us = ns / 1000;
+        buckets[us > HIST_MAX_US ? HIST_MAX_US : us]++;
+        count++;
+        min_ns = std::min(min_ns, ns);
+        max_ns = std::max(max_ns, ns);
+        sum_ns += ns;
+    }
+
+    // Upper bound of the bucket holding the given quantile, in us
+    int64_t percentile_us(double q) const {
+        uint64_t target = (uint64_t)(q * count);
+        uint64_t seen = 0;
+        for (int i = 0; i <= HIST_MAX_US; i++) {
+            seen += buckets[i];
+            if (seen > target) return i + 1;
+        }
+        return HIST_MAX_US;
+    }
+
+    void print() const {
+        if (count == 0) return;
+        printf("%-16s %8.1f %8.1f %7lld %7lld %7lld %8lld %9.1f %8llu\n",
+               name, min_ns / 1000.0, sum_ns / count / 1000.0,
+               (long long)percentile_us(0.50), (long long)percentile_us(0.99),
+               (long long)percentile_us(0.999), (long long)percentile_us(0.9999),
+               max_ns / 1000.0, (unsigned long long)buckets[HIST_MAX_US]);
+    }
+};
+
+int main(int argc, char** argv) {
+    int interval_us = 1000;
+    int loops = 10000;
+    int warmup = 1000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--interval-us") == 0 && i + 1 < argc) interval_us = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) loops = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rt") == 0) setenv("TRACED_RT", "1", 1);
+        else {
+            fprintf(stderr, "usage: %s [--interval-us N] [--loops N] [--warmup N] [--rt]\n", argv[0]);
+            return 1;
+        }
+    }
+    setenv("TRACED_SERVICE_NAME", SERVICE_NAME, 0);
+
+    dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    if (participant < 0) {
+        fprintf(stderr, "Failed to create participant!\n");
+        return 1;
+    }
+
+    auto writer = TRACED_WRITER(combat_MissionOrder, participant, "RtJitterTopic");
+    auto reader = TRACED_READER(combat_MissionOrder, participant, "RtJitterTopic");
+
+    printf("[%s] interval %dus, %d loops (+%d warm-up)\n", SERVICE_NAME, interval_us, loops, warmup);
+    sleep(1);  // local endpoint matching
+
+    Histogram wakeup("wakeup");
+    Histogram write_h("write");
+    Histogram deliver("write->callback");
+    Histogram cycle("cycle");
+
+    combat_MissionOrder msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.source_service = (char*)SERVICE_NAME;
+    msg.mission_id = (char*)"MSN-JITTER";
+    msg.mission_type = (char*)"RECON";
+    msg.priority = (char*)"HIGH";
+    msg.target_zone = (char*)"Alpha";
+    msg.commander_id = (char*)"CMD-1";
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (int i = 0; i < warmup + loops; i++) {
+        next.tv_nsec += interval_us * 1000L;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        int64_t expected = next.tv_sec * 1000000000LL + next.tv_nsec;
+        int64_t t_wake = now_ns();
+
+        msg.sequence_num = i;
+        msg.timestamp_ns = t_wake;
+        writer.write(msg, "jitter-write");
+        int64_t t_written = now_ns();
+
+        int64_t t_callback = 0;
+        reader.take_simple("jitter-take", [&](combat_MissionOrder&) {
+            t_callback = now_ns();
+        });
+        int64_t t_done = now_ns();
+
+        if (i < warmup) continue;
+        wakeup.record(t_wake - expected);
+        write_h.record(t_written - t_wake);
+        if (t_callback) deliver.record(t_callback - t_wake);
+        cycle.record(t_done - expected);
+    }
+
+    printf("\n%-16s %8s %8s %7s %7s %7s %8s %9s %8s\n",
+           "latency (us)", "min", "avg", "p50", "p99", "p99.9", "p99.99", "max", "overflow");
+    wakeup.print();
+    write_h.print();
+    deliver.print();
+    cycle.print();
+    if (deliver.count < (uint64_t)loops) {
+        printf("\n[%s] %llu of %d samples not delivered within their cycle\n",
+               SERVICE_NAME, (unsigned long long)(loops - deliver.count), loops);
+    }
+
+    dds_delete(participant);
+    return 0;
+}
@@ -0,0 +1,436 @@
+// Multi-process scale-out harness for the track fusion system on one host.
+//
+// Launches N instances of each service binary with distinct service names
+// and sensor IDs, lets them run for the configured time and collects the
+// TRACED_STATS_FILE of every instance (discovery time, samples written and
+// taken, take transit latency, CPU, RSS; see include/traced_stats.hpp).
+// Prints a summary per role and, with --per-process, one row per instance.
+//
+// Instances (environment set by the harness):
+//   radar/esm/optik-sensor-NN  SENSOR_ID=<TYPE>-NN, SENSOR_INTERVAL_MS
+//   track-fusion-N             FUSION_SHARD=N, FUSION_SHARDS
+//   track-consumer-NN
+// Each one logs to <out-dir>/<name>.log and writes <out-dir>/<name>.json.
+//
+// The middleware's background features (clock sync, topology, echo
+// responder, watchdog, flight recorder) are off in every instance unless
+// listed with --features: clock sync alone grows with the square of the
+// process count and would dominate what the harness measures. The report
+// names the features that ran.
+//
+// Usage: app [--sensors N] [--fusion-shards N] [--consumers N]
+//            [--sensor-interval-ms N] [--duration-s N] [--stagger-ms N]
+//            [--features LIST|all] [--bin-dir DIR] [--out-dir DIR] [--per-process]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define SERVICE_NAME "scale-harness"
+#define STOP_TIMEOUT_S 10
+
+extern char** environ;
+
+static volatile sig_atomic_t running = 1;
+
+void handle_signal(int sig) { running = 0; }
+
+static int64_t now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// Middleware features, enabled per instance by --features
+struct Feature {
+    const char* name;
+    const char* env;            // "0" disables, "1" enables
+};
+
+static const Feature FEATURES[] = {
+    {"timesync", "TRACED_TIMESYNC"},
+    {"topology", "TRACED_TOPOLOGY"},
+    {"echo",     "TRACED_ECHO"},
+    {"watchdog", "TRACED_WATCHDOG"},
+    {"recorder", "TRACED_FLIGHT_RECORDER"},
+};
+#define FEATURE_COUNT (sizeof(FEATURES) / sizeof(FEATURES[0]))
+
+// Comma-separated feature names or "all"; false on an unknown name
+static bool parse_features(const char* list, bool enabled[FEATURE_COUNT]) {
+    for (size_t f = 0; f < FEATURE_COUNT; f++) enabled[f] = strcmp(list, "all") == 0;
+    if (strcmp(list, "all") == 0 || !*list) return true;
+    std::string s(list);
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) end = s.size();
+        std::string name = s.substr(pos, end - pos);
+        pos = end + 1;
+        if (name.empty()) continue;
+        bool known = false;
+        for (size_t f = 0; f < FEATURE_COUNT; f++) {
+            if (name == FEATURES[f].name) enabled[f] = known = true;
+        }
+        if (!known) {
+            fprintf(stderr, "[%s] unknown feature '%s'\n", SERVICE_NAME, name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string feature_list(const bool enabled[FEATURE_COUNT]) {
+    std::string list;
+    for (size_t f = 0; f < FEATURE_COUNT; f++) {
+        if (!enabled[f]) continue;
+        if (!list.empty()) list += ",";
+        list += FEATURES[f].name;
+    }
+    return list.empty() ? "none" : list;
+}
+
+struct Instance {
+    std::string role;           // binary name, e.g. radar-sensor
+    std::string name;           // TRACED_SERVICE_NAME
+    std::vector<std::string> env;
+    pid_t pid = -1;
+    int status = 0;
+    bool exited = false;
+};
+
+// Last snapshot of an instance's statistics file
+struct Stats {
+    bool valid = false;
+    double uptime_ms = 0;
+    double endpoints = 0, matched = 0;
+    double discovery_ms = -1;
+    double written = 0, taken = 0;
+    double transit_p50_us = 0, transit_p99_us = 0, transit_max_us = 0;
+    double cpu_ms = 0, rss_kb = 0, max_rss_kb = 0;
+};
+
+static double field(const std::string& line, const char* key) {
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t pos = line.find(pattern);
+    return pos == std::string::npos ? 0 : strtod(line.c_str() + pos + pattern.size(), nullptr);
+}
+
+static Stats read_stats(const std::string& path) {
+    Stats s;
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return s;
+    char buf[1024];
+    if (fgets(buf, sizeof(buf), f)) {
+        std::string line(buf);
+        s.valid = line.find("\"service\"") != std::string::npos;
+        s.uptime_ms = field(line, "uptime_ms");
+        s.endpoints = field(line, "endpoints");
+        s.matched = field(line, "matched");
+        s.discovery_ms = field(line, "discovery_ms");
+        s.written = field(line, "written");
+        s.taken = field(line, "taken");
+        s.transit_p50_us = field(line, "transit_p50_us");
+        s.transit_p99_us = field(line, "transit_p99_us");
+        s.transit_max_us = field(line, "transit_max_us");
+        s.cpu_ms = field(line, "cpu_ms");
+        s.rss_kb = field(line, "rss_kb");
+        s.max_rss_kb = field(line, "max_rss_kb");
+    }
+    fclose(f);
+    return s;
+}
+
+static pid_t launch(Instance& inst, const std::string& bin_dir, const std::string& out_dir) {
+    std::string bin = bin_dir + "/" + inst.role;
+    std::string log = out_dir + "/" + inst.name + ".log";
+
+    // Inherited environment first, the instance's overrides win
+    std::vector<std::string> env;
+    for (char** e = environ; *e; e++) {
+        bool overridden = false;
+        for (const std::string& o : inst.env) {
+            size_t eq = o.find('=');
+            if (strncmp(*e, o.c_str(), eq + 1) == 0) overridden = true;
+        }
+        if (!overridden) env.emplace_back(*e);
+    }
+    env.insert(env.end(), inst.env.begin(), inst.env.end());
+
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+    std::vector<char*> envp;
+    for (std::string& e : env) envp.push_back(&e[0]);
+    envp.push_back(nullptr);
+    char* argv[] = {&bin[0], nullptr};
+    execve(bin.c_str(), argv, envp.data());
+    fprintf(stderr, "exec %s: %s\n", bin.c_str(), strerror(errno));
+    _exit(127);
+}
+
+static void reap(std::vector<Instance>& instances) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (Instance& inst : instances) {
+            if (inst.pid == pid) {
+                inst.exited = true;
+                inst.status = status;
+            }
+        }
+    }
+}
+
+static void stop_all(std::vector<Instance>& instances) {
+    for (Instance& inst : instances) {
+        if (inst.pid > 0 && !inst.exited) kill(inst.pid, SIGTERM);
+    }
+    int64_t give_up = now_ms() + STOP_TIMEOUT_S * 1000;
+    while (now_ms() < give_up) {
+        reap(instances);
+        bool all = std::all_of(instances.begin(), instances.end(),
+                               [](const Instance& i) { return i.pid <= 0 || i.exited; });
+        if (all) return;
+        usleep(50000);
+    }
+    for (Instance& inst : instances) {
+        if (inst.pid > 0 && !inst.exited) {
+            fprintf(stderr, "[%s] %s did not stop, killing\n", SERVICE_NAME, inst.name.c_str());
+            kill(inst.pid, SIGKILL);
+        }
+    }
+    while (waitpid(-1, nullptr, 0) > 0) {}
+}
+
+static double percentile(std::vector<double> v, double q) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(q * v.size()))];
+}
+
+static void print_summary(const char* role, const std::vector<Instance>& instances,
+                          const std::vector<Stats>& stats) {
+    std::vector<double> discovery, p50, p99, cpu_pct, rss_mb;
+    double written_rate = 0, taken_rate = 0;
+    int count = 0, reported = 0, discovered = 0, failed = 0;
+    for (size_t i = 0; i < instances.size(); i++) {
+        if (instances[i].role != role) continue;
+        count++;
+        const Instance& inst = instances[i];
+        if (inst.exited && !(WIFSIGNALED(inst.status) && WTERMSIG(inst.status) == SIGTERM) &&
+            !(WIFEXITED(inst.status) && WEXITSTATUS(inst.status) == 0)) {
+            failed++;
+        }
+        const Stats& s = stats[i];
+        if (!s.valid) continue;
+        reported++;
+        double uptime_s = s.uptime_ms / 1000.0;
+        if (s.discovery_ms >= 0) {
+            discovered++;
+            discovery.push_back(s.discovery_ms);
+        }
+        if (uptime_s > 0) {
+            written_rate += s.written / uptime_s;
+            taken_rate += s.taken / uptime_s;
+            cpu_pct.push_back(100.0 * s.cpu_ms / s.uptime_ms);
+        }
+        if (s.taken > 0) {
+            p50.push_back(s.transit_p50_us);
+            p99.push_back(s.transit_p99_us);
+        }
+        rss_mb.push_back(s.rss_kb / 1024.0);
+    }
+    if (count == 0) return;
+    printf("%-15s %4d %4d %4d %4d %8.0f %8.0f %9.1f %9.1f %8.0f %8.0f %6.1f %6.1f %6.1f %6.1f\n",
+           role, count, reported, discovered, failed,
+           percentile(discovery, 0.5), percentile(discovery, 1.0),
+           written_rate, taken_rate,
+           percentile(p50, 0.5), percentile(p99, 1.0),
+           percentile(cpu_pct, 0.5), percentile(cpu_pct, 1.0),
+           percentile(rss_mb, 0.5), percentile(rss_mb, 1.0));
+}
+
+int main(int argc, char** argv) {
+    int sensors = 50;
+    int fusion_shards = 4;
+    int consumers = 20;
+    int sensor_interval_ms = 2000;
+    int duration_s = 60;
+    int stagger_ms = 0;
+    std::string bin_dir = "/app/bin";
+    std::string out_dir = "/tmp/scale";
+    bool per_process = false;
+    bool features[FEATURE_COUNT] = {};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sensors") == 0 && i + 1 < argc) sensors = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fusion-shards") == 0 && i + 1 < argc) fusion_shards = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--consumers") == 0 && i + 1 < argc) consumers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--sensor-interval-ms") == 0 && i + 1 < argc) sensor_interval_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--duration-s") == 0 && i + 1 < argc) duration_s = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--stagger-ms") == 0 && i + 1 < argc) stagger_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bin-dir") == 0 && i + 1 < argc) bin_dir = argv[++i];
+        else if (strcmp(argv[i], "--out-dir") == 0 && i + 1 < argc) out_dir = argv[++i];
+        else if (strcmp(argv[i], "--per-process") == 0) per_process = true;
+        else if (strcmp(argv[i], "--features") == 0 && i + 1 < argc && parse_features(argv[i + 1], features)) i++;
+        else {
+            fprintf(stderr, "usage: %s [--sensors N] [--fusion-shards N] [--consumers N]\n"
+                            "          [--sensor-interval-ms N] [--duration-s N] [--stagger-ms N]\n"
+                            "          [--features LIST|all] [--bin-dir DIR] [--out-dir DIR] [--per-process]\n"
+                            "features: timesync, topology, echo, watchdog, recorder (default: none)\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (fusion_shards < 1) fusion_shards = 1;
+    mkdir(out_dir.c_str(), 0755);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    // Nothing may block on the OTLP endpoint at this scale
+    setenv("TRACED_SPAN_PROCESSOR", "batch", 0);
+
+    // Consumers and fusion first, so sensor discovery includes their readers
+    std::vector<Instance> instances;
+    char name[64], value[96];
+    for (int i = 0; i < consumers; i++) {
+        Instance inst;
+        inst.role = "track-consumer";
+        snprintf(name, sizeof(name), "track-consumer-%02d", i + 1);
+        inst.name = name;
+        instances.push_back(inst);
+    }
+    for (int i = 0; i < fusion_shards; i++) {
+        Instance inst;
+        inst.role = "track-fusion";
+        snprintf(name, sizeof(name), "track-fusion-%d", i);
+        inst.name = name;
+        snprintf(value, sizeof(value), "FUSION_SHARD=%d", i);
+        inst.env.push_back(value);
+        snprintf(value, sizeof(value), "FUSION_SHARDS=%d", fusion_shards);
+        inst.env.push_back(value);
+        instances.push_back(inst);
+    }
+    static const char* SENSOR_ROLES[][2] = {
+        {"radar-sensor", "RADAR"}, {"esm-sensor", "ESM"}, {"optik-sensor", "OPTIK"}
+    };
+    for (int i = 0; i < sensors; i++) {
+        Instance inst;
+        inst.role = SENSOR_ROLES[i % 3][0];
+        snprintf(name, sizeof(name), "%s-%02d", SENSOR_ROLES[i % 3][0], i + 1);
+        inst.name = name;
+        snprintf(value, sizeof(value), "SENSOR_ID=%s-%02d", SENSOR_ROLES[i % 3][1], i + 1);
+        inst.env.push_back(value);
+        snprintf(value, sizeof(value), "SENSOR_INTERVAL_MS=%d", sensor_interval_ms);
+        inst.env.push_back(value);
+        instances.push_back(inst);
+    }
+    for (Instance& inst : instances) {
+        inst.env.push_back("TRACED_SERVICE_NAME=" + inst.name);
+        inst.env.push_back("TRACED_STATS_FILE=" + out_dir + "/" + inst.name + ".json");
+        for (size_t f = 0; f < FEATURE_COUNT; f++) {
+            inst.env.push_back(std::string(FEATURES[f].env) + (features[f] ? "=1" : "=0"));
+        }
+        unlink((out_dir + "/" + inst.name + ".json").c_str());
+    }
+
+    printf("[%s] %d sensors (every %dms), %d fusion shards, %d consumers for %ds -> %s\n",
+           SERVICE_NAME, sensors, sensor_interval_ms, fusion_shards, consumers, duration_s,
+           out_dir.c_str());
+    printf("[%s] Middleware features: %s\n", SERVICE_NAME, feature_list(features).c_str());
+    fflush(stdout);
+
+    int64_t start = now_ms();
+    for (Instance& inst : instances) {
+        if (!running) break;
+        inst.pid = launch(inst, bin_dir, out_dir);
+        if (inst.pid < 0) fprintf(stderr, "[%s] fork failed for %s\n", SERVICE_NAME, inst.name.c_str());
+        if (stagger_ms > 0) usleep(stagger_ms * 1000);
+    }
+    printf("[%s] %zu processes launched in %lldms\n", SERVICE_NAME, instances.size(),
+           (long long)(now_ms() - start));
+
+    int64_t end = start + duration_s * 1000LL;
+    int64_t next_progress = start + 5000;
+    int64_t all_discovered_ms = -1;
+    while (running && now_ms() < end) {
+        usleep(200000);
+        reap(instances);
+        if (all_discovered_ms >= 0 && now_ms() < next_progress) continue;
+
+        int discovered = 0, alive = 0;
+        for (const Instance& inst : instances) {
+            if (inst.pid > 0 && !inst.exited) alive++;
+            Stats s = read_stats(out_dir + "/" + inst.name + ".json");
+            if (s.valid && s.discovery_ms >= 0) discovered++;
+        }
+        if (all_discovered_ms < 0 && discovered == (int)instances.size()) {
+            all_discovered_ms = now_ms() - start;
+            printf("[%s] All %d processes discovered their peers after %lldms\n",
+                   SERVICE_NAME, discovered, (long long)all_discovered_ms);
+        }
+        if (now_ms() >= next_progress) {
+            printf("[%s] t=%llds alive %d/%zu, discovered %d\n", SERVICE_NAME,
+                   (long long)((now_ms() - start) / 1000), alive, instances.size(), discovered);
+            next_progress += 5000;
+        }
+        fflush(stdout);
+    }
+
+    printf("[%s] Stopping...\n", SERVICE_NAME);
+    stop_all(instances);
+
+    std::vector<Stats> stats;
+    for (const Instance& inst : instances) stats.push_back(read_stats(out_dir + "/" + inst.name + ".json"));
+
+    printf("\nMiddleware features: %s\n", feature_list(features).c_str());
+    printf("\n%-15s %4s %4s %4s %4s %8s %8s %9s %9s %8s %8s %6s %6s %6s %6s\n",
+           "role", "n", "rep", "disc", "fail", "disc p50", "disc max", "written/s", "taken/s",
+           "tr p50", "tr p99", "cpu%", "cpu%mx", "rss MB", "rss mx");
+    printf("%-15s %4s %4s %4s %4s %8s %8s %9s %9s %8s %8s %6s %6s %6s %6s\n",
+           "", "", "", "", "", "ms", "ms", "(sum)", "(sum)", "us", "us max", "p50", "", "p50", "");
+    for (const auto& role : SENSOR_ROLES) print_summary(role[0], instances, stats);
+    print_summary("track-fusion", instances, stats);
+    print_summary("track-consumer", instances, stats);
+    if (all_discovered_ms >= 0) {
+        printf("\nAll processes discovered after %lldms\n", (long long)all_discovered_ms);
+    } else {
+        printf("\nNot every process discovered its peers within %ds\n", duration_s);
+    }
+
+    if (per_process) {
+        printf("\n%-20s %8s %9s %9s %8s %8s %8s %7s %8s\n", "process", "disc ms",
+               "written", "taken", "tr p50", "tr p99", "tr max", "cpu%", "maxrss");
+        for (size_t i = 0; i < instances.size(); i++) {
+            const Stats& s = stats[i];
+            if (!s.valid) {
+                printf("%-20s (no statistics, see %s/%s.log)\n", instances[i].name.c_str(),
+                       out_dir.c_str(), instances[i].name.c_str());
+                continue;
+            }
+            printf("%-20s %8.0f %9.0f %9.0f %8.0f %8.0f %8.0f %7.1f %6.0fMB\n",
+                   instances[i].name.c_str(), s.discovery_ms, s.written, s.taken,
+                   s.transit_p50_us, s.transit_p99_us, s.transit_max_us,
+                   s.uptime_ms > 0 ? 100.0 * s.cpu_ms / s.uptime_ms : 0, s.max_rss_kb / 1024.0);
+        }
+    }
+    return 0;
+}
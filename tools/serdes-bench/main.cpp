@@ -0,0 +1,302 @@
+// CDR serialization cost benchmark for the CombatMessages types.
+//
+// Runs the idlc-generated type descriptors through CycloneDDS's own
+// serdata path, the code dds_write and dds_take execute, without any
+// network or tracing in between:
+//   serialize   - ddsi_serdata_from_sample + copy out of the serdata
+//   deserialize - ddsi_serdata_from_ser_iov + ddsi_serdata_to_sample into a
+//                 reused sample (strings are reused like loaned take buffers)
+//   bytes       - encoded size including the 4-byte encapsulation header
+//
+// Every CombatMessages type is measured with the string TraceContext it
+// uses today. The trace context alone and SourceTrack (the highest-rate
+// topic) are also measured with the bounded and binary variants from
+// shared/TraceContextVariants.idl. Each case runs once per data
+// representation the CycloneDDS build supports (XCDR1, XCDR2).
+//
+// Usage: app [--min-time-ms N] [--rounds N] [--csv]
+//   each figure is the median of --rounds runs of at least --min-time-ms
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+
+#include "dds/dds.h"
+#include "dds/ddsi/ddsi_serdata.h"
+#include "dds/ddsi/ddsi_sertype.h"
+#include "CombatMessages.h"
+#include "TraceContextVariants.h"
+#include "payloads.h"
+
+#define SERVICE_NAME "serdes-bench"
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// ============ Sample contents ============
+
+// What traced::Writer injects: W3C hex ids, empty parent
+static const char* TRACE_ID = "4bf92f3577b34da6a3ce929d0e0e4736";
+static const char* SPAN_ID = "00f067aa0ba902b7";
+
+static void hex_to_bytes(const char* hex, uint8_t* out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        unsigned int byte = 0;
+        sscanf(hex + 2 * i, "%2x", &byte);
+        out[i] = (uint8_t)byte;
+    }
+}
+
+static void fill(combat_TraceContext& tc) {
+    tc.trace_id = (char*)TRACE_ID;
+    tc.span_id = (char*)SPAN_ID;
+    tc.parent_span_id = (char*)"";
+    tc.trace_flags = 1;
+    tc.sequence = 417;
+}
+
+static void fill(bench_TraceContextBounded& tc) {
+    snprintf(tc.trace_id, sizeof(tc.trace_id), "%s", TRACE_ID);
+    snprintf(tc.span_id, sizeof(tc.span_id), "%s", SPAN_ID);
+    tc.parent_span_id[0] = '\0';
+    tc.trace_flags = 1;
+    tc.sequence = 417;
+}
+
+static void fill(bench_TraceContextBinary& tc) {
+    hex_to_bytes(TRACE_ID, tc.trace_id, sizeof(tc.trace_id));
+    hex_to_bytes(SPAN_ID, tc.span_id, sizeof(tc.span_id));
+    memset(tc.parent_span_id, 0, sizeof(tc.parent_span_id));
+    tc.trace_flags = 1;
+    tc.sequence = 417;
+}
+
+static void fill(combat_MissionOrder& m) {
+    fill(m.trace_ctx);
+    fill_payload(m);
+    m.timestamp_ns = 1760000000000000000LL;
+    m.sequence_num = 417;
+}
+
+static void fill(combat_ReconReport& m) {
+    fill(m.trace_ctx);
+    fill_payload(m);
+    m.timestamp_ns = 1760000000000000000LL;
+}
+
+static void fill(combat_SupplyUpdate& m) {
+    fill(m.trace_ctx);
+    fill_payload(m);
+    m.timestamp_ns = 1760000000000000000LL;
+}
+
+static void fill(combat_CombatAlert& m) {
+    fill(m.trace_ctx);
+    fill_payload(m);
+    m.timestamp_ns = 1760000000000000000LL;
+}
+
+// combat_SourceTrack and the bench variants share every other field
+template<typename T>
+static void fill_source_track(T& m) {
+    fill(m.trace_ctx);
+    fill_source_track_payload(m);
+    m.timestamp_ns = 1760000000000000000LL;
+}
+
+static void fill(combat_SourceTrack& m) { fill_source_track(m); }
+static void fill(bench_SourceTrackBounded& m) { fill_source_track(m); }
+static void fill(bench_SourceTrackBinary& m) { fill_source_track(m); }
+
+static void fill(combat_TacticalTrack& m) {
+    fill(m.trace_ctx);
+    fill_payload(m);
+    m.timestamp_ns = 1760000000000000000LL;
+}
+
+// ============ Cases ============
+
+struct Case {
+    const char* type;
+    const char* trace_ctx;      // string, bounded, binary
+    const dds_topic_descriptor_t* desc;
+    const void* sample;
+    size_t sample_size;
+};
+
+template<typename T>
+static Case make_case(const char* type, const char* trace_ctx, const dds_topic_descriptor_t& desc) {
+    static T sample;            // one per instantiation, i.e. per IDL type
+    memset(&sample, 0, sizeof(sample));
+    fill(sample);
+    return {type, trace_ctx, &desc, &sample, sizeof(T)};
+}
+
+struct Representation {
+    const char* name;
+    const struct ddsi_sertype* sertype;
+    struct ddsi_sertype* derived;   // to unref, nullptr for the topic's own
+};
+
+// XCDR2 arrived with CycloneDDS 0.10; older builds only encode XCDR1
+static std::vector<Representation> representations(const struct ddsi_sertype* base) {
+    std::vector<Representation> reps;
+#ifdef DDS_DATA_REPRESENTATION_XCDR2
+    dds_type_consistency_enforcement_qospolicy_t tce{};
+    struct ddsi_sertype* xcdr1 = ddsi_sertype_derive_sertype(base, DDS_DATA_REPRESENTATION_XCDR1, tce);
+    struct ddsi_sertype* xcdr2 = ddsi_sertype_derive_sertype(base, DDS_DATA_REPRESENTATION_XCDR2, tce);
+    if (xcdr1) reps.push_back({"xcdr1", xcdr1, xcdr1});
+    if (xcdr2) reps.push_back({"xcdr2", xcdr2, xcdr2});
+#endif
+    if (reps.empty()) reps.push_back({"xcdr1", base, nullptr});
+    return reps;
+}
+
+struct Result {
+    uint32_t bytes;
+    double serialize_ns;
+    double deserialize_ns;
+};
+
+// Median over rounds of the mean time per op, each round at least min_ns long
+template<typename Op>
+static double time_op(Op&& op, int64_t min_ns, int rounds) {
+    for (int i = 0; i < 1000; i++) op();  // warm caches and allocator
+
+    std::vector<double> per_op;
+    for (int r = 0; r < rounds; r++) {
+        uint64_t iterations = 0;
+        int64_t start = now_ns();
+        int64_t elapsed;
+        do {
+            for (int i = 0; i < 256; i++) op();
+            iterations += 256;
+            elapsed = now_ns() - start;
+        } while (elapsed < min_ns);
+        per_op.push_back((double)elapsed / iterations);
+    }
+    std::sort(per_op.begin(), per_op.end());
+    return per_op[per_op.size() / 2];
+}
+
+static Result measure(const struct ddsi_sertype* sertype, const Case& c, int64_t min_ns, int rounds) {
+    Result result = {0, 0, 0};
+    struct ddsi_serdata* sd = ddsi_serdata_from_sample(sertype, SDK_DATA, c.sample);
+    if (!sd) return result;
+    result.bytes = ddsi_serdata_size(sd);
+    std::vector<char> encoded(result.bytes);
+    ddsi_serdata_to_ser(sd, 0, result.bytes, encoded.data());
+    ddsi_serdata_unref(sd);
+
+    std::vector<char> out(c.sample_size, 0);
+    ddsrt_iovec_t iov;
+    iov.iov_base = encoded.data();
+    iov.iov_len = result.bytes;
+
+    std::vector<char> scratch(result.bytes);
+    result.serialize_ns = time_op([&]() {
+        struct ddsi_serdata* d = ddsi_serdata_from_sample(sertype, SDK_DATA, c.sample);
+        ddsi_serdata_to_ser(d, 0, result.bytes, scratch.data());
+        ddsi_serdata_unref(d);
+    }, min_ns, rounds);
+
+    result.deserialize_ns = time_op([&]() {
+        struct ddsi_serdata* d = ddsi_serdata_from_ser_iov(sertype, SDK_DATA, 1, &iov, result.bytes);
+        ddsi_serdata_to_sample(d, out.data(), nullptr, nullptr);
+        ddsi_serdata_unref(d);
+    }, min_ns, rounds);
+
+    // The decoded sample must match what was encoded
+    sd = ddsi_serdata_from_sample(sertype, SDK_DATA, out.data());
+    bool same = sd && ddsi_serdata_size(sd) == result.bytes;
+    if (same) {
+        ddsi_serdata_to_ser(sd, 0, result.bytes, scratch.data());
+        same = memcmp(scratch.data(), encoded.data(), result.bytes) == 0;
+    }
+    if (!same) {
+        fprintf(stderr, "[%s] %s/%s does not round-trip\n", SERVICE_NAME, c.type, c.trace_ctx);
+    }
+    if (sd) ddsi_serdata_unref(sd);
+    ddsi_sertype_free_sample(sertype, out.data(), DDS_FREE_CONTENTS);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    int min_time_ms = 200;
+    int rounds = 5;
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--min-time-ms") == 0 && i + 1 < argc) min_time_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) rounds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--csv") == 0) csv = true;
+        else {
+            fprintf(stderr, "usage: %s [--min-time-ms N] [--rounds N] [--csv]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (rounds < 1) rounds = 1;
+
+    // Topics only, for the sertypes; nothing is written
+    dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    if (participant < 0) {
+        fprintf(stderr, "Failed to create participant!\n");
+        return 1;
+    }
+
+    const Case cases[] = {
+        make_case<combat_TraceContext>("TraceContext", "string", combat_TraceContext_desc),
+        make_case<bench_TraceContextBounded>("TraceContext", "bounded", bench_TraceContextBounded_desc),
+        make_case<bench_TraceContextBinary>("TraceContext", "binary", bench_TraceContextBinary_desc),
+        make_case<combat_MissionOrder>("MissionOrder", "string", combat_MissionOrder_desc),
+        make_case<combat_ReconReport>("ReconReport", "string", combat_ReconReport_desc),
+        make_case<combat_SupplyUpdate>("SupplyUpdate", "string", combat_SupplyUpdate_desc),
+        make_case<combat_CombatAlert>("CombatAlert", "string", combat_CombatAlert_desc),
+        make_case<combat_SourceTrack>("SourceTrack", "string", combat_SourceTrack_desc),
+        make_case<bench_SourceTrackBounded>("SourceTrack", "bounded", bench_SourceTrackBounded_desc),
+        make_case<bench_SourceTrackBinary>("SourceTrack", "binary", bench_SourceTrackBinary_desc),
+        make_case<combat_TacticalTrack>("TacticalTrack", "string", combat_TacticalTrack_desc),
+    };
+
+    if (csv) {
+        printf("type,trace_ctx,representation,bytes,serialize_ns,deserialize_ns\n");
+    } else {
+        printf("[%s] median of %d rounds, >= %dms each\n", SERVICE_NAME, rounds, min_time_ms);
+        printf("\n%-14s %-9s %-6s %6s %10s %10s %10s\n",
+               "type", "trace_ctx", "repr", "bytes", "ser ns", "deser ns", "total ns");
+    }
+
+    int64_t min_ns = min_time_ms * 1000000LL;
+    for (const Case& c : cases) {
+        char topic_name[64];
+        snprintf(topic_name, sizeof(topic_name), "SerdesBench_%s_%s", c.type, c.trace_ctx);
+        dds_entity_t topic = dds_create_topic(participant, c.desc, topic_name, NULL, NULL);
+        const struct ddsi_sertype* base = nullptr;
+        if (topic < 0 || dds_get_entity_sertype(topic, &base) < 0) {
+            fprintf(stderr, "[%s] No sertype for %s\n", SERVICE_NAME, topic_name);
+            continue;
+        }
+
+        for (const Representation& rep : representations(base)) {
+            Result r = measure(rep.sertype, c, min_ns, rounds);
+            if (csv) {
+                printf("%s,%s,%s,%u,%.1f,%.1f\n", c.type, c.trace_ctx, rep.name,
+                       r.bytes, r.serialize_ns, r.deserialize_ns);
+            } else {
+                printf("%-14s %-9s %-6s %6u %10.1f %10.1f %10.1f\n", c.type, c.trace_ctx, rep.name,
+                       r.bytes, r.serialize_ns, r.deserialize_ns, r.serialize_ns + r.deserialize_ns);
+            }
+            fflush(stdout);
+            if (rep.derived) ddsi_sertype_unref(rep.derived);
+        }
+    }
+
+    dds_delete(participant);
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Prints the live service dependency graph assembled from the TracedTopology
+// tables every traced service publishes (see traced_topology.hpp).
+//
+// Usage: app [--dot] [--interval-s N] [--once]
+//   app                 # refreshing table of upstream -> service edges
+//   app --dot --once    # one Graphviz snapshot, e.g. | dot -Tsvg > graph.svg
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "traced_dds.hpp"
+
+#define MAX_SAMPLES 32
+
+static volatile sig_atomic_t g_running = 1;
+
+static void on_signal(int) { g_running = 0; }
+
+int main(int argc, char** argv) {
+    bool dot = false;
+    bool once = false;
+    int interval_s = 5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dot") == 0) dot = true;
+        else if (strcmp(argv[i], "--once") == 0) once = true;
+        else if (strcmp(argv[i], "--interval-s") == 0 && i + 1 < argc) interval_s = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--dot] [--interval-s N] [--once]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (interval_s <= 0) interval_s = 5;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    if (participant < 0) {
+        fprintf(stderr, "Failed to create participant!\n");
+        return 1;
+    }
+
+    dds_entity_t topic = dds_create_topic(participant, &traced_ServiceTopology_desc,
+                                          traced::topology::TOPOLOGY_TOPIC, NULL, NULL);
+    dds_qos_t* qos = traced::topology::Publisher::create_qos();
+    dds_entity_t reader = dds_create_reader(participant, topic, qos, NULL);
+    dds_delete_qos(qos);
+    if (reader < 0) {
+        fprintf(stderr, "Failed to create reader!\n");
+        dds_delete(participant);
+        return 1;
+    }
+
+    traced::topology::Graph graph;
+    void* samples[MAX_SAMPLES];
+    dds_sample_info_t infos[MAX_SAMPLES];
+    dds_time_t next_print = dds_time() + DDS_SECS(interval_s);
+
+    while (g_running) {
+        memset(samples, 0, sizeof(samples));
+        int n = dds_take(reader, samples, infos, MAX_SAMPLES, MAX_SAMPLES);
+        dds_time_t now = dds_time();
+        for (int i = 0; i < n; i++) {
+            if (infos[i].valid_data) graph.update(*(traced_ServiceTopology*)samples[i], now);
+        }
+        if (n > 0) dds_return_loan(reader, samples, n);
+
+        if (now >= next_print) {
+            graph.expire(now);
+            if (dot) {
+                graph.print_dot(stdout);
+            } else {
+                printf("\n=== %zu services, %zu edges ===\n", graph.service_count(), graph.edges().size());
+                graph.print(stdout);
+            }
+            fflush(stdout);
+            if (once) break;
+            next_print = now + DDS_SECS(interval_s);
+        }
+
+        struct timespec ts = {0, 100000000};
+        nanosleep(&ts, NULL);
+    }
+
+    dds_delete(participant);
+    return 0;
+}
@@ -0,0 +1,789 @@
+// Offline critical-path analyzer for exported spans.
+//
+// Usage: app [options] <file>...
+//   --perfetto <out.json>   Chrome/Perfetto trace JSON of the slowest traces
+//   --perfetto-traces N     traces kept for --perfetto (default: 50)
+//   --window-s N            span time a trace stays open for late spans (default: 30)
+//   --max-open N            open traces before the oldest is closed early (default: 100000)
+//   --link-index N          spans remembered to resolve fan-in links (default: 500000)
+//
+// Input files are JSON lines in either format:
+//   flight recorder dumps   flight-<service>-*.jsonl (traced_recorder.hpp)
+//   OTLP JSON               one {"resourceSpans":[...]} request per line, as
+//                           written by the Collector's file exporter
+//
+// Files are merged by span start time. Traces are assembled while the spans
+// stream past and closed once no span arrived for --window-s, so memory is
+// bounded by the window, not by the input. Per closed trace the critical path
+// (root -> latest ending span) is broken down into DDS hops (transit, queue,
+// processing) and per-span self time. Fan-in roots such as fuse-tracks are
+// resolved through their link.N.span_id attributes to the source spans.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// ============ Spans ============
+
+enum Kind : uint8_t { KIND_INTERNAL = 0, KIND_SERVER, KIND_CLIENT, KIND_PRODUCER, KIND_CONSUMER };
+enum Operation : uint8_t { OP_NONE = 0, OP_SEND, OP_RECEIVE };
+
+struct TraceId {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+    bool operator==(const TraceId& o) const { return hi == o.hi && lo == o.lo; }
+};
+
+struct TraceIdHash {
+    size_t operator()(const TraceId& t) const { return t.hi ^ (t.lo * 0x9e3779b97f4a7c15ULL); }
+};
+
+struct Span {
+    TraceId trace;
+    uint64_t span_id = 0;
+    uint64_t parent_id = 0;
+    uint32_t name = 0;              // Strings index
+    uint32_t service = 0;           // Strings index
+    uint8_t kind = KIND_INTERNAL;
+    uint8_t op = OP_NONE;
+    bool error = false;
+    int64_t start_ns = 0;
+    int64_t end_ns = 0;
+    int64_t transit_ns = -1;        // messaging.dds.transit_ns
+    int64_t queue_ns = -1;          // messaging.dds.queue_ns
+    std::vector<uint64_t> links;    // linked span ids (fan-in)
+};
+
+// Span and service names repeat in every trace; keep one copy of each
+class Strings {
+public:
+    uint32_t intern(const std::string& s) {
+        auto it = index_.find(s);
+        if (it != index_.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(values_.size());
+        values_.push_back(s);
+        index_.emplace(s, id);
+        return id;
+    }
+    const std::string& operator[](uint32_t id) const { return values_[id]; }
+
+private:
+    std::unordered_map<std::string, uint32_t> index_;
+    std::vector<std::string> values_;
+};
+
+static Strings g_strings;
+
+static uint64_t parse_hex(const std::string& s, size_t offset, size_t len) {
+    uint64_t v = 0;
+    for (size_t i = offset; i < offset + len && i < s.size(); i++) {
+        char c = s[i];
+        int d = (c >= '0' && c <= '9') ? c - '0'
+              : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+              : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : 0;
+        v = (v << 4) | d;
+    }
+    return v;
+}
+
+static TraceId parse_trace_id(const std::string& s) {
+    TraceId t;
+    t.hi = parse_hex(s, 0, 16);
+    t.lo = parse_hex(s, 16, 16);
+    return t;
+}
+
+static int64_t json_int(const json& v) {
+    if (v.is_number()) return v.get<int64_t>();
+    if (v.is_string()) return strtoll(v.get_ref<const std::string&>().c_str(), NULL, 10);
+    return 0;
+}
+
+static bool ends_with(const std::string& s, const char* suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// Attributes the analysis needs, in either encoding
+static void apply_attribute(Span& span, const std::string& key, const json& value) {
+    if (key == "messaging.operation" && value.is_string()) {
+        const std::string& op = value.get_ref<const std::string&>();
+        span.op = op == "send" ? OP_SEND : op == "receive" ? OP_RECEIVE : OP_NONE;
+    } else if (key == "messaging.dds.transit_ns") {
+        span.transit_ns = json_int(value);
+    } else if (key == "messaging.dds.queue_ns") {
+        span.queue_ns = json_int(value);
+    } else if (key.compare(0, 5, "link.") == 0 && ends_with(key, ".span_id") && value.is_string()) {
+        span.links.push_back(parse_hex(value.get_ref<const std::string&>(), 0, 16));
+    }
+}
+
+static uint8_t kind_from_name(const std::string& kind) {
+    static const char* names[] = {"internal", "server", "client", "producer", "consumer"};
+    for (uint8_t i = 0; i < 5; i++) {
+        if (kind == names[i]) return i;
+    }
+    return KIND_INTERNAL;
+}
+
+// One flight recorder span line (the header line only sets the service)
+static bool parse_flight_span(const json& j, uint32_t service, Span& span) {
+    span.trace = parse_trace_id(j.value("trace_id", ""));
+    span.span_id = parse_hex(j.value("span_id", ""), 0, 16);
+    span.parent_id = parse_hex(j.value("parent_span_id", ""), 0, 16);
+    span.name = g_strings.intern(j.value("name", ""));
+    span.service = service;
+    span.kind = kind_from_name(j.value("kind", ""));
+    span.error = j.value("status", "") == "ERROR";
+    span.start_ns = j.value("start_unix_ns", (int64_t)0);
+    span.end_ns = span.start_ns + j.value("duration_ns", (int64_t)0);
+    auto attrs = j.find("attributes");
+    if (attrs != j.end() && attrs->is_object()) {
+        for (auto it = attrs->begin(); it != attrs->end(); ++it) apply_attribute(span, it.key(), it.value());
+    }
+    return span.span_id != 0;
+}
+
+// Member of an object, or null when absent (no copies, unlike json::value)
+static const json& member(const json& j, const char* key) {
+    static const json null_value;
+    auto it = j.find(key);
+    return it == j.end() ? null_value : *it;
+}
+
+static const json* otlp_value(const json& any) {
+    for (const char* type : {"stringValue", "intValue", "doubleValue", "boolValue"}) {
+        auto it = any.find(type);
+        if (it != any.end()) return &*it;
+    }
+    return nullptr;
+}
+
+// Spans of one OTLP JSON ExportTraceServiceRequest
+static void parse_otlp(const json& j, std::vector<Span>& out) {
+    for (const json& rs : member(j, "resourceSpans")) {
+        std::string service = "unknown";
+        for (const json& a : member(member(rs, "resource"), "attributes")) {
+            const json* v = otlp_value(member(a, "value"));
+            if (a.value("key", "") == "service.name" && v && v->is_string()) service = v->get<std::string>();
+        }
+        uint32_t service_id = g_strings.intern(service);
+
+        const char* scopes_key = rs.contains("scopeSpans") ? "scopeSpans" : "instrumentationLibrarySpans";
+        for (const json& ss : member(rs, scopes_key)) {
+            for (const json& s : member(ss, "spans")) {
+                Span span;
+                span.trace = parse_trace_id(s.value("traceId", ""));
+                span.span_id = parse_hex(s.value("spanId", ""), 0, 16);
+                span.parent_id = parse_hex(s.value("parentSpanId", ""), 0, 16);
+                span.name = g_strings.intern(s.value("name", ""));
+                span.service = service_id;
+                int64_t kind = s.contains("kind") ? json_int(s["kind"]) : 1;  // SPAN_KIND_INTERNAL
+                span.kind = kind >= 1 && kind <= 5 ? static_cast<uint8_t>(kind - 1) : uint8_t(KIND_INTERNAL);
+                span.start_ns = s.contains("startTimeUnixNano") ? json_int(s["startTimeUnixNano"]) : 0;
+                span.end_ns = s.contains("endTimeUnixNano") ? json_int(s["endTimeUnixNano"]) : span.start_ns;
+                if (s.contains("status") && s["status"].contains("code")) {
+                    const json& code = s["status"]["code"];
+                    span.error = code.is_string() ? code.get<std::string>() == "STATUS_CODE_ERROR" : json_int(code) == 2;
+                }
+                for (const json& a : member(s, "attributes")) {
+                    const json* v = otlp_value(member(a, "value"));
+                    if (v) apply_attribute(span, a.value("key", ""), *v);
+                }
+                for (const json& l : member(s, "links")) {
+                    span.links.push_back(parse_hex(l.value("spanId", ""), 0, 16));
+                }
+                if (span.kind == KIND_CONSUMER && span.op == OP_NONE) span.op = OP_RECEIVE;
+                if (span.kind == KIND_PRODUCER && span.op == OP_NONE) span.op = OP_SEND;
+                if (span.span_id) out.push_back(std::move(span));
+            }
+        }
+    }
+}
+
+// ============ Input ============
+
+// One input file, read a line (= one batch of spans) at a time
+class Input {
+public:
+    explicit Input(const char* path) : path_(path), stream_(path) {
+        service_ = g_strings.intern("unknown");
+    }
+
+    bool ok() const { return stream_.is_open(); }
+    const char* path() const { return path_.c_str(); }
+    size_t bad_lines() const { return bad_lines_; }
+
+    // Next batch of spans, false at end of file
+    bool next(std::vector<Span>& batch) {
+        batch.clear();
+        std::string line;
+        while (batch.empty() && std::getline(stream_, line)) {
+            if (line.empty()) continue;
+            json j = json::parse(line, nullptr, false);
+            if (j.is_discarded() || !j.is_object()) {
+                bad_lines_++;
+                continue;
+            }
+            if (j.contains("resourceSpans")) {
+                parse_otlp(j, batch);
+            } else if (j.contains("trace_id")) {
+                Span span;
+                if (parse_flight_span(j, service_, span)) batch.push_back(std::move(span));
+            } else if (j.contains("service")) {
+                service_ = g_strings.intern(j["service"].get<std::string>());  // flight recorder header
+            }
+        }
+        return !batch.empty();
+    }
+
+private:
+    std::string path_;
+    std::ifstream stream_;
+    uint32_t service_;
+    size_t bad_lines_ = 0;
+};
+
+// ============ Statistics ============
+
+/**
+ * Log-linear latency histogram: 8 buckets per power of two from 1us, so
+ * percentiles are within ~6% at any count with a fixed 2 KB footprint.
+ */
+class Histogram {
+public:
+    void add(int64_t ns) {
+        count_++;
+        if (ns < 0) {
+            negative_++;
+            ns = 0;
+        }
+        sum_ns_ += ns;
+        max_ns_ = std::max(max_ns_, ns);
+        buckets_[index(static_cast<uint64_t>(ns) / 1000)]++;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t negative() const { return negative_; }
+    double max_ms() const { return max_ns_ / 1e6; }
+    double mean_ms() const { return count_ ? sum_ns_ / 1e6 / count_ : 0.0; }
+
+    double percentile_ms(double q) const {
+        if (count_ == 0) return 0.0;
+        uint64_t target = static_cast<uint64_t>(q * (count_ - 1));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets_[i];
+            if (seen > target) return std::min(upper_us(i) / 1000.0, max_ms());
+        }
+        return max_ms();
+    }
+
+private:
+    static constexpr int SUB = 8;
+    static constexpr int BUCKETS = 1 + 64 * SUB;
+
+    static int index(uint64_t us) {
+        if (us == 0) return 0;
+        int octave = 63 - __builtin_clzll(us);
+        uint64_t sub = octave >= 3 ? (us >> (octave - 3)) & (SUB - 1) : (us << (3 - octave)) & (SUB - 1);
+        return 1 + octave * SUB + static_cast<int>(sub);
+    }
+
+    static double upper_us(int i) {
+        if (i == 0) return 1.0;
+        int octave = (i - 1) / SUB;
+        int sub = (i - 1) % SUB;
+        return static_cast<double>((uint64_t)(SUB + sub + 1) << octave) / SUB;
+    }
+
+    uint64_t buckets_[BUCKETS] = {0};
+    uint64_t count_ = 0;
+    uint64_t negative_ = 0;
+    double sum_ns_ = 0.0;
+    int64_t max_ns_ = 0;
+};
+
+struct HopStats {
+    Histogram transit;      // send -> take (or -> receive start without attributes)
+    Histogram queue;        // take -> callback start
+    Histogram processing;   // receive callback
+};
+
+struct FanInStats {
+    Histogram inputs_wait;  // last input sent -> fan-in span start
+    Histogram input_age;    // first input sent -> fan-in span start
+    uint64_t inputs = 0;
+    uint64_t unresolved = 0;
+};
+
+// Link targets: the last N spans seen, with the times fan-in analysis needs
+class LinkIndex {
+public:
+    struct Entry {
+        int64_t start_ns;
+        int64_t end_ns;
+        uint32_t name;
+        uint32_t service;
+    };
+
+    explicit LinkIndex(size_t capacity) : capacity_(capacity) { index_.reserve(capacity); }
+
+    void add(const Span& span) {
+        if (capacity_ == 0) return;
+        if (order_.size() == capacity_) {
+            index_.erase(order_.front());
+            order_.pop_front();
+        }
+        if (index_.emplace(span.span_id, Entry{span.start_ns, span.end_ns, span.name, span.service}).second) {
+            order_.push_back(span.span_id);
+        }
+    }
+
+    const Entry* find(uint64_t span_id) const {
+        auto it = index_.find(span_id);
+        return it == index_.end() ? nullptr : &it->second;
+    }
+
+private:
+    size_t capacity_;
+    std::unordered_map<uint64_t, Entry> index_;
+    std::deque<uint64_t> order_;
+};
+
+// ============ Analysis ============
+
+class Analyzer {
+public:
+    Analyzer(int64_t window_ns, size_t max_open, size_t link_capacity, size_t keep_traces)
+        : window_ns_(window_ns), max_open_(max_open), links_(link_capacity), keep_traces_(keep_traces) {}
+
+    void add(Span&& span) {
+        spans_++;
+        links_.add(span);
+        watermark_ns_ = std::max(watermark_ns_, span.start_ns);
+
+        OpenTrace& trace = open_[span.trace];
+        trace.last_ns = std::max(trace.last_ns, span.end_ns);
+        expiry_.push_back({span.trace, trace.last_ns});
+        trace.spans.push_back(std::move(span));
+
+        close_expired();
+    }
+
+    void finish() {
+        while (!open_.empty()) close(open_.begin());
+        expiry_.clear();
+    }
+
+    void print(FILE* out) const;
+    bool write_perfetto(const char* path) const;
+
+private:
+    struct OpenTrace {
+        int64_t last_ns = 0;
+        std::vector<Span> spans;
+    };
+
+    struct Pending {
+        TraceId trace;
+        int64_t last_ns;
+    };
+
+    struct Kept {
+        int64_t e2e_ns;
+        std::vector<Span> spans;
+        std::vector<uint64_t> critical;     // span ids on the critical path
+        bool operator>(const Kept& o) const { return e2e_ns > o.e2e_ns; }
+    };
+
+    using OpenMap = std::unordered_map<TraceId, OpenTrace, TraceIdHash>;
+
+    void close_expired() {
+        while (!expiry_.empty()) {
+            const Pending& p = expiry_.front();
+            auto it = open_.find(p.trace);
+            if (it == open_.end() || it->second.last_ns != p.last_ns) {
+                expiry_.pop_front();  // trace closed already, or a later span re-queued it
+                continue;
+            }
+            if (p.last_ns >= watermark_ns_ - window_ns_ && open_.size() <= max_open_) break;
+            if (p.last_ns >= watermark_ns_ - window_ns_) early_closed_++;
+            expiry_.pop_front();
+            close(it);
+        }
+    }
+
+    void close(OpenMap::iterator it) {
+        analyze(it->second.spans);
+        open_.erase(it);
+    }
+
+    static std::string label(const Span& s) {
+        return g_strings[s.service] + "/" + g_strings[s.name];
+    }
+
+    void analyze(std::vector<Span>& spans) {
+        traces_++;
+        std::unordered_map<uint64_t, size_t> by_id;
+        by_id.reserve(spans.size());
+        for (size_t i = 0; i < spans.size(); i++) by_id[spans[i].span_id] = i;
+
+        int64_t start = INT64_MAX;
+        size_t last = 0;
+        size_t roots = 0;
+        size_t orphans = 0;
+        bool error = false;
+        for (size_t i = 0; i < spans.size(); i++) {
+            start = std::min(start, spans[i].start_ns);
+            if (spans[i].end_ns > spans[last].end_ns) last = i;
+            if (spans[i].parent_id == 0) roots++;
+            else if (!by_id.count(spans[i].parent_id)) orphans++;
+            error |= spans[i].error;
+        }
+        if (roots != 1 || orphans) incomplete_++;
+        if (error) errors_++;
+
+        // Critical path: the ancestor chain of the span that ends last
+        std::vector<size_t> path;
+        for (size_t i = last;;) {
+            path.push_back(i);
+            auto parent = by_id.find(spans[i].parent_id);
+            if (spans[i].parent_id == 0 || parent == by_id.end() || path.size() > spans.size()) break;
+            i = parent->second;
+        }
+        std::reverse(path.begin(), path.end());
+
+        int64_t e2e = spans[last].end_ns - start;
+        std::string signature;
+        for (size_t k = 0; k < path.size(); k++) {
+            const Span& s = spans[path[k]];
+            if (k) signature += " > ";
+            signature += label(s);
+
+            if (!s.links.empty()) fan_in(s);
+
+            // Self time on the path: until the next span on the path starts. A send span
+            // followed by its receive counts only the write; the rest is the hop's transit.
+            const Span* next = k + 1 < path.size() ? &spans[path[k + 1]] : nullptr;
+            int64_t self = next && next->op != OP_RECEIVE ? next->start_ns - s.start_ns : s.end_ns - s.start_ns;
+            stat(span_stats_, label(s)).add(self);
+
+            if (k > 0 && s.op == OP_RECEIVE) {
+                const Span& sender = spans[path[k - 1]];
+                HopStats& hop = stat(hop_stats_, label(sender) + " -> " + label(s));
+                hop.transit.add(s.transit_ns >= 0 ? s.transit_ns : s.start_ns - sender.start_ns);
+                if (s.queue_ns >= 0) hop.queue.add(s.queue_ns);
+                hop.processing.add(s.end_ns - s.start_ns);
+            }
+        }
+        stat(path_stats_, signature).add(e2e);
+
+        if (keep_traces_ > 0 && (kept_.size() < keep_traces_ || e2e > kept_.top().e2e_ns)) {
+            Kept kept;
+            kept.e2e_ns = e2e;
+            for (size_t i : path) kept.critical.push_back(spans[i].span_id);
+            kept.spans = std::move(spans);
+            kept_.push(std::move(kept));
+            if (kept_.size() > keep_traces_) kept_.pop();
+        }
+    }
+
+    void fan_in(const Span& s) {
+        FanInStats& f = stat(fan_in_stats_, label(s));
+        int64_t first = INT64_MAX;
+        int64_t latest = INT64_MIN;
+        for (uint64_t id : s.links) {
+            const LinkIndex::Entry* e = links_.find(id);
+            if (!e) {
+                f.unresolved++;
+                continue;
+            }
+            f.inputs++;
+            first = std::min(first, e->start_ns);
+            latest = std::max(latest, e->end_ns);
+        }
+        if (latest == INT64_MIN) return;
+        f.inputs_wait.add(s.start_ns - latest);
+        f.input_age.add(s.start_ns - first);
+    }
+
+    // Distinct keys are bounded so that a stray high-cardinality span name cannot grow memory
+    template<typename T>
+    T& stat(std::map<std::string, T>& stats, const std::string& key) {
+        auto it = stats.find(key);
+        if (it != stats.end()) return it->second;
+        if (stats.size() >= MAX_KEYS) return stats["(other)"];
+        return stats[key];
+    }
+
+    static constexpr size_t MAX_KEYS = 2000;
+
+    int64_t window_ns_;
+    size_t max_open_;
+    LinkIndex links_;
+    size_t keep_traces_;
+
+    OpenMap open_;
+    std::deque<Pending> expiry_;
+    int64_t watermark_ns_ = INT64_MIN;
+
+    uint64_t spans_ = 0;
+    uint64_t traces_ = 0;
+    uint64_t errors_ = 0;
+    uint64_t incomplete_ = 0;
+    uint64_t early_closed_ = 0;
+
+    std::map<std::string, Histogram> path_stats_;
+    std::map<std::string, Histogram> span_stats_;
+    std::map<std::string, HopStats> hop_stats_;
+    std::map<std::string, FanInStats> fan_in_stats_;
+    std::priority_queue<Kept, std::vector<Kept>, std::greater<Kept>> kept_;   // slowest traces
+};
+
+template<typename T>
+static std::vector<std::pair<std::string, const T*>> by_count(
+        const std::map<std::string, T>& stats, std::function<uint64_t(const T&)> count) {
+    std::vector<std::pair<std::string, const T*>> out;
+    for (const auto& s : stats) out.push_back({s.first, &s.second});
+    std::sort(out.begin(), out.end(), [&](const auto& a, const auto& b) {
+        return count(*a.second) > count(*b.second);
+    });
+    return out;
+}
+
+void Analyzer::print(FILE* out) const {
+    fprintf(out, "traces: %llu from %llu spans (%llu with errors, %llu incomplete",
+            (unsigned long long)traces_, (unsigned long long)spans_,
+            (unsigned long long)errors_, (unsigned long long)incomplete_);
+    if (early_closed_) fprintf(out, ", %llu closed early by --max-open", (unsigned long long)early_closed_);
+    fprintf(out, ")\n");
+
+    fprintf(out, "\n=== Critical paths (end-to-end ms) ===\n");
+    fprintf(out, "%10s %9s %9s %9s %9s  %s\n", "traces", "p50", "p90", "p99", "max", "path");
+    for (const auto& p : by_count<Histogram>(path_stats_, [](const Histogram& h) { return h.count(); })) {
+        const Histogram& h = *p.second;
+        fprintf(out, "%10llu %9.3f %9.3f %9.3f %9.3f  %s\n", (unsigned long long)h.count(),
+                h.percentile_ms(0.5), h.percentile_ms(0.9), h.percentile_ms(0.99), h.max_ms(), p.first.c_str());
+    }
+
+    fprintf(out, "\n=== DDS hops on the critical path (ms, p50 / p99) ===\n");
+    fprintf(out, "%10s %19s %19s %19s  %s\n", "count", "transit", "queue", "processing", "hop");
+    for (const auto& p : by_count<HopStats>(hop_stats_, [](const HopStats& h) { return h.transit.count(); })) {
+        const HopStats& h = *p.second;
+        char queue[32] = "-";
+        if (h.queue.count()) snprintf(queue, sizeof(queue), "%.3f / %.3f", h.queue.percentile_ms(0.5), h.queue.percentile_ms(0.99));
+        fprintf(out, "%10llu %8.3f / %8.3f %19s %8.3f / %8.3f  %s", (unsigned long long)h.transit.count(),
+                h.transit.percentile_ms(0.5), h.transit.percentile_ms(0.99), queue,
+                h.processing.percentile_ms(0.5), h.processing.percentile_ms(0.99), p.first.c_str());
+        if (h.transit.negative()) fprintf(out, "  (%llu negative transit: clock offset)", (unsigned long long)h.transit.negative());
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "\n=== Self time on the critical path (ms) ===\n");
+    fprintf(out, "%10s %9s %9s %9s %9s  %s\n", "count", "mean", "p50", "p99", "max", "span");
+    for (const auto& p : by_count<Histogram>(span_stats_, [](const Histogram& h) { return h.count(); })) {
+        const Histogram& h = *p.second;
+        fprintf(out, "%10llu %9.3f %9.3f %9.3f %9.3f  %s\n", (unsigned long long)h.count(), h.mean_ms(),
+                h.percentile_ms(0.5), h.percentile_ms(0.99), h.max_ms(), p.first.c_str());
+    }
+
+    if (fan_in_stats_.empty()) return;
+    fprintf(out, "\n=== Fan-in (ms, p50 / p99) ===\n");
+    fprintf(out, "%10s %8s %10s %19s %19s  %s\n", "count", "inputs", "unresolved",
+            "last input wait", "oldest input age", "span");
+    for (const auto& p : by_count<FanInStats>(fan_in_stats_, [](const FanInStats& f) { return f.inputs_wait.count(); })) {
+        const FanInStats& f = *p.second;
+        double per = f.inputs_wait.count() ? (double)f.inputs / f.inputs_wait.count() : 0.0;
+        fprintf(out, "%10llu %8.1f %10llu %8.3f / %8.3f %8.3f / %8.3f  %s\n",
+                (unsigned long long)f.inputs_wait.count(), per, (unsigned long long)f.unresolved,
+                f.inputs_wait.percentile_ms(0.5), f.inputs_wait.percentile_ms(0.99),
+                f.input_age.percentile_ms(0.5), f.input_age.percentile_ms(0.99), p.first.c_str());
+    }
+}
+
+/**
+ * Chrome trace event JSON (ui.perfetto.dev, chrome://tracing): one process per
+ * service, one thread per kept trace, flow arrows for parent -> child across
+ * services. Critical path spans carry "critical": true.
+ */
+bool Analyzer::write_perfetto(const char* path) const {
+    auto kept = kept_;  // copy: popping yields fastest first
+    std::vector<Kept> traces;
+    while (!kept.empty()) {
+        traces.push_back(kept.top());
+        kept.pop();
+    }
+    std::reverse(traces.begin(), traces.end());
+
+    int64_t origin = INT64_MAX;
+    for (const Kept& t : traces) {
+        for (const Span& s : t.spans) origin = std::min(origin, s.start_ns);
+    }
+    auto us = [origin](int64_t ns) { return (ns - origin) / 1000.0; };
+
+    json events = json::array();
+    std::map<uint32_t, int> pids;
+    auto pid_of = [&](uint32_t service) {
+        auto it = pids.find(service);
+        if (it != pids.end()) return it->second;
+        int pid = static_cast<int>(pids.size()) + 1;
+        pids[service] = pid;
+        events.push_back({{"ph", "M"}, {"name", "process_name"}, {"pid", pid},
+                          {"args", {{"name", g_strings[service]}}}});
+        return pid;
+    };
+
+    uint64_t flow_id = 0;
+    for (size_t t = 0; t < traces.size(); t++) {
+        const Kept& trace = traces[t];
+        int tid = static_cast<int>(t) + 1;
+        char trace_hex[33];
+        snprintf(trace_hex, sizeof(trace_hex), "%016llx%016llx",
+                 (unsigned long long)trace.spans[0].trace.hi, (unsigned long long)trace.spans[0].trace.lo);
+        char thread_name[96];
+        snprintf(thread_name, sizeof(thread_name), "#%zu %.3f ms %.8s", t + 1, trace.e2e_ns / 1e6, trace_hex);
+
+        std::unordered_map<uint64_t, const Span*> by_id;
+        for (const Span& s : trace.spans) by_id[s.span_id] = &s;
+        std::map<int, bool> named;
+
+        for (const Span& s : trace.spans) {
+            int pid = pid_of(s.service);
+            if (!named[pid]) {
+                named[pid] = true;
+                events.push_back({{"ph", "M"}, {"name", "thread_name"}, {"pid", pid}, {"tid", tid},
+                                  {"args", {{"name", thread_name}}}});
+            }
+            char span_hex[17];
+            snprintf(span_hex, sizeof(span_hex), "%016llx", (unsigned long long)s.span_id);
+            bool critical = std::find(trace.critical.begin(), trace.critical.end(), s.span_id) != trace.critical.end();
+            json args = {{"trace_id", trace_hex}, {"span_id", span_hex}, {"critical", critical}};
+            if (s.error) args["error"] = true;
+            if (s.transit_ns >= 0) args["transit_ms"] = s.transit_ns / 1e6;
+            if (s.queue_ns >= 0) args["queue_ms"] = s.queue_ns / 1e6;
+            events.push_back({{"ph", "X"}, {"name", g_strings[s.name]}, {"cat", critical ? "critical" : "span"},
+                              {"pid", pid}, {"tid", tid}, {"ts", us(s.start_ns)},
+                              {"dur", (s.end_ns - s.start_ns) / 1000.0}, {"args", args}});
+
+            auto parent = by_id.find(s.parent_id);
+            if (parent != by_id.end() && parent->second->service != s.service) {
+                flow_id++;
+                events.push_back({{"ph", "s"}, {"name", "dds"}, {"cat", "hop"}, {"id", flow_id},
+                                  {"pid", pid_of(parent->second->service)}, {"tid", tid},
+                                  {"ts", us(parent->second->start_ns)}});
+                events.push_back({{"ph", "f"}, {"bp", "e"}, {"name", "dds"}, {"cat", "hop"}, {"id", flow_id},
+                                  {"pid", pid}, {"tid", tid}, {"ts", us(s.start_ns)}});
+            }
+        }
+    }
+
+    std::ofstream out(path);
+    if (!out) return false;
+    out << json({{"traceEvents", events}, {"displayTimeUnit", "ms"}}).dump() << "\n";
+    return static_cast<bool>(out);
+}
+
+// ============ Main ============
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [--perfetto out.json] [--perfetto-traces N] [--window-s N] "
+                    "[--max-open N] [--link-index N] <file>...\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    const char* perfetto = NULL;
+    long keep_traces = 50;
+    long window_s = 30;
+    long max_open = 100000;
+    long link_index = 500000;
+    std::vector<std::unique_ptr<Input>> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        auto value = [&](long& v) {
+            if (i + 1 >= argc) return false;
+            v = atol(argv[++i]);
+            return v >= 0;
+        };
+        bool ok = true;
+        if (strcmp(argv[i], "--perfetto") == 0 && i + 1 < argc) perfetto = argv[++i];
+        else if (strcmp(argv[i], "--perfetto-traces") == 0) ok = value(keep_traces);
+        else if (strcmp(argv[i], "--window-s") == 0) ok = value(window_s);
+        else if (strcmp(argv[i], "--max-open") == 0) ok = value(max_open);
+        else if (strcmp(argv[i], "--link-index") == 0) ok = value(link_index);
+        else if (argv[i][0] == '-') ok = false;
+        else {
+            inputs.emplace_back(new Input(argv[i]));
+            if (!inputs.back()->ok()) {
+                fprintf(stderr, "Cannot open %s\n", argv[i]);
+                return 1;
+            }
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Analyzer analyzer(window_s * 1000000000LL, static_cast<size_t>(max_open),
+                      static_cast<size_t>(link_index), perfetto ? static_cast<size_t>(keep_traces) : 0);
+
+    // k-way merge: always consume the batch that starts earliest
+    struct Head {
+        int64_t start_ns;
+        size_t input;
+        bool operator>(const Head& o) const { return start_ns > o.start_ns; }
+    };
+    std::vector<std::vector<Span>> batches(inputs.size());
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    auto refill = [&](size_t i) {
+        if (!inputs[i]->next(batches[i])) return;
+        int64_t start = INT64_MAX;
+        for (const Span& s : batches[i]) start = std::min(start, s.start_ns);
+        heads.push({start, i});
+    };
+    for (size_t i = 0; i < inputs.size(); i++) refill(i);
+
+    while (!heads.empty()) {
+        size_t i = heads.top().input;
+        heads.pop();
+        std::sort(batches[i].begin(), batches[i].end(),
+                  [](const Span& a, const Span& b) { return a.start_ns < b.start_ns; });
+        for (Span& s : batches[i]) analyzer.add(std::move(s));
+        refill(i);
+    }
+    analyzer.finish();
+
+    for (const auto& input : inputs) {
+        if (input->bad_lines()) fprintf(stderr, "%s: %zu unparsable lines skipped\n", input->path(), input->bad_lines());
+    }
+
+    analyzer.print(stdout);
+    if (perfetto) {
+        if (!analyzer.write_perfetto(perfetto)) {
+            fprintf(stderr, "Cannot write %s\n", perfetto);
+            return 1;
+        }
+        printf("\nPerfetto trace: %s (open in https://ui.perfetto.dev)\n", perfetto);
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+// Business-key lookup in the local trace index (traced_index.hpp).
+//
+// Usage: app [options] <key>...
+//   --dir <path>       segment directory (default: $TRACED_INDEX_DIR or /index)
+//   --field <name>     only records of this field (default: any)
+//   --since-s N        only records of the last N seconds
+//   --limit N          newest N records per key (default: 100)
+//   --stats            list the segments instead of looking up keys
+//
+// Prints one line per record, oldest first: time, service, field, key,
+// trace id, span id. Paste the trace id into Jaeger's trace lookup.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "traced_index.hpp"
+
+using traced::index::Record;
+using traced::index::Segment;
+
+struct Hit {
+    const Record* record;
+    const Segment* segment;
+};
+
+static void hex(const uint8_t* bytes, size_t n, char* out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < n; i++) {
+        out[2 * i] = digits[bytes[i] >> 4];
+        out[2 * i + 1] = digits[bytes[i] & 0xf];
+    }
+    out[2 * n] = '\0';
+}
+
+static void format_time(int64_t ns, char* out, size_t size) {
+    time_t secs = static_cast<time_t>(ns / 1000000000LL);
+    struct tm tm;
+    gmtime_r(&secs, &tm);
+    size_t len = strftime(out, size, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(out + len, size - len, ".%03dZ", static_cast<int>(ns / 1000000 % 1000));
+}
+
+static void print_stats(const std::vector<std::unique_ptr<Segment>>& segments) {
+    printf("%-48s %-24s %8s %10s %8s %s\n", "segment", "start", "pid", "records", "dropped", "state");
+    for (const auto& segment : segments) {
+        const traced::index::Header* h = segment->header();
+        char start[32];
+        format_time(h->start_ns, start, sizeof(start));
+        const char* name = strrchr(segment->path().c_str(), '/');
+        printf("%-48s %-24s %8u %10u %8llu %s\n", name ? name + 1 : segment->path().c_str(), start,
+               h->pid, segment->count(), static_cast<unsigned long long>(h->dropped),
+               h->end_ns ? "closed" : "open");
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* env_dir = getenv("TRACED_INDEX_DIR");
+    std::string dir = env_dir && *env_dir ? env_dir : "/index";
+    const char* field = nullptr;
+    int64_t since_s = 0;
+    size_t limit = 100;
+    bool stats = false;
+    std::vector<const char*> keys;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (strcmp(argv[i], "--field") == 0 && i + 1 < argc) {
+            field = argv[++i];
+        } else if (strcmp(argv[i], "--since-s") == 0 && i + 1 < argc) {
+            since_s = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc) {
+            limit = static_cast<size_t>(atol(argv[++i]));
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "usage: %s [--dir D] [--field F] [--since-s N] [--limit N] [--stats] <key>...\n", argv[0]);
+            return 2;
+        } else {
+            keys.push_back(argv[i]);
+        }
+    }
+    if (keys.empty() && !stats) {
+        fprintf(stderr, "usage: %s [--dir D] [--field F] [--since-s N] [--limit N] [--stats] <key>...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<std::unique_ptr<Segment>> segments;
+    for (const std::string& path : traced::index::segment_files(dir)) {
+        auto segment = std::make_unique<Segment>(path);
+        if (segment->valid()) segments.push_back(std::move(segment));
+    }
+    if (segments.empty()) {
+        fprintf(stderr, "No index segments in %s\n", dir.c_str());
+        return 1;
+    }
+    if (stats) {
+        print_stats(segments);
+        return 0;
+    }
+
+    int64_t since_ns = 0;
+    if (since_s > 0) {
+        since_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count() - since_s * 1000000000LL;
+    }
+
+    int status = 1;
+    for (const char* key : keys) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Hit> hits;
+        for (const auto& segment : segments) {
+            // Segments that ended before the window cannot hold a match
+            const traced::index::Header* h = segment->header();
+            if (since_ns && h->end_ns && h->end_ns < since_ns) continue;
+            segment->find(key, field, [&](const Record& r) {
+                if (r.timestamp_ns >= since_ns) hits.push_back({&r, segment.get()});
+            });
+        }
+        std::sort(hits.begin(), hits.end(), [](const Hit& a, const Hit& b) {
+            return a.record->timestamp_ns < b.record->timestamp_ns;
+        });
+        if (hits.size() > limit) hits.erase(hits.begin(), hits.end() - limit);
+        double lookup_us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count();
+
+        for (const Hit& hit : hits) {
+            char when[32], trace_id[33], span_id[17];
+            format_time(hit.record->timestamp_ns, when, sizeof(when));
+            hex(hit.record->trace_id, sizeof(hit.record->trace_id), trace_id);
+            hex(hit.record->span_id, sizeof(hit.record->span_id), span_id);
+            printf("%s  %-20s %-18s %-24s %s %s\n", when, hit.segment->header()->service,
+                   hit.record->field, hit.record->key, trace_id, span_id);
+        }
+        printf("# %s: %zu records, %zu segments, %.1f us\n", key, hits.size(), segments.size(), lookup_us);
+        if (!hits.empty()) status = 0;
+    }
+    return status;
+}
@@ -0,0 +1,111 @@
+// Sends a ServiceControl command to running traced services and prints
+// their ServiceControlStatus replies.
+//
+// Usage: app <command> [target-service|*] [argument]
+//   app flight-recorder-dump               # every traced service
+//   app flight-recorder-dump track-fusion  # one service
+//   app set track-fusion take-batch=32,fusion-window-ms=5000
+//   app set '*' sampling-ratio=0.05        # see include/traced_config.hpp
+//   app get '*'
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "traced_dds.hpp"
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "usage: %s <command> [target-service|*] [argument]\n", argv[0]);
+        return 1;
+    }
+
+    dds_entity_t participant = dds_create_participant(DDS_DOMAIN_DEFAULT, NULL, NULL);
+    if (participant < 0) {
+        fprintf(stderr, "Failed to create participant!\n");
+        return 1;
+    }
+
+    dds_entity_t topic = dds_create_topic(participant, &traced_ServiceControl_desc,
+                                          traced::CONTROL_TOPIC, NULL, NULL);
+    dds_entity_t status_topic = dds_create_topic(participant, &traced_ServiceControlStatus_desc,
+                                                 traced::CONTROL_STATUS_TOPIC, NULL, NULL);
+    dds_qos_t* qos = traced::internal::create_control_qos();
+    dds_entity_t writer = dds_create_writer(participant, topic, qos, NULL);
+    dds_entity_t status_reader = dds_create_reader(participant, status_topic, qos, NULL);
+    dds_delete_qos(qos);
+
+    // Give discovery time to match every service's control reader: the
+    // count a broadcast waits for is taken once it held for 500 ms (3 s at most)
+    dds_publication_matched_status_t matched;
+    matched.current_count = 0;
+    uint32_t last_count = 0;
+    int stable = 0;
+    for (int i = 0; i < 30 && !(matched.current_count > 0 && stable >= 5); i++) {
+        struct timespec ts = {0, 100000000};
+        nanosleep(&ts, NULL);
+        dds_get_publication_matched_status(writer, &matched);
+        stable = matched.current_count == last_count ? stable + 1 : 0;
+        last_count = matched.current_count;
+    }
+    if (matched.current_count == 0) {
+        fprintf(stderr, "No traced service is listening on %s\n", traced::CONTROL_TOPIC);
+        dds_delete(participant);
+        return 1;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    traced_ServiceControl cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.command = argv[1];
+    cmd.target_service = (char*)(argc > 2 ? argv[2] : "*");
+    cmd.argument = (char*)(argc > 3 ? argv[3] : "");
+    cmd.timestamp_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+    cmd.command_id = (cmd.timestamp_ns << 16) ^ getpid();
+
+    dds_return_t ret = dds_write(writer, &cmd);
+    if (ret >= 0) ret = dds_wait_for_acks(writer, DDS_SECS(3));
+
+    printf("%s -> %s (%u listening): %s\n", cmd.command, cmd.target_service,
+           matched.current_count, ret >= 0 ? "sent" : "failed");
+    if (ret < 0) {
+        dds_delete(participant);
+        return 1;
+    }
+
+    // One reply per addressed service; a broadcast waits for every listener
+    uint32_t expected = strcmp(cmd.target_service, "*") == 0 ? matched.current_count : 1;
+    uint32_t replies = 0;
+    bool all_ok = true;
+    dds_time_t deadline = dds_time() + DDS_SECS(3);
+    while (replies < expected && dds_time() < deadline) {
+        void* samples[8] = {nullptr};
+        dds_sample_info_t infos[8];
+        dds_return_t n = dds_take(status_reader, samples, infos, 8, 8);
+        for (int i = 0; i < n; i++) {
+            if (!infos[i].valid_data) continue;
+            const traced_ServiceControlStatus* status = static_cast<traced_ServiceControlStatus*>(samples[i]);
+            if (status->command_id != cmd.command_id) continue;
+            printf("  %-20s %s v%u %s\n", status->service, status->ok ? "ok    " : "FAILED",
+                   status->config_version, status->message);
+            all_ok = all_ok && status->ok;
+            replies++;
+        }
+        if (n > 0) {
+            dds_return_loan(status_reader, samples, n);
+        } else {
+            struct timespec ts = {0, 20000000};
+            nanosleep(&ts, NULL);
+        }
+    }
+    if (replies < expected) {
+        fprintf(stderr, "%u of %u services replied\n", replies, expected);
+    }
+
+    dds_delete(participant);
+    return replies > 0 && all_ok ? 0 : 1;
+}